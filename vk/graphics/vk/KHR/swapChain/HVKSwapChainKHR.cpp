@@ -8,6 +8,15 @@ namespace hinode
 {
 	namespace graphics
 	{
+		namespace
+		{
+			//r[C[W̎gp@
+			const VkImageUsageFlags sViewUsageMask = VK_IMAGE_USAGE_SAMPLED_BIT
+				| VK_IMAGE_USAGE_STORAGE_BIT
+				| VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+				| VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+		}
+
 		void HVKSwapChainKHR::sCreateSharedSwapchains(std::vector<VkSwapchainKHR>* pOut, VkDevice device, uint32_t count, const VkSwapchainCreateInfoKHR* pCreateInfos, const VkAllocationCallbacks* allocationCallback)
 		{
 			pOut->resize(count);
@@ -64,21 +73,36 @@ namespace hinode
 		HVKSwapChainKHR::HVKSwapChainKHR()
 			: mSwapChain(nullptr)
 			, mParentDevice(nullptr)
-		{ }
+			, mImageCount(0)
+			, mImageFormat(VK_FORMAT_UNDEFINED)
+		{
+			this->mImageExtent.width = 0;
+			this->mImageExtent.height = 0;
+			this->mImageViews.fill(VK_NULL_HANDLE);
+		}
 
 		HVKSwapChainKHR::HVKSwapChainKHR(HVKSwapChainKHR&& right)noexcept
+			: HVKSwapChainKHR()
 		{
-			this->mSwapChain = right.mSwapChain;
-			this->mParentDevice = right.mParentDevice;
+			*this = std::move(right);
 		}
 
 		HVKSwapChainKHR& HVKSwapChainKHR::operator=(HVKSwapChainKHR&& right)noexcept
 		{
+			this->release();
+
 			this->mSwapChain = right.mSwapChain;
 			this->mParentDevice = right.mParentDevice;
+			this->mImageCount = right.mImageCount;
+			this->mImageFormat = right.mImageFormat;
+			this->mImageExtent = right.mImageExtent;
+			this->mImages = std::move(right.mImages);
+			this->mImageViews = right.mImageViews;
 
 			right.mSwapChain = nullptr;
 			right.mParentDevice = nullptr;
+			right.mImageCount = 0;
+			right.mImageViews.fill(VK_NULL_HANDLE);
 			return *this;
 		}
 
@@ -89,11 +113,8 @@ namespace hinode
 
 		void HVKSwapChainKHR::release()noexcept
 		{
-			if (this->mSwapChain != nullptr) {
-				vkDestroySwapchainKHR(this->mParentDevice, this->mSwapChain, this->allocationCallbacksPointer());
-				this->mSwapChain = nullptr;
-				this->mParentDevice = nullptr;
-			}
+			this->destroySwapChain();
+			this->mParentDevice = nullptr;
 		}
 
 		void HVKSwapChainKHR::create(VkDevice device, VkSwapchainCreateInfoKHR* pCreateInfo)
@@ -103,6 +124,137 @@ namespace hinode
 				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKSwapChainKHR, create, ret);
 			}
 			this->mParentDevice = device;
+
+			try {
+				std::array<VkImage, sMaxImageCount> images;
+				auto count = this->getImages(this->mSwapChain, &images);
+				this->refreshImages(*pCreateInfo, count, images);
+			} catch (...) {
+				this->release();
+				throw;
+			}
+		}
+
+		void HVKSwapChainKHR::recreate(VkSwapchainCreateInfoKHR* pCreateInfo)
+		{
+			assert(nullptr != this->mParentDevice);
+
+			//oldSwapchainɓn͍̂쐬ɎsĂp~AxoldSwapchainɓnƂ͂łȂ.
+			//̂߈ȍ~̎sł͂ǂÂ̂jǍĂяołVK_NULL_HANDLEn
+			pCreateInfo->oldSwapchain = this->mSwapChain;
+			VkSwapchainKHR swapChain;
+			auto ret = vkCreateSwapchainKHR(this->mParentDevice, pCreateInfo, this->allocationCallbacksPointer(), &swapChain);
+			pCreateInfo->oldSwapchain = VK_NULL_HANDLE;
+			if (VK_SUCCESS != ret) {
+				this->destroySwapChain();
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKSwapChainKHR, recreate, ret) << "蒼Ɏs܂";
+			}
+
+			//C[W̐m߂ĂÂXbv`FCj
+			std::array<VkImage, sMaxImageCount> images;
+			uint32_t count;
+			try {
+				count = this->getImages(swapChain, &images);
+			} catch (...) {
+				vkDestroySwapchainKHR(this->mParentDevice, swapChain, this->allocationCallbacksPointer());
+				this->destroySwapChain();
+				throw;
+			}
+
+			//ÂC[W̃r[ĂÂXbv`FCj
+			this->destroyImageViews();
+			for (auto i = 0u; i < this->mImageCount; ++i) {
+				this->mImages[i].releaseViews();
+			}
+			if (nullptr != this->mSwapChain) {
+				vkDestroySwapchainKHR(this->mParentDevice, this->mSwapChain, this->allocationCallbacksPointer());
+			}
+			this->mSwapChain = swapChain;
+
+			try {
+				this->refreshImages(*pCreateInfo, count, images);
+			} catch (...) {
+				this->clearImages();
+				throw;
+			}
+		}
+
+		uint32_t HVKSwapChainKHR::getImages(VkSwapchainKHR swapChain, std::array<VkImage, sMaxImageCount>* pOut)
+		{
+			uint32_t count = 0;
+			auto ret = vkGetSwapchainImagesKHR(this->mParentDevice, swapChain, &count, nullptr);
+			if (VK_SUCCESS != ret) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKSwapChainKHR, getImages, ret) << "C[W̐̎擾Ɏs܂";
+			}
+			if (0 == count || sMaxImageCount < count) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKSwapChainKHR, getImages, VK_ERROR_INITIALIZATION_FAILED)
+					<< "C[W̐1sMaxImageCount͈̔͊Oł count=" << count;
+			}
+			ret = vkGetSwapchainImagesKHR(this->mParentDevice, swapChain, &count, pOut->data());
+			if (VK_SUCCESS != ret) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKSwapChainKHR, getImages, ret) << "C[W̎擾Ɏs܂";
+			}
+			return count;
+		}
+
+		void HVKSwapChainKHR::refreshImages(const VkSwapchainCreateInfoKHR& createInfo, uint32_t count, const std::array<VkImage, sMaxImageCount>& images)
+		{
+			this->destroyImageViews();
+
+			//HVKImage͎g񂷂̂ŁA蒼Ă̔z͊mۂȂ
+			for (auto i = 0u; i < count; ++i) {
+				this->mImages[i].setSwapChainImage(this->mParentDevice, images[i], createInfo.imageFormat, createInfo.imageArrayLayers);
+			}
+			for (auto i = count; i < this->mImageCount; ++i) {
+				this->mImages[i].release();
+			}
+			this->mImageCount = count;
+			this->mImageFormat = createInfo.imageFormat;
+			this->mImageExtent = createInfo.imageExtent;
+
+			if (0 == (createInfo.imageUsage & sViewUsageMask)) {
+				return;
+			}
+			auto viewType = 1 < createInfo.imageArrayLayers ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+			HVKImageViewCreateInfo viewInfo(viewType, createInfo.imageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+			viewInfo.subresourceRange.layerCount = createInfo.imageArrayLayers;
+			for (auto i = 0u; i < count; ++i) {
+				viewInfo.image = images[i];
+				auto ret = vkCreateImageView(this->mParentDevice, &viewInfo, this->allocationCallbacksPointer(), &this->mImageViews[i]);
+				if (VK_SUCCESS != ret) {
+					this->mImageViews[i] = VK_NULL_HANDLE;
+					this->destroyImageViews();
+					throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKSwapChainKHR, refreshImages, ret) << "r[̍쐬Ɏs܂ index=" << i;
+				}
+			}
+		}
+
+		void HVKSwapChainKHR::destroySwapChain()noexcept
+		{
+			this->clearImages();
+			if (nullptr != this->mSwapChain) {
+				vkDestroySwapchainKHR(this->mParentDevice, this->mSwapChain, this->allocationCallbacksPointer());
+				this->mSwapChain = nullptr;
+			}
+		}
+
+		void HVKSwapChainKHR::clearImages()noexcept
+		{
+			this->destroyImageViews();
+			for (auto i = 0u; i < this->mImageCount; ++i) {
+				this->mImages[i].release();
+			}
+			this->mImageCount = 0;
+		}
+
+		void HVKSwapChainKHR::destroyImageViews()noexcept
+		{
+			for (auto& view : this->mImageViews) {
+				if (VK_NULL_HANDLE != view) {
+					vkDestroyImageView(this->mParentDevice, view, this->allocationCallbacksPointer());
+					view = VK_NULL_HANDLE;
+				}
+			}
 		}
 
 		VkResult HVKSwapChainKHR::getSwapchainImages(uint32_t* pInOutCount, VkImage* pImages)
@@ -150,6 +302,33 @@ namespace hinode
 			assert(this->isGood());
 			return this->mSwapChain;
 		}
+
+		uint32_t HVKSwapChainKHR::imageCount()const noexcept
+		{
+			return this->mImageCount;
+		}
+
+		HVKImage& HVKSwapChainKHR::image(uint32_t index)noexcept
+		{
+			assert(index < this->mImageCount);
+			return this->mImages[index];
+		}
+
+		VkImageView HVKSwapChainKHR::imageView(uint32_t index)const noexcept
+		{
+			assert(index < this->mImageCount);
+			return this->mImageViews[index];
+		}
+
+		VkFormat HVKSwapChainKHR::imageFormat()const noexcept
+		{
+			return this->mImageFormat;
+		}
+
+		const VkExtent2D& HVKSwapChainKHR::imageExtent()const noexcept
+		{
+			return this->mImageExtent;
+		}
 	}
 
 	namespace graphics
@@ -6,16 +6,25 @@
 
 #include "../../allocationCallbacks/HVKAllocationCallbacks.h"
 #include "../../HVKInterface.h"
+#include "../../image/HVKImage.h"
 
 namespace hinode
 {
 	namespace graphics
 	{
+		/// @brief VkSwapchainKHR̃bp[
+		///
+		/// Xbv`FC̃C[Wƃr[͌Œ蒷̕\ɎA쐬ƍ蒼̂тɂ̏ōXV܂B
+		/// \̍XVł̓q[vgȂ̂ŁAEBhȆ傫ς邽тɍ蒼Ămۂ͋N܂
 		class HVKSwapChainKHR : public IHVKInterface, public HVKAllocationCallbacks
 		{
 			HVKSwapChainKHR(HVKSwapChainKHR& right)noexcept = delete;
 			HVKSwapChainKHR& operator=(HVKSwapChainKHR& right)noexcept = delete;
 
+		public:
+			/// @brief \ɎĂC[W̐
+			static const uint32_t sMaxImageCount = 8;
+
 		public:
 			/// @brief vkCreateSharedSwapchainsKHRgpăXbv`FC쐬
 			/// 쐬ɎsƂ͗O𓊂܂
@@ -42,11 +51,26 @@ namespace hinode
 			void release()noexcept override;
 
 			/// @brief Xbv`FC쐬܂
+			///
+			/// C[W̕\܂BpCreateInfo->imageUsager[gp@܂ނƂ́A
+			/// C[WŜw2D̃r[܂
 			/// @param[in] device
 			/// @param[in] pCreateInfo
 			/// @exception HVKException
 			void create(VkDevice device, VkSwapchainCreateInfoKHR* pCreateInfo);
 
+			/// @brief EBhȆ傫ςƂȂǂɍ蒼
+			///
+			/// ̃Xbv`FCpCreateInfo->oldSwapchainɐݒ肵ĐV̂AÂ͔̂j܂B
+			/// C[Wƃr[̕\͂̏ōXV܂B
+			/// VC[W̐m߂ĂÂ̂j܂B
+			/// ÂC[WgR}hׂďIĂĂяoĂB
+			/// sƂ͕\ɂAp~ꂽÂXbv`FCĵisGood()falseɂȂ܂B
+			/// foCX͊oĂ̂ŁAxrecreateĂԂoldSwapchainȂō蒼܂
+			/// @param[in] pCreateInfo
+			/// @exception HVKException
+			void recreate(VkSwapchainCreateInfoKHR* pCreateInfo);
+
 			/// @brief Xbv`FC̃obt@擾
 			/// pImagesnullptȑꍇpInOutCountɃobt@̐ݒ肳܂
 			/// @param[inout] pInOutCount
@@ -70,10 +94,31 @@ namespace hinode
 			bool isGood()const noexcept;
 			VkSwapchainKHR swapChain()noexcept;
 			operator VkSwapchainKHR()noexcept { return this->swapChain(); }
+			uint32_t imageCount()const noexcept;
+			HVKImage& image(uint32_t index)noexcept;
+			VkImageView imageView(uint32_t index)const noexcept;
+			VkFormat imageFormat()const noexcept;
+			const VkExtent2D& imageExtent()const noexcept;
+
+		private:
+			/// @brief swapChaiñC[W擾. sMaxImageCount𒴂Ƃ͗O𓊂܂
+			uint32_t getImages(VkSwapchainKHR swapChain, std::array<VkImage, sMaxImageCount>* pOut);
+			/// @brief C[Wƃr[̕\imagesɍ킹
+			void refreshImages(const VkSwapchainCreateInfoKHR& createInfo, uint32_t count, const std::array<VkImage, sMaxImageCount>& images);
+			/// @brief C[Wƃr[̕\ɂ
+			/// @brief \ɂăXbv`FCj. foCX͎ĉrecreateō蒼܂
+			void destroySwapChain()noexcept;
+			void clearImages()noexcept;
+			void destroyImageViews()noexcept;
 
 		private:
 			VkSwapchainKHR mSwapChain;
 			VkDevice mParentDevice;
+			uint32_t mImageCount;
+			VkFormat mImageFormat;
+			VkExtent2D mImageExtent;
+			std::array<HVKImage, sMaxImageCount> mImages;
+			std::array<VkImageView, sMaxImageCount> mImageViews;
 		};
 	}
 
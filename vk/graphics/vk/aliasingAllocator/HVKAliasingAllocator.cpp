@@ -0,0 +1,311 @@
+﻿#include "HVKAliasingAllocator.h"
+
+#include <algorithm>
+
+#include "../common/Common.h"
+#include "../memoryRequirements/HVKMemoryRequirements.h"
+#include "../memoryTypeResolver/HVKMemoryTypeResolver.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace
+		{
+			inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)noexcept
+			{
+				return (value + alignment - 1) / alignment * alignment;
+			}
+		}
+
+		HVKAliasingAllocator::Placement::Placement()noexcept
+			: memoryTypeIndex(HVKMemoryTypeResolver::sInvalidIndex)
+			, offset(0)
+			, size(0)
+		{ }
+
+		HVKAliasingAllocator::HVKAliasingAllocator()
+			: mParentDevice(nullptr)
+			, mBufferImageGranularity(1)
+			, mIsBuilt(false)
+		{
+			setMemory(&this->mMemoryProps, 0);
+		}
+
+		HVKAliasingAllocator::~HVKAliasingAllocator()
+		{
+			this->release();
+		}
+
+		void HVKAliasingAllocator::release()noexcept
+		{
+			this->mGroups.clear();
+			this->mResources.clear();
+			this->mParentDevice = nullptr;
+			this->mBufferImageGranularity = 1;
+			this->mIsBuilt = false;
+		}
+
+		void HVKAliasingAllocator::create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps, VkDeviceSize bufferImageGranularity)
+		{
+			this->release();
+			this->mParentDevice = device;
+			this->mMemoryProps = memoryProps;
+			this->mBufferImageGranularity = std::max<VkDeviceSize>(1, bufferImageGranularity);
+		}
+
+		HVKAliasingAllocator::ResourceID HVKAliasingAllocator::addBuffer(HVKBuffer& buffer, uint32_t firstUse, uint32_t lastUse)
+		{
+			auto id = this->addResource(buffer.getMemoryRequirements(), firstUse, lastUse);
+			this->mResources[id].buffer = buffer.buffer();
+			return id;
+		}
+
+		HVKAliasingAllocator::ResourceID HVKAliasingAllocator::addImage(HVKImage& image, VkImageAspectFlags aspect, VkImageLayout firstLayout, uint32_t firstUse, uint32_t lastUse)
+		{
+			auto id = this->addResource(image.getMemoryRequirements(), firstUse, lastUse);
+			auto& resource = this->mResources[id];
+			resource.image = image.image();
+			resource.pImage = &image;
+			resource.aspect = aspect;
+			resource.firstLayout = firstLayout;
+			return id;
+		}
+
+		HVKAliasingAllocator::ResourceID HVKAliasingAllocator::addResource(const HVKMemoryRequirements& requirements, uint32_t firstUse, uint32_t lastUse)
+		{
+			assert(this->isGood());
+			assert(!this->mIsBuilt);
+			assert(firstUse <= lastUse);
+
+			if (requirements.requiresDedicatedAllocation) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKAliasingAllocator, addResource, VK_ERROR_FEATURE_NOT_PRESENT) << "専用メモリが必要なリソースは他のリソースと重ねられません";
+			}
+
+			Resource resource;
+			resource.buffer = VK_NULL_HANDLE;
+			resource.image = VK_NULL_HANDLE;
+			resource.pImage = nullptr;
+			resource.aspect = 0;
+			resource.firstLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			resource.requirements = requirements;
+			resource.firstUse = firstUse;
+			resource.lastUse = lastUse;
+			resource.isAliased = false;
+			this->mResources.push_back(resource);
+			return static_cast<ResourceID>(this->mResources.size() - 1);
+		}
+
+		void HVKAliasingAllocator::build(VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred)
+		{
+			assert(this->isGood());
+			assert(!this->mIsBuilt);
+
+			HVKMemoryTypeResolver resolver;
+			resolver.create(this->mMemoryProps);
+			for (auto& resource : this->mResources) {
+				resource.placement.memoryTypeIndex = resolver.find(resource.requirements.memoryTypeBits, required, preferred);
+				if (HVKMemoryTypeResolver::sInvalidIndex == resource.placement.memoryTypeIndex) {
+					throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKAliasingAllocator, build, VK_ERROR_FEATURE_NOT_PRESENT) << "条件に合うメモリタイプが見つかりませんでした";
+				}
+				resource.placement.size = resource.requirements.size;
+			}
+
+			//大きいものから置くと隙間が小さくなる
+			std::vector<Resource*> order;
+			order.reserve(this->mResources.size());
+			for (auto& resource : this->mResources) {
+				order.push_back(&resource);
+			}
+			std::stable_sort(order.begin(), order.end(), [](const Resource* pLeft, const Resource* pRight) {
+				return pLeft->requirements.size > pRight->requirements.size;
+			});
+
+			std::vector<const Resource*> placed[VK_MAX_MEMORY_TYPES];
+			VkDeviceSize groupSizes[VK_MAX_MEMORY_TYPES] = {};
+			for (auto* pResource : order) {
+				auto typeIndex = pResource->placement.memoryTypeIndex;
+				pResource->placement.offset = this->findOffset(*pResource, placed[typeIndex]);
+				placed[typeIndex].push_back(pResource);
+				groupSizes[typeIndex] = std::max(groupSizes[typeIndex], pResource->placement.offset + pResource->placement.size);
+			}
+
+			for (auto typeIndex = 0u; typeIndex < VK_MAX_MEMORY_TYPES; ++typeIndex) {
+				auto& resources = placed[typeIndex];
+				for (auto i = 0u; i < resources.size(); ++i) {
+					for (auto j = i + 1; j < resources.size(); ++j) {
+						auto& left = resources[i]->placement;
+						auto& right = resources[j]->placement;
+						if (left.offset < right.offset + right.size && right.offset < left.offset + left.size) {
+							const_cast<Resource*>(resources[i])->isAliased = true;
+							const_cast<Resource*>(resources[j])->isAliased = true;
+						}
+					}
+				}
+			}
+
+			auto* pCallbacks = const_cast<VkAllocationCallbacks*>(this->allocationCallbacksPointer());
+			try {
+				for (auto typeIndex = 0u; typeIndex < VK_MAX_MEMORY_TYPES; ++typeIndex) {
+					if (0 == groupSizes[typeIndex]) {
+						continue;
+					}
+					Group group;
+					group.memoryTypeIndex = typeIndex;
+					group.size = groupSizes[typeIndex];
+					group.pMemory.reset(new HVKDeviceMemory());
+					group.pMemory->setCallbacks(pCallbacks);
+					HVKMemoryAllocateInfo allocInfo(group.size, typeIndex);
+					group.pMemory->create(this->mParentDevice, &allocInfo);
+					this->mGroups.push_back(std::move(group));
+				}
+
+				for (auto& resource : this->mResources) {
+					auto it = std::find_if(this->mGroups.begin(), this->mGroups.end(), [&](const Group& group) {
+						return group.memoryTypeIndex == resource.placement.memoryTypeIndex;
+					});
+					assert(this->mGroups.end() != it);
+					auto ret = VK_NULL_HANDLE != resource.buffer
+						? it->pMemory->bindBuffer(resource.buffer, resource.placement.offset)
+						: it->pMemory->bindImage(resource.image, resource.placement.offset);
+					if (VK_SUCCESS != ret) {
+						throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKAliasingAllocator, build, ret) << "リソースとメモリの結びつけに失敗しました";
+					}
+				}
+			} catch (...) {
+				this->mGroups.clear();
+				throw;
+			}
+			this->mIsBuilt = true;
+		}
+
+		VkDeviceSize HVKAliasingAllocator::findOffset(const Resource& resource, const std::vector<const Resource*>& placed)const noexcept
+		{
+			//寿命が重なるものだけが障害物になる
+			std::vector<const Placement*> obstacles;
+			for (auto* pOther : placed) {
+				if (pOther->lastUse < resource.firstUse || resource.lastUse < pOther->firstUse) {
+					continue;
+				}
+				obstacles.push_back(&pOther->placement);
+			}
+			std::sort(obstacles.begin(), obstacles.end(), [](const Placement* pLeft, const Placement* pRight) {
+				return pLeft->offset < pRight->offset;
+			});
+
+			//バッファとイメージが混ざるので、同時に生きているもの同士はbufferImageGranularityのページを共有させない
+			auto alignment = std::max(resource.requirements.alignment, this->mBufferImageGranularity);
+			VkDeviceSize candidate = 0;
+			for (auto* pObstacle : obstacles) {
+				auto offset = alignUp(candidate, alignment);
+				if (offset + resource.requirements.size <= pObstacle->offset) {
+					break;
+				}
+				candidate = std::max(candidate, alignUp(pObstacle->offset + pObstacle->size, this->mBufferImageGranularity));
+			}
+			return alignUp(candidate, alignment);
+		}
+
+		uint32_t HVKAliasingAllocator::recordAliasingBarriers(VkCommandBuffer cmd, uint32_t usePoint, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+		{
+			assert(this->isBuilt());
+
+			std::vector<VkBufferMemoryBarrier> bufferBarriers;
+			std::vector<VkImageMemoryBarrier> imageBarriers;
+			for (auto& resource : this->mResources) {
+				if (resource.firstUse != usePoint) {
+					continue;
+				}
+				//重なっていないイメージも前のフレームの書き込みと順序をつける必要があるので、どちらも書き込みを待つ
+				VkAccessFlags srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+
+				if (VK_NULL_HANDLE != resource.image) {
+					VkImageMemoryBarrier barrier;
+					barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+					barrier.pNext = nullptr;
+					barrier.srcAccessMask = srcAccessMask;
+					barrier.dstAccessMask = dstAccessMask;
+					barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+					barrier.newLayout = resource.firstLayout;
+					barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.image = resource.image;
+					barrier.subresourceRange.aspectMask = resource.aspect;
+					barrier.subresourceRange.baseMipLevel = 0;
+					barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+					barrier.subresourceRange.baseArrayLayer = 0;
+					barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+					imageBarriers.push_back(barrier);
+					resource.pImage->setState(barrier.subresourceRange, resource.firstLayout, dstAccessMask, dstStageMask);
+				} else if (resource.isAliased) {
+					VkBufferMemoryBarrier barrier;
+					barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+					barrier.pNext = nullptr;
+					barrier.srcAccessMask = srcAccessMask;
+					barrier.dstAccessMask = dstAccessMask;
+					barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.buffer = resource.buffer;
+					barrier.offset = 0;
+					barrier.size = VK_WHOLE_SIZE;
+					bufferBarriers.push_back(barrier);
+				}
+			}
+
+			auto count = static_cast<uint32_t>(bufferBarriers.size() + imageBarriers.size());
+			if (0 < count) {
+				//範囲を共有している前のリソースや前のフレームでどのステージで使われたかは分からないので、すべてのコマンドを待つ
+				vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, dstStageMask, 0,
+					0, nullptr,
+					static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+					static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+			}
+			return count;
+		}
+
+		bool HVKAliasingAllocator::isGood()const noexcept
+		{
+			return nullptr != this->mParentDevice;
+		}
+
+		bool HVKAliasingAllocator::isBuilt()const noexcept
+		{
+			return this->mIsBuilt;
+		}
+
+		size_t HVKAliasingAllocator::resourceCount()const noexcept
+		{
+			return this->mResources.size();
+		}
+
+		const HVKAliasingAllocator::Placement& HVKAliasingAllocator::placement(ResourceID id)const noexcept
+		{
+			assert(id < this->mResources.size());
+			return this->mResources[id].placement;
+		}
+
+		bool HVKAliasingAllocator::isAliased(ResourceID id)const noexcept
+		{
+			assert(id < this->mResources.size());
+			return this->mResources[id].isAliased;
+		}
+
+		VkDeviceSize HVKAliasingAllocator::allocatedSize()const noexcept
+		{
+			VkDeviceSize result = 0;
+			for (auto& group : this->mGroups) {
+				result += group.size;
+			}
+			return result;
+		}
+
+		VkDeviceSize HVKAliasingAllocator::unaliasedSize()const noexcept
+		{
+			VkDeviceSize result = 0;
+			for (auto& resource : this->mResources) {
+				result += resource.requirements.size;
+			}
+			return result;
+		}
+	}
+}
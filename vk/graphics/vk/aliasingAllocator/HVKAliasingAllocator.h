@@ -0,0 +1,137 @@
+﻿#pragma once
+
+#include <vector>
+#include <memory>
+#include <vulkan\vulkan.h>
+
+#include "../HVKInterface.h"
+#include "../allocationCallbacks/HVKAllocationCallbacks.h"
+#include "../deviceMemory/HVKDeviceMemory.h"
+#include "../buffer/HVKBuffer.h"
+#include "../image/HVKImage.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		/// @brief フレームの一部でしか使わないリソースのメモリを重ねて割り当てるクラス
+		///
+		/// リソースごとに最初と最後に使うパスの番号を登録し、buildで寿命の重ならないリソース同士を同じメモリの範囲に配置します。
+		/// 配置は大きいものから順に、寿命の重なるリソースを避けた最も低いオフセットに置いていきます。
+		/// メモリはメモリタイプごとに1つのHVKDeviceMemoryにまとめ、buildの中ですべてのリソースを結びつけます。
+		///
+		/// 別のリソースと範囲を共有しているリソースは、使い始める前にrecordAliasingBarriersでバリアを記録してください。
+		/// 前のフレームで最後に使ったリソースとの間の依存もこのバリアで解決します
+		class HVKAliasingAllocator : public IHVKInterface, public HVKAllocationCallbacks
+		{
+			HVKAliasingAllocator(const HVKAliasingAllocator&) = delete;
+			HVKAliasingAllocator& operator=(const HVKAliasingAllocator&) = delete;
+
+		public:
+			using ResourceID = uint32_t;
+
+			/// @brief 配置結果
+			struct Placement
+			{
+				uint32_t memoryTypeIndex;
+				VkDeviceSize offset;
+				VkDeviceSize size;
+
+				Placement()noexcept;
+			};
+
+		public:
+			HVKAliasingAllocator();
+			~HVKAliasingAllocator();
+
+			void release()noexcept override;
+
+			/// @brief 作成
+			/// @param[in] device
+			/// @param[in] memoryProps
+			/// @param[in] bufferImageGranularity VkPhysicalDeviceLimits::bufferImageGranularity
+			void create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps, VkDeviceSize bufferImageGranularity);
+
+			/// @brief バッファを登録する
+			/// @param[in] buffer build()が終わるまで破棄しないでください
+			/// @param[in] firstUse 最初に使うパスの番号
+			/// @param[in] lastUse 最後に使うパスの番号
+			/// @retval ResourceID
+			/// @exception HVKException 専用メモリが必要なリソースは重ねられません
+			ResourceID addBuffer(HVKBuffer& buffer, uint32_t firstUse, uint32_t lastUse);
+
+			/// @brief イメージを登録する
+			/// @param[in] image recordAliasingBarriersで状態を書き換えるので、このオブジェクトより先に破棄しないでください
+			/// @param[in] aspect
+			/// @param[in] firstLayout 最初に使うときのレイアウト. バリアでVK_IMAGE_LAYOUT_UNDEFINEDから遷移します
+			/// @param[in] firstUse
+			/// @param[in] lastUse
+			/// @retval ResourceID
+			/// @exception HVKException
+			ResourceID addImage(HVKImage& image, VkImageAspectFlags aspect, VkImageLayout firstLayout, uint32_t firstUse, uint32_t lastUse);
+
+			/// @brief 配置を決めてメモリを確保し、すべてのリソースを結びつける
+			/// @param[in] required
+			/// @param[in] preferred
+			/// @exception HVKException
+			void build(VkMemoryPropertyFlags required = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VkMemoryPropertyFlags preferred = 0);
+
+			/// @brief usePointで使い始めるリソースのバリアを記録する
+			///
+			/// イメージはVK_IMAGE_LAYOUT_UNDEFINEDから登録したレイアウトに遷移させ、HVKImageの状態も書き換えます。
+			/// 範囲を共有している前のリソースや前のフレームでの同じリソースの書き込みが終わるまで待ちます
+			/// @param[in] cmd
+			/// @param[in] usePoint
+			/// @param[in] dstStageMask
+			/// @param[in] dstAccessMask
+			/// @retval uint32_t 記録したバリアの数
+			uint32_t recordAliasingBarriers(VkCommandBuffer cmd, uint32_t usePoint, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
+
+		public:
+			bool isGood()const noexcept override;
+			bool isBuilt()const noexcept;
+			size_t resourceCount()const noexcept;
+			const Placement& placement(ResourceID id)const noexcept;
+			/// @brief idと範囲を共有しているか
+			bool isAliased(ResourceID id)const noexcept;
+			/// @brief 確保したメモリの大きさの合計
+			VkDeviceSize allocatedSize()const noexcept;
+			/// @brief 重ねずに割り当てたときの大きさの合計
+			VkDeviceSize unaliasedSize()const noexcept;
+
+		private:
+			struct Resource
+			{
+				VkBuffer buffer;
+				VkImage image;
+				HVKImage* pImage;
+				VkImageAspectFlags aspect;
+				VkImageLayout firstLayout;
+				VkMemoryRequirements requirements;
+				uint32_t firstUse;
+				uint32_t lastUse;
+				Placement placement;
+				bool isAliased;
+			};
+
+			struct Group
+			{
+				uint32_t memoryTypeIndex;
+				VkDeviceSize size;
+				std::unique_ptr<HVKDeviceMemory> pMemory;
+			};
+
+			ResourceID addResource(const HVKMemoryRequirements& requirements, uint32_t firstUse, uint32_t lastUse);
+			/// @brief pResourceをgroupの中で置けるもっとも低いオフセットを探す
+			VkDeviceSize findOffset(const Resource& resource, const std::vector<const Resource*>& placed)const noexcept;
+
+		private:
+			VkDevice mParentDevice;
+			VkPhysicalDeviceMemoryProperties mMemoryProps;
+			VkDeviceSize mBufferImageGranularity;
+			std::vector<Resource> mResources;
+			std::vector<Group> mGroups;
+			bool mIsBuilt;
+		};
+	}
+}
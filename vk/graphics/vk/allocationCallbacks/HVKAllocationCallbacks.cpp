@@ -1,5 +1,7 @@
 #include "HVKAllocationCallbacks.h"
 
+#include "../hostAllocator/HVKHostAllocator.h"
+
 namespace hinode
 {
 	namespace graphics
@@ -22,6 +24,11 @@ namespace hinode
 			}
 		}
 
+		void HVKAllocationCallbacks::sSetDefaultCallbacks(HVKHostAllocator& allocator)noexcept
+		{
+			sSetDefaultCallbacks(allocator.callbacks());
+		}
+
 		const VkAllocationCallbacks* HVKAllocationCallbacks::sGetDefaultCallbacksPointer()noexcept
 		{
 			return pDefaultCallback;
@@ -43,7 +50,7 @@ namespace hinode
 
 		const VkAllocationCallbacks* HVKAllocationCallbacks::allocationCallbacksPointer()const noexcept
 		{
-			return this->mpCallbacks;
+			return nullptr != this->mpCallbacks ? this->mpCallbacks : pDefaultCallback;
 		}
 
 	}
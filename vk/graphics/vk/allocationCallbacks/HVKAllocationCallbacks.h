@@ -6,10 +6,19 @@ namespace hinode
 {
 	namespace graphics
 	{
+		class HVKHostAllocator;
+
 		class HVKAllocationCallbacks
 		{
 		public:
 			static void sSetDefaultCallbacks(VkAllocationCallbacks callbacks)noexcept;
+
+			/// @brief gݍ݂̃AP[^ftHgɂ
+			///
+			/// VulkañIuWFNg쐬OɌĂłB
+			/// R[obNw肵ĂȂIuWFNgׂ͂allocatorg܂
+			/// @param[in] allocator ʏHVKHostAllocator::sGetBuiltin()
+			static void sSetDefaultCallbacks(HVKHostAllocator& allocator)noexcept;
 			static const VkAllocationCallbacks* sGetDefaultCallbacksPointer()noexcept;
 
 		public:
@@ -19,6 +28,7 @@ namespace hinode
 			void setCallbacks(VkAllocationCallbacks* pCallbacks)noexcept;
 
 		public:
+			/// @brief setCallbacksŐݒ肵. ݒ肵ĂȂ΃ftHĝ
 			const VkAllocationCallbacks* allocationCallbacksPointer()const noexcept;
 
 		private:
@@ -0,0 +1,231 @@
+﻿#include "HVKAssetStreamer.h"
+
+#include <vector>
+#include <algorithm>
+
+#include "../common/Common.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		HVKAssetStreamer::HVKAssetStreamer()
+			: mpUploader(nullptr)
+			, mChunkSize(0)
+			, mStreamedBytes(0)
+		{ }
+
+		HVKAssetStreamer::HVKAssetStreamer(HVKAssetStreamer&& right)noexcept
+			: HVKAssetStreamer()
+		{
+			*this = std::move(right);
+		}
+
+		HVKAssetStreamer& HVKAssetStreamer::operator=(HVKAssetStreamer&& right)noexcept
+		{
+			this->release();
+
+			this->mpUploader = right.mpUploader;
+			this->mChunkSize = right.mChunkSize;
+			this->mStreamedBytes = right.mStreamedBytes;
+
+			right.release();
+			return *this;
+		}
+
+		HVKAssetStreamer::~HVKAssetStreamer()
+		{
+			this->release();
+		}
+
+		void HVKAssetStreamer::release()noexcept
+		{
+			this->mpUploader = nullptr;
+			this->mChunkSize = 0;
+			this->mStreamedBytes = 0;
+		}
+
+		void HVKAssetStreamer::create(HVKStagingUploader& uploader, VkDeviceSize chunkSize)
+		{
+			assert(uploader.isGood());
+			this->release();
+
+			//チャンクがステージングバッファの半分以下なら、1つを転送している間にもう1つへ書き込める
+			auto half = std::max<VkDeviceSize>(1, uploader.stagingSize() / 2);
+			this->mpUploader = &uploader;
+			this->mChunkSize = 0 == chunkSize ? half : std::min(chunkSize, uploader.stagingSize());
+		}
+
+		HVKAssetStreamer::Token HVKAssetStreamer::streamBuffer(const winapi::MappedFile& file, VkDeviceSize fileOffset, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset)
+		{
+			assert(this->isGood());
+
+			//fileOffset + sizeは桁あふれしうるので、足さずに比べる
+			if (file.size() < fileOffset || (VK_WHOLE_SIZE != size && file.size() - fileOffset < size)) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKAssetStreamer, streamBuffer, VK_ERROR_INITIALIZATION_FAILED)
+					<< "ファイルの範囲外です offset=" << fileOffset << " size=" << size << " fileSize=" << file.size();
+			}
+			if (VK_WHOLE_SIZE == size) {
+				size = file.size() - fileOffset;
+			}
+
+			//所有権を移譲するときは提出ごとに取得が必要になるので、区切らずに1回で提出する
+			auto isOwnershipTransfer = this->mpUploader->isOwnershipTransfer();
+			if (isOwnershipTransfer && this->mpUploader->stagingSize() < size) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKAssetStreamer, streamBuffer, VK_ERROR_OUT_OF_HOST_MEMORY)
+					<< "所有権を移譲するときはステージングバッファに収まる大きさしか転送できません size=" << size << " stagingSize=" << this->mpUploader->stagingSize();
+			}
+			auto chunkSize = isOwnershipTransfer ? std::max<VkDeviceSize>(1, size) : this->mChunkSize;
+
+			//何も転送しないときは直前に提出したもののTokenを返す
+			auto token = this->mpUploader->pendingToken() - 1;
+			file.prefetch(fileOffset, chunkSize);
+			for (VkDeviceSize done = 0; done < size; ) {
+				auto chunk = std::min(chunkSize, size - done);
+				//このチャンクをコピーしている間に、OSに次のチャンクを読み込ませておく
+				file.prefetch(fileOffset + done + chunk, chunkSize);
+				this->mpUploader->uploadBuffer(dst, dstOffset + done, file.data() + fileOffset + done, chunk);
+				token = this->mpUploader->submit();
+				done += chunk;
+				this->mStreamedBytes += chunk;
+			}
+			return token;
+		}
+
+		HVKAssetStreamer::Token HVKAssetStreamer::streamBuffer(const TCHAR* pPath, VkBuffer dst, VkDeviceSize dstOffset)
+		{
+			winapi::MappedFile file;
+			file.open(pPath);
+			//submitの中でステージングバッファへのコピーは終わっているので、戻る前にファイルを閉じてよい
+			return this->streamBuffer(file, 0, VK_WHOLE_SIZE, dst, dstOffset);
+		}
+
+		HVKAssetStreamer::Token HVKAssetStreamer::streamImage(const winapi::MappedFile& file, VkDeviceSize fileOffset, VkDeviceSize size, const HVKStagingUploader::ImageUpload& upload, uint32_t texelSize, uint32_t levelCount)
+		{
+			assert(this->isGood());
+			assert(0 < texelSize && 0 < levelCount && 0 < upload.subresource.layerCount);
+			assert(1 == levelCount || (0 == upload.offset.x && 0 == upload.offset.y && 0 == upload.offset.z));
+			assert(1 == levelCount || (0 == upload.bufferRowLength && 0 == upload.bufferImageHeight));
+
+			if (file.size() < fileOffset || (VK_WHOLE_SIZE != size && file.size() - fileOffset < size)) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKAssetStreamer, streamImage, VK_ERROR_INITIALIZATION_FAILED)
+					<< "ファイルの範囲外です offset=" << fileOffset << " size=" << size << " fileSize=" << file.size();
+			}
+			if (VK_WHOLE_SIZE == size) {
+				size = file.size() - fileOffset;
+			}
+
+			//レベルごとの大きさ. 行と奥行きの詰め方はuploadの指定に従う
+			struct Level
+			{
+				VkExtent3D extent;
+				uint32_t rowLength;
+				uint32_t imageHeight;
+				VkDeviceSize rowBytes;
+				VkDeviceSize layerBytes;
+			};
+			std::vector<Level> levels(levelCount);
+			VkDeviceSize requiredSize = 0;
+			for (auto i = 0u; i < levelCount; ++i) {
+				auto& level = levels[i];
+				level.extent.width = std::max(1u, upload.extent.width >> i);
+				level.extent.height = std::max(1u, upload.extent.height >> i);
+				level.extent.depth = std::max(1u, upload.extent.depth >> i);
+				level.rowLength = 0 == upload.bufferRowLength ? level.extent.width : upload.bufferRowLength;
+				level.imageHeight = 0 == upload.bufferImageHeight ? level.extent.height : upload.bufferImageHeight;
+				level.rowBytes = static_cast<VkDeviceSize>(level.rowLength) * texelSize;
+				level.layerBytes = level.rowBytes * level.imageHeight * level.extent.depth;
+				requiredSize += level.layerBytes * upload.subresource.layerCount;
+			}
+			if (size < requiredSize) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKAssetStreamer, streamImage, VK_ERROR_INITIALIZATION_FAILED)
+					<< "イメージに必要な大きさが足りません size=" << size << " required=" << requiredSize;
+			}
+
+			//所有権を移譲するときは提出ごとに取得が必要になるので、区切らずに1回で提出する
+			auto isOwnershipTransfer = this->mpUploader->isOwnershipTransfer();
+			if (isOwnershipTransfer && this->mpUploader->stagingSize() < requiredSize) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKAssetStreamer, streamImage, VK_ERROR_OUT_OF_HOST_MEMORY)
+					<< "所有権を移譲するときはステージングバッファに収まる大きさしか転送できません size=" << requiredSize << " stagingSize=" << this->mpUploader->stagingSize();
+			}
+
+			auto token = this->mpUploader->pendingToken() - 1;
+			VkDeviceSize pendingBytes = 0;
+			auto uploadChunk = [&](const HVKStagingUploader::ImageUpload& chunk, VkDeviceSize dataOffset, VkDeviceSize bytes) {
+				//このチャンクをコピーしている間に、OSに次のチャンクを読み込ませておく
+				file.prefetch(dataOffset + bytes, this->mChunkSize);
+				this->mpUploader->uploadImage(chunk, file.data() + dataOffset, bytes);
+				this->mStreamedBytes += bytes;
+				pendingBytes += bytes;
+				//小さなレベルやレイヤーはchunkSizeに達するまでまとめて提出する
+				if (!isOwnershipTransfer && this->mChunkSize <= pendingBytes) {
+					token = this->mpUploader->submit();
+					pendingBytes = 0;
+				}
+			};
+
+			file.prefetch(fileOffset, this->mChunkSize);
+			auto dataOffset = fileOffset;
+			for (auto i = 0u; i < levelCount; ++i) {
+				auto& level = levels[i];
+				for (auto layer = 0u; layer < upload.subresource.layerCount; ++layer) {
+					auto chunk = upload;
+					chunk.subresource.mipLevel = upload.subresource.mipLevel + i;
+					chunk.subresource.baseArrayLayer = upload.subresource.baseArrayLayer + layer;
+					chunk.subresource.layerCount = 1;
+					chunk.extent = level.extent;
+					chunk.bufferRowLength = level.rowLength;
+					chunk.bufferImageHeight = level.imageHeight;
+
+					if (isOwnershipTransfer || level.layerBytes <= this->mChunkSize) {
+						uploadChunk(chunk, dataOffset, level.layerBytes);
+						dataOffset += level.layerBytes;
+						continue;
+					}
+
+					//レイヤーがチャンクに収まらないときは奥行き1枚ずつ、行の範囲ごとに区切る
+					auto rowsPerChunk = static_cast<uint32_t>(std::min<VkDeviceSize>(level.extent.height, std::max<VkDeviceSize>(1, this->mChunkSize / level.rowBytes)));
+					for (auto z = 0u; z < level.extent.depth; ++z) {
+						for (auto y = 0u; y < level.extent.height; y += rowsPerChunk) {
+							auto rows = std::min(rowsPerChunk, level.extent.height - y);
+							auto part = chunk;
+							part.offset.y = chunk.offset.y + static_cast<int32_t>(y);
+							part.offset.z = chunk.offset.z + static_cast<int32_t>(z);
+							part.extent.height = rows;
+							part.extent.depth = 1;
+							part.bufferImageHeight = 0;
+							if (0 != y || 0 != z) {
+								//先に転送した部分は提出が分かれると転送後のレイアウトになっているので、内容を残したまま遷移させる
+								part.oldLayout = upload.newLayout;
+								part.srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+								part.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+							}
+							auto rowOffset = (static_cast<VkDeviceSize>(z) * level.imageHeight + y) * level.rowBytes;
+							uploadChunk(part, dataOffset + rowOffset, rows * level.rowBytes);
+						}
+					}
+					dataOffset += level.layerBytes;
+				}
+			}
+			if (0 < pendingBytes) {
+				token = this->mpUploader->submit();
+			}
+			return token;
+		}
+
+		bool HVKAssetStreamer::isGood()const noexcept
+		{
+			return nullptr != this->mpUploader;
+		}
+
+		VkDeviceSize HVKAssetStreamer::chunkSize()const noexcept
+		{
+			return this->mChunkSize;
+		}
+
+		VkDeviceSize HVKAssetStreamer::streamedBytes()const noexcept
+		{
+			return this->mStreamedBytes;
+		}
+	}
+}
@@ -0,0 +1,92 @@
+﻿#pragma once
+
+#include <vulkan\vulkan.h>
+
+#include "../HVKInterface.h"
+#include "../stagingUploader/HVKStagingUploader.h"
+#include "../utility/winapi/MappedFile.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		/// @brief マップしたファイルの内容をステージングバッファへ直接コピーして転送するクラス
+		///
+		/// ファイルはwinapi::MappedFileでマップするので、読み込み用の中間バッファを使わず、
+		/// ページキャッシュからHVKStagingUploaderの常にマップされたステージングバッファへ1回のコピーで書き込みます。
+		/// 大きなデータはchunkSizeごとに区切って提出し、GPUが1つ前のチャンクを転送している間に次のチャンクを読み込みます。
+		/// HVKStagingUploaderのsubmitCountを2以上、stagingSizeをchunkSizeの2倍以上にするとダブルバッファリングになります。
+		///
+		/// HVKStagingUploaderが所有権の移譲を行うときは、提出ごとに使う側のキューでの取得が必要になるので区切らず、
+		/// 1回の転送をすべて1回の提出にまとめます。このときは転送する大きさがステージングバッファに収まらなければなりません
+		class HVKAssetStreamer : public IHVKInterface
+		{
+			HVKAssetStreamer(const HVKAssetStreamer&) = delete;
+			HVKAssetStreamer& operator=(const HVKAssetStreamer&) = delete;
+
+		public:
+			using Token = HVKStagingUploader::Token;
+
+		public:
+			HVKAssetStreamer();
+			HVKAssetStreamer(HVKAssetStreamer&& right)noexcept;
+			HVKAssetStreamer& operator=(HVKAssetStreamer&& right)noexcept;
+			~HVKAssetStreamer();
+
+			void release()noexcept override;
+
+			/// @brief 作成
+			/// @param[in] uploader 解放するまで生存していること
+			/// @param[in] chunkSize 1回に提出する大きさ. 0ならステージングバッファの半分にします
+			void create(HVKStagingUploader& uploader, VkDeviceSize chunkSize = 0);
+
+			/// @brief ファイルの一部をバッファへ転送する
+			///
+			/// chunkSizeごとに区切って提出します
+			/// @param[in] file
+			/// @param[in] fileOffset
+			/// @param[in] size VK_WHOLE_SIZEならfileOffsetからファイルの最後まで
+			/// @param[in] dst
+			/// @param[in] dstOffset
+			/// @retval Token 最後のチャンクの転送のToken
+			/// @exception HVKException 範囲がファイルの外にあるときや、所有権を移譲するときにステージングバッファに収まらないときも投げます
+			Token streamBuffer(const winapi::MappedFile& file, VkDeviceSize fileOffset, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset);
+
+			/// @brief ファイルを開いて全体をバッファへ転送する
+			/// @param[in] pPath
+			/// @param[in] dst
+			/// @param[in] dstOffset
+			/// @retval Token
+			/// @exception HVKException
+			Token streamBuffer(const TCHAR* pPath, VkBuffer dst, VkDeviceSize dstOffset = 0);
+
+			/// @brief ファイルの一部をイメージへ転送する
+			///
+			/// ファイル上のデータはミップレベルごとに、その中はupload.subresourceの配列レイヤーごとに並んでいるものとします。
+			/// レベル、レイヤーごとに区切り、1つのレイヤーがchunkSizeを超えるときは行の範囲ごとに区切って提出します。
+			/// 2つ目以降の提出では、先に転送した部分を残すよう転送後のレイアウトから遷移させます。
+			/// 圧縮フォーマットには使えません
+			/// @param[in] file
+			/// @param[in] fileOffset
+			/// @param[in] size VK_WHOLE_SIZEならfileOffsetからファイルの最後まで. 必要な大きさより小さいときは例外を投げます
+			/// @param[in] upload 最初のミップレベルの転送. levelCountが2以上のときはoffsetを0, bufferRowLengthとbufferImageHeightを0にしてください
+			/// @param[in] texelSize 1テクセルのバイト数
+			/// @param[in] levelCount upload.subresource.mipLevelから転送するミップレベルの数. 2つ目以降の大きさは半分ずつにします
+			/// @retval Token 最後の提出のToken
+			/// @exception HVKException
+			Token streamImage(const winapi::MappedFile& file, VkDeviceSize fileOffset, VkDeviceSize size, const HVKStagingUploader::ImageUpload& upload, uint32_t texelSize, uint32_t levelCount = 1);
+
+		public:
+			bool isGood()const noexcept override;
+			VkDeviceSize chunkSize()const noexcept;
+
+			/// @brief これまでに転送したバイト数
+			VkDeviceSize streamedBytes()const noexcept;
+
+		private:
+			HVKStagingUploader* mpUploader;
+			VkDeviceSize mChunkSize;
+			VkDeviceSize mStreamedBytes;
+		};
+	}
+}
@@ -1,6 +1,7 @@
 #include "HVKBuffer.h"
 
 #include "../common/Common.h"
+#include "../utility/ViewCreateInfoHash/ViewCreateInfoHash.h"
 
 namespace hinode
 {
@@ -16,11 +17,15 @@ namespace hinode
 			: mBuffer(right.mBuffer)
 			, mParentDevice(right.mParentDevice)
 			, mViews(std::move(right.mViews))
+			, mViewInfos(std::move(right.mViewInfos))
+			, mViewIndices(std::move(right.mViewIndices))
 		{
 			right.mBuffer = nullptr;
 			right.mParentDevice = nullptr;
 			right.mViews.clear();
 			right.mViews.shrink_to_fit();
+			right.mViewInfos.clear();
+			right.mViewIndices.clear();
 		}
 
 		HVKBuffer& HVKBuffer::operator=(HVKBuffer&& right)noexcept
@@ -28,11 +33,15 @@ namespace hinode
 			this->mBuffer = right.mBuffer;
 			this->mParentDevice = right.mParentDevice;
 			this->mViews = std::move(right.mViews);
+			this->mViewInfos = std::move(right.mViewInfos);
+			this->mViewIndices = std::move(right.mViewIndices);
 
 			right.mBuffer = nullptr;
 			right.mParentDevice = nullptr;
 			right.mViews.clear();
 			right.mViews.shrink_to_fit();
+			right.mViewInfos.clear();
+			right.mViewIndices.clear();
 
 			return *this;
 		}
@@ -50,6 +59,9 @@ namespace hinode
 				}
 				this->mViews.clear();
 				this->mViews.shrink_to_fit();
+				this->mViewInfos.clear();
+				this->mViewInfos.shrink_to_fit();
+				this->mViewIndices.clear();
 
 				vkDestroyBuffer(this->mParentDevice, this->mBuffer, this->allocationCallbacksPointer());
 				this->mParentDevice = nullptr;
@@ -73,21 +85,44 @@ namespace hinode
 			assert(this->isGood());
 
 			pInfo->buffer = this->mBuffer;
+			auto index = this->findView(*pInfo);
+			if (sInvalidViewIndex != index) {
+				return index;
+			}
+
 			VkBufferView view;
 			auto ret = vkCreateBufferView(this->mParentDevice, pInfo, this->allocationCallbacksPointer(), &view);
 			if (VK_SUCCESS != ret) {
 				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKBuffer, addView, ret) << "r[̍쐬Ɏs܂";
 			}
 			this->mViews.push_back(view);
-			return this->mViews.size() - 1;
+			this->mViewInfos.push_back(*pInfo);
+			index = this->mViews.size() - 1;
+			//pNext͔̐rłȂ̂ŁAg\̕t̃r[͋LȂ
+			if (nullptr == pInfo->pNext) {
+				this->mViewIndices.emplace(utility::hashViewCreateInfo(*pInfo), index);
+			}
+			return index;
+		}
+
+		size_t HVKBuffer::findView(const VkBufferViewCreateInfo& info)const noexcept
+		{
+			if (nullptr != info.pNext) {
+				return sInvalidViewIndex;
+			}
+			auto range = this->mViewIndices.equal_range(utility::hashViewCreateInfo(info));
+			for (auto it = range.first; it != range.second; ++it) {
+				if (utility::isSameViewCreateInfo(this->mViewInfos[it->second], info)) {
+					return it->second;
+				}
+			}
+			return sInvalidViewIndex;
 		}
 
-		VkMemoryRequirements HVKBuffer::getMemoryRequirements()
+		HVKMemoryRequirements HVKBuffer::getMemoryRequirements()
 		{
 			assert(this->isGood());
-			VkMemoryRequirements result;
-			vkGetBufferMemoryRequirements(this->mParentDevice, this->mBuffer, &result);
-			return result;
+			return HVKMemoryRequirements::sGetBuffer(this->mParentDevice, this->mBuffer);
 		}
 
 		bool HVKBuffer::isGood()const noexcept
@@ -106,6 +141,11 @@ namespace hinode
 			assert(this->isGood());
 			return this->mViews[index];
 		}
+
+		size_t HVKBuffer::viewCount()const noexcept
+		{
+			return this->mViews.size();
+		}
 	}
 
 	namespace graphics
@@ -1,10 +1,12 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
 #include <vulkan\vulkan.h>
 
 #include "../allocationCallbacks/HVKAllocationCallbacks.h"
 #include "../HVKInterface.h"
+#include "../memoryRequirements/HVKMemoryRequirements.h"
 
 namespace hinode
 {
@@ -29,23 +31,41 @@ namespace hinode
 			void create(VkDevice device, VkBufferCreateInfo* pInfo);
 
 			/// @brief r[̍쐬
+			///
+			/// pNextnullptrŁAẽr[łɂƂ͍炸ɂ̓YԂ܂B
+			/// r[͂̃IuWFNg̔jƈꏏɔj܂
 			/// @param[in] pInfo
 			/// @retval size_t
 			/// @exception HVKException
 			size_t addView(VkBufferViewCreateInfo* pInfo);
 
-			VkMemoryRequirements getMemoryRequirements();
+			/// @brief ẽr[T
+			/// @param[in] info
+			/// @retval size_t ȂsInvalidViewIndex
+			size_t findView(const VkBufferViewCreateInfo& info)const noexcept;
+
+			/// @brief v擾
+			///
+			/// ΉĂfoCXł͐p̃qg擾܂
+			/// @retval HVKMemoryRequirements
+			HVKMemoryRequirements getMemoryRequirements();
+
+		public:
+			static const size_t sInvalidViewIndex = static_cast<size_t>(-1);
 
 		public:
 			bool isGood()const noexcept;
 			VkBuffer buffer()noexcept;
 			operator VkBuffer()noexcept { return this->buffer(); }
 			VkBufferView view(int index);
+			size_t viewCount()const noexcept;
 
 		private:
 			VkBuffer mBuffer;
 			VkDevice mParentDevice;
 			std::vector<VkBufferView> mViews;
+			std::vector<VkBufferViewCreateInfo> mViewInfos;
+			std::unordered_multimap<size_t, size_t> mViewIndices;	///< 쐬̃nbVlmViews̓Y
 		};
 	}
 
@@ -0,0 +1,340 @@
+﻿#include "HVKCpuMipGenerator.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <system_error>
+#include <algorithm>
+
+#include "../common/Common.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace
+		{
+			VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)noexcept
+			{
+				return (value + alignment - 1) / alignment * alignment;
+			}
+		}
+
+		/// @brief 待機させておくスレッド. runのたびに起こして同じ処理を呼び出す
+		struct HVKCpuMipGenerator::WorkerPool
+		{
+			std::vector<std::thread> threads;
+			std::mutex mutex;
+			std::condition_variable wakeCondition;
+			std::condition_variable doneCondition;
+			std::function<void(uint32_t)> task;
+			uint64_t generation;		///< runのたびに増やす. スレッドはこれが変わったら起きる
+			uint32_t activeCount;		///< 今回のrunで処理するスレッドの数
+			uint32_t remainingCount;	///< 今回のrunでまだ終わっていないスレッドの数
+			bool isQuit;
+
+			explicit WorkerPool(uint32_t threadCount)
+				: generation(0)
+				, activeCount(0)
+				, remainingCount(0)
+				, isQuit(false)
+			{
+				this->threads.reserve(threadCount);
+				try {
+					for (auto i = 0u; i < threadCount; ++i) {
+						//呼び出したスレッドが0番を受け持つので、1番から振る
+						this->threads.emplace_back(&WorkerPool::loop, this, i + 1);
+					}
+				} catch (const std::system_error&) {
+					//作れた数だけで動く
+				}
+			}
+
+			~WorkerPool()
+			{
+				{
+					std::lock_guard<std::mutex> lock(this->mutex);
+					this->isQuit = true;
+				}
+				this->wakeCondition.notify_all();
+				for (auto& thread : this->threads) {
+					thread.join();
+				}
+			}
+
+			/// @brief 1番からworkerCount番のスレッドでfuncを呼び出し、すべて終わるまで待つ
+			void run(uint32_t workerCount, const std::function<void(uint32_t)>& func)
+			{
+				assert(workerCount <= this->threads.size());
+				{
+					std::lock_guard<std::mutex> lock(this->mutex);
+					this->task = func;
+					this->activeCount = workerCount;
+					this->remainingCount = workerCount;
+					++this->generation;
+				}
+				this->wakeCondition.notify_all();
+			}
+
+			void wait()
+			{
+				std::unique_lock<std::mutex> lock(this->mutex);
+				this->doneCondition.wait(lock, [this]() { return 0 == this->remainingCount; });
+				this->task = nullptr;
+			}
+
+			void loop(uint32_t index)
+			{
+				uint64_t seenGeneration = 0;
+				std::unique_lock<std::mutex> lock(this->mutex);
+				for (;;) {
+					this->wakeCondition.wait(lock, [&]() { return this->isQuit || seenGeneration != this->generation; });
+					if (this->isQuit) {
+						return;
+					}
+					seenGeneration = this->generation;
+					if (this->activeCount < index) {
+						continue;
+					}
+
+					lock.unlock();
+					this->task(index);
+					lock.lock();
+					if (0 == --this->remainingCount) {
+						this->doneCondition.notify_one();
+					}
+				}
+			}
+		};
+
+		HVKCpuMipGenerator::Layout::Layout()noexcept
+			: totalSize(0)
+			, format(VK_FORMAT_UNDEFINED)
+			, pixelFormat(utility::MipKernel::ePIXEL_FORMAT_RGBA8_UNORM)
+			, width(0)
+			, height(0)
+			, mipLevels(0)
+		{ }
+
+		bool HVKCpuMipGenerator::sToPixelFormat(VkFormat format, utility::MipKernel::PIXEL_FORMAT* pOut)noexcept
+		{
+			utility::MipKernel::PIXEL_FORMAT pixelFormat;
+			switch (format) {
+			case VK_FORMAT_R8G8B8A8_UNORM:		pixelFormat = utility::MipKernel::ePIXEL_FORMAT_RGBA8_UNORM; break;
+			case VK_FORMAT_R8G8B8A8_SRGB:		pixelFormat = utility::MipKernel::ePIXEL_FORMAT_RGBA8_SRGB; break;
+			case VK_FORMAT_R16G16B16A16_SFLOAT:	pixelFormat = utility::MipKernel::ePIXEL_FORMAT_RGBA16F; break;
+			case VK_FORMAT_R32_SFLOAT:			pixelFormat = utility::MipKernel::ePIXEL_FORMAT_R32F; break;
+			default: return false;
+			}
+			if (pOut) {
+				*pOut = pixelFormat;
+			}
+			return true;
+		}
+
+		uint32_t HVKCpuMipGenerator::sCalFullMipLevels(uint32_t width, uint32_t height)noexcept
+		{
+			auto levels = 1u;
+			for (auto size = std::max(width, height); 1 < size; size >>= 1) {
+				++levels;
+			}
+			return levels;
+		}
+
+		HVKCpuMipGenerator::Layout HVKCpuMipGenerator::sCalLayout(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, VkDeviceSize offsetAlignment)
+		{
+			assert(0 < width && 0 < height);
+			assert(0 < offsetAlignment && 0 == (offsetAlignment & (offsetAlignment - 1)));
+
+			Layout layout;
+			if (!sToPixelFormat(format, &layout.pixelFormat)) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKCpuMipGenerator, sCalLayout, VK_ERROR_FORMAT_NOT_SUPPORTED)
+					<< "CPUでのミップマップ生成に対応していないフォーマットです format=" << format;
+			}
+			layout.format = format;
+			layout.width = width;
+			layout.height = height;
+			layout.mipLevels = std::min(0 == mipLevels ? UINT32_MAX : mipLevels, sCalFullMipLevels(width, height));
+
+			//開始位置はテクセルの大きさと4の倍数でなければならない
+			auto texelSize = static_cast<VkDeviceSize>(utility::MipKernel::sTexelSize(layout.pixelFormat));
+			auto alignment = std::max(std::max(offsetAlignment, texelSize), static_cast<VkDeviceSize>(4));
+
+			layout.regions.resize(layout.mipLevels);
+			VkDeviceSize offset = 0;
+			for (auto level = 0u; level < layout.mipLevels; ++level) {
+				auto& region = layout.regions[level];
+				offset = alignUp(offset, alignment);
+				region.bufferOffset = offset;
+				region.bufferRowLength = 0;
+				region.bufferImageHeight = 0;
+				region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				region.imageSubresource.mipLevel = level;
+				region.imageSubresource.baseArrayLayer = 0;
+				region.imageSubresource.layerCount = 1;
+				region.imageOffset = { 0, 0, 0 };
+				region.imageExtent.width = std::max(1u, width >> level);
+				region.imageExtent.height = std::max(1u, height >> level);
+				region.imageExtent.depth = 1;
+				offset += texelSize * region.imageExtent.width * region.imageExtent.height;
+			}
+			layout.totalSize = offset;
+			return layout;
+		}
+
+		HVKCpuMipGenerator::HVKCpuMipGenerator()
+			: mThreadCount(0)
+		{ }
+
+		HVKCpuMipGenerator::HVKCpuMipGenerator(HVKCpuMipGenerator&& right)noexcept
+			: HVKCpuMipGenerator()
+		{
+			*this = std::move(right);
+		}
+
+		HVKCpuMipGenerator& HVKCpuMipGenerator::operator=(HVKCpuMipGenerator&& right)noexcept
+		{
+			this->release();
+
+			this->mThreadCount = right.mThreadCount;
+			this->mpPool = std::move(right.mpPool);
+			this->mLevels[0] = std::move(right.mLevels[0]);
+			this->mLevels[1] = std::move(right.mLevels[1]);
+			this->mScratches = std::move(right.mScratches);
+
+			right.release();
+			return *this;
+		}
+
+		HVKCpuMipGenerator::~HVKCpuMipGenerator()
+		{
+			this->release();
+		}
+
+		void HVKCpuMipGenerator::release()noexcept
+		{
+			this->mThreadCount = 0;
+			this->mpPool.reset();
+			this->mLevels[0].clear();
+			this->mLevels[0].shrink_to_fit();
+			this->mLevels[1].clear();
+			this->mLevels[1].shrink_to_fit();
+			this->mScratches.clear();
+		}
+
+		void HVKCpuMipGenerator::create(uint32_t threadCount)
+		{
+			this->release();
+
+			if (0 == threadCount) {
+				threadCount = std::max(1u, std::thread::hardware_concurrency());
+			}
+			if (1 < threadCount) {
+				this->mpPool.reset(new WorkerPool(threadCount - 1));
+				threadCount = static_cast<uint32_t>(this->mpPool->threads.size()) + 1;
+				if (1 == threadCount) {
+					this->mpPool.reset();
+				}
+			}
+			this->mThreadCount = threadCount;
+			this->mScratches.resize(threadCount);
+		}
+
+		void HVKCpuMipGenerator::generate(const Layout& layout, const void* pSrc, size_t srcRowPitch, utility::MipKernel::FILTER filter, void* pDst)
+		{
+			assert(this->isGood());
+			assert(0 < layout.mipLevels && layout.regions.size() == layout.mipLevels);
+
+			auto pixelFormat = layout.pixelFormat;
+			auto texelSize = utility::MipKernel::sTexelSize(pixelFormat);
+			auto channelCount = utility::MipKernel::sChannelCount(pixelFormat);
+			auto pSrcBytes = static_cast<const uint8_t*>(pSrc);
+			auto pDstBytes = static_cast<uint8_t*>(pDst);
+			auto rowBytes = static_cast<size_t>(layout.width) * texelSize;
+			if (0 == srcRowPitch) {
+				srcRowPitch = rowBytes;
+			}
+
+			//レベル0はそのまま写す
+			for (auto y = 0u; y < layout.height; ++y) {
+				memcpy(pDstBytes + layout.regions[0].bufferOffset + rowBytes * y, pSrcBytes + srcRowPitch * y, rowBytes);
+			}
+			if (1 == layout.mipLevels) {
+				return;
+			}
+
+			//作業用のバッファは足りないときだけ広げる
+			auto reserve = [](std::vector<float>& buffer, size_t count) {
+				if (buffer.size() < count) {
+					buffer.resize(count);
+				}
+			};
+			auto width0 = static_cast<size_t>(layout.width) * channelCount;
+			reserve(this->mLevels[0], width0 * layout.height);
+			reserve(this->mLevels[1], static_cast<size_t>(std::max(1u, layout.width >> 1)) * channelCount * std::max(1u, layout.height >> 1));
+			for (auto& scratch : this->mScratches) {
+				reserve(scratch, width0);
+			}
+
+			auto pLevel0 = this->mLevels[0].data();
+			this->parallelRows(layout.height, rowBytes, [&](uint32_t, uint32_t begin, uint32_t end) {
+				for (auto y = begin; y < end; ++y) {
+					utility::MipKernel::sDecodeRow(pixelFormat, pSrcBytes + srcRowPitch * y, pLevel0 + width0 * y, layout.width);
+				}
+			});
+
+			for (auto level = 1u; level < layout.mipLevels; ++level) {
+				auto srcWidth = std::max(1u, layout.width >> (level - 1));
+				auto srcHeight = std::max(1u, layout.height >> (level - 1));
+				auto& region = layout.regions[level];
+				auto dstWidth = region.imageExtent.width;
+				auto pSrcLevel = this->mLevels[(level - 1) & 1].data();
+				auto pDstLevel = this->mLevels[level & 1].data();
+				auto pDstLevelBytes = pDstBytes + region.bufferOffset;
+				auto taps = utility::MipKernel::eFILTER_BOX == filter ? (1 < srcHeight && 1 == (srcHeight & 1) ? 3 : 2) : utility::MipKernel::sKaiserTapCount;
+
+				//縮小した行はすぐに書き出す. 次のレベルの縮小元になるのでfloatの行も残す
+				this->parallelRows(region.imageExtent.height, static_cast<size_t>(srcWidth) * channelCount * taps, [&](uint32_t threadIndex, uint32_t begin, uint32_t end) {
+					auto pScratch = this->mScratches[threadIndex].data();
+					for (auto y = begin; y < end; ++y) {
+						auto pRow = pDstLevel + static_cast<size_t>(dstWidth) * channelCount * y;
+						utility::MipKernel::sDownsampleRow(filter, pSrcLevel, srcWidth, srcHeight, channelCount, y, pRow, pScratch);
+						utility::MipKernel::sEncodeRow(pixelFormat, pRow, pDstLevelBytes + static_cast<size_t>(dstWidth) * texelSize * y, dstWidth);
+					}
+				});
+			}
+		}
+
+		template<typename Func>
+		void HVKCpuMipGenerator::parallelRows(uint32_t rowCount, size_t costPerRow, Func func)
+		{
+			//小さなレベルはスレッドを起こす時間のほうが長いので分けない
+			const size_t minCostPerThread = 64 * 1024;
+			auto threadCount = static_cast<uint32_t>(std::min<size_t>(std::min(this->mThreadCount, rowCount), static_cast<size_t>(rowCount) * costPerRow / minCostPerThread));
+			if (threadCount <= 1 || !this->mpPool) {
+				func(0, 0, rowCount);
+				return;
+			}
+
+			auto band = (rowCount + threadCount - 1) / threadCount;
+			auto runBand = [&](uint32_t index) {
+				auto begin = std::min(band * index, rowCount);
+				func(index, begin, std::min(begin + band, rowCount));
+			};
+			this->mpPool->run(threadCount - 1, runBand);
+			runBand(0);
+			this->mpPool->wait();
+		}
+
+		bool HVKCpuMipGenerator::isGood()const noexcept
+		{
+			return 0 < this->mThreadCount;
+		}
+
+		uint32_t HVKCpuMipGenerator::threadCount()const noexcept
+		{
+			return this->mThreadCount;
+		}
+	}
+}
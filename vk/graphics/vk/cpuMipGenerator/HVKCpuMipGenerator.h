@@ -0,0 +1,108 @@
+﻿#pragma once
+
+#include <vector>
+#include <memory>
+#include <vulkan\vulkan.h>
+
+#include "../HVKInterface.h"
+#include "../utility/MipKernel/MipKernel.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		/// @brief CPUでミップマップを生成し、1回のvkCmdCopyBufferToImageで転送できる形に並べるクラス
+		///
+		/// ブリットに対応していないフォーマットや、ロード時に一度だけ生成してGPUの時間を使いたくないときに使います。
+		/// 縮小はutility::MipKernelで行い、各レベルの行を複数のスレッドに分けて計算します。
+		/// スレッドはcreateで作って解放するまで待機させておくので、レベルごとにスレッドを作る時間はかかりません。
+		/// レベルiはレベルi-1から作るのでレベルの間は並列にできませんが、計算した行はその場で書き出すので
+		/// 書き出しのためにもう一度画像全体をなめることはありません。
+		/// 作業用のバッファは保持して使い回すので、複数の画像を続けて処理するときは同じインスタンスを使ってください
+		class HVKCpuMipGenerator : public IHVKInterface
+		{
+			HVKCpuMipGenerator(const HVKCpuMipGenerator&) = delete;
+			HVKCpuMipGenerator& operator=(const HVKCpuMipGenerator&) = delete;
+
+		public:
+			/// @brief 生成したミップマップの並び
+			struct Layout
+			{
+				std::vector<VkBufferImageCopy> regions;	///< レベルごとのコピー範囲. そのままvkCmdCopyBufferToImageに渡せます
+				VkDeviceSize totalSize;			///< すべてのレベルを並べたときの大きさ
+				VkFormat format;
+				utility::MipKernel::PIXEL_FORMAT pixelFormat;
+				uint32_t width;					///< レベル0の幅
+				uint32_t height;				///< レベル0の高さ
+				uint32_t mipLevels;
+
+				Layout()noexcept;
+			};
+
+		public:
+			/// @brief 対応しているフォーマットか調べる
+			/// @param[in] format VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_R16G16B16A16_SFLOAT, VK_FORMAT_R32_SFLOAT
+			/// @param[out] pOut nullptrでもよい
+			/// @retval bool
+			static bool sToPixelFormat(VkFormat format, utility::MipKernel::PIXEL_FORMAT* pOut)noexcept;
+
+			/// @brief すべてのレベルの大きさから並びを計算する
+			/// @param[in] format
+			/// @param[in] width
+			/// @param[in] height
+			/// @param[in] mipLevels 0のときは1x1までのすべてのレベル
+			/// @param[in] offsetAlignment 各レベルの開始位置のアライメント. VkPhysicalDeviceLimits::optimalBufferCopyOffsetAlignmentを想定しています
+			/// @retval Layout
+			/// @exception HVKException 対応していないフォーマットのとき
+			static Layout sCalLayout(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels = 0, VkDeviceSize offsetAlignment = 4);
+
+			/// @brief 1x1までのレベルの数
+			/// @param[in] width
+			/// @param[in] height
+			/// @retval uint32_t
+			static uint32_t sCalFullMipLevels(uint32_t width, uint32_t height)noexcept;
+
+		public:
+			HVKCpuMipGenerator();
+			HVKCpuMipGenerator(HVKCpuMipGenerator&& right)noexcept;
+			HVKCpuMipGenerator& operator=(HVKCpuMipGenerator&& right)noexcept;
+			~HVKCpuMipGenerator();
+
+			void release()noexcept override;
+
+			/// @brief 作成
+			///
+			/// 呼び出したスレッドも縮小に使うので、threadCount - 1個のスレッドを作ります。
+			/// スレッドを作れなかったときは作れた数だけで動きます
+			/// @param[in] threadCount 縮小に使うスレッドの数. 0のときはstd::thread::hardware_concurrency()
+			void create(uint32_t threadCount = 0);
+
+			/// @brief ミップマップを生成してpDstに並べる
+			///
+			/// pDstにはステージングバッファのマップしたメモリをそのまま渡せます
+			/// @param[in] layout sCalLayoutで計算したもの
+			/// @param[in] pSrc レベル0の画素
+			/// @param[in] srcRowPitch pSrcの行の間隔. 0のときは隙間がないとみなします
+			/// @param[in] filter
+			/// @param[out] pDst layout.totalSizeバイト以上
+			void generate(const Layout& layout, const void* pSrc, size_t srcRowPitch, utility::MipKernel::FILTER filter, void* pDst);
+
+		public:
+			bool isGood()const noexcept override;
+			uint32_t threadCount()const noexcept;
+
+		private:
+			struct WorkerPool;
+
+			/// @brief [0, rowCount)を分けてfuncを並列に呼び出す
+			template<typename Func>
+			void parallelRows(uint32_t rowCount, size_t costPerRow, Func func);
+
+		private:
+			uint32_t mThreadCount;
+			std::unique_ptr<WorkerPool> mpPool;	///< 呼び出したスレッド以外の分. 1スレッドのときはnullptr
+			std::vector<float> mLevels[2];			///< 縮小元と縮小先のリニアな画素. 交互に使う
+			std::vector<std::vector<float>> mScratches;	///< スレッドごとの作業用
+		};
+	}
+}
@@ -90,6 +90,12 @@ namespace hinode
 			vkUpdateDescriptorSets(this->mParentDevice, writeCount, pWriteInfo, copyCount, pCopyInfo);
 		}
 
+		void HVKDescriptorSets::bind(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet, int index, const uint32_t* pDynamicOffsets, uint32_t dynamicOffsetCount)
+		{
+			assert(this->isGood());
+			vkCmdBindDescriptorSets(cmd, bindPoint, layout, firstSet, 1, &this->get(index), dynamicOffsetCount, pDynamicOffsets);
+		}
+
 		bool HVKDescriptorSets::isGood()const noexcept
 		{
 			return this->mParentDevice != VK_NULL_HANDLE && this->mParentPool != VK_NULL_HANDLE && !this->mSets.empty();
@@ -174,6 +180,11 @@ namespace hinode
 			this->descriptorCount = infoCount;
 			return *this;
 		}
+
+		bool HVKWriteDescriptorSet::sIsDynamicType(VkDescriptorType type)noexcept
+		{
+			return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC == type || VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC == type;
+		}
 	}
 
 	namespace graphics
@@ -38,6 +38,18 @@ namespace hinode
 			/// @param[in] copyCount
 			void update(int index, VkWriteDescriptorSet* pWriteInfo, uint32_t writeCount, VkCopyDescriptorSet* pCopyInfo, uint32_t copyCount);
 
+			/// @brief R}hobt@Ɍт
+			///
+			/// VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMICȂǂ܂ނƂ́AIȃoCfBȌɓIItZbgnĂ
+			/// @param[in] cmd
+			/// @param[in] bindPoint
+			/// @param[in] layout
+			/// @param[in] firstSet
+			/// @param[in] index тfBXNv^Zbg̓Y
+			/// @param[in] pDynamicOffsets
+			/// @param[in] dynamicOffsetCount
+			void bind(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet, int index, const uint32_t* pDynamicOffsets = nullptr, uint32_t dynamicOffsetCount = 0);
+
 		public:
 			bool isGood()const noexcept;
 			VkDescriptorSet& get(int index);
@@ -71,6 +83,11 @@ namespace hinode
 			HVKWriteDescriptorSet& setImageInfo(VkDescriptorType type, const VkDescriptorImageInfo* pImageInfos, uint32_t infoCount)noexcept;
 			HVKWriteDescriptorSet& setBufferInfo(VkDescriptorType type, const VkDescriptorBufferInfo* pBufferInfos, uint32_t infoCount)noexcept;
 			HVKWriteDescriptorSet& setTexelBufferView(VkDescriptorType type, const VkBufferView* pTexelBufferViews, uint32_t infoCount)noexcept;
+
+			/// @brief IItZbggfBXNv^̎ނׂ
+			/// @param[in] type
+			/// @retval bool
+			static bool sIsDynamicType(VkDescriptorType type)noexcept;
 		};
 	}
 
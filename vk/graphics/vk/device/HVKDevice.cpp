@@ -3,6 +3,8 @@
 #include <utility> // for std::move
 
 #include "../common/Common.h"
+#include "../memoryRequirements/HVKMemoryRequirements.h"
+#include "../memoryStatistics/HVKMemoryStatistics.h"
 
 namespace hinode
 {
@@ -36,6 +38,8 @@ namespace hinode
 		{
 			if (this->mDevice) {
 				vkDeviceWaitIdle(this->mDevice);
+				HVKMemoryRequirements::sUnregisterDevice(this->mDevice);
+				HVKMemoryStatistics::sUnregisterDevice(this->mDevice);
 				vkDestroyDevice(this->mDevice, this->allocationCallbacksPointer());
 			}
 		}
@@ -49,6 +53,11 @@ namespace hinode
 				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKDevice, create, result)
 					<< "foCX̍쐬Ɏs";
 			}
+			HVKMemoryRequirements::sRegisterDevice(this->mDevice, pInfo->enabledExtensionCount, pInfo->ppEnabledExtensionNames);
+
+			VkPhysicalDeviceMemoryProperties memoryProps;
+			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProps);
+			HVKMemoryStatistics::sRegisterDevice(this->mDevice, memoryProps);
 		}
 
 		VkResult HVKDevice::waitIdle()noexcept
@@ -57,6 +66,14 @@ namespace hinode
 			return vkDeviceWaitIdle(this->mDevice);
 		}
 
+		VkQueue HVKDevice::getQueue(uint32_t queueFamilyIndex, uint32_t queueIndex)noexcept
+		{
+			assert(this->isGood());
+			VkQueue queue = nullptr;
+			vkGetDeviceQueue(this->mDevice, queueFamilyIndex, queueIndex, &queue);
+			return queue;
+		}
+
 		bool HVKDevice::isGood()const noexcept
 		{
 			return nullptr != this->mDevice;
@@ -145,5 +162,25 @@ namespace hinode
 			}
 			return *this;
 		}
+
+		uint32_t HVKDeviceQueueCreateInfo::sFindTransferQueueFamilyIndex(const std::vector<VkQueueFamilyProperties>& queueFamilyProps, uint32_t fallbackFamilyIndex)
+		{
+			//OtBbNXRs[g̃L[͈ÖٓIɓ]ł̂ŁAVK_QUEUE_TRANSFER_BITł͔łȂ
+			const VkQueueFlags transferCapable = VK_QUEUE_TRANSFER_BIT | VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+			uint32_t withoutGraphics = UINT32_MAX;
+			for (auto i = 0u; i < queueFamilyProps.size(); ++i) {
+				auto& prop = queueFamilyProps[i];
+				if (0 == prop.queueCount || !(prop.queueFlags & transferCapable)) {
+					continue;
+				}
+				if (!(prop.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+					return i;
+				}
+				if (!(prop.queueFlags & VK_QUEUE_GRAPHICS_BIT) && UINT32_MAX == withoutGraphics) {
+					withoutGraphics = i;
+				}
+			}
+			return UINT32_MAX != withoutGraphics ? withoutGraphics : fallbackFamilyIndex;
+		}
 	}
 }
\ No newline at end of file
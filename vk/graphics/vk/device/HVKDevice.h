@@ -27,6 +27,12 @@ namespace hinode
 
 			VkResult waitIdle()noexcept;
 
+			/// @brief キューを取得する
+			/// @param[in] queueFamilyIndex 作成時にVkDeviceQueueCreateInfoで指定したファミリー
+			/// @param[in] queueIndex
+			/// @retval VkQueue
+			VkQueue getQueue(uint32_t queueFamilyIndex, uint32_t queueIndex)noexcept;
+
 		public:
 			bool isGood()const noexcept;
 			VkDevice device()noexcept;
@@ -58,6 +64,16 @@ namespace hinode
 
 			HVKDeviceQueueCreateInfo& setQueuePriorities(const std::vector<float>& priorities);
 			HVKDeviceQueueCreateInfo& setQueueFamilyIndexAndPresentQueueIndex(const std::vector<VkQueueFamilyProperties>& queueFamilyProps, const std::vector<bool>& supportPresentFlags);
+
+			/// @brief 転送に使うキューファミリーを探す
+			///
+			/// グラフィックスとコンピュートを持たない転送専用のファミリーを優先し、次にグラフィックスを持たないファミリーを選びます。
+			/// 見つからなければfallbackFamilyIndexを返します。
+			/// 転送専用のファミリーはminImageTransferGranularityに制限があることが多いので、イメージの一部への転送には注意してください
+			/// @param[in] queueFamilyProps
+			/// @param[in] fallbackFamilyIndex 見つからなかったときに返すもの. 通常はグラフィックスのファミリー
+			/// @retval uint32_t
+			static uint32_t sFindTransferQueueFamilyIndex(const std::vector<VkQueueFamilyProperties>& queueFamilyProps, uint32_t fallbackFamilyIndex);
 		};
 	}
 }
@@ -1,6 +1,9 @@
 #include "HVKDeviceMemory.h"
 
+#include <utility> // for std::move
+
 #include "../common/Common.h"
+#include "../memoryStatistics/HVKMemoryStatistics.h"
 
 namespace hinode
 {
@@ -9,23 +12,38 @@ namespace hinode
 		HVKDeviceMemory::HVKDeviceMemory()
 			: mMemory(nullptr)
 			, mParentDevice(nullptr)
+			, mSize(0)
+			, mMemoryTypeIndex(0)
+			, mpMapped(nullptr)
+			, mMapRefCount(0)
+			, mIsPersistentMapping(false)
 		{ }
 
 		HVKDeviceMemory::HVKDeviceMemory(HVKDeviceMemory&& right)noexcept
-			: mMemory(right.mMemory)
-			, mParentDevice(right.mParentDevice)
+			: HVKDeviceMemory()
 		{
-			right.mMemory = nullptr;
-			right.mParentDevice = nullptr;
+			*this = std::move(right);
 		}
 
 		HVKDeviceMemory& HVKDeviceMemory::operator=(HVKDeviceMemory&& right)noexcept
 		{
+			this->release();
+
 			this->mMemory = right.mMemory;
 			this->mParentDevice = right.mParentDevice;
+			this->mSize = right.mSize;
+			this->mMemoryTypeIndex = right.mMemoryTypeIndex;
+			this->mpMapped = right.mpMapped.load();
+			this->mMapRefCount = right.mMapRefCount.load();
+			this->mIsPersistentMapping = right.mIsPersistentMapping;
 
 			right.mMemory = nullptr;
 			right.mParentDevice = nullptr;
+			right.mSize = 0;
+			right.mMemoryTypeIndex = 0;
+			right.mpMapped = nullptr;
+			right.mMapRefCount = 0;
+			right.mIsPersistentMapping = false;
 			return *this;
 		}
 
@@ -38,19 +56,44 @@ namespace hinode
 		void HVKDeviceMemory::release()noexcept
 		{
 			if (nullptr != this->mMemory) {
+				if (nullptr != this->mpMapped.load()) {
+					vkUnmapMemory(this->mParentDevice, this->mMemory);
+				}
 				vkFreeMemory(this->mParentDevice, this->mMemory, this->allocationCallbacksPointer());
+				HVKMemoryStatistics::sRecordFree(this->mParentDevice, this->mMemoryTypeIndex, this->mSize);
 				this->mParentDevice = nullptr;
 				this->mMemory = nullptr;
 			}
+			this->mSize = 0;
+			this->mMemoryTypeIndex = 0;
+			this->mpMapped = nullptr;
+			this->mMapRefCount = 0;
+			this->mIsPersistentMapping = false;
 		}
 
-		void HVKDeviceMemory::create(VkDevice device, VkMemoryAllocateInfo* pInfo)
+		void HVKDeviceMemory::create(VkDevice device, VkMemoryAllocateInfo* pInfo, bool isPersistentMapping)
 		{
+			this->release();
+
 			auto ret = vkAllocateMemory(device, pInfo, this->allocationCallbacksPointer(), &this->mMemory);
 			if (ret != VK_SUCCESS) {
 				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKDeviceMemory, create, ret) << "mۂɎs";
 			}
 			this->mParentDevice = device;
+			this->mSize = pInfo->allocationSize;
+			this->mMemoryTypeIndex = pInfo->memoryTypeIndex;
+			HVKMemoryStatistics::sRecordAllocate(this->mParentDevice, this->mMemoryTypeIndex, this->mSize);
+
+			if (isPersistentMapping) {
+				void* pData = nullptr;
+				ret = vkMapMemory(this->mParentDevice, this->mMemory, 0, VK_WHOLE_SIZE, 0, &pData);
+				if (ret != VK_SUCCESS) {
+					this->release();
+					throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKDeviceMemory, create, ret) << "}bvɎs";
+				}
+				this->mpMapped = static_cast<uint8_t*>(pData);
+				this->mIsPersistentMapping = true;
+			}
 		}
 
 		VkResult HVKDeviceMemory::bindImage(VkImage image, VkDeviceSize offset)
@@ -69,13 +112,55 @@ namespace hinode
 		VkResult HVKDeviceMemory::map(void** ppOutPointer, VkDeviceSize offset, VkDeviceSize size, VkMemoryMapFlags flags)
 		{
 			assert(this->isGood());
-			return vkMapMemory(this->mParentDevice, this->mMemory, offset, size, flags, ppOutPointer);
+			assert(VK_WHOLE_SIZE == size || offset + size <= this->mSize);
+			assert(0 == flags && "VkMemoryMapFlags͗\񂳂Ă܂");
+			(void)size;
+
+			//łɒN}bvĂΎQƂ𑝂₷ł悢
+			auto count = this->mMapRefCount.load(std::memory_order_relaxed);
+			while (0 < count) {
+				if (this->mMapRefCount.compare_exchange_weak(count, count + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+					*ppOutPointer = this->mpMapped.load(std::memory_order_acquire) + offset;
+					return VK_SUCCESS;
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(this->mMapMutex);
+			auto pMapped = this->mpMapped.load(std::memory_order_acquire);
+			if (nullptr == pMapped) {
+				//͈͂ƂɃ}bvȂčςނ悤AɑŜ}bv
+				void* pData = nullptr;
+				auto ret = vkMapMemory(this->mParentDevice, this->mMemory, 0, VK_WHOLE_SIZE, flags, &pData);
+				if (ret != VK_SUCCESS) {
+					return ret;
+				}
+				pMapped = static_cast<uint8_t*>(pData);
+				this->mpMapped.store(pMapped, std::memory_order_release);
+			}
+			this->mMapRefCount.fetch_add(1, std::memory_order_acq_rel);
+			*ppOutPointer = pMapped + offset;
+			return VK_SUCCESS;
 		}
 
 		void HVKDeviceMemory::unmap()
 		{
 			assert(this->isGood());
-			vkUnmapMemory(this->mParentDevice, this->mMemory);
+
+			//Ō̎QƂłȂΌ炷ł悢
+			auto count = this->mMapRefCount.load(std::memory_order_relaxed);
+			while (1 < count) {
+				if (this->mMapRefCount.compare_exchange_weak(count, count - 1, std::memory_order_release, std::memory_order_relaxed)) {
+					return;
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(this->mMapMutex);
+			auto previous = this->mMapRefCount.fetch_sub(1, std::memory_order_acq_rel);
+			assert(0 < previous);
+			if (1 == previous && !this->mIsPersistentMapping) {
+				vkUnmapMemory(this->mParentDevice, this->mMemory);
+				this->mpMapped.store(nullptr, std::memory_order_release);
+			}
 		}
 
 		bool HVKDeviceMemory::isGood()const noexcept
@@ -88,6 +173,117 @@ namespace hinode
 			return this->mMemory;
 		}
 
+		VkDeviceSize HVKDeviceMemory::size()const noexcept
+		{
+			return this->mSize;
+		}
+
+		uint32_t HVKDeviceMemory::memoryTypeIndex()const noexcept
+		{
+			return this->mMemoryTypeIndex;
+		}
+
+		bool HVKDeviceMemory::isPersistentMapping()const noexcept
+		{
+			return this->mIsPersistentMapping;
+		}
+
+		void* HVKDeviceMemory::mappedPointer()noexcept
+		{
+			return this->mpMapped.load(std::memory_order_acquire);
+		}
+
+		VkDeviceSize HVKDeviceMemory::getCommitment()noexcept
+		{
+			assert(this->isGood());
+			VkDeviceSize committed = 0;
+			vkGetDeviceMemoryCommitment(this->mParentDevice, this->mMemory, &committed);
+			return committed;
+		}
+
+	}
+
+	namespace graphics
+	{
+		HVKMappedMemoryView::HVKMappedMemoryView()
+			: mpMemory(nullptr)
+			, mpData(nullptr)
+			, mOffset(0)
+			, mSize(0)
+		{ }
+
+		HVKMappedMemoryView::HVKMappedMemoryView(HVKMappedMemoryView&& right)noexcept
+			: HVKMappedMemoryView()
+		{
+			*this = std::move(right);
+		}
+
+		HVKMappedMemoryView& HVKMappedMemoryView::operator=(HVKMappedMemoryView&& right)noexcept
+		{
+			this->release();
+
+			this->mpMemory = right.mpMemory;
+			this->mpData = right.mpData;
+			this->mOffset = right.mOffset;
+			this->mSize = right.mSize;
+
+			right.mpMemory = nullptr;
+			right.mpData = nullptr;
+			right.mOffset = 0;
+			right.mSize = 0;
+			return *this;
+		}
+
+		HVKMappedMemoryView::~HVKMappedMemoryView()
+		{
+			this->release();
+		}
+
+		void HVKMappedMemoryView::release()noexcept
+		{
+			if (nullptr != this->mpMemory) {
+				this->mpMemory->unmap();
+			}
+			this->mpMemory = nullptr;
+			this->mpData = nullptr;
+			this->mOffset = 0;
+			this->mSize = 0;
+		}
+
+		void HVKMappedMemoryView::create(HVKDeviceMemory& memory, VkDeviceSize offset, VkDeviceSize size)
+		{
+			this->release();
+
+			void* pData = nullptr;
+			auto ret = memory.map(&pData, offset, size, 0);
+			if (ret != VK_SUCCESS) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKMappedMemoryView, create, ret) << "}bvɎs";
+			}
+			this->mpMemory = &memory;
+			this->mpData = pData;
+			this->mOffset = offset;
+			this->mSize = VK_WHOLE_SIZE == size ? memory.size() - offset : size;
+		}
+
+		bool HVKMappedMemoryView::isGood()const noexcept
+		{
+			return nullptr != this->mpData;
+		}
+
+		void* HVKMappedMemoryView::data()noexcept
+		{
+			return this->mpData;
+		}
+
+		VkDeviceSize HVKMappedMemoryView::offset()const noexcept
+		{
+			return this->mOffset;
+		}
+
+		VkDeviceSize HVKMappedMemoryView::size()const noexcept
+		{
+			return this->mSize;
+		}
 	}
 
 	namespace graphics
@@ -106,7 +302,7 @@ namespace hinode
 			this->pNext = NULL;
 		}
 
-		uint32_t HVKMemoryAllocateInfo::sCheckMemmoryType(VkPhysicalDeviceMemoryProperties props, uint32_t typeBits, VkFlags requirementsMask)noexcept
+		uint32_t HVKMemoryAllocateInfo::sCheckMemmoryType(const VkPhysicalDeviceMemoryProperties& props, uint32_t typeBits, VkFlags requirementsMask)noexcept
 		{
 			uint32_t result = static_cast<uint32_t >(-1);
 			// Search memtypes to find first index with those properties
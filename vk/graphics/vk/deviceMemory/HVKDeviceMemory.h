@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <mutex>
 #include <vulkan\vulkan.h>
 
 #include "../HVKInterface.h"
@@ -24,23 +26,97 @@ namespace hinode
 			/// @brief 쐬
 			/// @param[in] device
 			/// @param[in] pInfo HVKMemoryAllocateInfopӂĂ܂̂ŁAgƂ𐄏܂B
+			/// @param[in] isPersistentMapping trueȂ쐬ɃŜ}bvAj܂Ń}bv܂܂ɂ܂
 			/// @exception HVKExeption
-			void create(VkDevice device, VkMemoryAllocateInfo* pInfo);
+			void create(VkDevice device, VkMemoryAllocateInfo* pInfo, bool isPersistentMapping = false);
 
 			VkResult bindImage(VkImage image, VkDeviceSize offset = 0);
 			VkResult bindBuffer(VkBuffer buffer, VkDeviceSize offset = 0);
 
+			/// @brief }bv|C^擾
+			///
+			/// QƃJEgtŁA܂}bvĂȂ΃Ŝ}bv܂B
+			/// łɃ}bvĂƂ̓hCoĂ΂offset炵|C^Ԃ̂ŁA̕ʂ͈̔͂𓯎ɏ߂܂B
+			/// ̃XbhĂяo܂Bŏ̃}bvƍŌ̃A}bvbN܂
+			/// @param[out] ppOutPointer offseẗʒuw|C^
+			/// @param[in] offset
+			/// @param[in] size ͈͂̃`FbNɂ̂ݎg܂
+			/// @param[in] flags VkMemoryMapFlags͗\񂳂Ă̂0w肵Ă
+			/// @retval VkResult
 			VkResult map(void** ppOutPointer, VkDeviceSize offset, VkDeviceSize size, VkMemoryMapFlags flags);
+
+			/// @brief map̎QƃJEg炷
+			///
+			/// 0ɂȂA쐬ɏɃ}bvwĂȂ΃A}bv܂B
+			/// ̃XbhĂяo܂
 			void unmap();
 
+			/// @brief ۂɊmۂĂ傫Ԃ
+			///
+			/// VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT̃^Cvł݈̂Ӗ܂
+			/// @retval VkDeviceSize
+			VkDeviceSize getCommitment()noexcept;
+
 		public:
 			bool isGood()const noexcept override;
 			VkDeviceMemory memory()noexcept;
 			operator VkDeviceMemory()noexcept { return this->memory(); }
+			VkDeviceSize size()const noexcept;
+			uint32_t memoryTypeIndex()const noexcept;
+			bool isPersistentMapping()const noexcept;
+
+			/// @brief }bvĂ΃̐擪w|C^Ԃ. ĂȂnullptr
+			void* mappedPointer()noexcept;
 
 		private:
 			VkDeviceMemory mMemory;
 			VkDevice mParentDevice;
+			VkDeviceSize mSize;
+			uint32_t mMemoryTypeIndex;
+			std::atomic<uint8_t*> mpMapped;
+			std::atomic<uint32_t> mMapRefCount;
+			std::mutex mMapMutex;	///< ŏ̃}bvƍŌ̃A}bv. [uĂڂ܂
+			bool mIsPersistentMapping;
+		};
+	}
+
+	namespace graphics
+	{
+		/// @brief HVKDeviceMemorÿꕔ}bvĂԂێNX
+		///
+		/// jƂHVKDeviceMemory::unmapĂяo܂
+		class HVKMappedMemoryView
+		{
+			HVKMappedMemoryView(const HVKMappedMemoryView&) = delete;
+			HVKMappedMemoryView& operator=(const HVKMappedMemoryView&) = delete;
+
+		public:
+			HVKMappedMemoryView();
+			HVKMappedMemoryView(HVKMappedMemoryView&& right)noexcept;
+			HVKMappedMemoryView& operator=(HVKMappedMemoryView&& right)noexcept;
+			~HVKMappedMemoryView();
+
+			void release()noexcept;
+
+			/// @brief 쐬
+			/// @param[in] memory
+			/// @param[in] offset
+			/// @param[in] size
+			/// @exception HVKException
+			void create(HVKDeviceMemory& memory, VkDeviceSize offset, VkDeviceSize size);
+
+		public:
+			bool isGood()const noexcept;
+			void* data()noexcept;
+			template<typename T> T* data()noexcept { return static_cast<T*>(this->data()); }
+			VkDeviceSize offset()const noexcept;
+			VkDeviceSize size()const noexcept;
+
+		private:
+			HVKDeviceMemory* mpMemory;
+			void* mpData;
+			VkDeviceSize mOffset;
+			VkDeviceSize mSize;
 		};
 	}
 
@@ -53,12 +129,13 @@ namespace hinode
 
 			/// @brief requirementsMaskmemoryTypeIndex𒲂ׂ
 			///
-			/// Ȃ-1Ԃ
+			/// Ȃ-1ԂB
+			/// xĂяoƂA]܂tOw肵ƂHVKMemoryTypeResolvergĂ
 			/// @param[in] props
 			/// @param[in] typeBits
 			/// @param[in] requirementsMask `FbNVkMemoryPropertiesFlagBit
 			/// @retval uint32_t
-			static uint32_t sCheckMemmoryType(VkPhysicalDeviceMemoryProperties props, uint32_t typeBits, VkFlags requirementsMask)noexcept;
+			static uint32_t sCheckMemmoryType(const VkPhysicalDeviceMemoryProperties& props, uint32_t typeBits, VkFlags requirementsMask)noexcept;
 		};
 	}
 }
\ No newline at end of file
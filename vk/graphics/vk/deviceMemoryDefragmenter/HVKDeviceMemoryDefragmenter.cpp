@@ -0,0 +1,467 @@
+﻿#include "HVKDeviceMemoryDefragmenter.h"
+
+#include <utility> // for std::move
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+#include "../common/Common.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		const HVKDeviceMemoryDefragmenter::ResourceID HVKDeviceMemoryDefragmenter::sInvalidID = static_cast<ResourceID>(-1);
+
+		HVKDeviceMemoryDefragmenter::Budget::Budget()noexcept
+			: Budget(16ull * 1024 * 1024, 8, 0)
+		{ }
+
+		HVKDeviceMemoryDefragmenter::Budget::Budget(VkDeviceSize maxBytes, uint32_t maxMoves, uint32_t maxMicroseconds)noexcept
+			: maxBytes(maxBytes)
+			, maxMoves(maxMoves)
+			, maxMicroseconds(maxMicroseconds)
+		{ }
+
+		HVKDeviceMemoryDefragmenter::HVKDeviceMemoryDefragmenter()
+			: mpHeap(nullptr)
+			, mNextID(0)
+		{ }
+
+		HVKDeviceMemoryDefragmenter::HVKDeviceMemoryDefragmenter(HVKDeviceMemoryDefragmenter&& right)noexcept
+			: HVKDeviceMemoryDefragmenter()
+		{
+			*this = std::move(right);
+		}
+
+		HVKDeviceMemoryDefragmenter& HVKDeviceMemoryDefragmenter::operator=(HVKDeviceMemoryDefragmenter&& right)noexcept
+		{
+			this->release();
+
+			this->mpHeap = right.mpHeap;
+			this->mNextID = right.mNextID;
+			this->mEntries = std::move(right.mEntries);
+			this->mRelocationCallback = std::move(right.mRelocationCallback);
+			this->mCurrentBatch = std::move(right.mCurrentBatch);
+			this->mPendingBatches = std::move(right.mPendingBatches);
+
+			right.mpHeap = nullptr;
+			right.mEntries.clear();
+			right.mCurrentBatch = Batch();
+			right.mPendingBatches.clear();
+			right.release();
+			return *this;
+		}
+
+		HVKDeviceMemoryDefragmenter::~HVKDeviceMemoryDefragmenter()
+		{
+			this->release();
+		}
+
+		void HVKDeviceMemoryDefragmenter::release()noexcept
+		{
+			if (nullptr != this->mpHeap) {
+				this->destroyBatch(this->mCurrentBatch);
+				for (auto& batch : this->mPendingBatches) {
+					this->destroyBatch(batch);
+				}
+			}
+			this->mCurrentBatch = Batch();
+			this->mPendingBatches.clear();
+			this->mEntries.clear();
+			this->mRelocationCallback = nullptr;
+			this->mNextID = 0;
+			this->mpHeap = nullptr;
+		}
+
+		void HVKDeviceMemoryDefragmenter::create(HVKDeviceMemoryHeap& heap)
+		{
+			assert(heap.isGood());
+			this->release();
+
+			this->mpHeap = &heap;
+		}
+
+		HVKDeviceMemoryDefragmenter::ResourceID HVKDeviceMemoryDefragmenter::registerBuffer(HVKBuffer& buffer, HVKMemoryAllocation& allocation, const VkBufferCreateInfo& info, void* pUserData)
+		{
+			assert(this->isGood());
+			assert(buffer.isGood() && allocation.isGood());
+			assert((info.usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) && (info.usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT));
+
+			auto id = this->mNextID++;
+			auto& entry = this->mEntries[id];
+			entry.pBuffer = &buffer;
+			entry.pImage = nullptr;
+			entry.pAllocation = &allocation;
+			entry.bufferInfo = info;
+			entry.bufferInfo.pNext = nullptr;
+			setMemory(&entry.imageInfo, 0);
+			if (VK_SHARING_MODE_CONCURRENT == info.sharingMode) {
+				entry.queueFamilyIndices.assign(info.pQueueFamilyIndices, info.pQueueFamilyIndices + info.queueFamilyIndexCount);
+			}
+			entry.bufferInfo.pQueueFamilyIndices = entry.queueFamilyIndices.data();
+			entry.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			entry.aspect = 0;
+			entry.requirements = buffer.getMemoryRequirements();
+			entry.pUserData = pUserData;
+			entry.isMoving = false;
+			return id;
+		}
+
+		HVKDeviceMemoryDefragmenter::ResourceID HVKDeviceMemoryDefragmenter::registerImage(HVKImage& image, HVKMemoryAllocation& allocation, const VkImageCreateInfo& info, VkImageLayout layout, VkImageAspectFlags aspect, void* pUserData)
+		{
+			assert(this->isGood());
+			assert(image.isGood() && allocation.isGood());
+			assert((info.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) && (info.usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT));
+			assert(VK_IMAGE_LAYOUT_PREINITIALIZED != layout);
+
+			auto id = this->mNextID++;
+			auto& entry = this->mEntries[id];
+			entry.pBuffer = nullptr;
+			entry.pImage = &image;
+			entry.pAllocation = &allocation;
+			setMemory(&entry.bufferInfo, 0);
+			entry.imageInfo = info;
+			entry.imageInfo.pNext = nullptr;
+			//移動先は内容をコピーしてから使うので、初期レイアウトは常にUNDEFINEDになる
+			entry.imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			if (VK_SHARING_MODE_CONCURRENT == info.sharingMode) {
+				entry.queueFamilyIndices.assign(info.pQueueFamilyIndices, info.pQueueFamilyIndices + info.queueFamilyIndexCount);
+			}
+			entry.imageInfo.pQueueFamilyIndices = entry.queueFamilyIndices.data();
+			entry.layout = layout;
+			entry.aspect = aspect;
+			entry.requirements = image.getMemoryRequirements();
+			entry.pUserData = pUserData;
+			entry.isMoving = false;
+			return id;
+		}
+
+		void HVKDeviceMemoryDefragmenter::unregister(ResourceID id)noexcept
+		{
+			this->mEntries.erase(id);
+		}
+
+		void HVKDeviceMemoryDefragmenter::setImageLayout(ResourceID id, VkImageLayout layout)noexcept
+		{
+			assert(VK_IMAGE_LAYOUT_PREINITIALIZED != layout);
+			auto it = this->mEntries.find(id);
+			if (this->mEntries.end() != it) {
+				auto& entry = it->second;
+				entry.layout = layout;
+				if (nullptr != entry.pImage && VK_IMAGE_LAYOUT_UNDEFINED != layout) {
+					entry.pImage->setState(entry.pImage->wholeRange(), layout, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+				}
+			}
+		}
+
+		void HVKDeviceMemoryDefragmenter::setRelocationCallback(RelocationCallback callback)
+		{
+			this->mRelocationCallback = std::move(callback);
+		}
+
+		uint32_t HVKDeviceMemoryDefragmenter::step(HVKCommandBuffer& cmd, const Budget& budget)
+		{
+			assert(this->isGood());
+			assert(cmd.isGood());
+
+			auto startTime = std::chrono::steady_clock::now();
+
+			//使われていないブロックにあるものほど先に移動する
+			std::vector<std::pair<VkDeviceSize, ResourceID>> candidates;
+			candidates.reserve(this->mEntries.size());
+			for (auto& it : this->mEntries) {
+				auto& entry = it.second;
+				if (entry.isMoving || !entry.pAllocation->isGood() || entry.pAllocation->isDedicated()) {
+					continue;
+				}
+				candidates.emplace_back(this->mpHeap->blockUsedSize(*entry.pAllocation), it.first);
+			}
+			std::sort(candidates.begin(), candidates.end());
+
+			std::vector<ResourceID> movedIDs;
+			std::vector<VkBuffer> oldBuffers;
+			std::vector<HVKImage*> oldImages;
+			auto finish = [&]() {
+				if (movedIDs.empty()) {
+					return;
+				}
+				this->recordCommands(cmd.buffer(), movedIDs, oldBuffers, oldImages);
+
+				unless(this->mRelocationCallback) {
+					return;
+				}
+				for (auto i = 0u; i < movedIDs.size(); ++i) {
+					//通知の中で登録が解除されたものは通知しない
+					auto it = this->mEntries.find(movedIDs[i]);
+					if (this->mEntries.end() == it) {
+						continue;
+					}
+					auto& entry = it->second;
+					Relocation relocation;
+					relocation.id = movedIDs[i];
+					relocation.pUserData = entry.pUserData;
+					relocation.isImage = nullptr != entry.pImage;
+					relocation.oldBuffer = oldBuffers[i];
+					relocation.newBuffer = entry.pBuffer ? entry.pBuffer->buffer() : VK_NULL_HANDLE;
+					relocation.oldImage = oldImages[i] ? oldImages[i]->image() : VK_NULL_HANDLE;
+					relocation.newImage = entry.pImage ? entry.pImage->image() : VK_NULL_HANDLE;
+					relocation.pAllocation = entry.pAllocation;
+					this->mRelocationCallback(relocation);
+				}
+			};
+
+			VkDeviceSize movedBytes = 0;
+			for (auto& candidate : candidates) {
+				if (budget.maxMoves <= movedIDs.size()) {
+					break;
+				}
+				if (0 < budget.maxMicroseconds) {
+					auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+					if (budget.maxMicroseconds <= elapsed) {
+						break;
+					}
+				}
+				auto id = candidate.second;
+				auto& entry = this->mEntries.at(id);
+				if (!movedIDs.empty() && budget.maxBytes < movedBytes + entry.requirements.size) {
+					//小さいものなら入るかもしれないので続ける
+					continue;
+				}
+
+				auto type = (nullptr != entry.pImage && VK_IMAGE_TILING_OPTIMAL == entry.imageInfo.tiling)
+					? HVKDeviceMemoryHeap::eRESOURCE_TYPE_OPTIMAL
+					: HVKDeviceMemoryHeap::eRESOURCE_TYPE_LINEAR;
+				auto newAllocation = this->mpHeap->allocateForDefragment(entry.requirements, *entry.pAllocation, type);
+				if (!newAllocation.isGood()) {
+					continue;
+				}
+
+				try {
+					if (nullptr != entry.pBuffer) {
+						auto* pCallbacks = const_cast<VkAllocationCallbacks*>(entry.pBuffer->allocationCallbacksPointer());
+						HVKBuffer newBuffer;
+						newBuffer.setCallbacks(pCallbacks);
+						newBuffer.create(this->mpHeap->device(), &entry.bufferInfo);
+						auto ret = newAllocation.bindBuffer(newBuffer);
+						if (VK_SUCCESS != ret) {
+							throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKDeviceMemoryDefragmenter, step, ret) << "移動先のバッファとメモリの結びつけに失敗しました";
+						}
+						oldBuffers.push_back(entry.pBuffer->buffer());
+						oldImages.push_back(nullptr);
+						//ムーブではアロケーションコールバックが引き継がれないので設定し直す
+						std::unique_ptr<HVKBuffer> pOld(new HVKBuffer(std::move(*entry.pBuffer)));
+						pOld->setCallbacks(pCallbacks);
+						this->mCurrentBatch.buffers.push_back(std::move(pOld));
+						*entry.pBuffer = std::move(newBuffer);
+					} else {
+						auto* pCallbacks = const_cast<VkAllocationCallbacks*>(entry.pImage->allocationCallbacksPointer());
+						HVKImage newImage;
+						newImage.setCallbacks(pCallbacks);
+						newImage.create(this->mpHeap->device(), &entry.imageInfo);
+						auto ret = newAllocation.bindImage(newImage);
+						if (VK_SUCCESS != ret) {
+							throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKDeviceMemoryDefragmenter, step, ret) << "移動先のイメージとメモリの結びつけに失敗しました";
+						}
+						//ムーブではアロケーションコールバックが引き継がれないので設定し直す
+						//移動元は状態も引き継ぐので、コピー前のバリアはそこから作れる
+						std::unique_ptr<HVKImage> pOld(new HVKImage(std::move(*entry.pImage)));
+						pOld->setCallbacks(pCallbacks);
+						oldBuffers.push_back(VK_NULL_HANDLE);
+						oldImages.push_back(pOld.get());
+						this->mCurrentBatch.images.push_back(std::move(pOld));
+						*entry.pImage = std::move(newImage);
+					}
+				} catch (...) {
+					this->mpHeap->free(newAllocation);
+					//それまでに移動したものは記録しておかないと内容が失われる
+					finish();
+					throw;
+				}
+
+				this->mCurrentBatch.ids.push_back(id);
+				this->mCurrentBatch.allocations.push_back(*entry.pAllocation);
+				*entry.pAllocation = newAllocation;
+				entry.isMoving = true;
+
+				movedIDs.push_back(id);
+				movedBytes += entry.requirements.size;
+			}
+
+			finish();
+			return static_cast<uint32_t>(movedIDs.size());
+		}
+
+		void HVKDeviceMemoryDefragmenter::endStep(VkFence fence)noexcept
+		{
+			if (this->mCurrentBatch.ids.empty()) {
+				return;
+			}
+			this->mCurrentBatch.fence = fence;
+			this->mPendingBatches.push_back(std::move(this->mCurrentBatch));
+			this->mCurrentBatch = Batch();
+		}
+
+		uint32_t HVKDeviceMemoryDefragmenter::collect()noexcept
+		{
+			assert(this->isGood());
+
+			uint32_t count = 0;
+			for (auto it = this->mPendingBatches.begin(); it != this->mPendingBatches.end(); ) {
+				if (VK_NULL_HANDLE != it->fence && VK_SUCCESS != vkGetFenceStatus(this->mpHeap->device(), it->fence)) {
+					++it;
+					continue;
+				}
+				count += static_cast<uint32_t>(it->ids.size());
+				this->destroyBatch(*it);
+				it = this->mPendingBatches.erase(it);
+			}
+			return count;
+		}
+
+		void HVKDeviceMemoryDefragmenter::recordCommands(VkCommandBuffer cmd, const std::vector<ResourceID>& movedIDs, const std::vector<VkBuffer>& oldBuffers, const std::vector<HVKImage*>& oldImages)
+		{
+			//コピーが終わったら移動先をサブリソースごとに移動元と同じレイアウトに戻すので、移動元の状態を覚えておく
+			std::vector<VkImageLayout> oldLayouts;
+			HVKImageBarrierBatch preBarriers;
+			for (auto i = 0u; i < movedIDs.size(); ++i) {
+				//登録が解除されたものは移動先も破棄されているので記録しない
+				auto it = this->mEntries.find(movedIDs[i]);
+				if (this->mEntries.end() == it) {
+					continue;
+				}
+				auto& entry = it->second;
+				if (nullptr == entry.pImage || VK_IMAGE_LAYOUT_UNDEFINED == entry.layout) {
+					continue;
+				}
+				auto* pOld = oldImages[i];
+				for (auto layer = 0u; layer < pOld->arrayLayers(); ++layer) {
+					for (auto mip = 0u; mip < pOld->mipLevels(); ++mip) {
+						oldLayouts.push_back(pOld->state(mip, layer).layout);
+					}
+				}
+				auto range = pOld->wholeRange();
+				range.aspectMask = entry.aspect;
+				pOld->transition(preBarriers, range, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+				entry.pImage->transition(preBarriers, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+			}
+
+			VkMemoryBarrier memoryBarrier;
+			memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			memoryBarrier.pNext = nullptr;
+			memoryBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+				1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			preBarriers.flush(cmd);
+
+			std::vector<VkImageCopy> imageCopies;
+			for (auto i = 0u; i < movedIDs.size(); ++i) {
+				auto it = this->mEntries.find(movedIDs[i]);
+				if (this->mEntries.end() == it) {
+					continue;
+				}
+				auto& entry = it->second;
+				if (nullptr != entry.pBuffer) {
+					VkBufferCopy region;
+					region.srcOffset = 0;
+					region.dstOffset = 0;
+					region.size = entry.bufferInfo.size;
+					vkCmdCopyBuffer(cmd, oldBuffers[i], entry.pBuffer->buffer(), 1, &region);
+					continue;
+				}
+				if (VK_IMAGE_LAYOUT_UNDEFINED == entry.layout) {
+					continue;
+				}
+
+				imageCopies.resize(entry.imageInfo.mipLevels);
+				for (auto mip = 0u; mip < entry.imageInfo.mipLevels; ++mip) {
+					auto& region = imageCopies[mip];
+					region.srcSubresource.aspectMask = entry.aspect;
+					region.srcSubresource.mipLevel = mip;
+					region.srcSubresource.baseArrayLayer = 0;
+					region.srcSubresource.layerCount = entry.imageInfo.arrayLayers;
+					region.dstSubresource = region.srcSubresource;
+					region.srcOffset = { 0, 0, 0 };
+					region.dstOffset = { 0, 0, 0 };
+					region.extent.width = std::max(1u, entry.imageInfo.extent.width >> mip);
+					region.extent.height = std::max(1u, entry.imageInfo.extent.height >> mip);
+					region.extent.depth = std::max(1u, entry.imageInfo.extent.depth >> mip);
+				}
+				vkCmdCopyImage(cmd, oldImages[i]->image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, entry.pImage->image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					static_cast<uint32_t>(imageCopies.size()), imageCopies.data());
+			}
+
+			//移動先の状態も書き換わるので、次のtransitionはコピーした内容を捨てずに移動元と同じレイアウトから始まる
+			HVKImageBarrierBatch postBarriers;
+			size_t layoutIndex = 0;
+			for (auto i = 0u; i < movedIDs.size(); ++i) {
+				auto it = this->mEntries.find(movedIDs[i]);
+				if (this->mEntries.end() == it) {
+					continue;
+				}
+				auto& entry = it->second;
+				if (nullptr == entry.pImage || VK_IMAGE_LAYOUT_UNDEFINED == entry.layout) {
+					continue;
+				}
+				VkImageSubresourceRange range;
+				range.aspectMask = entry.aspect;
+				range.levelCount = 1;
+				range.layerCount = 1;
+				for (range.baseArrayLayer = 0; range.baseArrayLayer < entry.pImage->arrayLayers(); ++range.baseArrayLayer) {
+					for (range.baseMipLevel = 0; range.baseMipLevel < entry.pImage->mipLevels(); ++range.baseMipLevel) {
+						auto layout = oldLayouts[layoutIndex++];
+						//内容のなかったサブリソースはコピー先のレイアウトのままにしておく
+						if (VK_IMAGE_LAYOUT_UNDEFINED != layout && VK_IMAGE_LAYOUT_PREINITIALIZED != layout) {
+							entry.pImage->transition(postBarriers, range, layout, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+						}
+					}
+				}
+			}
+
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+				1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			postBarriers.flush(cmd);
+		}
+
+		void HVKDeviceMemoryDefragmenter::destroyBatch(Batch& batch)noexcept
+		{
+			//メモリより先にリソースを破棄する
+			batch.buffers.clear();
+			batch.images.clear();
+			for (auto& allocation : batch.allocations) {
+				this->mpHeap->free(allocation);
+			}
+			batch.allocations.clear();
+
+			for (auto id : batch.ids) {
+				auto it = this->mEntries.find(id);
+				if (this->mEntries.end() != it) {
+					it->second.isMoving = false;
+				}
+			}
+			batch.ids.clear();
+		}
+
+		bool HVKDeviceMemoryDefragmenter::isGood()const noexcept
+		{
+			return nullptr != this->mpHeap;
+		}
+
+		size_t HVKDeviceMemoryDefragmenter::registeredCount()const noexcept
+		{
+			return this->mEntries.size();
+		}
+
+		size_t HVKDeviceMemoryDefragmenter::pendingCount()const noexcept
+		{
+			size_t count = 0;
+			for (auto& batch : this->mPendingBatches) {
+				count += batch.ids.size();
+			}
+			return count + this->mCurrentBatch.ids.size();
+		}
+	}
+}
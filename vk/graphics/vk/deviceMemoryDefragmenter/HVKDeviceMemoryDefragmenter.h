@@ -0,0 +1,174 @@
+﻿#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <vulkan\vulkan.h>
+
+#include "../HVKInterface.h"
+#include "../buffer/HVKBuffer.h"
+#include "../image/HVKImage.h"
+#include "../commandBuffer/HVKCommandBuffer.h"
+#include "../deviceMemoryHeap/HVKDeviceMemoryHeap.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		/// @brief HVKDeviceMemoryHeapの断片化を少しずつ解消するクラス
+		///
+		/// 登録されたバッファとイメージを、使われていないブロックからより使われているブロックへ移動します。
+		/// 移動先に新しくリソースを作成してGPUでコピーするコマンドを記録し、登録時に渡したHVKBuffer, HVKImage, HVKMemoryAllocationを移動先のものに置き換えます。
+		/// 移動元のリソースとメモリは、endStepで渡したフェンスがシグナルされたあとのcollectで破棄します。
+		///
+		/// リソースのハンドルが変わるので、ディスクリプタなどはsetRelocationCallbackで設定した関数の中で更新してください。
+		/// ビューは引き継がれないので、必要なら同じく作り直してください。
+		/// コピーに使うので、登録するリソースはVK_*_USAGE_TRANSFER_SRC_BITとVK_*_USAGE_TRANSFER_DST_BITを持っていなければなりません。
+		class HVKDeviceMemoryDefragmenter : public IHVKInterface
+		{
+			HVKDeviceMemoryDefragmenter(const HVKDeviceMemoryDefragmenter&) = delete;
+			HVKDeviceMemoryDefragmenter& operator=(const HVKDeviceMemoryDefragmenter&) = delete;
+
+		public:
+			using ResourceID = uint32_t;
+			static const ResourceID sInvalidID;
+
+			/// @brief リソースが移動したことの通知
+			struct Relocation
+			{
+				ResourceID id;
+				void* pUserData;					///< 登録時に渡したもの
+				bool isImage;
+				VkBuffer oldBuffer;					///< 移動前のバッファ. collectまで有効です
+				VkBuffer newBuffer;
+				VkImage oldImage;					///< 移動前のイメージ. collectまで有効です
+				VkImage newImage;
+				const HVKMemoryAllocation* pAllocation;	///< 移動後の割り当て
+			};
+			using RelocationCallback = std::function<void(const Relocation&)>;
+
+			/// @brief 1回のstepで行う移動の上限
+			struct Budget
+			{
+				VkDeviceSize maxBytes;		///< コピーする大きさの合計. 1つ目の移動は超えていても行います
+				uint32_t maxMoves;			///< 移動するリソースの数
+				uint32_t maxMicroseconds;	///< 移動の計画とコマンドの記録にかけるCPU時間. 0なら制限しません
+
+				Budget()noexcept;
+				Budget(VkDeviceSize maxBytes, uint32_t maxMoves, uint32_t maxMicroseconds = 0)noexcept;
+			};
+
+		public:
+			HVKDeviceMemoryDefragmenter();
+			HVKDeviceMemoryDefragmenter(HVKDeviceMemoryDefragmenter&& right)noexcept;
+			HVKDeviceMemoryDefragmenter& operator=(HVKDeviceMemoryDefragmenter&& right)noexcept;
+			~HVKDeviceMemoryDefragmenter();
+
+			/// @brief 破棄
+			///
+			/// 移動中のリソースはGPUの完了を待たずに破棄するので、呼び出す前にデバイスの処理が終わっていることを確認してください
+			void release()noexcept override;
+
+			/// @brief 作成
+			/// @param[in] heap
+			void create(HVKDeviceMemoryHeap& heap);
+
+			/// @brief バッファを移動できるものとして登録する
+			/// @param[in] buffer
+			/// @param[in] allocation bufferに結びつけられているheapからの割り当て
+			/// @param[in] info bufferを作成したときの情報. 移動先の作成に使います
+			/// @param[in] pUserData
+			/// @retval ResourceID
+			ResourceID registerBuffer(HVKBuffer& buffer, HVKMemoryAllocation& allocation, const VkBufferCreateInfo& info, void* pUserData = nullptr);
+
+			/// @brief イメージを移動できるものとして登録する
+			/// @param[in] image
+			/// @param[in] allocation imageに結びつけられているheapからの割り当て
+			/// @param[in] info imageを作成したときの情報. 移動先の作成に使います
+			/// @param[in] layout VK_IMAGE_LAYOUT_UNDEFINEDなら内容はコピーしません. コピー前のバリアはimageが覚えている状態から作ります
+			/// @param[in] aspect
+			/// @param[in] pUserData
+			/// @retval ResourceID
+			ResourceID registerImage(HVKImage& image, HVKMemoryAllocation& allocation, const VkImageCreateInfo& info, VkImageLayout layout, VkImageAspectFlags aspect, void* pUserData = nullptr);
+
+			/// @brief 登録を解除する
+			///
+			/// 移動中のものもあとでcollectが正しく破棄します。移動の通知の中で呼び出してもかまいません
+			/// @param[in] id
+			void unregister(ResourceID id)noexcept;
+
+			/// @brief イメージの現在のレイアウトを設定する
+			///
+			/// コピー前のバリアはHVKImageが覚えている状態から作るので、HVKImageの状態も書き換えます。
+			/// transition関数でレイアウトを変えているときは呼び出す必要はありません
+			/// @param[in] id
+			/// @param[in] layout
+			void setImageLayout(ResourceID id, VkImageLayout layout)noexcept;
+
+			void setRelocationCallback(RelocationCallback callback);
+
+			/// @brief 移動を行うコマンドを記録する
+			///
+			/// cmdは記録中でなければなりません。コピーの前後にバリアも記録します。
+			/// 移動したリソースについてはこの関数の中で通知します
+			/// @param[in] cmd
+			/// @param[in] budget
+			/// @retval uint32_t 移動したリソースの数
+			/// @exception HVKException
+			uint32_t step(HVKCommandBuffer& cmd, const Budget& budget);
+
+			/// @brief 直前のstepで記録したコマンドを提出したフェンスを設定する
+			/// @param[in] fence VK_NULL_HANDLEのときは次のcollectですぐに破棄します
+			void endStep(VkFence fence)noexcept;
+
+			/// @brief コピーが終わった移動元のリソースとメモリを破棄する
+			/// @retval uint32_t 破棄したリソースの数
+			uint32_t collect()noexcept;
+
+		public:
+			bool isGood()const noexcept override;
+			size_t registeredCount()const noexcept;
+			size_t pendingCount()const noexcept;
+
+		private:
+			struct Entry
+			{
+				HVKBuffer* pBuffer;
+				HVKImage* pImage;
+				HVKMemoryAllocation* pAllocation;
+				VkBufferCreateInfo bufferInfo;
+				VkImageCreateInfo imageInfo;
+				std::vector<uint32_t> queueFamilyIndices;
+				VkImageLayout layout;
+				VkImageAspectFlags aspect;
+				VkMemoryRequirements requirements;
+				void* pUserData;
+				bool isMoving;
+			};
+
+			/// @brief 1回のstepで移動したものの移動元
+			struct Batch
+			{
+				VkFence fence;
+				std::vector<ResourceID> ids;
+				std::vector<std::unique_ptr<HVKBuffer>> buffers;
+				std::vector<std::unique_ptr<HVKImage>> images;
+				std::vector<HVKMemoryAllocation> allocations;
+
+				Batch()noexcept : fence(VK_NULL_HANDLE) {}
+			};
+
+			void recordCommands(VkCommandBuffer cmd, const std::vector<ResourceID>& movedIDs, const std::vector<VkBuffer>& oldBuffers, const std::vector<HVKImage*>& oldImages);
+			void destroyBatch(Batch& batch)noexcept;
+
+		private:
+			HVKDeviceMemoryHeap* mpHeap;
+			ResourceID mNextID;
+			std::unordered_map<ResourceID, Entry> mEntries;
+			RelocationCallback mRelocationCallback;
+			Batch mCurrentBatch;
+			std::vector<Batch> mPendingBatches;
+		};
+	}
+}
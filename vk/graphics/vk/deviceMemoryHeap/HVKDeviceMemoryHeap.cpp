@@ -0,0 +1,458 @@
+﻿#include "HVKDeviceMemoryHeap.h"
+
+#include <utility> // for std::move
+#include <algorithm>
+
+#include "../common/Common.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		struct HVKDeviceMemoryHeap::Block
+		{
+			HVKDeviceMemory memory;
+			utility::TLSFAllocator allocator;
+			uint32_t memoryTypeIndex;
+			size_t index;	///< HVKDeviceMemoryHeap::mBlocks[memoryTypeIndex]またはmDedicatedBlocks内での位置
+			bool isDedicated;
+		};
+
+		const VkDeviceSize HVKDeviceMemoryHeap::sDefaultBlockSize = 64ull * 1024 * 1024;
+
+		HVKDeviceMemoryHeap::Statistics::Statistics()noexcept
+			: blockCount(0)
+			, blockBytes(0)
+			, usedBytes(0)
+			, allocationCount(0)
+			, largestFreeBlock(0)
+			, dedicatedCount(0)
+			, dedicatedBytes(0)
+		{ }
+
+		HVKDeviceMemoryHeap::DedicatedPolicy::DedicatedPolicy()noexcept
+			: bufferThreshold(32ull * 1024 * 1024)
+			, imageThreshold(16ull * 1024 * 1024)
+			, isFollowDriverHint(true)
+		{ }
+
+		HVKDeviceMemoryHeap::HVKDeviceMemoryHeap()
+			: mParentDevice(nullptr)
+			, mBufferImageGranularity(1)
+			, mNonCoherentAtomSize(1)
+			, mPreferredBlockSize(sDefaultBlockSize)
+		{
+			setMemory(&this->mMemoryProps, 0);
+			memset(this->mEmptyBlockCounts, 0, sizeof(this->mEmptyBlockCounts));
+		}
+
+		HVKDeviceMemoryHeap::HVKDeviceMemoryHeap(HVKDeviceMemoryHeap&& right)noexcept
+			: HVKDeviceMemoryHeap()
+		{
+			*this = std::move(right);
+		}
+
+		HVKDeviceMemoryHeap& HVKDeviceMemoryHeap::operator=(HVKDeviceMemoryHeap&& right)noexcept
+		{
+			this->release();
+
+			this->mParentDevice = right.mParentDevice;
+			this->mMemoryProps = right.mMemoryProps;
+			this->mMemoryTypeResolver = std::move(right.mMemoryTypeResolver);
+			this->mBufferImageGranularity = right.mBufferImageGranularity;
+			this->mNonCoherentAtomSize = right.mNonCoherentAtomSize;
+			this->mPreferredBlockSize = right.mPreferredBlockSize;
+			for (auto i = 0u; i < VK_MAX_MEMORY_TYPES; ++i) {
+				this->mBlocks[i] = std::move(right.mBlocks[i]);
+				right.mBlocks[i].clear();
+			}
+			memcpy(this->mEmptyBlockCounts, right.mEmptyBlockCounts, sizeof(this->mEmptyBlockCounts));
+			this->mDedicatedBlocks = std::move(right.mDedicatedBlocks);
+			this->mDedicatedPolicy = right.mDedicatedPolicy;
+			right.mDedicatedBlocks.clear();
+
+			right.release();
+			return *this;
+		}
+
+		HVKDeviceMemoryHeap::~HVKDeviceMemoryHeap()
+		{
+			this->release();
+		}
+
+		void HVKDeviceMemoryHeap::release()noexcept
+		{
+			for (auto& blocks : this->mBlocks) {
+				blocks.clear();
+				blocks.shrink_to_fit();
+			}
+			memset(this->mEmptyBlockCounts, 0, sizeof(this->mEmptyBlockCounts));
+			this->mDedicatedBlocks.clear();
+			this->mDedicatedBlocks.shrink_to_fit();
+			this->mMemoryTypeResolver.release();
+			this->mParentDevice = nullptr;
+		}
+
+		void HVKDeviceMemoryHeap::create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps, VkDeviceSize bufferImageGranularity, VkDeviceSize nonCoherentAtomSize, VkDeviceSize preferredBlockSize)
+		{
+			this->release();
+
+			this->mParentDevice = device;
+			this->mMemoryProps = memoryProps;
+			this->mMemoryTypeResolver.create(memoryProps);
+			this->mPreferredBlockSize = preferredBlockSize;
+
+			//TLSFAllocatorは2の累乗しか受け付けないので切り上げておく
+			this->mBufferImageGranularity = 1;
+			while (this->mBufferImageGranularity < bufferImageGranularity) {
+				this->mBufferImageGranularity <<= 1;
+			}
+			this->mNonCoherentAtomSize = 1;
+			while (this->mNonCoherentAtomSize < nonCoherentAtomSize) {
+				this->mNonCoherentAtomSize <<= 1;
+			}
+		}
+
+		HVKMemoryAllocation HVKDeviceMemoryHeap::allocate(const VkMemoryRequirements& originalRequirements, uint32_t memoryTypeIndex, RESOURCE_TYPE type)
+		{
+			assert(this->isGood());
+			assert(memoryTypeIndex < this->mMemoryProps.memoryTypeCount);
+			assert(originalRequirements.memoryTypeBits & (1u << memoryTypeIndex));
+
+			auto requirements = this->alignForHostAccess(originalRequirements, memoryTypeIndex);
+
+			auto& blocks = this->mBlocks[memoryTypeIndex];
+
+			Block* pTarget = nullptr;
+			utility::TLSFAllocator::Allocation range;
+			for (auto& pBlock : blocks) {
+				range = pBlock->allocator.allocate(requirements.size, requirements.alignment, type);
+				if (range.isGood()) {
+					pTarget = pBlock.get();
+					break;
+				}
+			}
+
+			if (nullptr == pTarget) {
+				auto blockSize = std::max(this->calBlockSize(memoryTypeIndex), requirements.size);
+
+				auto pBlock = this->newBlock(blockSize, memoryTypeIndex, nullptr);
+				pBlock->index = blocks.size();
+
+				range = pBlock->allocator.allocate(requirements.size, requirements.alignment, type);
+				if (!range.isGood()) {
+					throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKDeviceMemoryHeap, allocate, VK_ERROR_OUT_OF_DEVICE_MEMORY)
+						<< "新しく確保したブロックからの割り当てに失敗しました size=" << requirements.size << " alignment=" << requirements.alignment;
+				}
+				pTarget = pBlock.get();
+				blocks.push_back(std::move(pBlock));
+			} else if (1 == pTarget->allocator.allocationCount()) {
+				//空のブロックを使い始めた
+				--this->mEmptyBlockCounts[memoryTypeIndex];
+			}
+
+			return this->makeAllocation(pTarget, range);
+		}
+
+		HVKMemoryAllocation HVKDeviceMemoryHeap::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags notPreferred, RESOURCE_TYPE type)
+		{
+			assert(this->isGood());
+
+			auto memoryTypeIndex = this->findMemoryType(requirements, required, preferred, notPreferred);
+			return this->allocate(requirements, memoryTypeIndex, type);
+		}
+
+		HVKMemoryAllocation HVKDeviceMemoryHeap::allocateDedicated(const HVKMemoryRequirements& requirements, uint32_t memoryTypeIndex, VkBuffer buffer, VkImage image)
+		{
+			assert(this->isGood());
+			assert(memoryTypeIndex < this->mMemoryProps.memoryTypeCount);
+			assert(requirements.memoryTypeBits & (1u << memoryTypeIndex));
+
+			VkMemoryDedicatedAllocateInfoKHR dedicatedInfo;
+			dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR;
+			dedicatedInfo.pNext = nullptr;
+			dedicatedInfo.buffer = buffer;
+			dedicatedInfo.image = image;
+			//ヒントを取得できなかったときは拡張機能が使えないので、普通に確保する
+			const void* pNext = requirements.isDedicatedHintAvailable ? &dedicatedInfo : nullptr;
+
+			auto pBlock = this->newBlock(requirements.size, memoryTypeIndex, pNext);
+			pBlock->isDedicated = true;
+			pBlock->index = this->mDedicatedBlocks.size();
+			auto range = pBlock->allocator.allocate(requirements.size, 1);
+			assert(range.isGood());
+
+			auto result = this->makeAllocation(pBlock.get(), range);
+			this->mDedicatedBlocks.push_back(std::move(pBlock));
+			return result;
+		}
+
+		HVKMemoryAllocation HVKDeviceMemoryHeap::allocateForBuffer(HVKBuffer& buffer, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags notPreferred)
+		{
+			assert(this->isGood());
+
+			auto requirements = buffer.getMemoryRequirements();
+			auto memoryTypeIndex = this->findMemoryType(requirements, required, preferred, notPreferred);
+			if (this->isDedicated(requirements, memoryTypeIndex, false)) {
+				return this->allocateDedicated(requirements, memoryTypeIndex, buffer.buffer(), VK_NULL_HANDLE);
+			}
+			return this->allocate(requirements, memoryTypeIndex, eRESOURCE_TYPE_LINEAR);
+		}
+
+		HVKMemoryAllocation HVKDeviceMemoryHeap::allocateForImage(HVKImage& image, VkImageTiling tiling, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags notPreferred)
+		{
+			assert(this->isGood());
+
+			auto requirements = image.getMemoryRequirements();
+			auto memoryTypeIndex = this->findMemoryType(requirements, required, preferred, notPreferred);
+			if (this->isDedicated(requirements, memoryTypeIndex, true)) {
+				return this->allocateDedicated(requirements, memoryTypeIndex, VK_NULL_HANDLE, image.image());
+			}
+			auto type = VK_IMAGE_TILING_OPTIMAL == tiling ? eRESOURCE_TYPE_OPTIMAL : eRESOURCE_TYPE_LINEAR;
+			return this->allocate(requirements, memoryTypeIndex, type);
+		}
+
+		HVKMemoryAllocation HVKDeviceMemoryHeap::allocateForTransientImage(HVKImage& image)
+		{
+			//遅延割り当てのメモリタイプがないときは同じ優先度の通常のメモリタイプが選ばれる
+			return this->allocateForImage(image, VK_IMAGE_TILING_OPTIMAL, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		}
+
+		HVKMemoryAllocation HVKDeviceMemoryHeap::allocateForDefragment(const VkMemoryRequirements& originalRequirements, const HVKMemoryAllocation& source, RESOURCE_TYPE type)noexcept
+		{
+			assert(this->isGood());
+			assert(source.isGood() && !source.isDedicated());
+
+			auto requirements = this->alignForHostAccess(originalRequirements, source.memoryTypeIndex);
+
+			//使われていないブロックから使われているブロックへ移すことで、空になったブロックを破棄できるようにする
+			auto sourceUsedSize = source.pBlock->allocator.usedSize();
+			for (auto& pBlock : this->mBlocks[source.memoryTypeIndex]) {
+				if (pBlock.get() == source.pBlock || pBlock->allocator.usedSize() <= sourceUsedSize) {
+					continue;
+				}
+				auto range = pBlock->allocator.allocate(requirements.size, requirements.alignment, type);
+				if (range.isGood()) {
+					return this->makeAllocation(pBlock.get(), range);
+				}
+			}
+			return HVKMemoryAllocation();
+		}
+
+		VkDeviceSize HVKDeviceMemoryHeap::blockUsedSize(const HVKMemoryAllocation& allocation)const noexcept
+		{
+			assert(allocation.isGood());
+			return allocation.pBlock->allocator.usedSize();
+		}
+
+		HVKDeviceMemoryHeap::Statistics HVKDeviceMemoryHeap::calStatistics(uint32_t memoryTypeIndex)const noexcept
+		{
+			assert(memoryTypeIndex < VK_MAX_MEMORY_TYPES);
+
+			Statistics result;
+			for (auto& pBlock : this->mBlocks[memoryTypeIndex]) {
+				++result.blockCount;
+				result.blockBytes += pBlock->allocator.capacity();
+				result.usedBytes += pBlock->allocator.usedSize();
+				result.allocationCount += static_cast<uint32_t>(pBlock->allocator.allocationCount());
+				result.largestFreeBlock = std::max(result.largestFreeBlock, pBlock->allocator.largestFreeSize());
+			}
+			for (auto& pBlock : this->mDedicatedBlocks) {
+				if (memoryTypeIndex == pBlock->memoryTypeIndex) {
+					++result.dedicatedCount;
+					result.dedicatedBytes += pBlock->allocator.capacity();
+				}
+			}
+			return result;
+		}
+
+		bool HVKDeviceMemoryHeap::isDedicated(const HVKMemoryRequirements& requirements, uint32_t memoryTypeIndex, bool isImage)const noexcept
+		{
+			if (requirements.requiresDedicatedAllocation) {
+				return true;
+			}
+			//遅延割り当てのメモリは使われるまで実体がないので、ブロックにまとめると確保量を調べられなくなる
+			if (this->mMemoryProps.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+				return true;
+			}
+			if (this->mDedicatedPolicy.isFollowDriverHint && requirements.prefersDedicatedAllocation) {
+				return true;
+			}
+			auto threshold = isImage ? this->mDedicatedPolicy.imageThreshold : this->mDedicatedPolicy.bufferThreshold;
+			if (0 < threshold && threshold <= requirements.size) {
+				return true;
+			}
+			//ブロックの半分を超えるものは切り出すと無駄が大きいので専用にする
+			return this->calBlockSize(memoryTypeIndex) / 2 < requirements.size;
+		}
+
+		void HVKDeviceMemoryHeap::free(HVKMemoryAllocation& allocation)noexcept
+		{
+			if (!allocation.isGood()) {
+				return;
+			}
+			assert(this->isGood());
+
+			auto* pBlock = allocation.pBlock;
+			pBlock->allocator.free(allocation.range);
+			allocation = HVKMemoryAllocation();
+
+			if (pBlock->isDedicated) {
+				auto index = pBlock->index;
+				if (index + 1 != this->mDedicatedBlocks.size()) {
+					std::swap(this->mDedicatedBlocks[index], this->mDedicatedBlocks.back());
+					this->mDedicatedBlocks[index]->index = index;
+				}
+				this->mDedicatedBlocks.pop_back();
+				return;
+			}
+
+			if (pBlock->allocator.isEmpty()) {
+				auto memoryTypeIndex = pBlock->memoryTypeIndex;
+				if (0 == this->mEmptyBlockCounts[memoryTypeIndex]) {
+					++this->mEmptyBlockCounts[memoryTypeIndex];
+				} else {
+					//空のブロックはすでにあるので破棄する
+					auto& blocks = this->mBlocks[memoryTypeIndex];
+					auto index = pBlock->index;
+					if (index + 1 != blocks.size()) {
+						std::swap(blocks[index], blocks.back());
+						blocks[index]->index = index;
+					}
+					blocks.pop_back();
+				}
+			}
+		}
+
+		VkDeviceSize HVKDeviceMemoryHeap::calBlockSize(uint32_t memoryTypeIndex)const noexcept
+		{
+			auto heapIndex = this->mMemoryProps.memoryTypes[memoryTypeIndex].heapIndex;
+			auto heapSize = this->mMemoryProps.memoryHeaps[heapIndex].size;
+			//小さいヒープを1つのブロックで使い切らないようにする
+			return std::min(this->mPreferredBlockSize, heapSize / 8);
+		}
+
+		VkMemoryRequirements HVKDeviceMemoryHeap::alignForHostAccess(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex)const noexcept
+		{
+			auto flags = this->mMemoryProps.memoryTypes[memoryTypeIndex].propertyFlags;
+			if (!(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) || (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) || 1 == this->mNonCoherentAtomSize) {
+				return requirements;
+			}
+			//フラッシュの範囲はnonCoherentAtomSizeの倍数に広げられるので、隣の割り当てと同じアトムに入らないようにする
+			auto result = requirements;
+			result.alignment = std::max(result.alignment, this->mNonCoherentAtomSize);
+			result.size = (result.size + this->mNonCoherentAtomSize - 1) / this->mNonCoherentAtomSize * this->mNonCoherentAtomSize;
+			return result;
+		}
+
+		HVKMemoryAllocation HVKDeviceMemoryHeap::makeAllocation(Block* pBlock, const utility::TLSFAllocator::Allocation& range)noexcept
+		{
+			HVKMemoryAllocation result;
+			result.pMemory = &pBlock->memory;
+			result.offset = range.offset;
+			result.size = range.size;
+			result.memoryTypeIndex = pBlock->memoryTypeIndex;
+			result.pBlock = pBlock;
+			result.range = range;
+			if (auto* pMapped = static_cast<uint8_t*>(pBlock->memory.mappedPointer())) {
+				result.pMappedData = pMapped + range.offset;
+			}
+			return result;
+		}
+
+		std::unique_ptr<HVKDeviceMemoryHeap::Block> HVKDeviceMemoryHeap::newBlock(VkDeviceSize blockSize, uint32_t memoryTypeIndex, const void* pAllocateNext)
+		{
+			std::unique_ptr<Block> pBlock(new Block());
+			pBlock->memory.setCallbacks(const_cast<VkAllocationCallbacks*>(this->allocationCallbacksPointer()));
+			HVKMemoryAllocateInfo allocInfo(blockSize, memoryTypeIndex);
+			allocInfo.pNext = pAllocateNext;
+			//ホストから見えるブロックは確保したときにマップしておき、割り当てごとのマップを不要にする
+			auto isHostVisible = 0 != (this->mMemoryProps.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			pBlock->memory.create(this->mParentDevice, &allocInfo, isHostVisible);
+			pBlock->allocator.create(blockSize, this->mBufferImageGranularity);
+			pBlock->memoryTypeIndex = memoryTypeIndex;
+			pBlock->index = 0;
+			pBlock->isDedicated = false;
+			return pBlock;
+		}
+
+		uint32_t HVKDeviceMemoryHeap::findMemoryType(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags notPreferred)
+		{
+			auto memoryTypeIndex = this->mMemoryTypeResolver.find(requirements.memoryTypeBits, required, preferred, notPreferred);
+			if (HVKMemoryTypeResolver::sInvalidIndex == memoryTypeIndex) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKDeviceMemoryHeap, findMemoryType, VK_ERROR_FEATURE_NOT_PRESENT)
+					<< "条件に合うメモリタイプが見つかりませんでした typeBits=" << requirements.memoryTypeBits << " required=" << required;
+			}
+			return memoryTypeIndex;
+		}
+
+		bool HVKDeviceMemoryHeap::isGood()const noexcept
+		{
+			return nullptr != this->mParentDevice;
+		}
+
+		VkDevice HVKDeviceMemoryHeap::device()noexcept
+		{
+			return this->mParentDevice;
+		}
+
+		const VkPhysicalDeviceMemoryProperties& HVKDeviceMemoryHeap::memoryProperties()const noexcept
+		{
+			return this->mMemoryProps;
+		}
+
+		HVKMemoryTypeResolver& HVKDeviceMemoryHeap::memoryTypeResolver()noexcept
+		{
+			return this->mMemoryTypeResolver;
+		}
+
+		void HVKDeviceMemoryHeap::setDedicatedPolicy(const DedicatedPolicy& policy)noexcept
+		{
+			this->mDedicatedPolicy = policy;
+		}
+
+		const HVKDeviceMemoryHeap::DedicatedPolicy& HVKDeviceMemoryHeap::dedicatedPolicy()const noexcept
+		{
+			return this->mDedicatedPolicy;
+		}
+	}
+
+	namespace graphics
+	{
+		HVKMemoryAllocation::HVKMemoryAllocation()noexcept
+			: pMemory(nullptr)
+			, offset(0)
+			, size(0)
+			, memoryTypeIndex(0)
+			, pBlock(nullptr)
+			, pMappedData(nullptr)
+		{ }
+
+		VkResult HVKMemoryAllocation::bindBuffer(VkBuffer buffer)
+		{
+			assert(this->isGood());
+			return this->pMemory->bindBuffer(buffer, this->offset);
+		}
+
+		VkResult HVKMemoryAllocation::bindImage(VkImage image)
+		{
+			assert(this->isGood());
+			return this->pMemory->bindImage(image, this->offset);
+		}
+
+		bool HVKMemoryAllocation::isGood()const noexcept
+		{
+			return nullptr != this->pMemory;
+		}
+
+		bool HVKMemoryAllocation::isDedicated()const noexcept
+		{
+			return this->isGood() && this->pBlock->isDedicated;
+		}
+
+		VkDeviceMemory HVKMemoryAllocation::memory()noexcept
+		{
+			return this->isGood() ? this->pMemory->memory() : nullptr;
+		}
+	}
+}
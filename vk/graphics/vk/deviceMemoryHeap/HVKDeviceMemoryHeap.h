@@ -0,0 +1,245 @@
+﻿#pragma once
+
+#include <vector>
+#include <memory>
+#include <vulkan\vulkan.h>
+
+#include "../HVKInterface.h"
+#include "../allocationCallbacks/HVKAllocationCallbacks.h"
+#include "../deviceMemory/HVKDeviceMemory.h"
+#include "../buffer/HVKBuffer.h"
+#include "../image/HVKImage.h"
+#include "../memoryTypeResolver/HVKMemoryTypeResolver.h"
+#include "../utility/TLSFAllocator/TLSFAllocator.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		struct HVKMemoryAllocation;
+
+		/// @brief 大きなVkDeviceMemoryをメモリタイプごとに確保し、そこから切り出して割り当てるクラス
+		///
+		/// 切り出しにはTLSFを使用しているので、割り当てと解放のコストはリソースの数に依存しません。
+		/// VkMemoryRequirements::alignmentとVkPhysicalDeviceLimits::bufferImageGranularityを考慮して配置します。
+		/// HOST_COHERENTでないホストから見えるメモリタイプでは、位置と大きさをnonCoherentAtomSizeの倍数にそろえるので
+		/// 割り当てごとのフラッシュやインバリデートが隣の割り当てにかかることはありません。
+		/// 大きなリソースやドライバが推奨するリソースには、ブロックから切り出さずに専用のVkDeviceMemoryを確保します。
+		class HVKDeviceMemoryHeap : public IHVKInterface, public HVKAllocationCallbacks
+		{
+			HVKDeviceMemoryHeap(const HVKDeviceMemoryHeap&) = delete;
+			HVKDeviceMemoryHeap& operator=(const HVKDeviceMemoryHeap&) = delete;
+
+		public:
+			/// @brief bufferImageGranularityの判定に使うリソースの種類
+			enum RESOURCE_TYPE {
+				eRESOURCE_TYPE_LINEAR = 1,	///< バッファとVK_IMAGE_TILING_LINEARのイメージ
+				eRESOURCE_TYPE_OPTIMAL = 2,	///< VK_IMAGE_TILING_OPTIMALのイメージ
+			};
+
+			static const VkDeviceSize sDefaultBlockSize;
+
+			/// @brief 1つのVkDeviceMemoryとその切り出し状況
+			struct Block;
+
+			/// @brief メモリタイプごとの使用状況
+			struct Statistics
+			{
+				uint32_t blockCount;			///< ブロックの数. 専用メモリは含みません
+				VkDeviceSize blockBytes;		///< ブロックの大きさの合計
+				VkDeviceSize usedBytes;			///< ブロックから切り出されている大きさの合計
+				uint32_t allocationCount;		///< ブロックから切り出されている数
+				VkDeviceSize largestFreeBlock;	///< ブロックの中で最も大きな空き領域
+				uint32_t dedicatedCount;		///< 専用メモリの数
+				VkDeviceSize dedicatedBytes;	///< 専用メモリの大きさの合計
+
+				Statistics()noexcept;
+			};
+
+			/// @brief 専用のVkDeviceMemoryを確保するかの判定基準
+			struct DedicatedPolicy
+			{
+				VkDeviceSize bufferThreshold;	///< この大きさ以上のバッファは専用メモリにします. 0なら大きさで判定しません
+				VkDeviceSize imageThreshold;	///< この大きさ以上のイメージは専用メモリにします. 0なら大きさで判定しません
+				bool isFollowDriverHint;		///< HVKMemoryRequirements::prefersDedicatedAllocationに従うか
+
+				DedicatedPolicy()noexcept;
+			};
+
+		public:
+			HVKDeviceMemoryHeap();
+			HVKDeviceMemoryHeap(HVKDeviceMemoryHeap&& right)noexcept;
+			HVKDeviceMemoryHeap& operator=(HVKDeviceMemoryHeap&& right)noexcept;
+			~HVKDeviceMemoryHeap();
+
+			void release()noexcept override;
+
+			/// @brief 作成
+			///
+			/// この時点ではVkDeviceMemoryは確保しません
+			/// @param[in] device
+			/// @param[in] memoryProps
+			/// @param[in] bufferImageGranularity VkPhysicalDeviceLimits::bufferImageGranularity
+			/// @param[in] nonCoherentAtomSize VkPhysicalDeviceLimits::nonCoherentAtomSize
+			/// @param[in] preferredBlockSize 一度に確保するVkDeviceMemoryの大きさ. ヒープが小さいときはこれより小さくなります
+			void create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps, VkDeviceSize bufferImageGranularity, VkDeviceSize nonCoherentAtomSize, VkDeviceSize preferredBlockSize = sDefaultBlockSize);
+
+			/// @brief 割り当て
+			///
+			/// 空きがなければ新しくVkDeviceMemoryを確保します
+			/// @param[in] requirements
+			/// @param[in] memoryTypeIndex requirements.memoryTypeBitsに含まれるもの
+			/// @param[in] type
+			/// @retval HVKMemoryAllocation
+			/// @exception HVKException
+			HVKMemoryAllocation allocate(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, RESOURCE_TYPE type);
+
+			/// @brief メモリタイプを選んでから割り当てる
+			///
+			/// メモリタイプの選択にはmemoryTypeResolver()を使います
+			/// @param[in] requirements
+			/// @param[in] required 必ず持っていなければならないフラグ
+			/// @param[in] preferred 持っていると望ましいフラグ
+			/// @param[in] notPreferred 持っていないほうが望ましいフラグ
+			/// @param[in] type
+			/// @retval HVKMemoryAllocation
+			/// @exception HVKException
+			HVKMemoryAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags notPreferred, RESOURCE_TYPE type);
+
+			/// @brief 専用のVkDeviceMemoryを確保する
+			///
+			/// requirements.isDedicatedHintAvailableがtrueのときはVkMemoryDedicatedAllocateInfoKHRでリソースを指定します
+			/// @param[in] requirements
+			/// @param[in] memoryTypeIndex
+			/// @param[in] buffer 割り当て先のバッファ. イメージのときはVK_NULL_HANDLE
+			/// @param[in] image 割り当て先のイメージ. バッファのときはVK_NULL_HANDLE
+			/// @retval HVKMemoryAllocation
+			/// @exception HVKException
+			HVKMemoryAllocation allocateDedicated(const HVKMemoryRequirements& requirements, uint32_t memoryTypeIndex, VkBuffer buffer, VkImage image);
+
+			/// @brief バッファ用に割り当てる
+			///
+			/// DedicatedPolicyに従ってブロックからの切り出しか専用メモリかを選びます。結びつけは行いません
+			/// @param[in] buffer
+			/// @param[in] required
+			/// @param[in] preferred
+			/// @param[in] notPreferred
+			/// @retval HVKMemoryAllocation
+			/// @exception HVKException
+			HVKMemoryAllocation allocateForBuffer(HVKBuffer& buffer, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0, VkMemoryPropertyFlags notPreferred = 0);
+
+			/// @brief イメージ用に割り当てる
+			///
+			/// DedicatedPolicyに従ってブロックからの切り出しか専用メモリかを選びます。結びつけは行いません
+			/// @param[in] image
+			/// @param[in] tiling 作成時に指定したもの
+			/// @param[in] required
+			/// @param[in] preferred
+			/// @param[in] notPreferred
+			/// @retval HVKMemoryAllocation
+			/// @exception HVKException
+			HVKMemoryAllocation allocateForImage(HVKImage& image, VkImageTiling tiling, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0, VkMemoryPropertyFlags notPreferred = 0);
+
+			/// @brief VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BITを付けたイメージ用に割り当てる
+			///
+			/// VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BITのメモリタイプがあればそれを専用メモリとして確保し、
+			/// なければ通常のDEVICE_LOCALなメモリから割り当てます。結びつけは行いません
+			/// @param[in] image VK_IMAGE_TILING_OPTIMALで作成したもの
+			/// @retval HVKMemoryAllocation
+			/// @exception HVKException
+			HVKMemoryAllocation allocateForTransientImage(HVKImage& image);
+
+			/// @brief デフラグ用に割り当てる
+			///
+			/// sourceと同じメモリタイプで、sourceのブロックより使われているブロックからのみ切り出します。
+			/// 新しいブロックは確保しないので、失敗したときはisGood()がfalseを返すHVKMemoryAllocationを返します
+			/// @param[in] requirements
+			/// @param[in] source 移動元の割り当て
+			/// @param[in] type
+			/// @retval HVKMemoryAllocation
+			HVKMemoryAllocation allocateForDefragment(const VkMemoryRequirements& requirements, const HVKMemoryAllocation& source, RESOURCE_TYPE type)noexcept;
+
+			/// @brief allocationが属しているブロックの使用量を返す
+			/// @param[in] allocation
+			/// @retval VkDeviceSize
+			VkDeviceSize blockUsedSize(const HVKMemoryAllocation& allocation)const noexcept;
+
+			/// @brief メモリタイプごとの使用状況を集計する
+			///
+			/// ブロックの数に比例した時間がかかります
+			/// @param[in] memoryTypeIndex
+			/// @retval Statistics
+			Statistics calStatistics(uint32_t memoryTypeIndex)const noexcept;
+
+			/// @brief 専用メモリにするべきか判定する
+			/// @param[in] requirements
+			/// @param[in] memoryTypeIndex
+			/// @param[in] isImage
+			/// @retval bool
+			bool isDedicated(const HVKMemoryRequirements& requirements, uint32_t memoryTypeIndex, bool isImage)const noexcept;
+
+			/// @brief 解放. 定数時間で終わります
+			///
+			/// 空になったVkDeviceMemoryはメモリタイプごとに1つだけ残し、それ以外は破棄します。
+			/// 専用メモリはすぐに破棄します
+			/// @param[inout] allocation 解放後は無効な状態になります
+			void free(HVKMemoryAllocation& allocation)noexcept;
+
+		public:
+			bool isGood()const noexcept override;
+			VkDevice device()noexcept;
+			const VkPhysicalDeviceMemoryProperties& memoryProperties()const noexcept;
+			HVKMemoryTypeResolver& memoryTypeResolver()noexcept;
+			void setDedicatedPolicy(const DedicatedPolicy& policy)noexcept;
+			const DedicatedPolicy& dedicatedPolicy()const noexcept;
+
+		private:
+			VkDeviceSize calBlockSize(uint32_t memoryTypeIndex)const noexcept;
+			VkMemoryRequirements alignForHostAccess(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex)const noexcept;
+			HVKMemoryAllocation makeAllocation(Block* pBlock, const utility::TLSFAllocator::Allocation& range)noexcept;
+			std::unique_ptr<Block> newBlock(VkDeviceSize blockSize, uint32_t memoryTypeIndex, const void* pAllocateNext);
+			uint32_t findMemoryType(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags notPreferred);
+
+		private:
+			VkDevice mParentDevice;
+			VkPhysicalDeviceMemoryProperties mMemoryProps;
+			HVKMemoryTypeResolver mMemoryTypeResolver;
+			VkDeviceSize mBufferImageGranularity;
+			VkDeviceSize mNonCoherentAtomSize;
+			VkDeviceSize mPreferredBlockSize;
+			std::vector<std::unique_ptr<Block>> mBlocks[VK_MAX_MEMORY_TYPES];
+			uint32_t mEmptyBlockCounts[VK_MAX_MEMORY_TYPES];
+			std::vector<std::unique_ptr<Block>> mDedicatedBlocks;
+			DedicatedPolicy mDedicatedPolicy;
+		};
+	}
+
+	namespace graphics
+	{
+		/// @brief HVKDeviceMemoryHeapから切り出されたメモリ
+		///
+		/// bindBuffer, bindImageでそのままリソースに結びつけられます。
+		/// ホストから見えるメモリタイプのブロックは常にマップされているので、pMappedDataから直接書き込めます。
+		/// HOST_COHERENTでないメモリタイプではoffsetとsizeはnonCoherentAtomSizeの倍数になっています
+		struct HVKMemoryAllocation
+		{
+			HVKDeviceMemory* pMemory;
+			VkDeviceSize offset;
+			VkDeviceSize size;
+			uint32_t memoryTypeIndex;
+
+			HVKDeviceMemoryHeap::Block* pBlock;
+			utility::TLSFAllocator::Allocation range;
+			void* pMappedData;	///< ホストから見えるメモリタイプならoffsetの位置を指すポインタ. それ以外はnullptr
+
+			HVKMemoryAllocation()noexcept;
+
+			VkResult bindBuffer(VkBuffer buffer);
+			VkResult bindImage(VkImage image);
+
+			bool isGood()const noexcept;
+			bool isDedicated()const noexcept;
+			VkDeviceMemory memory()noexcept;
+		};
+	}
+}
@@ -0,0 +1,178 @@
+﻿#include "HVKDynamicBuffer.h"
+
+#include <cstring>
+#include <algorithm>
+
+#include "../common/Common.h"
+#include "../descriptorSets/HVKDescriptorSets.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace
+		{
+			inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)noexcept
+			{
+				return (value + alignment - 1) / alignment * alignment;
+			}
+		}
+
+		HVKDynamicBuffer::HVKDynamicBuffer()
+			: mType(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
+			, mRange(0)
+			, mStride(0)
+		{ }
+
+		HVKDynamicBuffer::HVKDynamicBuffer(HVKDynamicBuffer&& right)noexcept
+			: HVKDynamicBuffer()
+		{
+			*this = std::move(right);
+		}
+
+		HVKDynamicBuffer& HVKDynamicBuffer::operator=(HVKDynamicBuffer&& right)noexcept
+		{
+			this->release();
+
+			this->mRing = std::move(right.mRing);
+			this->mType = right.mType;
+			this->mRange = right.mRange;
+			this->mStride = right.mStride;
+
+			right.release();
+			return *this;
+		}
+
+		HVKDynamicBuffer::~HVKDynamicBuffer()
+		{
+			this->release();
+		}
+
+		void HVKDynamicBuffer::release()noexcept
+		{
+			this->mRing.release();
+			this->mType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+			this->mRange = 0;
+			this->mStride = 0;
+		}
+
+		void HVKDynamicBuffer::create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps, const VkPhysicalDeviceLimits& limits, VkDescriptorType type, VkDeviceSize range, uint32_t maxDrawCount, uint32_t frameCount)
+		{
+			assert(0 < range && 0 < maxDrawCount && 0 < frameCount);
+			this->release();
+
+			if (!HVKWriteDescriptorSet::sIsDynamicType(type)) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKDynamicBuffer, create, VK_ERROR_FEATURE_NOT_PRESENT)
+					<< "動的オフセットを使うディスクリプタの種類ではありません type=" << type;
+			}
+
+			auto isUniform = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC == type;
+			VkDeviceSize maxRange = isUniform ? limits.maxUniformBufferRange : limits.maxStorageBufferRange;
+			if (maxRange < range) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKDynamicBuffer, create, VK_ERROR_FEATURE_NOT_PRESENT)
+					<< "ディスクリプタの範囲が上限を超えています range=" << range << " max=" << maxRange;
+			}
+
+			//動的オフセットは常にstrideの倍数になるので、アライメントの条件を自動的に満たす
+			auto alignment = std::max<VkDeviceSize>(1, isUniform ? limits.minUniformBufferOffsetAlignment : limits.minStorageBufferOffsetAlignment);
+			auto stride = alignUp(range, alignment);
+
+			this->mRing.setCallbacks(const_cast<VkAllocationCallbacks*>(this->allocationCallbacksPointer()));
+			VkBufferUsageFlags usage = isUniform ? VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT : VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+			this->mRing.create(device, memoryProps, limits, stride * maxDrawCount, frameCount, usage);
+
+			//動的オフセットはuint32_tなので、バッファ全体がその範囲に収まらなければならない
+			auto totalSize = this->mRing.frameSize() * frameCount;
+			if (static_cast<VkDeviceSize>(UINT32_MAX) < totalSize) {
+				this->mRing.release();
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKDynamicBuffer, create, VK_ERROR_OUT_OF_DEVICE_MEMORY)
+					<< "動的オフセットで指せる範囲を超えています size=" << totalSize;
+			}
+			this->mType = type;
+			this->mRange = range;
+			this->mStride = stride;
+		}
+
+		void HVKDynamicBuffer::writeDescriptor(HVKDescriptorSets& sets, int index, uint32_t binding, uint32_t arrayElement)
+		{
+			assert(this->isGood());
+			assert(HVKWriteDescriptorSet::sIsDynamicType(this->mType));
+
+			//範囲の先頭は動的オフセットで決まるので、ディスクリプタはバッファの先頭を指しておく
+			auto bufferInfo = this->descriptorInfo();
+			auto write = HVKWriteDescriptorSet()
+				.setDest(binding, arrayElement)
+				.setBufferInfo(this->mType, &bufferInfo, 1);
+			sets.update(index, &write, 1, nullptr, 0);
+		}
+
+		VkResult HVKDynamicBuffer::beginFrame(uint64_t timeout)
+		{
+			return this->mRing.beginFrame(timeout);
+		}
+
+		void HVKDynamicBuffer::endFrame(VkFence fence)noexcept
+		{
+			this->mRing.endFrame(fence);
+		}
+
+		HVKDynamicBuffer::Slice HVKDynamicBuffer::allocate()noexcept
+		{
+			assert(this->isGood());
+
+			Slice result;
+			auto slice = this->mRing.allocate(this->mStride);
+			if (slice.isGood()) {
+				assert(slice.offset <= UINT32_MAX);
+				result.pData = slice.pData;
+				result.dynamicOffset = static_cast<uint32_t>(slice.offset);
+			}
+			return result;
+		}
+
+		HVKDynamicBuffer::Slice HVKDynamicBuffer::push(const void* pData, VkDeviceSize size)noexcept
+		{
+			assert(size <= this->mRange);
+
+			auto slice = this->allocate();
+			if (slice.isGood()) {
+				memcpy(slice.pData, pData, static_cast<size_t>(size));
+			}
+			return slice;
+		}
+
+		bool HVKDynamicBuffer::isGood()const noexcept
+		{
+			return this->mRing.isGood();
+		}
+
+		VkBuffer HVKDynamicBuffer::buffer()noexcept
+		{
+			return this->mRing.buffer();
+		}
+
+		VkDescriptorType HVKDynamicBuffer::descriptorType()const noexcept
+		{
+			return this->mType;
+		}
+
+		VkDeviceSize HVKDynamicBuffer::range()const noexcept
+		{
+			return this->mRange;
+		}
+
+		VkDeviceSize HVKDynamicBuffer::stride()const noexcept
+		{
+			return this->mStride;
+		}
+
+		VkDescriptorBufferInfo HVKDynamicBuffer::descriptorInfo()noexcept
+		{
+			VkDescriptorBufferInfo info;
+			info.buffer = this->buffer();
+			info.offset = 0;
+			info.range = this->mRange;
+			return info;
+		}
+	}
+}
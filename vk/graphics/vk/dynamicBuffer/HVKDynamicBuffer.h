@@ -0,0 +1,100 @@
+﻿#pragma once
+
+#include <vulkan\vulkan.h>
+
+#include "../HVKInterface.h"
+#include "../allocationCallbacks/HVKAllocationCallbacks.h"
+#include "../frameRingAllocator/HVKFrameRingAllocator.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		class HVKDescriptorSets;
+
+		/// @brief VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC用のバッファ
+		///
+		/// HVKFrameRingAllocatorのバッファ全体を1つのディスクリプタで指し、描画ごとのデータの位置は動的オフセットで切り替えます。
+		/// ディスクリプタセットの数と更新は描画の数によらず1回で済みます。
+		/// 割り当ては常にstride()の大きさで行うので、どの動的オフセットでもディスクリプタの範囲がバッファからはみ出しません
+		class HVKDynamicBuffer : public IHVKInterface, public HVKAllocationCallbacks
+		{
+			HVKDynamicBuffer(const HVKDynamicBuffer&) = delete;
+			HVKDynamicBuffer& operator=(const HVKDynamicBuffer&) = delete;
+
+		public:
+			/// @brief 描画1回分の割り当て
+			struct Slice
+			{
+				void* pData;			///< 書き込み先
+				uint32_t dynamicOffset;	///< vkCmdBindDescriptorSetsに渡す値
+
+				Slice()noexcept : pData(nullptr), dynamicOffset(0) {}
+				bool isGood()const noexcept { return nullptr != this->pData; }
+			};
+
+		public:
+			HVKDynamicBuffer();
+			HVKDynamicBuffer(HVKDynamicBuffer&& right)noexcept;
+			HVKDynamicBuffer& operator=(HVKDynamicBuffer&& right)noexcept;
+			~HVKDynamicBuffer();
+
+			void release()noexcept override;
+
+			/// @brief 作成
+			/// @param[in] device
+			/// @param[in] memoryProps
+			/// @param[in] limits アライメントと範囲の上限を調べるのに使います
+			/// @param[in] type VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMICかVK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC
+			/// @param[in] range 1回の描画で使う大きさ. ディスクリプタの範囲になります
+			/// @param[in] maxDrawCount 1フレームで割り当てられる数
+			/// @param[in] frameCount 同時に処理されるフレームの数
+			/// @exception HVKException typeが動的オフセットを使う種類でないときや、バッファ全体が動的オフセットで指せる範囲を超えるときも投げます
+			void create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps, const VkPhysicalDeviceLimits& limits, VkDescriptorType type, VkDeviceSize range, uint32_t maxDrawCount, uint32_t frameCount);
+
+			/// @brief ディスクリプタセットにバッファを書き込む
+			///
+			/// バッファは作り直さないので、作成後に1回呼び出せば十分です
+			/// @param[in] sets
+			/// @param[in] index 対象のディスクリプタセットの添え字
+			/// @param[in] binding
+			/// @param[in] arrayElement
+			void writeDescriptor(HVKDescriptorSets& sets, int index, uint32_t binding, uint32_t arrayElement = 0);
+
+			/// @brief 次のフレームの領域に切り替える
+			/// @param[in] timeout
+			/// @retval VkResult
+			VkResult beginFrame(uint64_t timeout = UINT64_MAX);
+
+			/// @brief 現在のフレームの領域を使うコマンドを提出したフェンスを設定する
+			/// @param[in] fence
+			void endFrame(VkFence fence)noexcept;
+
+			/// @brief 描画1回分を割り当てる
+			///
+			/// 現在のフレームで割り当てられる数を超えたときはisGood()がfalseを返すSliceを返します
+			/// @retval Slice
+			Slice allocate()noexcept;
+
+			/// @brief 割り当ててpDataの内容をコピーする
+			/// @param[in] pData
+			/// @param[in] size range()以下であること
+			/// @retval Slice
+			Slice push(const void* pData, VkDeviceSize size)noexcept;
+
+		public:
+			bool isGood()const noexcept override;
+			VkBuffer buffer()noexcept;
+			VkDescriptorType descriptorType()const noexcept;
+			VkDeviceSize range()const noexcept;
+			VkDeviceSize stride()const noexcept;
+			VkDescriptorBufferInfo descriptorInfo()noexcept;
+
+		private:
+			HVKFrameRingAllocator mRing;
+			VkDescriptorType mType;
+			VkDeviceSize mRange;
+			VkDeviceSize mStride;
+		};
+	}
+}
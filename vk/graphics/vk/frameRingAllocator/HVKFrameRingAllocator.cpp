@@ -0,0 +1,235 @@
+﻿#include "HVKFrameRingAllocator.h"
+
+#include <utility> // for std::move
+#include <algorithm>
+
+#include "../common/Common.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace
+		{
+			inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)noexcept
+			{
+				return (value + alignment - 1) / alignment * alignment;
+			}
+		}
+
+		HVKFrameRingAllocator::Slice::Slice()noexcept
+			: buffer(nullptr)
+			, offset(0)
+			, size(0)
+			, pData(nullptr)
+		{ }
+
+		VkDescriptorBufferInfo HVKFrameRingAllocator::Slice::descriptorInfo()const noexcept
+		{
+			VkDescriptorBufferInfo info;
+			info.buffer = this->buffer;
+			info.offset = this->offset;
+			info.range = this->size;
+			return info;
+		}
+
+		HVKFrameRingAllocator::HVKFrameRingAllocator()
+			: mParentDevice(nullptr)
+			, mpMapped(nullptr)
+			, mFrameSize(0)
+			, mAlignment(1)
+			, mFrameIndex(0)
+			, mHead(0)
+			, mHasBegunFrame(false)
+		{ }
+
+		HVKFrameRingAllocator::HVKFrameRingAllocator(HVKFrameRingAllocator&& right)noexcept
+			: HVKFrameRingAllocator()
+		{
+			*this = std::move(right);
+		}
+
+		HVKFrameRingAllocator& HVKFrameRingAllocator::operator=(HVKFrameRingAllocator&& right)noexcept
+		{
+			this->release();
+
+			this->mParentDevice = right.mParentDevice;
+			this->mBuffer = std::move(right.mBuffer);
+			this->mMemory = std::move(right.mMemory);
+			this->mpMapped = right.mpMapped;
+			this->mFrameSize = right.mFrameSize;
+			this->mAlignment = right.mAlignment;
+			this->mFrameIndex = right.mFrameIndex;
+			this->mHead = right.mHead;
+			this->mHasBegunFrame = right.mHasBegunFrame;
+			this->mFences = std::move(right.mFences);
+
+			right.mParentDevice = nullptr;
+			right.mpMapped = nullptr;
+			right.mFences.clear();
+			right.release();
+			return *this;
+		}
+
+		HVKFrameRingAllocator::~HVKFrameRingAllocator()
+		{
+			this->release();
+		}
+
+		void HVKFrameRingAllocator::release()noexcept
+		{
+			this->mpMapped = nullptr;
+			this->mBuffer.release();
+			this->mMemory.release();
+			this->mFences.clear();
+			this->mFences.shrink_to_fit();
+
+			this->mParentDevice = nullptr;
+			this->mFrameSize = 0;
+			this->mAlignment = 1;
+			this->mFrameIndex = 0;
+			this->mHead = 0;
+			this->mHasBegunFrame = false;
+		}
+
+		void HVKFrameRingAllocator::create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps, const VkPhysicalDeviceLimits& limits, VkDeviceSize frameSize, uint32_t frameCount, VkBufferUsageFlags usage)
+		{
+			assert(0 < frameSize && 0 < frameCount);
+			this->release();
+
+			this->mAlignment = std::max<VkDeviceSize>(1, limits.minUniformBufferOffsetAlignment);
+			if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) {
+				this->mAlignment = std::max(this->mAlignment, limits.minStorageBufferOffsetAlignment);
+			}
+			if (usage & (VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT)) {
+				this->mAlignment = std::max(this->mAlignment, limits.minTexelBufferOffsetAlignment);
+			}
+			this->mFrameSize = alignUp(frameSize, this->mAlignment);
+
+			auto* pCallbacks = const_cast<VkAllocationCallbacks*>(this->allocationCallbacksPointer());
+			this->mBuffer.setCallbacks(pCallbacks);
+			this->mMemory.setCallbacks(pCallbacks);
+
+			HVKBufferCreateInfo bufferInfo(this->mFrameSize * frameCount, usage);
+			this->mBuffer.create(device, &bufferInfo);
+
+			auto requirements = this->mBuffer.getMemoryRequirements();
+			auto memoryTypeIndex = HVKMemoryAllocateInfo::sCheckMemmoryType(memoryProps, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			if (static_cast<uint32_t>(-1) == memoryTypeIndex) {
+				this->release();
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKFrameRingAllocator, create, VK_ERROR_FEATURE_NOT_PRESENT) << "ホストから見えるメモリタイプが見つかりませんでした";
+			}
+			HVKMemoryAllocateInfo allocInfo(requirements.size, memoryTypeIndex);
+			this->mMemory.create(device, &allocInfo, true);
+			auto ret = this->mMemory.bindBuffer(this->mBuffer);
+			if (VK_SUCCESS != ret) {
+				this->release();
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKFrameRingAllocator, create, ret) << "バッファとメモリの結びつけに失敗しました";
+			}
+			this->mpMapped = static_cast<uint8_t*>(this->mMemory.mappedPointer());
+
+			this->mParentDevice = device;
+			this->mFences.assign(frameCount, VK_NULL_HANDLE);
+			this->mFrameIndex = 0;
+			this->mHead = 0;
+			this->mHasBegunFrame = false;
+		}
+
+		VkResult HVKFrameRingAllocator::beginFrame(uint64_t timeout)
+		{
+			assert(this->isGood());
+
+			//最初のフレームは作成時に選んだ領域0をそのまま使う. それより前に割り当てたものも領域0のものとして残す
+			if (!this->mHasBegunFrame) {
+				this->mHasBegunFrame = true;
+				return VK_SUCCESS;
+			}
+
+			auto next = (this->mFrameIndex + 1) % this->frameCount();
+			auto& fence = this->mFences[next];
+			if (VK_NULL_HANDLE != fence) {
+				auto ret = vkWaitForFences(this->mParentDevice, 1, &fence, VK_TRUE, timeout);
+				if (VK_SUCCESS != ret) {
+					return ret;
+				}
+				fence = VK_NULL_HANDLE;
+			}
+			this->mFrameIndex = next;
+			this->mHead = 0;
+			return VK_SUCCESS;
+		}
+
+		void HVKFrameRingAllocator::endFrame(VkFence fence)noexcept
+		{
+			assert(this->isGood());
+			this->mFences[this->mFrameIndex] = fence;
+		}
+
+		HVKFrameRingAllocator::Slice HVKFrameRingAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment)noexcept
+		{
+			assert(this->isGood());
+
+			Slice result;
+			alignment = std::max(alignment, this->mAlignment);
+			//領域の大きさはmAlignmentの倍数でしかないので、バッファの先頭からのオフセットで揃える
+			auto frameOffset = this->mFrameSize * this->mFrameIndex;
+			auto bufferOffset = alignUp(frameOffset + this->mHead, alignment);
+			auto offset = bufferOffset - frameOffset;
+			if (this->mFrameSize < offset || this->mFrameSize - offset < size) {
+				return result;
+			}
+			this->mHead = offset + size;
+
+			result.buffer = this->mBuffer.buffer();
+			result.offset = bufferOffset;
+			result.size = size;
+			result.pData = this->mpMapped + bufferOffset;
+			return result;
+		}
+
+		HVKFrameRingAllocator::Slice HVKFrameRingAllocator::push(const void* pData, VkDeviceSize size)noexcept
+		{
+			auto slice = this->allocate(size);
+			if (slice.isGood()) {
+				memcpy(slice.pData, pData, static_cast<size_t>(size));
+			}
+			return slice;
+		}
+
+		bool HVKFrameRingAllocator::isGood()const noexcept
+		{
+			return nullptr != this->mParentDevice && nullptr != this->mpMapped;
+		}
+
+		VkBuffer HVKFrameRingAllocator::buffer()noexcept
+		{
+			assert(this->isGood());
+			return this->mBuffer.buffer();
+		}
+
+		uint32_t HVKFrameRingAllocator::frameIndex()const noexcept
+		{
+			return this->mFrameIndex;
+		}
+
+		uint32_t HVKFrameRingAllocator::frameCount()const noexcept
+		{
+			return static_cast<uint32_t>(this->mFences.size());
+		}
+
+		VkDeviceSize HVKFrameRingAllocator::frameSize()const noexcept
+		{
+			return this->mFrameSize;
+		}
+
+		VkDeviceSize HVKFrameRingAllocator::usedSize()const noexcept
+		{
+			return this->mHead;
+		}
+
+		VkDeviceSize HVKFrameRingAllocator::alignment()const noexcept
+		{
+			return this->mAlignment;
+		}
+	}
+}
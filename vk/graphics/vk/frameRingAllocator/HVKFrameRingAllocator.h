@@ -0,0 +1,108 @@
+﻿#pragma once
+
+#include <vector>
+#include <vulkan\vulkan.h>
+
+#include "../HVKInterface.h"
+#include "../allocationCallbacks/HVKAllocationCallbacks.h"
+#include "../buffer/HVKBuffer.h"
+#include "../deviceMemory/HVKDeviceMemory.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		/// @brief フレームごとに使い捨てるユニフォームや頂点データ用のリングアロケータ
+		///
+		/// 1つのバッファをframeCount個の領域に分け、フレームごとに先頭からポインタを進めるだけで割り当てます。
+		/// メモリは常にマップされたHVKDeviceMemoryを使うので、破棄するまでマップしたままになります。
+		/// 領域はendFrameで渡したフェンスがシグナルされたあと、次にその領域を使うbeginFrameでまとめてリセットされます。
+		class HVKFrameRingAllocator : public IHVKInterface, public HVKAllocationCallbacks
+		{
+			HVKFrameRingAllocator(const HVKFrameRingAllocator&) = delete;
+			HVKFrameRingAllocator& operator=(const HVKFrameRingAllocator&) = delete;
+
+		public:
+			/// @brief 割り当てられた領域
+			struct Slice
+			{
+				VkBuffer buffer;
+				VkDeviceSize offset;
+				VkDeviceSize size;
+				void* pData;
+
+				Slice()noexcept;
+				bool isGood()const noexcept { return nullptr != this->pData; }
+
+				/// @brief ディスクリプタの更新に使う情報を返す
+				/// @retval VkDescriptorBufferInfo
+				VkDescriptorBufferInfo descriptorInfo()const noexcept;
+			};
+
+		public:
+			HVKFrameRingAllocator();
+			HVKFrameRingAllocator(HVKFrameRingAllocator&& right)noexcept;
+			HVKFrameRingAllocator& operator=(HVKFrameRingAllocator&& right)noexcept;
+			~HVKFrameRingAllocator();
+
+			void release()noexcept override;
+
+			/// @brief 作成
+			/// @param[in] device
+			/// @param[in] memoryProps
+			/// @param[in] limits 割り当てのアライメントにminUniformBufferOffsetAlignmentなどを使います
+			/// @param[in] frameSize 1フレームで使える大きさ
+			/// @param[in] frameCount 同時に処理されるフレームの数
+			/// @param[in] usage
+			/// @exception HVKException
+			void create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps, const VkPhysicalDeviceLimits& limits, VkDeviceSize frameSize, uint32_t frameCount, VkBufferUsageFlags usage);
+
+			/// @brief 次のフレームの領域に切り替える
+			///
+			/// その領域を前回使ったフレームのフェンスがシグナルされるまで待ってから、領域をリセットします。
+			/// 作成後の最初の呼び出しでは領域0のまま切り替えません
+			/// @param[in] timeout
+			/// @retval VkResult 待機に失敗したときは領域を切り替えません
+			VkResult beginFrame(uint64_t timeout = UINT64_MAX);
+
+			/// @brief 現在のフレームの領域を使うコマンドを提出したフェンスを設定する
+			/// @param[in] fence 次にこの領域を使う前に待つフェンス. VK_NULL_HANDLEなら待ちません
+			void endFrame(VkFence fence)noexcept;
+
+			/// @brief 現在のフレームの領域から割り当てる
+			///
+			/// 領域が足りないときはisGood()がfalseを返すSliceを返します
+			/// @param[in] size
+			/// @param[in] alignment 0なら作成時に決めたアライメントを使います. バッファの先頭からのオフセットで揃えます
+			/// @retval Slice
+			Slice allocate(VkDeviceSize size, VkDeviceSize alignment = 0)noexcept;
+
+			/// @brief 割り当てたあとpDataの内容をコピーする
+			/// @param[in] pData
+			/// @param[in] size
+			/// @retval Slice
+			Slice push(const void* pData, VkDeviceSize size)noexcept;
+
+		public:
+			bool isGood()const noexcept override;
+			VkBuffer buffer()noexcept;
+			uint32_t frameIndex()const noexcept;
+			uint32_t frameCount()const noexcept;
+			VkDeviceSize frameSize()const noexcept;
+			VkDeviceSize usedSize()const noexcept;
+			VkDeviceSize alignment()const noexcept;
+
+		private:
+			VkDevice mParentDevice;
+			HVKBuffer mBuffer;
+			HVKDeviceMemory mMemory;
+			uint8_t* mpMapped;
+			VkDeviceSize mFrameSize;
+			VkDeviceSize mAlignment;
+			uint32_t mFrameIndex;
+			VkDeviceSize mHead;
+			bool mHasBegunFrame;	///< 作成後にbeginFrameを呼んだか
+			std::vector<VkFence> mFences;
+		};
+	}
+}
@@ -0,0 +1,262 @@
+﻿#include "HVKGeometryPool.h"
+
+#include "../common/Common.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		HVKGeometryPool::Handle::Handle()noexcept
+			: page(0)
+			, vertexOffset(0)
+			, vertexCount(0)
+			, firstIndex(0)
+			, indexCount(0)
+		{ }
+
+		VkDrawIndexedIndirectCommand HVKGeometryPool::Handle::drawCommand(uint32_t instanceCount, uint32_t firstInstance)const noexcept
+		{
+			VkDrawIndexedIndirectCommand command;
+			command.indexCount = this->indexCount;
+			command.instanceCount = instanceCount;
+			command.firstIndex = this->firstIndex;
+			command.vertexOffset = this->vertexOffset;
+			command.firstInstance = firstInstance;
+			return command;
+		}
+
+		HVKGeometryPool::HVKGeometryPool()
+			: mpHeap(nullptr)
+			, mVertexStride(0)
+			, mIndexType(VK_INDEX_TYPE_UINT32)
+			, mPageVertexCount(0)
+			, mPageIndexCount(0)
+			, mExtraUsage(0)
+			, mAllocationCount(0)
+		{ }
+
+		HVKGeometryPool::HVKGeometryPool(HVKGeometryPool&& right)noexcept
+			: HVKGeometryPool()
+		{
+			*this = std::move(right);
+		}
+
+		HVKGeometryPool& HVKGeometryPool::operator=(HVKGeometryPool&& right)noexcept
+		{
+			this->release();
+
+			this->mpHeap = right.mpHeap;
+			this->mPages = std::move(right.mPages);
+			this->mVertexStride = right.mVertexStride;
+			this->mIndexType = right.mIndexType;
+			this->mPageVertexCount = right.mPageVertexCount;
+			this->mPageIndexCount = right.mPageIndexCount;
+			this->mExtraUsage = right.mExtraUsage;
+			this->mAllocationCount = right.mAllocationCount;
+
+			right.mPages.clear();
+			right.release();
+			return *this;
+		}
+
+		HVKGeometryPool::~HVKGeometryPool()
+		{
+			this->release();
+		}
+
+		void HVKGeometryPool::release()noexcept
+		{
+			this->mPages.clear();
+			this->mpHeap = nullptr;
+			this->mVertexStride = 0;
+			this->mIndexType = VK_INDEX_TYPE_UINT32;
+			this->mPageVertexCount = 0;
+			this->mPageIndexCount = 0;
+			this->mExtraUsage = 0;
+			this->mAllocationCount = 0;
+		}
+
+		void HVKGeometryPool::create(HVKDeviceMemoryHeap& heap, uint32_t vertexStride, VkIndexType indexType, uint32_t pageVertexCount, uint32_t pageIndexCount, VkBufferUsageFlags extraUsage)
+		{
+			assert(heap.isGood());
+			assert(0 < vertexStride);
+			assert(VK_INDEX_TYPE_UINT16 == indexType || VK_INDEX_TYPE_UINT32 == indexType);
+			assert(0 < pageVertexCount && 0 < pageIndexCount);
+
+			this->release();
+			this->mpHeap = &heap;
+			this->mVertexStride = vertexStride;
+			this->mIndexType = indexType;
+			this->mPageVertexCount = pageVertexCount;
+			this->mPageIndexCount = pageIndexCount;
+			this->mExtraUsage = extraUsage;
+		}
+
+		HVKGeometryPool::Handle HVKGeometryPool::allocate(uint32_t vertexCount, uint32_t indexCount)
+		{
+			assert(this->isGood());
+			assert(0 < vertexCount);
+
+			if (this->mPageVertexCount < vertexCount || this->mPageIndexCount < indexCount) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKGeometryPool, allocate, VK_ERROR_OUT_OF_DEVICE_MEMORY)
+					<< "1ページに収まらない大きさです vertexCount=" << vertexCount << " indexCount=" << indexCount;
+			}
+
+			auto tryAllocate = [&](uint32_t pageIndex, Page& page, Handle* pOut) {
+				auto vertexRange = page.vertexAllocator.allocate(vertexCount, 1);
+				if (!vertexRange.isGood()) {
+					return false;
+				}
+				utility::TLSFAllocator::Allocation indexRange;
+				if (0 < indexCount) {
+					indexRange = page.indexAllocator.allocate(indexCount, 1);
+					if (!indexRange.isGood()) {
+						page.vertexAllocator.free(vertexRange);
+						return false;
+					}
+				}
+				pOut->page = pageIndex;
+				pOut->vertexOffset = static_cast<int32_t>(vertexRange.offset);
+				pOut->vertexCount = vertexCount;
+				pOut->firstIndex = static_cast<uint32_t>(indexRange.offset);
+				pOut->indexCount = indexCount;
+				pOut->vertexRange = vertexRange;
+				pOut->indexRange = indexRange;
+				return true;
+			};
+
+			Handle result;
+			for (auto i = 0u; i < this->mPages.size(); ++i) {
+				if (tryAllocate(i, *this->mPages[i], &result)) {
+					++this->mAllocationCount;
+					return result;
+				}
+			}
+
+			auto& page = this->newPage();
+			auto isSuccess = tryAllocate(static_cast<uint32_t>(this->mPages.size() - 1), page, &result);
+			assert(isSuccess);
+			(void)isSuccess;
+			++this->mAllocationCount;
+			return result;
+		}
+
+		HVKGeometryPool::Handle HVKGeometryPool::upload(HVKStagingUploader& uploader, const void* pVertices, uint32_t vertexCount, const void* pIndices, uint32_t indexCount, HVKStagingUploader::Token* pOutToken)
+		{
+			auto handle = this->allocate(vertexCount, indexCount);
+			try {
+				auto& page = *this->mPages[handle.page];
+				auto token = uploader.uploadBuffer(page.vertexBuffer.buffer(), this->vertexByteOffset(handle), pVertices, static_cast<VkDeviceSize>(vertexCount) * this->mVertexStride);
+				if (0 < indexCount) {
+					token = uploader.uploadBuffer(page.indexBuffer.buffer(), this->indexByteOffset(handle), pIndices, static_cast<VkDeviceSize>(indexCount) * this->indexSize());
+				}
+				if (pOutToken) {
+					*pOutToken = token;
+				}
+			} catch (...) {
+				this->free(handle);
+				throw;
+			}
+			return handle;
+		}
+
+		void HVKGeometryPool::free(Handle& handle)noexcept
+		{
+			if (!handle.isGood()) {
+				return;
+			}
+			assert(handle.page < this->mPages.size());
+
+			auto& page = *this->mPages[handle.page];
+			page.vertexAllocator.free(handle.vertexRange);
+			if (handle.indexRange.isGood()) {
+				page.indexAllocator.free(handle.indexRange);
+			}
+			--this->mAllocationCount;
+			handle = Handle();
+		}
+
+		void HVKGeometryPool::bind(VkCommandBuffer cmd, uint32_t page, uint32_t binding)noexcept
+		{
+			assert(page < this->mPages.size());
+
+			auto& target = *this->mPages[page];
+			VkBuffer vertexBuffer = target.vertexBuffer.buffer();
+			VkDeviceSize offset = 0;
+			vkCmdBindVertexBuffers(cmd, binding, 1, &vertexBuffer, &offset);
+			vkCmdBindIndexBuffer(cmd, target.indexBuffer.buffer(), 0, this->mIndexType);
+		}
+
+		HVKGeometryPool::Page& HVKGeometryPool::newPage()
+		{
+			std::unique_ptr<Page> pPage(new Page());
+			auto* pCallbacks = const_cast<VkAllocationCallbacks*>(this->allocationCallbacksPointer());
+			pPage->vertexBuffer.setCallbacks(pCallbacks);
+			pPage->indexBuffer.setCallbacks(pCallbacks);
+			pPage->vertexBuffer.createBytes(*this->mpHeap, static_cast<VkDeviceSize>(this->mPageVertexCount) * this->mVertexStride,
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | this->mExtraUsage,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			pPage->indexBuffer.createBytes(*this->mpHeap, static_cast<VkDeviceSize>(this->mPageIndexCount) * this->indexSize(),
+				VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | this->mExtraUsage,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			//要素単位で切り出すのでアライメントは常に1で済む
+			pPage->vertexAllocator.create(this->mPageVertexCount);
+			pPage->indexAllocator.create(this->mPageIndexCount);
+
+			this->mPages.push_back(std::move(pPage));
+			return *this->mPages.back();
+		}
+
+		bool HVKGeometryPool::isGood()const noexcept
+		{
+			return nullptr != this->mpHeap;
+		}
+
+		uint32_t HVKGeometryPool::pageCount()const noexcept
+		{
+			return static_cast<uint32_t>(this->mPages.size());
+		}
+
+		VkBuffer HVKGeometryPool::vertexBuffer(uint32_t page)noexcept
+		{
+			assert(page < this->mPages.size());
+			return this->mPages[page]->vertexBuffer.buffer();
+		}
+
+		VkBuffer HVKGeometryPool::indexBuffer(uint32_t page)noexcept
+		{
+			assert(page < this->mPages.size());
+			return this->mPages[page]->indexBuffer.buffer();
+		}
+
+		VkDeviceSize HVKGeometryPool::vertexByteOffset(const Handle& handle)const noexcept
+		{
+			return static_cast<VkDeviceSize>(handle.vertexOffset) * this->mVertexStride;
+		}
+
+		VkDeviceSize HVKGeometryPool::indexByteOffset(const Handle& handle)const noexcept
+		{
+			return static_cast<VkDeviceSize>(handle.firstIndex) * this->indexSize();
+		}
+
+		uint32_t HVKGeometryPool::vertexStride()const noexcept
+		{
+			return this->mVertexStride;
+		}
+
+		uint32_t HVKGeometryPool::indexSize()const noexcept
+		{
+			return VK_INDEX_TYPE_UINT16 == this->mIndexType ? 2u : 4u;
+		}
+
+		VkIndexType HVKGeometryPool::indexType()const noexcept
+		{
+			return this->mIndexType;
+		}
+
+		size_t HVKGeometryPool::allocationCount()const noexcept
+		{
+			return this->mAllocationCount;
+		}
+	}
+}
@@ -0,0 +1,139 @@
+﻿#pragma once
+
+#include <vector>
+#include <memory>
+#include <vulkan\vulkan.h>
+
+#include "../HVKInterface.h"
+#include "../allocationCallbacks/HVKAllocationCallbacks.h"
+#include "../deviceMemoryHeap/HVKDeviceMemoryHeap.h"
+#include "../stagingUploader/HVKStagingUploader.h"
+#include "../typedBuffer/HVKTypedBuffer.h"
+#include "../utility/TLSFAllocator/TLSFAllocator.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		/// @brief 多数の小さなメッシュの頂点とインデックスを大きなバッファにまとめて持つクラス
+		///
+		/// 頂点バッファとインデックスバッファの組をページと呼び、メッシュはページの中から要素単位で切り出します。
+		/// 切り出しにはTLSFを使っているので、解放された範囲は隣の空き範囲と結合されます。
+		/// 同じページのメッシュは1回のbindで描画でき、drawCommand()の結果を並べればvkCmdDrawIndexedIndirectにそのまま渡せます。
+		/// ページに空きがなくなったときは新しいページを作ります
+		class HVKGeometryPool : public IHVKInterface, public HVKAllocationCallbacks
+		{
+			HVKGeometryPool(const HVKGeometryPool&) = delete;
+			HVKGeometryPool& operator=(const HVKGeometryPool&) = delete;
+
+		public:
+			/// @brief 切り出されたメッシュ
+			struct Handle
+			{
+				uint32_t page;			///< 属しているページ. bind()に渡します
+				int32_t vertexOffset;	///< VkDrawIndexedIndirectCommand::vertexOffset
+				uint32_t vertexCount;
+				uint32_t firstIndex;	///< VkDrawIndexedIndirectCommand::firstIndex
+				uint32_t indexCount;
+
+				utility::TLSFAllocator::Allocation vertexRange;
+				utility::TLSFAllocator::Allocation indexRange;
+
+				Handle()noexcept;
+				bool isGood()const noexcept { return this->vertexRange.isGood(); }
+
+				/// @brief 描画コマンドを作る
+				/// @param[in] instanceCount
+				/// @param[in] firstInstance
+				/// @retval VkDrawIndexedIndirectCommand
+				VkDrawIndexedIndirectCommand drawCommand(uint32_t instanceCount = 1, uint32_t firstInstance = 0)const noexcept;
+			};
+
+			/// @brief 1組の頂点バッファとインデックスバッファ
+			struct Page
+			{
+				HVKTypedBufferBase vertexBuffer;
+				HVKTypedBufferBase indexBuffer;
+				utility::TLSFAllocator vertexAllocator;	///< 頂点数単位
+				utility::TLSFAllocator indexAllocator;	///< インデックス数単位
+			};
+
+		public:
+			HVKGeometryPool();
+			HVKGeometryPool(HVKGeometryPool&& right)noexcept;
+			HVKGeometryPool& operator=(HVKGeometryPool&& right)noexcept;
+			~HVKGeometryPool();
+
+			void release()noexcept override;
+
+			/// @brief 作成
+			///
+			/// この時点ではページを作りません
+			/// @param[in] heap 解放するまで生存していること
+			/// @param[in] vertexStride 1頂点の大きさ
+			/// @param[in] indexType VK_INDEX_TYPE_UINT16かVK_INDEX_TYPE_UINT32
+			/// @param[in] pageVertexCount 1ページの頂点数
+			/// @param[in] pageIndexCount 1ページのインデックス数
+			/// @param[in] extraUsage 頂点バッファとインデックスバッファに追加するフラグ. ストレージバッファとして読むときなど
+			void create(HVKDeviceMemoryHeap& heap, uint32_t vertexStride, VkIndexType indexType, uint32_t pageVertexCount, uint32_t pageIndexCount, VkBufferUsageFlags extraUsage = 0);
+
+			/// @brief メッシュ用の範囲を切り出す
+			///
+			/// 既存のページに入らないときは新しいページを作ります。
+			/// 1ページに収まらない大きさのときは例外を投げます
+			/// @param[in] vertexCount
+			/// @param[in] indexCount
+			/// @retval Handle
+			/// @exception HVKException
+			Handle allocate(uint32_t vertexCount, uint32_t indexCount);
+
+			/// @brief 切り出して内容を転送する
+			/// @param[in] uploader
+			/// @param[in] pVertices vertexCount * vertexStrideの大きさ
+			/// @param[in] vertexCount
+			/// @param[in] pIndices indexCount * インデックスの大きさ
+			/// @param[in] indexCount
+			/// @param[out] pOutToken 転送の完了を調べるためのToken. nullptrなら返しません
+			/// @retval Handle
+			/// @exception HVKException
+			Handle upload(HVKStagingUploader& uploader, const void* pVertices, uint32_t vertexCount, const void* pIndices, uint32_t indexCount, HVKStagingUploader::Token* pOutToken = nullptr);
+
+			/// @brief 解放
+			///
+			/// GPUが使い終わってから呼び出してください
+			/// @param[inout] handle 解放後は無効な状態になります
+			void free(Handle& handle)noexcept;
+
+			/// @brief ページの頂点バッファとインデックスバッファを結びつける
+			/// @param[in] cmd
+			/// @param[in] page
+			/// @param[in] binding 頂点バッファのバインディング番号
+			void bind(VkCommandBuffer cmd, uint32_t page, uint32_t binding = 0)noexcept;
+
+		public:
+			bool isGood()const noexcept override;
+			uint32_t pageCount()const noexcept;
+			VkBuffer vertexBuffer(uint32_t page)noexcept;
+			VkBuffer indexBuffer(uint32_t page)noexcept;
+			VkDeviceSize vertexByteOffset(const Handle& handle)const noexcept;
+			VkDeviceSize indexByteOffset(const Handle& handle)const noexcept;
+			uint32_t vertexStride()const noexcept;
+			uint32_t indexSize()const noexcept;
+			VkIndexType indexType()const noexcept;
+			size_t allocationCount()const noexcept;
+
+		private:
+			Page& newPage();
+
+		private:
+			HVKDeviceMemoryHeap* mpHeap;
+			std::vector<std::unique_ptr<Page>> mPages;
+			uint32_t mVertexStride;
+			VkIndexType mIndexType;
+			uint32_t mPageVertexCount;
+			uint32_t mPageIndexCount;
+			VkBufferUsageFlags mExtraUsage;
+			size_t mAllocationCount;
+		};
+	}
+}
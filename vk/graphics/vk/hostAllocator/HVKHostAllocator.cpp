@@ -0,0 +1,169 @@
+﻿#include "HVKHostAllocator.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+namespace hinode
+{
+	namespace graphics
+	{
+		HVKHostAllocator& HVKHostAllocator::sGetBuiltin()noexcept
+		{
+			static HVKHostAllocator instance;
+			return instance;
+		}
+
+		HVKHostAllocator::ThreadArena::ThreadArena()
+			: allocationCount(0)
+		{ }
+
+		HVKHostAllocator::HVKHostAllocator()
+			: mID(utility::HostThreadCacheTable::sIssueID())
+			, mSystemAllocationCount(0)
+		{ }
+
+		HVKHostAllocator::~HVKHostAllocator()
+		{
+			this->release();
+		}
+
+		void HVKHostAllocator::release()noexcept
+		{
+			{
+				std::lock_guard<std::mutex> lock(this->mPoolMutex);
+				assert(0 == this->mPool.allocationCount());
+				this->mPool.release();
+			}
+			{
+				//スレッドの対応表が指しているので、アリーナ自体は破棄せずチャンクだけ解放する
+				std::lock_guard<std::mutex> lock(this->mArenasMutex);
+				for (auto& pArena : this->mArenas) {
+					assert(0 == pArena->allocationCount.load());
+					pArena->arena.release();
+				}
+			}
+		}
+
+		VkAllocationCallbacks HVKHostAllocator::callbacks()noexcept
+		{
+			return Header::sMakeCallbacks(this);
+		}
+
+		void* HVKHostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)noexcept
+		{
+			assert(0 == (alignment & (alignment - 1)));
+			if (0 == size || UINT32_MAX < size) {
+				return nullptr;
+			}
+
+			alignment = std::max(alignment, Header::sMinAlignment);
+			auto requiredSize = Header::sCalRequiredSize(size, alignment);
+
+			switch (scope) {
+			case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND:
+			{
+				auto* pArena = this->getThreadArena();
+				if (nullptr == pArena) {
+					break;
+				}
+				//減らすのは他のスレッドでも、巻き戻すのは所有するスレッドだけなので競合しない
+				if (0 == pArena->allocationCount.load(std::memory_order_acquire)) {
+					pArena->arena.reset();
+				}
+				auto* pBase = pArena->arena.allocate(requiredSize, Header::sMinAlignment);
+				if (nullptr == pBase) {
+					return nullptr;
+				}
+				pArena->allocationCount.fetch_add(1, std::memory_order_relaxed);
+				return Header::sPlace(pBase, pArena, size, alignment, Header::eORIGIN_ARENA, 0);
+			}
+			case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT:
+			{
+				auto classIndex = utility::SizeClassPool::sCalClassIndex(requiredSize);
+				if (classIndex < utility::SizeClassPool::sClassCount) {
+					std::lock_guard<std::mutex> lock(this->mPoolMutex);
+					auto* pBase = this->mPool.allocate(classIndex);
+					if (nullptr == pBase) {
+						return nullptr;
+					}
+					return Header::sPlace(pBase, nullptr, size, alignment, Header::eORIGIN_POOL, static_cast<uint16_t>(classIndex));
+				}
+				break;
+			}
+			default:
+				break;
+			}
+
+			//mallocが16に揃えるとは限らないので、その分も余分に確保する
+			auto* pBase = std::malloc(requiredSize + Header::sMinAlignment - 1);
+			if (nullptr == pBase) {
+				return nullptr;
+			}
+			++this->mSystemAllocationCount;
+			return Header::sPlace(pBase, nullptr, size, alignment, Header::eORIGIN_SYSTEM, 0);
+		}
+
+		void* HVKHostAllocator::reallocate(void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope scope)noexcept
+		{
+			return Header::sReallocate(*this, pOriginal, size, alignment, scope);
+		}
+
+		void HVKHostAllocator::free(void* pMemory)noexcept
+		{
+			if (nullptr == pMemory) {
+				return;
+			}
+
+			auto header = *Header::sGet(pMemory);
+			switch (header.origin) {
+			case Header::eORIGIN_ARENA:
+			{
+				//コマンドの間だけ使われるものなので、すべて返ってきたら所有するスレッドが次の割り当てで先頭に戻す
+				auto* pArena = static_cast<ThreadArena*>(header.pOwner);
+				auto previous = pArena->allocationCount.fetch_sub(1, std::memory_order_release);
+				assert(0 < previous);
+				(void)previous;
+				break;
+			}
+			case Header::eORIGIN_POOL:
+			{
+				std::lock_guard<std::mutex> lock(this->mPoolMutex);
+				this->mPool.free(header.pBase, header.classIndex);
+				break;
+			}
+			default:
+				std::free(header.pBase);
+				--this->mSystemAllocationCount;
+				break;
+			}
+		}
+
+		size_t HVKHostAllocator::poolAllocationCount()noexcept
+		{
+			std::lock_guard<std::mutex> lock(this->mPoolMutex);
+			return this->mPool.allocationCount();
+		}
+
+		size_t HVKHostAllocator::arenaAllocationCount()noexcept
+		{
+			std::lock_guard<std::mutex> lock(this->mArenasMutex);
+			size_t result = 0;
+			for (auto& pArena : this->mArenas) {
+				result += pArena->allocationCount.load(std::memory_order_relaxed);
+			}
+			return result;
+		}
+
+		size_t HVKHostAllocator::systemAllocationCount()const noexcept
+		{
+			return this->mSystemAllocationCount;
+		}
+
+		HVKHostAllocator::ThreadArena* HVKHostAllocator::getThreadArena()noexcept
+		{
+			return utility::HostThreadCacheTable::sGetOrCreate(this->mID, this->mArenasMutex, this->mArenas);
+		}
+	}
+}
@@ -0,0 +1,104 @@
+﻿#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <vulkan\vulkan.h>
+
+#include "../utility/SizeClassPool/SizeClassPool.h"
+#include "../utility/BumpArena/BumpArena.h"
+#include "../utility/HostAllocatorCommon/HostAllocatorCommon.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		/// @brief VkAllocationCallbacksの組み込み実装
+		///
+		/// 割り当てスコープによって割り当て先を切り替えます。
+		/// - VK_SYSTEM_ALLOCATION_SCOPE_COMMAND : スレッドごとのアリーナ. そのスレッドの割り当てがすべて解放されたら先頭に戻します
+		/// - VK_SYSTEM_ALLOCATION_SCOPE_OBJECT : 大きさごとのプール. プールに入らない大きさはmallocを使います
+		/// - それ以外 : malloc
+		///
+		/// コマンドの間だけ使われる割り当てはそのコマンドを呼んだスレッドで確保と解放が完結するので、
+		/// アリーナをスレッドごとに分けることでロックを取らず、他のスレッドの割り当てが残っていても先頭に戻せます。
+		/// 割り当ての直前にutility::HostAllocationHeaderを置いているので、解放時にスコープが分からなくても割り当て先を判別できます。
+		/// HVKAllocationCallbacks::sSetDefaultCallbacksに渡すと、コールバックを指定していないすべてのオブジェクトで使われます。
+		/// その場合、これで作成したVulkanのオブジェクトをすべて破棄するまで破棄しないでください
+		class HVKHostAllocator
+		{
+			HVKHostAllocator(const HVKHostAllocator&) = delete;
+			HVKHostAllocator& operator=(const HVKHostAllocator&) = delete;
+
+		public:
+			/// @brief アプリケーション全体で共有する組み込みのアロケータ
+			/// @retval HVKHostAllocator&
+			static HVKHostAllocator& sGetBuiltin()noexcept;
+
+		public:
+			HVKHostAllocator();
+			~HVKHostAllocator();
+
+			/// @brief プールとアリーナのメモリを解放する
+			///
+			/// 割り当て中のものがあるときや、他のスレッドが割り当てているときに呼んではいけません
+			void release()noexcept;
+
+			/// @brief このアロケータを呼び出すVkAllocationCallbacksを返す
+			/// @retval VkAllocationCallbacks
+			VkAllocationCallbacks callbacks()noexcept;
+
+			/// @brief 割り当て
+			/// @param[in] size
+			/// @param[in] alignment 2の累乗であること
+			/// @param[in] scope
+			/// @retval void* 失敗したときはnullptr
+			void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)noexcept;
+
+			/// @brief 再割り当て
+			///
+			/// 確保済みの領域に収まりアライメントも満たしていれば、同じポインタを返します
+			/// @param[in] pOriginal nullptrならallocateと同じです
+			/// @param[in] size 0ならfreeと同じです
+			/// @param[in] alignment
+			/// @param[in] scope
+			/// @retval void* 失敗したときはnullptrを返し、pOriginalはそのまま残ります
+			void* reallocate(void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope scope)noexcept;
+
+			/// @brief 解放
+			/// @param[in] pMemory
+			void free(void* pMemory)noexcept;
+
+		public:
+			size_t poolAllocationCount()noexcept;
+			size_t arenaAllocationCount()noexcept;
+			size_t systemAllocationCount()const noexcept;
+
+		private:
+			using Header = utility::HostAllocationHeader;
+
+			/// @brief スレッドごとのアリーナ
+			struct ThreadArena
+			{
+				utility::BumpArena arena;
+				std::atomic<size_t> allocationCount;
+
+				ThreadArena();
+			};
+
+			/// @brief 呼び出したスレッドのアリーナを返す. なければ作ります
+			ThreadArena* getThreadArena()noexcept;
+
+		private:
+			std::mutex mPoolMutex;
+			utility::SizeClassPool mPool;
+
+			uint64_t mID;	///< thread_localの対応表で使う. 再利用されません
+			std::mutex mArenasMutex;
+			std::vector<std::unique_ptr<ThreadArena>> mArenas;
+
+			std::atomic<size_t> mSystemAllocationCount;
+		};
+	}
+}
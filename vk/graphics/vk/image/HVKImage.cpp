@@ -3,24 +3,127 @@
 #include <utility> //for std::move()
 
 #include "../common/Common.h"
+#include "../utility/ViewCreateInfoHash/ViewCreateInfoHash.h"
 
 namespace hinode
 {
 	namespace graphics
 	{
-		std::vector<HVKImage> HVKImage::sConvert(VkDevice device, VkImage* images, uint32_t count)
+		namespace
+		{
+			//݂̃ANZX. ͎̌̃ANZX̑OɃoAKvɂȂ
+			const VkAccessFlags sWriteAccessMask = VK_ACCESS_SHADER_WRITE_BIT
+				| VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+				| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+				| VK_ACCESS_TRANSFER_WRITE_BIT
+				| VK_ACCESS_HOST_WRITE_BIT
+				| VK_ACCESS_MEMORY_WRITE_BIT;
+
+			bool isSameState(const HVKImage::SubresourceState& left, const HVKImage::SubresourceState& right)noexcept
+			{
+				return left.layout == right.layout
+					&& left.accessMask == right.accessMask
+					&& left.stageMask == right.stageMask;
+			}
+
+			uint32_t resolveCount(uint32_t base, uint32_t count, uint32_t total)noexcept
+			{
+				assert(base < total);
+				return VK_REMAINING_MIP_LEVELS == count ? total - base : count;
+			}
+		}
+
+		std::vector<HVKImage> HVKImage::sConvert(VkDevice device, VkImage* images, uint32_t count, VkFormat format)
 		{
 			std::vector<HVKImage> ret(count);
 			for (auto i = 0u; i < count; ++i) {
-				ret[i].setSwapChainImage(device, images[i]);
+				ret[i].setSwapChainImage(device, images[i], format);
 			}
 			return ret;
 		}
 
+		VkImageAspectFlags HVKImage::sFormatAspect(VkFormat format)noexcept
+		{
+			switch (format) {
+			case VK_FORMAT_D16_UNORM:
+			case VK_FORMAT_X8_D24_UNORM_PACK32:
+			case VK_FORMAT_D32_SFLOAT:
+				return VK_IMAGE_ASPECT_DEPTH_BIT;
+			case VK_FORMAT_S8_UINT:
+				return VK_IMAGE_ASPECT_STENCIL_BIT;
+			case VK_FORMAT_D16_UNORM_S8_UINT:
+			case VK_FORMAT_D24_UNORM_S8_UINT:
+			case VK_FORMAT_D32_SFLOAT_S8_UINT:
+				return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+			default:
+				return VK_IMAGE_ASPECT_COLOR_BIT;
+			}
+		}
+
+		uint32_t HVKImage::sFormatTexelBlockSize(VkFormat format)noexcept
+		{
+			switch (format) {
+			case VK_FORMAT_R4G4_UNORM_PACK8:
+			case VK_FORMAT_S8_UINT:
+				return 1;
+			case VK_FORMAT_D16_UNORM:
+				return 2;
+			case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+			case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+			case VK_FORMAT_X8_D24_UNORM_PACK32:
+			case VK_FORMAT_D32_SFLOAT:
+			case VK_FORMAT_D16_UNORM_S8_UINT:
+			case VK_FORMAT_D24_UNORM_S8_UINT:
+			case VK_FORMAT_D32_SFLOAT_S8_UINT:
+				return 4;
+			default:
+				break;
+			}
+
+			//傫̃tH[}bg͗񋓎qĂ̂Ŕ͈͂Œׂ
+			struct Range { VkFormat first; VkFormat last; uint32_t size; };
+			static const Range sRanges[] = {
+				{ VK_FORMAT_R4G4B4A4_UNORM_PACK16, VK_FORMAT_A1R5G5B5_UNORM_PACK16, 2 },
+				{ VK_FORMAT_R8_UNORM, VK_FORMAT_R8_SRGB, 1 },
+				{ VK_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8_SRGB, 2 },
+				{ VK_FORMAT_R8G8B8_UNORM, VK_FORMAT_B8G8R8_SRGB, 3 },
+				{ VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_A2B10G10R10_SINT_PACK32, 4 },
+				{ VK_FORMAT_R16_UNORM, VK_FORMAT_R16_SFLOAT, 2 },
+				{ VK_FORMAT_R16G16_UNORM, VK_FORMAT_R16G16_SFLOAT, 4 },
+				{ VK_FORMAT_R16G16B16_UNORM, VK_FORMAT_R16G16B16_SFLOAT, 6 },
+				{ VK_FORMAT_R16G16B16A16_UNORM, VK_FORMAT_R16G16B16A16_SFLOAT, 8 },
+				{ VK_FORMAT_R32_UINT, VK_FORMAT_R32_SFLOAT, 4 },
+				{ VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32_SFLOAT, 8 },
+				{ VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32_SFLOAT, 12 },
+				{ VK_FORMAT_R32G32B32A32_UINT, VK_FORMAT_R32G32B32A32_SFLOAT, 16 },
+				{ VK_FORMAT_R64_UINT, VK_FORMAT_R64_SFLOAT, 8 },
+				{ VK_FORMAT_R64G64_UINT, VK_FORMAT_R64G64_SFLOAT, 16 },
+				{ VK_FORMAT_R64G64B64_UINT, VK_FORMAT_R64G64B64_SFLOAT, 24 },
+				{ VK_FORMAT_R64G64B64A64_UINT, VK_FORMAT_R64G64B64A64_SFLOAT, 32 },
+				{ VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGBA_SRGB_BLOCK, 8 },
+				{ VK_FORMAT_BC2_UNORM_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK, 16 },
+				{ VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_BC4_SNORM_BLOCK, 8 },
+				{ VK_FORMAT_BC5_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK, 16 },
+				{ VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK, 8 },
+				{ VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK, 16 },
+				{ VK_FORMAT_EAC_R11_UNORM_BLOCK, VK_FORMAT_EAC_R11_SNORM_BLOCK, 8 },
+				{ VK_FORMAT_EAC_R11G11_UNORM_BLOCK, VK_FORMAT_ASTC_12x12_SRGB_BLOCK, 16 },
+			};
+			for (auto& range : sRanges) {
+				if (range.first <= format && format <= range.last) {
+					return range.size;
+				}
+			}
+			return 0;
+		}
+
 		HVKImage::HVKImage()
 			: mIsSwapChainImage(false)
 			, mImage(nullptr)
 			, mParentDevice(nullptr)
+			, mMipLevels(0)
+			, mArrayLayers(0)
+			, mAspect(0)
 		{ }
 
 		HVKImage::HVKImage(HVKImage&& right)noexcept
@@ -28,11 +131,23 @@ namespace hinode
 			, mImage(right.mImage)
 			, mParentDevice(right.mParentDevice)
 			, mViews(std::move(right.mViews))
+			, mViewInfos(std::move(right.mViewInfos))
+			, mViewIndices(std::move(right.mViewIndices))
+			, mMipLevels(right.mMipLevels)
+			, mArrayLayers(right.mArrayLayers)
+			, mAspect(right.mAspect)
+			, mStates(std::move(right.mStates))
 		{
 			right.mImage = nullptr;
 			right.mParentDevice = nullptr;
 			right.mViews.clear();
 			right.mViews.shrink_to_fit();
+			right.mViewInfos.clear();
+			right.mViewIndices.clear();
+			right.mMipLevels = 0;
+			right.mArrayLayers = 0;
+			right.mAspect = 0;
+			right.mStates.clear();
 		}
 
 		HVKImage& HVKImage::operator=(HVKImage&& right)noexcept
@@ -42,11 +157,23 @@ namespace hinode
 			this->mImage = right.mImage;
 			this->mParentDevice = right.mParentDevice;
 			this->mViews = right.mViews;
+			this->mViewInfos = std::move(right.mViewInfos);
+			this->mViewIndices = std::move(right.mViewIndices);
+			this->mMipLevels = right.mMipLevels;
+			this->mArrayLayers = right.mArrayLayers;
+			this->mAspect = right.mAspect;
+			this->mStates = std::move(right.mStates);
 
 			right.mImage = nullptr;
 			right.mParentDevice = nullptr;
 			right.mViews.clear();
 			right.mViews.shrink_to_fit();
+			right.mViewInfos.clear();
+			right.mViewIndices.clear();
+			right.mMipLevels = 0;
+			right.mArrayLayers = 0;
+			right.mAspect = 0;
+			right.mStates.clear();
 			return *this;
 		}
 
@@ -58,11 +185,14 @@ namespace hinode
 		void HVKImage::release()noexcept
 		{
 			if (this->mImage != nullptr) {
-				for (auto& view : this->mViews) {
-					vkDestroyImageView(this->mParentDevice, view, this->allocationCallbacksPointer());
-				}
-				this->mViews.clear();
+				this->releaseViews();
 				this->mViews.shrink_to_fit();
+				this->mViewInfos.shrink_to_fit();
+				this->mStates.clear();
+				this->mStates.shrink_to_fit();
+				this->mMipLevels = 0;
+				this->mArrayLayers = 0;
+				this->mAspect = 0;
 
 				if (!this->mIsSwapChainImage) {
 					vkDestroyImage(this->mParentDevice, this->mImage, this->allocationCallbacksPointer());
@@ -83,15 +213,136 @@ namespace hinode
 			}
 
 			this->mParentDevice = device;
+			this->resetStates(pCreateInfo->mipLevels, pCreateInfo->arrayLayers, pCreateInfo->format, pCreateInfo->initialLayout);
 		}
 
-		void HVKImage::setSwapChainImage(VkDevice device, VkImage image)
+		void HVKImage::setSwapChainImage(VkDevice device, VkImage image, VkFormat format, uint32_t arrayLayers)
 		{
-			this->release();
+			//Xbv`FC̍蒼̂тɊmۂȂ悤Az͋ɂ邾ɂ
+			if (this->mIsSwapChainImage) {
+				this->releaseViews();
+			} else {
+				this->release();
+			}
 
 			this->mIsSwapChainImage = true;
 			this->mParentDevice = device;
 			this->mImage = image;
+			this->resetStates(1, arrayLayers, format, VK_IMAGE_LAYOUT_UNDEFINED);
+		}
+
+		void HVKImage::transition(VkCommandBuffer cmd, VkImageLayout newLayout, VkAccessFlags accessMask, VkPipelineStageFlags stageMask)
+		{
+			HVKImageBarrierBatch batch;
+			this->transition(batch, this->wholeRange(), newLayout, accessMask, stageMask);
+			batch.flush(cmd);
+		}
+
+		void HVKImage::transition(HVKImageBarrierBatch& batch, VkImageLayout newLayout, VkAccessFlags accessMask, VkPipelineStageFlags stageMask)
+		{
+			this->transition(batch, this->wholeRange(), newLayout, accessMask, stageMask);
+		}
+
+		void HVKImage::transition(HVKImageBarrierBatch& batch, const VkImageSubresourceRange& range, VkImageLayout newLayout, VkAccessFlags accessMask, VkPipelineStageFlags stageMask)
+		{
+			assert(this->isGood());
+			assert(VK_IMAGE_LAYOUT_UNDEFINED != newLayout && VK_IMAGE_LAYOUT_PREINITIALIZED != newLayout);
+
+			auto levelCount = resolveCount(range.baseMipLevel, range.levelCount, this->mMipLevels);
+			auto layerCount = resolveCount(range.baseArrayLayer, range.layerCount, this->mArrayLayers);
+			auto levelEnd = range.baseMipLevel + levelCount;
+			auto willWrite = 0 != (accessMask & sWriteAccessMask);
+
+			VkImageMemoryBarrier barrier;
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.pNext = nullptr;
+			barrier.dstAccessMask = accessMask;
+			barrier.newLayout = newLayout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = this->mImage;
+			barrier.subresourceRange.aspectMask = range.aspectMask;
+			barrier.subresourceRange.layerCount = 1;
+
+			for (auto layer = range.baseArrayLayer; layer < range.baseArrayLayer + layerCount; ++layer) {
+				auto level = range.baseMipLevel;
+				while (level < levelEnd) {
+					//Ԃ~bvx1̃oAɂ܂Ƃ߂
+					auto old = this->stateRef(level, layer);
+					auto runEnd = level + 1;
+					while (runEnd < levelEnd && isSameState(this->stateRef(runEnd, layer), old)) {
+						++runEnd;
+					}
+
+					auto srcStageMask = 0 != old.stageMask ? old.stageMask : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+					auto wasWritten = 0 != (old.accessMask & sWriteAccessMask);
+					auto isVisible = 0 == (accessMask & ~old.accessMask) && 0 == (stageMask & ~old.stageMask);
+					SubresourceState next = { newLayout, accessMask, stageMask };
+					barrier.oldLayout = old.layout;
+					barrier.subresourceRange.baseMipLevel = level;
+					barrier.subresourceRange.levelCount = runEnd - level;
+					barrier.subresourceRange.baseArrayLayer = layer;
+					if (old.layout != newLayout || wasWritten) {
+						//ǂݍ݂͉ɂKvȂ̂ŁA݂҂
+						barrier.srcAccessMask = old.accessMask & sWriteAccessMask;
+						batch.add(barrier, srcStageMask, stageMask);
+					} else if (willWrite) {
+						//ǂݍ݂݂̌̏́Aǂݍ݂Î҂Ă΂悢
+						batch.addExecutionDependency(srcStageMask, stageMask);
+					} else {
+						//ǂݍ݂Ƃ͎݂̏ő҂Ώۂɉ.
+						//ÕoAŉɂĂȂXe[WǂނƂ́AÕoAɂȂĉɂ
+						if (!isVisible) {
+							barrier.srcAccessMask = 0;
+							batch.add(barrier, srcStageMask, stageMask);
+						}
+						next.accessMask |= old.accessMask;
+						next.stageMask |= old.stageMask;
+					}
+					for (; level < runEnd; ++level) {
+						this->stateRef(level, layer) = next;
+					}
+				}
+			}
+		}
+
+		void HVKImage::setState(const VkImageSubresourceRange& range, VkImageLayout layout, VkAccessFlags accessMask, VkPipelineStageFlags stageMask)noexcept
+		{
+			assert(this->isGood());
+
+			auto levelCount = resolveCount(range.baseMipLevel, range.levelCount, this->mMipLevels);
+			auto layerCount = resolveCount(range.baseArrayLayer, range.layerCount, this->mArrayLayers);
+			SubresourceState state = { layout, accessMask, stageMask };
+			for (auto layer = range.baseArrayLayer; layer < range.baseArrayLayer + layerCount; ++layer) {
+				for (auto level = range.baseMipLevel; level < range.baseMipLevel + levelCount; ++level) {
+					this->stateRef(level, layer) = state;
+				}
+			}
+		}
+
+		void HVKImage::releaseViews()noexcept
+		{
+			for (auto& view : this->mViews) {
+				vkDestroyImageView(this->mParentDevice, view, this->allocationCallbacksPointer());
+			}
+			this->mViews.clear();
+			this->mViewInfos.clear();
+			this->mViewIndices.clear();
+		}
+
+		void HVKImage::resetStates(uint32_t mipLevels, uint32_t arrayLayers, VkFormat format, VkImageLayout layout)
+		{
+			this->mMipLevels = mipLevels;
+			this->mArrayLayers = arrayLayers;
+			this->mAspect = sFormatAspect(format);
+			SubresourceState state = { layout, 0, 0 };
+			this->mStates.assign(static_cast<size_t>(mipLevels) * arrayLayers, state);
+		}
+
+		HVKImage::SubresourceState& HVKImage::stateRef(uint32_t mipLevel, uint32_t arrayLayer)noexcept
+		{
+			assert(mipLevel < this->mMipLevels && arrayLayer < this->mArrayLayers);
+			return this->mStates[static_cast<size_t>(arrayLayer) * this->mMipLevels + mipLevel];
 		}
 
 		size_t HVKImage::addView(VkImageViewCreateInfo* pInfo)
@@ -99,22 +350,44 @@ namespace hinode
 			assert(this->isGood());
 
 			pInfo->image = this->mImage;
+			auto index = this->findView(*pInfo);
+			if (sInvalidViewIndex != index) {
+				return index;
+			}
+
 			VkImageView view;
 			auto ret = vkCreateImageView(this->mParentDevice, pInfo, this->allocationCallbacksPointer(), &view);
 			if (VK_SUCCESS != ret) {
 				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKImage, addView, ret) << "r[̍쐬Ɏs܂";
 			}
 			this->mViews.push_back(view);
-			return this->mViews.size() - 1;
+			this->mViewInfos.push_back(*pInfo);
+			index = this->mViews.size() - 1;
+			//pNext͔̐rłȂ̂ŁAg\̕t̃r[͋LȂ
+			if (nullptr == pInfo->pNext) {
+				this->mViewIndices.emplace(utility::hashViewCreateInfo(*pInfo), index);
+			}
+			return index;
 		}
 
-		VkMemoryRequirements HVKImage::getMemoryRequirements()
+		size_t HVKImage::findView(const VkImageViewCreateInfo& info)const noexcept
 		{
-			assert(this->isGood());
+			if (nullptr != info.pNext) {
+				return sInvalidViewIndex;
+			}
+			auto range = this->mViewIndices.equal_range(utility::hashViewCreateInfo(info));
+			for (auto it = range.first; it != range.second; ++it) {
+				if (utility::isSameViewCreateInfo(this->mViewInfos[it->second], info)) {
+					return it->second;
+				}
+			}
+			return sInvalidViewIndex;
+		}
 
-			VkMemoryRequirements result;
-			vkGetImageMemoryRequirements(this->mParentDevice, this->mImage, &result);
-			return result;
+		HVKMemoryRequirements HVKImage::getMemoryRequirements()
+		{
+			assert(this->isGood());
+			return HVKMemoryRequirements::sGetImage(this->mParentDevice, this->mImage);
 		}
 
 		bool HVKImage::isGood()const noexcept
@@ -133,6 +406,145 @@ namespace hinode
 			assert(this->isGood());
 			return this->mViews[index];
 		}
+
+		size_t HVKImage::viewCount()const noexcept
+		{
+			return this->mViews.size();
+		}
+
+		uint32_t HVKImage::mipLevels()const noexcept
+		{
+			return this->mMipLevels;
+		}
+
+		uint32_t HVKImage::arrayLayers()const noexcept
+		{
+			return this->mArrayLayers;
+		}
+
+		VkImageAspectFlags HVKImage::aspect()const noexcept
+		{
+			return this->mAspect;
+		}
+
+		VkImageSubresourceRange HVKImage::wholeRange()const noexcept
+		{
+			VkImageSubresourceRange range;
+			range.aspectMask = this->mAspect;
+			range.baseMipLevel = 0;
+			range.levelCount = this->mMipLevels;
+			range.baseArrayLayer = 0;
+			range.layerCount = this->mArrayLayers;
+			return range;
+		}
+
+		const HVKImage::SubresourceState& HVKImage::state(uint32_t mipLevel, uint32_t arrayLayer)const noexcept
+		{
+			assert(mipLevel < this->mMipLevels && arrayLayer < this->mArrayLayers);
+			return this->mStates[static_cast<size_t>(arrayLayer) * this->mMipLevels + mipLevel];
+		}
+	}
+
+	namespace graphics
+	{
+		HVKImageBarrierBatch::HVKImageBarrierBatch()noexcept
+			: mSrcStageMask(0)
+			, mDstStageMask(0)
+		{ }
+
+		HVKImageBarrierBatch::HVKImageBarrierBatch(HVKImageBarrierBatch&& right)noexcept
+			: HVKImageBarrierBatch()
+		{
+			*this = std::move(right);
+		}
+
+		HVKImageBarrierBatch& HVKImageBarrierBatch::operator=(HVKImageBarrierBatch&& right)noexcept
+		{
+			this->mSrcStageMask = right.mSrcStageMask;
+			this->mDstStageMask = right.mDstStageMask;
+			this->mBarriers = std::move(right.mBarriers);
+
+			right.mBarriers.clear();
+			right.clear();
+			return *this;
+		}
+
+		void HVKImageBarrierBatch::add(const VkImageMemoryBarrier& barrier, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
+		{
+			this->addExecutionDependency(srcStageMask, dstStageMask);
+
+			//HVKImage::transition̓C[̏ɒǉ̂ŁAÔ̂Ƃׂ
+			if (!this->mBarriers.empty()) {
+				auto& last = this->mBarriers.back();
+				auto& lastRange = last.subresourceRange;
+				auto& range = barrier.subresourceRange;
+				auto isSameBarrier = last.image == barrier.image
+					&& last.pNext == barrier.pNext
+					&& last.oldLayout == barrier.oldLayout
+					&& last.newLayout == barrier.newLayout
+					&& last.srcAccessMask == barrier.srcAccessMask
+					&& last.dstAccessMask == barrier.dstAccessMask
+					&& last.srcQueueFamilyIndex == barrier.srcQueueFamilyIndex
+					&& last.dstQueueFamilyIndex == barrier.dstQueueFamilyIndex
+					&& lastRange.aspectMask == range.aspectMask;
+				if (isSameBarrier) {
+					if (lastRange.baseMipLevel == range.baseMipLevel && lastRange.levelCount == range.levelCount
+						&& lastRange.baseArrayLayer + lastRange.layerCount == range.baseArrayLayer) {
+						lastRange.layerCount += range.layerCount;
+						return;
+					}
+					if (lastRange.baseArrayLayer == range.baseArrayLayer && lastRange.layerCount == range.layerCount
+						&& lastRange.baseMipLevel + lastRange.levelCount == range.baseMipLevel) {
+						lastRange.levelCount += range.levelCount;
+						return;
+					}
+				}
+			}
+			this->mBarriers.push_back(barrier);
+		}
+
+		void HVKImageBarrierBatch::addExecutionDependency(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)noexcept
+		{
+			this->mSrcStageMask |= srcStageMask;
+			this->mDstStageMask |= dstStageMask;
+		}
+
+		void HVKImageBarrierBatch::flush(VkCommandBuffer cmd, VkDependencyFlags dependencyFlags)
+		{
+			if (this->empty()) {
+				return;
+			}
+			vkCmdPipelineBarrier(cmd, this->mSrcStageMask, this->mDstStageMask, dependencyFlags,
+				0, nullptr, 0, nullptr, static_cast<uint32_t>(this->mBarriers.size()), this->mBarriers.data());
+			this->clear();
+		}
+
+		void HVKImageBarrierBatch::clear()noexcept
+		{
+			this->mSrcStageMask = 0;
+			this->mDstStageMask = 0;
+			this->mBarriers.clear();
+		}
+
+		bool HVKImageBarrierBatch::empty()const noexcept
+		{
+			return 0 == this->mSrcStageMask && 0 == this->mDstStageMask && this->mBarriers.empty();
+		}
+
+		size_t HVKImageBarrierBatch::barrierCount()const noexcept
+		{
+			return this->mBarriers.size();
+		}
+
+		VkPipelineStageFlags HVKImageBarrierBatch::srcStageMask()const noexcept
+		{
+			return this->mSrcStageMask;
+		}
+
+		VkPipelineStageFlags HVKImageBarrierBatch::dstStageMask()const noexcept
+		{
+			return this->mDstStageMask;
+		}
 	}
 
 	namespace graphics
@@ -193,6 +605,18 @@ namespace hinode
 			return HVKImageCreateInfo(VK_IMAGE_TYPE_2D, format, width, height, static_cast<uint32_t>(1u));
 		}
 
+		HVKImageCreateInfo HVKImageCreateInfo::sMakeTransientAttachment(VkFormat format, uint32_t width, uint32_t height, VkImageUsageFlags attachmentUsage, VkSampleCountFlagBits samples)noexcept
+		{
+			//TRANSIENTƑgݍ킹̂̓A^b`gƂĂ̎gp@
+			assert(0 == (attachmentUsage & ~(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT)));
+
+			auto info = sMake2D(format, width, height);
+			info.samples = samples;
+			info.tiling = VK_IMAGE_TILING_OPTIMAL;
+			info.usage = attachmentUsage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+			return info;
+		}
+
 		//
 		//	struct HVKImageViewCreateInfo
 		//
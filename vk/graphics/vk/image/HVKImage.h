@@ -1,22 +1,52 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
 #include <vulkan\vulkan.h>
 
 #include "../allocationCallbacks/HVKAllocationCallbacks.h"
 #include "../HVKInterface.h"
+#include "../memoryRequirements/HVKMemoryRequirements.h"
 
 namespace hinode
 {
 	namespace graphics
 	{
+		class HVKImageBarrierBatch;
+
+		/// @brief VkImagẽbp[
+		///
+		/// ~bvxƃC[ƂɌ݂̃CAEgAŌ̃ANZXƂ̃Xe[WoĂāA
+		/// transition֐ŕKvȃoA܂
 		class HVKImage : public IHVKInterface, public HVKAllocationCallbacks
 		{
 			HVKImage(HVKImage& right)noexcept = delete;
 			HVKImage& operator=(HVKImage& right)noexcept = delete;
 
 		public:
-			static std::vector<HVKImage> sConvert(VkDevice device, VkImage* images, uint32_t count);
+			/// @brief Tu\[X̏
+			struct SubresourceState
+			{
+				VkImageLayout layout;
+				VkAccessFlags accessMask;		///< Ō̃oÃANZX. ǂݍ݂Ƃ͂܂Ƃ߂܂
+				VkPipelineStageFlags stageMask;	///< accessMask̃ANZXsXe[W
+			};
+
+		public:
+			static std::vector<HVKImage> sConvert(VkDevice device, VkImage* images, uint32_t count, VkFormat format = VK_FORMAT_UNDEFINED);
+
+			/// @brief tH[}bgAXyNg߂
+			/// @param[in] format
+			/// @retval VkImageAspectFlags
+			static VkImageAspectFlags sFormatAspect(VkFormat format)noexcept;
+
+			/// @brief tH[}bg̃eNZubN̑傫߂
+			///
+			/// ktH[}bg1ubN̑傫Ԃ܂B
+			/// [xXeV̓AXyNgƂɃRs[̂ŁAobt@Ƃ̃Rs[ł̑傫Ԃ܂
+			/// @param[in] format
+			/// @retval uint32_t oCg. ȂtH[}bĝƂ0
+			static uint32_t sFormatTexelBlockSize(VkFormat format)noexcept;
 
 		public:
 			HVKImage();
@@ -27,6 +57,8 @@ namespace hinode
 			void release()noexcept override;
 
 			/// @brief 쐬
+			///
+			/// ׂẴTu\[XpCreateInfo->initialLayout̏Ԃn܂܂
 			/// @param[in] device
 			/// @param[in] pCreateInfo
 			/// @exception HVKException
@@ -35,29 +67,162 @@ namespace hinode
 			/// @brief Xbv`FC̃C[Wݒ肷
 			///
 			/// ̊֐Őݒ肳ꂽVkImagerelease֐ł͔j܂B
+			/// ~bvx1ACAEgVK_IMAGE_LAYOUT_UNDEFINEDn܂܂B
+			/// łɃXbv`FC̃C[Wݒ肵ĂƂ́Ar[jē̔z̗͎̈g񂵂܂
 			/// @param[in] device
 			/// @param[in] image
-			void setSwapChainImage(VkDevice device, VkImage image);
+			/// @param[in] format
+			/// @param[in] arrayLayers VkSwapchainCreateInfoKHR::imageArrayLayers
+			void setSwapChainImage(VkDevice device, VkImage image, VkFormat format = VK_FORMAT_UNDEFINED, uint32_t arrayLayers = 1);
+
+			/// @brief C[WŜ̃CAEgςoAL^
+			///
+			/// ̃C[W܂Ƃ߂Đ؂ւƂHVKImageBarrierBatchgĂяoĂ
+			/// @param[in] cmd
+			/// @param[in] newLayout
+			/// @param[in] accessMask ؂ւɍsANZX
+			/// @param[in] stageMask accessMask̃ANZXsXe[W
+			void transition(VkCommandBuffer cmd, VkImageLayout newLayout, VkAccessFlags accessMask, VkPipelineStageFlags stageMask);
+
+			/// @brief C[WŜ̃oAbatchɒǉ
+			/// @param[in] batch
+			/// @param[in] newLayout
+			/// @param[in] accessMask
+			/// @param[in] stageMask
+			void transition(HVKImageBarrierBatch& batch, VkImageLayout newLayout, VkAccessFlags accessMask, VkPipelineStageFlags stageMask);
+
+			/// @brief rangẽoAbatchɒǉ
+			///
+			/// oĂԂƔׂāȀꍇoA܂B
+			/// - CAEgςƂ
+			/// - ÕANZXɏ݂܂܂Ƃ
+			/// - ÕoAŉɂĂȂXe[WANZXǂݍނƂ
+			/// ǂݍ݂̌ɓCAEĝ܂܏ނƂ́AoAȂ̎sˑǉ܂B
+			/// ɂȂĂǂݍ݂Ƃ͉ǉAANZXƃXe[WoĂԂɂ܂Ƃ߂܂B
+			/// Ԃ~bvxƃC[1̃oAɂ܂Ƃ߂܂B
+			/// 1batch̒œTu\[X2ȏ؂ւȂł
+			/// @param[in] batch
+			/// @param[in] range VK_REMAINING_MIP_LEVELSVK_REMAINING_ARRAY_LAYERSg܂
+			/// @param[in] newLayout VK_IMAGE_LAYOUT_UNDEFINEDVK_IMAGE_LAYOUT_PREINITIALIZED͎wł܂
+			/// @param[in] accessMask
+			/// @param[in] stageMask
+			void transition(HVKImageBarrierBatch& batch, const VkImageSubresourceRange& range, VkImageLayout newLayout, VkAccessFlags accessMask, VkPipelineStageFlags stageMask);
+
+			/// @brief oA炸ɏԂ
+			///
+			/// _[pXfinalLayoutȂǁAtransition֐ȊOŃCAEgςƂɎg܂
+			/// @param[in] range
+			/// @param[in] layout
+			/// @param[in] accessMask
+			/// @param[in] stageMask
+			void setState(const VkImageSubresourceRange& range, VkImageLayout layout, VkAccessFlags accessMask, VkPipelineStageFlags stageMask)noexcept;
 
 			/// @brief r[̍쐬
+			///
+			/// pNextnullptrŁAẽr[łɂƂ͍炸ɂ̓YԂ܂B
+			/// r[͂̃IuWFNg̔jƈꏏɔj܂
 			/// @param[in] pInfo
 			/// @retval size_t
 			/// @exception HVKException
 			size_t addView(VkImageViewCreateInfo* pInfo);
 
-			VkMemoryRequirements getMemoryRequirements();
+			/// @brief r[j
+			///
+			/// ̔z̗͎̈ĉŁÃr[蒼Ămۂ͋N܂
+			void releaseViews()noexcept;
+
+			/// @brief ẽr[T
+			/// @param[in] info
+			/// @retval size_t ȂsInvalidViewIndex
+			size_t findView(const VkImageViewCreateInfo& info)const noexcept;
+
+			/// @brief v擾
+			///
+			/// ΉĂfoCXł͐p̃qg擾܂
+			/// @retval HVKMemoryRequirements
+			HVKMemoryRequirements getMemoryRequirements();
+
+		public:
+			static const size_t sInvalidViewIndex = static_cast<size_t>(-1);
 
 		public:
 			bool isGood()const noexcept;
 			VkImage image()noexcept;
 			operator VkImage()noexcept { return this->image(); }
 			VkImageView& getView(int index);
+			size_t viewCount()const noexcept;
+			uint32_t mipLevels()const noexcept;
+			uint32_t arrayLayers()const noexcept;
+			VkImageAspectFlags aspect()const noexcept;
+			VkImageSubresourceRange wholeRange()const noexcept;
+			const SubresourceState& state(uint32_t mipLevel, uint32_t arrayLayer)const noexcept;
+
+		private:
+			void resetStates(uint32_t mipLevels, uint32_t arrayLayers, VkFormat format, VkImageLayout layout);
+			SubresourceState& stateRef(uint32_t mipLevel, uint32_t arrayLayer)noexcept;
 
 		private:
 			bool mIsSwapChainImage;
 			VkImage mImage;
 			VkDevice mParentDevice;
 			std::vector<VkImageView> mViews;
+			std::vector<VkImageViewCreateInfo> mViewInfos;
+			std::unordered_multimap<size_t, size_t> mViewIndices;	///< 쐬̃nbVlmViews̓Y
+			uint32_t mMipLevels;
+			uint32_t mArrayLayers;
+			VkImageAspectFlags mAspect;
+			std::vector<SubresourceState> mStates;	///< C[ƂɃ~bvxׂ
+		};
+	}
+
+	namespace graphics
+	{
+		/// @brief C[W̃oAW߂1vkCmdPipelineBarrierŋL^NX
+		///
+		/// Xe[Wׂ͂ẴoÂ̂킹Ďg܂B
+		/// flush֐̌obt@͉Ȃ̂ŁAt[ƂɎg񂵂Ă
+		class HVKImageBarrierBatch
+		{
+			HVKImageBarrierBatch(const HVKImageBarrierBatch&) = delete;
+			HVKImageBarrierBatch& operator=(const HVKImageBarrierBatch&) = delete;
+
+		public:
+			HVKImageBarrierBatch()noexcept;
+			HVKImageBarrierBatch(HVKImageBarrierBatch&& right)noexcept;
+			HVKImageBarrierBatch& operator=(HVKImageBarrierBatch&& right)noexcept;
+
+			/// @brief oAǉ
+			///
+			/// OɒǉoAƗׂ荇Tu\[XœeƂ1ɂ܂Ƃ߂܂
+			/// @param[in] barrier
+			/// @param[in] srcStageMask
+			/// @param[in] dstStageMask
+			void add(const VkImageMemoryBarrier& barrier, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask);
+
+			/// @brief oAȂ̎sˑǉ
+			/// @param[in] srcStageMask
+			/// @param[in] dstStageMask
+			void addExecutionDependency(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)noexcept;
+
+			/// @brief W߂oAL^ċɂ
+			///
+			/// ǉĂȂƂ͉L^܂
+			/// @param[in] cmd
+			/// @param[in] dependencyFlags
+			void flush(VkCommandBuffer cmd, VkDependencyFlags dependencyFlags = 0);
+
+			void clear()noexcept;
+
+		public:
+			bool empty()const noexcept;
+			size_t barrierCount()const noexcept;
+			VkPipelineStageFlags srcStageMask()const noexcept;
+			VkPipelineStageFlags dstStageMask()const noexcept;
+
+		private:
+			VkPipelineStageFlags mSrcStageMask;
+			VkPipelineStageFlags mDstStageMask;
+			std::vector<VkImageMemoryBarrier> mBarriers;
 		};
 	}
 
@@ -74,6 +239,18 @@ namespace hinode
 			static uint32_t sCalMiplevel(uint32_t width, uint32_t height)noexcept;
 
 			static HVKImageCreateInfo sMake2D(VkFormat format, uint32_t width, uint32_t height)noexcept;
+
+			/// @brief _[pX̒łgȂ2D̃A^b`g
+			///
+			/// VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BITt̂ŁA
+			/// HVKDeviceMemoryHeap::allocateForTransientImageVK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT̃Ɋ蓖Ă܂B
+			/// XgAIvVK_ATTACHMENT_STORE_OP_DONT_CAREɂĎgĂ
+			/// @param[in] format
+			/// @param[in] width
+			/// @param[in] height
+			/// @param[in] attachmentUsage VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT̑gݍ킹
+			/// @param[in] samples
+			static HVKImageCreateInfo sMakeTransientAttachment(VkFormat format, uint32_t width, uint32_t height, VkImageUsageFlags attachmentUsage, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT)noexcept;
 		};
 	}
 
@@ -0,0 +1,213 @@
+﻿#include "HVKMappedRangeBatch.h"
+
+#include <utility> // for std::move
+#include <algorithm>
+#include <functional>
+
+#include "../common/Common.h"
+#include "../deviceMemoryHeap/HVKDeviceMemoryHeap.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		HVKMappedRangeBatch::HVKMappedRangeBatch()
+			: mParentDevice(nullptr)
+			, mAtomSize(1)
+			, mLastSubmittedRangeCount(0)
+		{
+			setMemory(&this->mMemoryProps, 0);
+		}
+
+		HVKMappedRangeBatch::HVKMappedRangeBatch(HVKMappedRangeBatch&& right)noexcept
+			: HVKMappedRangeBatch()
+		{
+			*this = std::move(right);
+		}
+
+		HVKMappedRangeBatch& HVKMappedRangeBatch::operator=(HVKMappedRangeBatch&& right)noexcept
+		{
+			this->release();
+
+			this->mParentDevice = right.mParentDevice;
+			this->mMemoryProps = right.mMemoryProps;
+			this->mAtomSize = right.mAtomSize;
+			this->mFlushRanges = std::move(right.mFlushRanges);
+			this->mInvalidateRanges = std::move(right.mInvalidateRanges);
+			this->mSubmitRanges = std::move(right.mSubmitRanges);
+			this->mLastSubmittedRangeCount = right.mLastSubmittedRangeCount;
+
+			right.mFlushRanges.clear();
+			right.mInvalidateRanges.clear();
+			right.mSubmitRanges.clear();
+			right.release();
+			return *this;
+		}
+
+		HVKMappedRangeBatch::~HVKMappedRangeBatch()
+		{
+			this->release();
+		}
+
+		void HVKMappedRangeBatch::release()noexcept
+		{
+			this->mFlushRanges.clear();
+			this->mInvalidateRanges.clear();
+			this->mSubmitRanges.clear();
+			this->mParentDevice = nullptr;
+			this->mAtomSize = 1;
+			this->mLastSubmittedRangeCount = 0;
+		}
+
+		void HVKMappedRangeBatch::create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps, VkDeviceSize nonCoherentAtomSize)
+		{
+			this->release();
+
+			this->mParentDevice = device;
+			this->mMemoryProps = memoryProps;
+			this->mAtomSize = std::max<VkDeviceSize>(1, nonCoherentAtomSize);
+		}
+
+		void HVKMappedRangeBatch::addFlush(HVKDeviceMemory& memory, VkDeviceSize offset, VkDeviceSize size)noexcept
+		{
+			this->add(this->mFlushRanges, memory, offset, size);
+		}
+
+		void HVKMappedRangeBatch::addFlush(const HVKMemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size)noexcept
+		{
+			assert(allocation.isGood());
+			assert(offset <= allocation.size);
+			//広げた範囲が隣の割り当てにかからないよう、HVKDeviceMemoryHeapはアトムの境界から割り当てている
+			assert((this->mMemoryProps.memoryTypes[allocation.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+				|| (0 == allocation.offset % this->mAtomSize && 0 == allocation.size % this->mAtomSize));
+			size = VK_WHOLE_SIZE == size ? allocation.size - offset : size;
+			this->add(this->mFlushRanges, *allocation.pMemory, allocation.offset + offset, size);
+		}
+
+		void HVKMappedRangeBatch::addInvalidate(HVKDeviceMemory& memory, VkDeviceSize offset, VkDeviceSize size)noexcept
+		{
+			this->add(this->mInvalidateRanges, memory, offset, size);
+		}
+
+		void HVKMappedRangeBatch::addInvalidate(const HVKMemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size)noexcept
+		{
+			assert(allocation.isGood());
+			assert(offset <= allocation.size);
+			//広げた範囲が隣の割り当てにかからないよう、HVKDeviceMemoryHeapはアトムの境界から割り当てている
+			assert((this->mMemoryProps.memoryTypes[allocation.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+				|| (0 == allocation.offset % this->mAtomSize && 0 == allocation.size % this->mAtomSize));
+			size = VK_WHOLE_SIZE == size ? allocation.size - offset : size;
+			this->add(this->mInvalidateRanges, *allocation.pMemory, allocation.offset + offset, size);
+		}
+
+		VkResult HVKMappedRangeBatch::flush()
+		{
+			assert(this->isGood());
+
+			this->merge(this->mFlushRanges);
+			this->mFlushRanges.clear();
+			this->mLastSubmittedRangeCount = static_cast<uint32_t>(this->mSubmitRanges.size());
+			if (this->mSubmitRanges.empty()) {
+				return VK_SUCCESS;
+			}
+			return vkFlushMappedMemoryRanges(this->mParentDevice, this->mLastSubmittedRangeCount, this->mSubmitRanges.data());
+		}
+
+		VkResult HVKMappedRangeBatch::invalidate()
+		{
+			assert(this->isGood());
+
+			this->merge(this->mInvalidateRanges);
+			this->mInvalidateRanges.clear();
+			this->mLastSubmittedRangeCount = static_cast<uint32_t>(this->mSubmitRanges.size());
+			if (this->mSubmitRanges.empty()) {
+				return VK_SUCCESS;
+			}
+			return vkInvalidateMappedMemoryRanges(this->mParentDevice, this->mLastSubmittedRangeCount, this->mSubmitRanges.data());
+		}
+
+		void HVKMappedRangeBatch::add(std::vector<Range>& ranges, HVKDeviceMemory& memory, VkDeviceSize offset, VkDeviceSize size)noexcept
+		{
+			assert(this->isGood());
+			assert(memory.isGood());
+			assert(offset <= memory.size());
+
+			auto flags = this->mMemoryProps.memoryTypes[memory.memoryTypeIndex()].propertyFlags;
+			if (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) {
+				return;
+			}
+			if (0 == size) {
+				return;
+			}
+
+			//nonCoherentAtomSizeの倍数に広げる. 最後はメモリの終端に合わせればよい
+			Range range;
+			range.memory = memory.memory();
+			range.begin = offset / this->mAtomSize * this->mAtomSize;
+			if (VK_WHOLE_SIZE == size) {
+				range.end = memory.size();
+			} else {
+				range.end = std::min((offset + size + this->mAtomSize - 1) / this->mAtomSize * this->mAtomSize, memory.size());
+			}
+			ranges.push_back(range);
+		}
+
+		void HVKMappedRangeBatch::merge(std::vector<Range>& ranges)
+		{
+			this->mSubmitRanges.clear();
+			if (ranges.empty()) {
+				return;
+			}
+
+			std::less<VkDeviceMemory> lessMemory;
+			std::sort(ranges.begin(), ranges.end(), [&](const Range& left, const Range& right) {
+				if (left.memory != right.memory) {
+					return lessMemory(left.memory, right.memory);
+				}
+				return left.begin < right.begin;
+			});
+
+			VkMappedMemoryRange submit;
+			submit.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			submit.pNext = nullptr;
+
+			auto current = ranges.front();
+			for (auto it = ranges.begin() + 1; it != ranges.end(); ++it) {
+				//重なっているか隣り合っているならつなげる
+				if (it->memory == current.memory && it->begin <= current.end) {
+					current.end = std::max(current.end, it->end);
+					continue;
+				}
+				submit.memory = current.memory;
+				submit.offset = current.begin;
+				submit.size = current.end - current.begin;
+				this->mSubmitRanges.push_back(submit);
+				current = *it;
+			}
+			submit.memory = current.memory;
+			submit.offset = current.begin;
+			submit.size = current.end - current.begin;
+			this->mSubmitRanges.push_back(submit);
+		}
+
+		bool HVKMappedRangeBatch::isGood()const noexcept
+		{
+			return nullptr != this->mParentDevice;
+		}
+
+		size_t HVKMappedRangeBatch::flushRangeCount()const noexcept
+		{
+			return this->mFlushRanges.size();
+		}
+
+		size_t HVKMappedRangeBatch::invalidateRangeCount()const noexcept
+		{
+			return this->mInvalidateRanges.size();
+		}
+
+		uint32_t HVKMappedRangeBatch::lastSubmittedRangeCount()const noexcept
+		{
+			return this->mLastSubmittedRangeCount;
+		}
+	}
+}
@@ -0,0 +1,106 @@
+﻿#pragma once
+
+#include <vector>
+#include <vulkan\vulkan.h>
+
+#include "../HVKInterface.h"
+#include "../deviceMemory/HVKDeviceMemory.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		struct HVKMemoryAllocation;
+
+		/// @brief HOST_COHERENTでないメモリへのフラッシュとインバリデートをまとめて行うクラス
+		///
+		/// 書き込んだ範囲や読み込む範囲をフレームの間に集めておき、nonCoherentAtomSizeに合わせて広げ、
+		/// 重なったり隣り合ったりしている範囲をまとめてから1回のvkFlushMappedMemoryRanges, vkInvalidateMappedMemoryRangesで処理します。
+		/// HOST_COHERENTなメモリタイプの範囲は追加しても無視されます。
+		/// 広げた範囲は隣のデータにもかかるので、HVKMemoryAllocationはnonCoherentAtomSizeにそろえて割り当てたものでなければなりません。
+		/// HVKDeviceMemoryHeapの割り当ては常にそろっています。
+		class HVKMappedRangeBatch : public IHVKInterface
+		{
+			HVKMappedRangeBatch(const HVKMappedRangeBatch&) = delete;
+			HVKMappedRangeBatch& operator=(const HVKMappedRangeBatch&) = delete;
+
+		public:
+			HVKMappedRangeBatch();
+			HVKMappedRangeBatch(HVKMappedRangeBatch&& right)noexcept;
+			HVKMappedRangeBatch& operator=(HVKMappedRangeBatch&& right)noexcept;
+			~HVKMappedRangeBatch();
+
+			void release()noexcept override;
+
+			/// @brief 作成
+			/// @param[in] device
+			/// @param[in] memoryProps メモリタイプがHOST_COHERENTか調べるのに使います
+			/// @param[in] nonCoherentAtomSize VkPhysicalDeviceLimits::nonCoherentAtomSize
+			void create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps, VkDeviceSize nonCoherentAtomSize);
+
+			/// @brief ホストから書き込んだ範囲を追加する
+			/// @param[in] memory
+			/// @param[in] offset
+			/// @param[in] size VK_WHOLE_SIZEならoffsetから最後まで
+			void addFlush(HVKDeviceMemory& memory, VkDeviceSize offset, VkDeviceSize size)noexcept;
+
+			/// @brief ホストから書き込んだ範囲を追加する
+			/// @param[in] allocation
+			/// @param[in] offset allocationの先頭からの位置
+			/// @param[in] size VK_WHOLE_SIZEならallocationの最後まで
+			void addFlush(const HVKMemoryAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE)noexcept;
+
+			/// @brief ホストから読み込む範囲を追加する
+			/// @param[in] memory
+			/// @param[in] offset
+			/// @param[in] size VK_WHOLE_SIZEならoffsetから最後まで
+			void addInvalidate(HVKDeviceMemory& memory, VkDeviceSize offset, VkDeviceSize size)noexcept;
+
+			/// @brief ホストから読み込む範囲を追加する
+			/// @param[in] allocation
+			/// @param[in] offset allocationの先頭からの位置
+			/// @param[in] size VK_WHOLE_SIZEならallocationの最後まで
+			void addInvalidate(const HVKMemoryAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE)noexcept;
+
+			/// @brief 追加された書き込み範囲をまとめてフラッシュする
+			///
+			/// 成否にかかわらず追加された範囲は空になります
+			/// @retval VkResult
+			VkResult flush();
+
+			/// @brief 追加された読み込み範囲をまとめてインバリデートする
+			///
+			/// 成否にかかわらず追加された範囲は空になります
+			/// @retval VkResult
+			VkResult invalidate();
+
+		public:
+			bool isGood()const noexcept override;
+			size_t flushRangeCount()const noexcept;
+			size_t invalidateRangeCount()const noexcept;
+
+			/// @brief 直前のflush, invalidateでドライバに渡した範囲の数
+			uint32_t lastSubmittedRangeCount()const noexcept;
+
+		private:
+			struct Range
+			{
+				VkDeviceMemory memory;
+				VkDeviceSize begin;
+				VkDeviceSize end;
+			};
+
+			void add(std::vector<Range>& ranges, HVKDeviceMemory& memory, VkDeviceSize offset, VkDeviceSize size)noexcept;
+			void merge(std::vector<Range>& ranges);
+
+		private:
+			VkDevice mParentDevice;
+			VkPhysicalDeviceMemoryProperties mMemoryProps;
+			VkDeviceSize mAtomSize;
+			std::vector<Range> mFlushRanges;
+			std::vector<Range> mInvalidateRanges;
+			std::vector<VkMappedMemoryRange> mSubmitRanges;
+			uint32_t mLastSubmittedRangeCount;
+		};
+	}
+}
@@ -0,0 +1,168 @@
+﻿#include "HVKMemoryRequirements.h"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <cstring>
+
+#include "../common/Common.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace
+		{
+			/// @brief 拡張機能を有効にしたデバイスと取得済みの関数
+			///
+			/// 取得のたびにvkGetDeviceProcAddrを呼ばないよう、作成時に一度だけ取得しておく.
+			/// 登録と解除はまれなのでロックするが、検索はメモリ要件の取得ごとに行うのでロックしない
+			struct DeviceEntry
+			{
+				std::atomic<VkDevice> device;
+				PFN_vkGetBufferMemoryRequirements2KHR pGetBufferRequirements2;
+				PFN_vkGetImageMemoryRequirements2KHR pGetImageRequirements2;
+			};
+
+			const size_t MAX_DEVICE_COUNT = 8;
+			std::array<DeviceEntry, MAX_DEVICE_COUNT> gDeviceEntries = {};
+			std::mutex gDeviceEntriesMutex;
+
+			const DeviceEntry* findDeviceEntry(VkDevice device)noexcept
+			{
+				for (auto& entry : gDeviceEntries) {
+					if (device == entry.device.load(std::memory_order_acquire)) {
+						return &entry;
+					}
+				}
+				return nullptr;
+			}
+
+			bool isExtensionEnabled(const char* pName, uint32_t enabledExtensionCount, const char* const* ppEnabledExtensionNames)noexcept
+			{
+				for (auto i = 0u; i < enabledExtensionCount; ++i) {
+					if (0 == strcmp(pName, ppEnabledExtensionNames[i])) {
+						return true;
+					}
+				}
+				return false;
+			}
+		}
+
+		HVKMemoryRequirements::HVKMemoryRequirements()noexcept
+			: prefersDedicatedAllocation(VK_FALSE)
+			, requiresDedicatedAllocation(VK_FALSE)
+			, isDedicatedHintAvailable(false)
+		{
+			this->size = 0;
+			this->alignment = 0;
+			this->memoryTypeBits = 0;
+		}
+
+		HVKMemoryRequirements HVKMemoryRequirements::sGetBuffer(VkDevice device, VkBuffer buffer)noexcept
+		{
+			HVKMemoryRequirements result;
+
+			//拡張機能が有効なデバイスだけ登録時に関数を取得している
+			auto pEntry = findDeviceEntry(device);
+			auto pGetRequirements2 = pEntry ? pEntry->pGetBufferRequirements2 : nullptr;
+			if (nullptr == pGetRequirements2) {
+				vkGetBufferMemoryRequirements(device, buffer, &result);
+				return result;
+			}
+
+			VkBufferMemoryRequirementsInfo2KHR info;
+			info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2_KHR;
+			info.pNext = nullptr;
+			info.buffer = buffer;
+
+			VkMemoryDedicatedRequirementsKHR dedicated;
+			dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR;
+			dedicated.pNext = nullptr;
+
+			VkMemoryRequirements2KHR requirements2;
+			requirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2_KHR;
+			requirements2.pNext = &dedicated;
+
+			pGetRequirements2(device, &info, &requirements2);
+			static_cast<VkMemoryRequirements&>(result) = requirements2.memoryRequirements;
+			result.prefersDedicatedAllocation = dedicated.prefersDedicatedAllocation;
+			result.requiresDedicatedAllocation = dedicated.requiresDedicatedAllocation;
+			result.isDedicatedHintAvailable = true;
+			return result;
+		}
+
+		HVKMemoryRequirements HVKMemoryRequirements::sGetImage(VkDevice device, VkImage image)noexcept
+		{
+			HVKMemoryRequirements result;
+
+			auto pEntry = findDeviceEntry(device);
+			auto pGetRequirements2 = pEntry ? pEntry->pGetImageRequirements2 : nullptr;
+			if (nullptr == pGetRequirements2) {
+				vkGetImageMemoryRequirements(device, image, &result);
+				return result;
+			}
+
+			VkImageMemoryRequirementsInfo2KHR info;
+			info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2_KHR;
+			info.pNext = nullptr;
+			info.image = image;
+
+			VkMemoryDedicatedRequirementsKHR dedicated;
+			dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR;
+			dedicated.pNext = nullptr;
+
+			VkMemoryRequirements2KHR requirements2;
+			requirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2_KHR;
+			requirements2.pNext = &dedicated;
+
+			pGetRequirements2(device, &info, &requirements2);
+			static_cast<VkMemoryRequirements&>(result) = requirements2.memoryRequirements;
+			result.prefersDedicatedAllocation = dedicated.prefersDedicatedAllocation;
+			result.requiresDedicatedAllocation = dedicated.requiresDedicatedAllocation;
+			result.isDedicatedHintAvailable = true;
+			return result;
+		}
+
+		void HVKMemoryRequirements::sRegisterDevice(VkDevice device, uint32_t enabledExtensionCount, const char* const* ppEnabledExtensionNames)noexcept
+		{
+			assert(nullptr != device);
+
+			//VkMemoryDedicatedAllocateInfoKHRを使うにはVK_KHR_dedicated_allocationも有効でなければならない
+			if (!isExtensionEnabled(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME, enabledExtensionCount, ppEnabledExtensionNames)
+				|| !isExtensionEnabled(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME, enabledExtensionCount, ppEnabledExtensionNames)) {
+				return;
+			}
+
+			//拡張機能の関数はローダーから直接呼べないので、デバイスから取得する
+			auto pGetBufferRequirements2 = reinterpret_cast<PFN_vkGetBufferMemoryRequirements2KHR>(vkGetDeviceProcAddr(device, "vkGetBufferMemoryRequirements2KHR"));
+			auto pGetImageRequirements2 = reinterpret_cast<PFN_vkGetImageMemoryRequirements2KHR>(vkGetDeviceProcAddr(device, "vkGetImageMemoryRequirements2KHR"));
+			if (nullptr == pGetBufferRequirements2 || nullptr == pGetImageRequirements2) {
+				return;
+			}
+
+			std::lock_guard<std::mutex> lock(gDeviceEntriesMutex);
+			for (auto& entry : gDeviceEntries) {
+				if (nullptr == entry.device.load(std::memory_order_relaxed)) {
+					//関数を書き込んでからデバイスを公開する
+					entry.pGetBufferRequirements2 = pGetBufferRequirements2;
+					entry.pGetImageRequirements2 = pGetImageRequirements2;
+					entry.device.store(device, std::memory_order_release);
+					return;
+				}
+			}
+			//登録できなかったデバイスは従来の関数で取得する
+		}
+
+		void HVKMemoryRequirements::sUnregisterDevice(VkDevice device)noexcept
+		{
+			std::lock_guard<std::mutex> lock(gDeviceEntriesMutex);
+			for (auto& entry : gDeviceEntries) {
+				if (device == entry.device.load(std::memory_order_relaxed)) {
+					entry.device.store(nullptr, std::memory_order_release);
+					return;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,50 @@
+﻿#pragma once
+
+#include <vulkan\vulkan.h>
+
+namespace hinode
+{
+	namespace graphics
+	{
+		/// @brief VkMemoryRequirementsに専用メモリのヒントを加えたもの
+		///
+		/// VK_KHR_get_memory_requirements2とVK_KHR_dedicated_allocationを有効にして作成したデバイスでは
+		/// vkGet*MemoryRequirements2KHRでVkMemoryDedicatedRequirementsKHRも取得します。
+		/// 使えないときは従来の関数で取得し、ヒントはどちらもVK_FALSEになります。
+		/// 拡張機能が有効かどうかはドライバに問い合わせても分からないので、sRegisterDeviceで登録したものを使います。
+		/// HVKDeviceで作成したデバイスは自動で登録されます
+		struct HVKMemoryRequirements : public VkMemoryRequirements
+		{
+			VkBool32 prefersDedicatedAllocation;	///< ドライバが専用のVkDeviceMemoryを推奨している
+			VkBool32 requiresDedicatedAllocation;	///< 専用のVkDeviceMemoryでなければならない
+			bool isDedicatedHintAvailable;			///< 上の2つをドライバから取得できたか. VkMemoryDedicatedAllocateInfoKHRを使えるかの判定にも使えます
+
+			HVKMemoryRequirements()noexcept;
+
+			/// @brief バッファのメモリ要件を取得する
+			/// @param[in] device
+			/// @param[in] buffer
+			/// @retval HVKMemoryRequirements
+			static HVKMemoryRequirements sGetBuffer(VkDevice device, VkBuffer buffer)noexcept;
+
+			/// @brief イメージのメモリ要件を取得する
+			/// @param[in] device
+			/// @param[in] image
+			/// @retval HVKMemoryRequirements
+			static HVKMemoryRequirements sGetImage(VkDevice device, VkImage image)noexcept;
+
+			/// @brief デバイスで有効にした拡張機能を登録する
+			///
+			/// 2つの拡張機能がどちらも有効なときだけ、ここでvkGet*MemoryRequirements2KHRを一度だけ取得しておきます。
+			/// 登録していないデバイスや登録できる数を超えたデバイスでは、専用メモリのヒントを使いません
+			/// @param[in] device
+			/// @param[in] enabledExtensionCount VkDeviceCreateInfo::enabledExtensionCount
+			/// @param[in] ppEnabledExtensionNames VkDeviceCreateInfo::ppEnabledExtensionNames
+			static void sRegisterDevice(VkDevice device, uint32_t enabledExtensionCount, const char* const* ppEnabledExtensionNames)noexcept;
+
+			/// @brief 登録を解除する. vkDestroyDeviceの前に呼んでください
+			/// @param[in] device
+			static void sUnregisterDevice(VkDevice device)noexcept;
+		};
+	}
+}
@@ -0,0 +1,364 @@
+﻿#include "HVKMemoryStatistics.h"
+
+#include <atomic>
+#include <mutex>
+#include <sstream>
+
+#include "../common/Common.h"
+#include "../instance/HVKInstance.h"
+#include "../physicalDevice/HVKPhysicalDevice.h"
+#include "../device/HVKDevice.h"
+#include "../deviceMemoryHeap/HVKDeviceMemoryHeap.h"
+#include "../memoryTypeResolver/HVKMemoryTypeResolver.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace
+		{
+			struct AtomicCounter
+			{
+				std::atomic<uint32_t> allocationCount;
+				std::atomic<uint64_t> liveBytes;
+				std::atomic<uint64_t> peakBytes;
+
+				void reset()noexcept
+				{
+					this->allocationCount = 0;
+					this->liveBytes = 0;
+					this->peakBytes = 0;
+				}
+
+				void add(VkDeviceSize size)noexcept
+				{
+					++this->allocationCount;
+					auto live = (this->liveBytes += size);
+					auto peak = this->peakBytes.load();
+					while (peak < live && !this->peakBytes.compare_exchange_weak(peak, live)) {}
+				}
+
+				void sub(VkDeviceSize size)noexcept
+				{
+					--this->allocationCount;
+					this->liveBytes -= size;
+				}
+
+				HVKMemoryStatistics::Counter load()const noexcept
+				{
+					HVKMemoryStatistics::Counter result;
+					result.allocationCount = this->allocationCount.load();
+					result.liveBytes = this->liveBytes.load();
+					result.peakBytes = this->peakBytes.load();
+					return result;
+				}
+			};
+
+			/// @brief デバイスごとの集計
+			///
+			/// ヒープのpeakBytesはメモリタイプのpeakBytesの和からは求められないので、ヒープの合計も別に持つ
+			struct DeviceCounters
+			{
+				std::atomic<VkDevice> device;
+				uint32_t typeToHeap[VK_MAX_MEMORY_TYPES];
+				AtomicCounter types[VK_MAX_MEMORY_TYPES];
+				AtomicCounter heaps[VK_MAX_MEMORY_HEAPS];
+			};
+
+			const size_t MAX_DEVICE_COUNT = 8;
+			DeviceCounters gDeviceCounters[MAX_DEVICE_COUNT];
+			std::mutex gDeviceCountersMutex;
+
+			DeviceCounters* findDeviceCounters(VkDevice device)noexcept
+			{
+				if (nullptr == device) {
+					return nullptr;
+				}
+				for (auto& counters : gDeviceCounters) {
+					if (device == counters.device.load(std::memory_order_acquire)) {
+						return &counters;
+					}
+				}
+				return nullptr;
+			}
+		}
+
+		HVKMemoryStatistics::Counter::Counter()noexcept
+			: allocationCount(0)
+			, liveBytes(0)
+			, peakBytes(0)
+		{ }
+
+		void HVKMemoryStatistics::sRegisterDevice(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps)noexcept
+		{
+			assert(nullptr != device);
+
+			std::lock_guard<std::mutex> lock(gDeviceCountersMutex);
+			for (auto& counters : gDeviceCounters) {
+				if (nullptr != counters.device.load(std::memory_order_relaxed)) {
+					continue;
+				}
+				//集計を初期化してからデバイスを公開する
+				for (auto i = 0u; i < VK_MAX_MEMORY_TYPES; ++i) {
+					counters.typeToHeap[i] = i < memoryProps.memoryTypeCount ? memoryProps.memoryTypes[i].heapIndex : 0;
+					counters.types[i].reset();
+				}
+				for (auto& heap : counters.heaps) {
+					heap.reset();
+				}
+				counters.device.store(device, std::memory_order_release);
+				return;
+			}
+			//登録できる数を超えたデバイスは集計しない
+		}
+
+		void HVKMemoryStatistics::sUnregisterDevice(VkDevice device)noexcept
+		{
+			std::lock_guard<std::mutex> lock(gDeviceCountersMutex);
+			auto pCounters = findDeviceCounters(device);
+			if (nullptr != pCounters) {
+				pCounters->device.store(nullptr, std::memory_order_release);
+			}
+		}
+
+		void HVKMemoryStatistics::sRecordAllocate(VkDevice device, uint32_t memoryTypeIndex, VkDeviceSize size)noexcept
+		{
+			assert(memoryTypeIndex < VK_MAX_MEMORY_TYPES);
+
+			auto pCounters = findDeviceCounters(device);
+			if (nullptr == pCounters) {
+				return;
+			}
+			pCounters->types[memoryTypeIndex].add(size);
+			pCounters->heaps[pCounters->typeToHeap[memoryTypeIndex]].add(size);
+		}
+
+		void HVKMemoryStatistics::sRecordFree(VkDevice device, uint32_t memoryTypeIndex, VkDeviceSize size)noexcept
+		{
+			assert(memoryTypeIndex < VK_MAX_MEMORY_TYPES);
+
+			auto pCounters = findDeviceCounters(device);
+			if (nullptr == pCounters) {
+				return;
+			}
+			pCounters->types[memoryTypeIndex].sub(size);
+			pCounters->heaps[pCounters->typeToHeap[memoryTypeIndex]].sub(size);
+		}
+
+		HVKMemoryStatistics::Counter HVKMemoryStatistics::sGetTypeCounter(VkDevice device, uint32_t memoryTypeIndex)noexcept
+		{
+			assert(memoryTypeIndex < VK_MAX_MEMORY_TYPES);
+
+			auto pCounters = findDeviceCounters(device);
+			return nullptr != pCounters ? pCounters->types[memoryTypeIndex].load() : Counter();
+		}
+
+		HVKMemoryStatistics::Counter HVKMemoryStatistics::sGetHeapCounter(VkDevice device, uint32_t heapIndex)noexcept
+		{
+			assert(heapIndex < VK_MAX_MEMORY_HEAPS);
+
+			auto pCounters = findDeviceCounters(device);
+			return nullptr != pCounters ? pCounters->heaps[heapIndex].load() : Counter();
+		}
+
+		void HVKMemoryStatistics::sResetPeak(VkDevice device)noexcept
+		{
+			auto pCounters = findDeviceCounters(device);
+			if (nullptr == pCounters) {
+				return;
+			}
+			for (auto& type : pCounters->types) {
+				type.peakBytes = type.liveBytes.load();
+			}
+			for (auto& heap : pCounters->heaps) {
+				heap.peakBytes = heap.liveBytes.load();
+			}
+		}
+
+		HVKMemoryStatistics::HVKMemoryStatistics()
+			: mGPU(nullptr)
+			, mDevice(nullptr)
+			, mpGetMemoryProperties2(nullptr)
+		{
+			setMemory(&this->mMemoryProps, 0);
+			memset(this->mHeapBudgets, 0, sizeof(this->mHeapBudgets));
+			memset(this->mHeapUsages, 0, sizeof(this->mHeapUsages));
+			memset(this->mLiveBytesAtUpdate, 0, sizeof(this->mLiveBytesAtUpdate));
+		}
+
+		HVKMemoryStatistics::~HVKMemoryStatistics()
+		{
+			this->release();
+		}
+
+		void HVKMemoryStatistics::release()noexcept
+		{
+			this->mGPU = nullptr;
+			this->mDevice = nullptr;
+			this->mpGetMemoryProperties2 = nullptr;
+			setMemory(&this->mMemoryProps, 0);
+			memset(this->mHeapBudgets, 0, sizeof(this->mHeapBudgets));
+			memset(this->mHeapUsages, 0, sizeof(this->mHeapUsages));
+			memset(this->mLiveBytesAtUpdate, 0, sizeof(this->mLiveBytesAtUpdate));
+		}
+
+		void HVKMemoryStatistics::create(HVKInstance& instance, HVKPhysicalDevice& gpu, HVKDevice& device, bool isMemoryBudgetEnabled)
+		{
+			this->release();
+
+			this->mGPU = gpu.device();
+			this->mDevice = device.device();
+			this->mMemoryProps = gpu.getMemoryProperties();
+			if (isMemoryBudgetEnabled) {
+				this->mpGetMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(instance.getProcAddr("vkGetPhysicalDeviceMemoryProperties2KHR"));
+			}
+			this->update();
+		}
+
+		void HVKMemoryStatistics::update()noexcept
+		{
+			assert(this->isGood());
+
+			VkDeviceSize liveBytes[VK_MAX_MEMORY_HEAPS];
+			for (auto i = 0u; i < this->mMemoryProps.memoryHeapCount; ++i) {
+				liveBytes[i] = this->heapCounter(i).liveBytes;
+			}
+
+			if (nullptr == this->mpGetMemoryProperties2) {
+				for (auto i = 0u; i < this->mMemoryProps.memoryHeapCount; ++i) {
+					this->mHeapBudgets[i] = this->mMemoryProps.memoryHeaps[i].size * 8 / 10;
+					this->mHeapUsages[i] = liveBytes[i];
+					this->mLiveBytesAtUpdate[i] = liveBytes[i];
+				}
+				return;
+			}
+
+			VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProps;
+			budgetProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+			budgetProps.pNext = nullptr;
+			VkPhysicalDeviceMemoryProperties2KHR props2;
+			props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+			props2.pNext = &budgetProps;
+			this->mpGetMemoryProperties2(this->mGPU, &props2);
+
+			for (auto i = 0u; i < this->mMemoryProps.memoryHeapCount; ++i) {
+				//0を返すドライバもあるので、そのときはヒープの大きさから見積もる
+				this->mHeapBudgets[i] = 0 < budgetProps.heapBudget[i] ? budgetProps.heapBudget[i] : this->mMemoryProps.memoryHeaps[i].size * 8 / 10;
+				this->mHeapUsages[i] = budgetProps.heapUsage[i];
+				this->mLiveBytesAtUpdate[i] = liveBytes[i];
+			}
+		}
+
+		void HVKMemoryStatistics::applyTo(HVKMemoryTypeResolver& resolver)const noexcept
+		{
+			assert(this->isGood());
+			for (auto i = 0u; i < this->mMemoryProps.memoryHeapCount; ++i) {
+				resolver.setHeapBudget(i, this->remainingBudget(i));
+			}
+		}
+
+		bool HVKMemoryStatistics::isOverBudget(uint32_t heapIndex, VkDeviceSize additionalSize)const noexcept
+		{
+			return this->heapBudget(heapIndex) < this->heapUsage(heapIndex) + additionalSize;
+		}
+
+		std::string HVKMemoryStatistics::toJson(const HVKDeviceMemoryHeap* pHeap)const
+		{
+			assert(this->isGood());
+
+			std::ostringstream out;
+			out << "{\"memoryBudgetAvailable\":" << (this->isMemoryBudgetAvailable() ? "true" : "false");
+
+			out << ",\"heaps\":[";
+			for (auto i = 0u; i < this->mMemoryProps.memoryHeapCount; ++i) {
+				auto counter = this->heapCounter(i);
+				out << (0 == i ? "" : ",") << "{"
+					<< "\"index\":" << i
+					<< ",\"size\":" << this->mMemoryProps.memoryHeaps[i].size
+					<< ",\"flags\":" << this->mMemoryProps.memoryHeaps[i].flags
+					<< ",\"budget\":" << this->heapBudget(i)
+					<< ",\"usage\":" << this->heapUsage(i)
+					<< ",\"allocationCount\":" << counter.allocationCount
+					<< ",\"liveBytes\":" << counter.liveBytes
+					<< ",\"peakBytes\":" << counter.peakBytes
+					<< "}";
+			}
+			out << "]";
+
+			out << ",\"types\":[";
+			for (auto i = 0u; i < this->mMemoryProps.memoryTypeCount; ++i) {
+				auto counter = sGetTypeCounter(this->mDevice, i);
+				out << (0 == i ? "" : ",") << "{"
+					<< "\"index\":" << i
+					<< ",\"heapIndex\":" << this->mMemoryProps.memoryTypes[i].heapIndex
+					<< ",\"flags\":" << this->mMemoryProps.memoryTypes[i].propertyFlags
+					<< ",\"allocationCount\":" << counter.allocationCount
+					<< ",\"liveBytes\":" << counter.liveBytes
+					<< ",\"peakBytes\":" << counter.peakBytes;
+				if (nullptr != pHeap) {
+					auto stats = pHeap->calStatistics(i);
+					out << ",\"pool\":{"
+						<< "\"blockCount\":" << stats.blockCount
+						<< ",\"blockBytes\":" << stats.blockBytes
+						<< ",\"usedBytes\":" << stats.usedBytes
+						<< ",\"allocationCount\":" << stats.allocationCount
+						<< ",\"largestFreeBlock\":" << stats.largestFreeBlock
+						<< ",\"dedicatedCount\":" << stats.dedicatedCount
+						<< ",\"dedicatedBytes\":" << stats.dedicatedBytes
+						<< "}";
+				}
+				out << "}";
+			}
+			out << "]}";
+			return out.str();
+		}
+
+		bool HVKMemoryStatistics::isGood()const noexcept
+		{
+			return nullptr != this->mGPU;
+		}
+
+		bool HVKMemoryStatistics::isMemoryBudgetAvailable()const noexcept
+		{
+			return nullptr != this->mpGetMemoryProperties2;
+		}
+
+		const VkPhysicalDeviceMemoryProperties& HVKMemoryStatistics::memoryProperties()const noexcept
+		{
+			return this->mMemoryProps;
+		}
+
+		HVKMemoryStatistics::Counter HVKMemoryStatistics::heapCounter(uint32_t heapIndex)const noexcept
+		{
+			assert(heapIndex < this->mMemoryProps.memoryHeapCount);
+			return sGetHeapCounter(this->mDevice, heapIndex);
+		}
+
+		VkDeviceSize HVKMemoryStatistics::heapBudget(uint32_t heapIndex)const noexcept
+		{
+			assert(heapIndex < this->mMemoryProps.memoryHeapCount);
+			return this->mHeapBudgets[heapIndex];
+		}
+
+		VkDeviceSize HVKMemoryStatistics::heapUsage(uint32_t heapIndex)const noexcept
+		{
+			assert(heapIndex < this->mMemoryProps.memoryHeapCount);
+
+			//前回のupdateからこのプロセスで増減した分を反映する
+			auto live = this->heapCounter(heapIndex).liveBytes;
+			auto atUpdate = this->mLiveBytesAtUpdate[heapIndex];
+			if (atUpdate <= live) {
+				return this->mHeapUsages[heapIndex] + (live - atUpdate);
+			}
+			auto decrease = atUpdate - live;
+			return decrease < this->mHeapUsages[heapIndex] ? this->mHeapUsages[heapIndex] - decrease : 0;
+		}
+
+		VkDeviceSize HVKMemoryStatistics::remainingBudget(uint32_t heapIndex)const noexcept
+		{
+			auto budget = this->heapBudget(heapIndex);
+			auto usage = this->heapUsage(heapIndex);
+			return usage < budget ? budget - usage : 0;
+		}
+	}
+}
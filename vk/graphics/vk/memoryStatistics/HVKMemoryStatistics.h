@@ -0,0 +1,131 @@
+﻿#pragma once
+
+#include <string>
+#include <vulkan\vulkan.h>
+
+#include "../HVKInterface.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		class HVKInstance;
+		class HVKPhysicalDevice;
+		class HVKDevice;
+		class HVKDeviceMemoryHeap;
+		class HVKMemoryTypeResolver;
+
+		/// @brief HVKDeviceMemoryで確保したメモリの統計とヒープの予算を扱うクラス
+		///
+		/// 確保と解放の記録はHVKDeviceMemoryが自動で行い、デバイスごとにメモリタイプとヒープの単位で集計されます。
+		/// 集計するデバイスはHVKDeviceが作成時に登録します。登録されていないデバイスでの確保は集計されません。
+		/// VK_EXT_memory_budgetが使えるときはドライバが報告する予算と使用量を、使えないときはヒープの大きさの80%を予算として使います。
+		/// ストリーミングなどではisOverBudgetで確保する前に余裕があるか調べてください。
+		class HVKMemoryStatistics : public IHVKInterface
+		{
+		public:
+			/// @brief 確保の集計
+			struct Counter
+			{
+				uint32_t allocationCount;	///< 生きているVkDeviceMemoryの数
+				VkDeviceSize liveBytes;		///< 生きているVkDeviceMemoryの大きさの合計
+				VkDeviceSize peakBytes;		///< liveBytesの最大値
+
+				Counter()noexcept;
+			};
+
+			/// @brief 集計するデバイスを登録する. HVKDeviceから呼び出されます
+			///
+			/// メモリタイプの属するヒープを覚えておき、確保のたびにヒープの合計も更新します
+			/// @param[in] device
+			/// @param[in] memoryProps deviceを作成した物理デバイスのもの
+			static void sRegisterDevice(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps)noexcept;
+
+			/// @brief 登録を解除する. HVKDeviceから呼び出されます
+			static void sUnregisterDevice(VkDevice device)noexcept;
+
+			/// @brief 確保を記録する. HVKDeviceMemoryから呼び出されます
+			static void sRecordAllocate(VkDevice device, uint32_t memoryTypeIndex, VkDeviceSize size)noexcept;
+
+			/// @brief 解放を記録する. HVKDeviceMemoryから呼び出されます
+			static void sRecordFree(VkDevice device, uint32_t memoryTypeIndex, VkDeviceSize size)noexcept;
+
+			/// @brief メモリタイプごとの集計を取得する
+			/// @param[in] device
+			/// @param[in] memoryTypeIndex
+			/// @retval Counter
+			static Counter sGetTypeCounter(VkDevice device, uint32_t memoryTypeIndex)noexcept;
+
+			/// @brief ヒープごとの集計を取得する
+			///
+			/// peakBytesはメモリタイプごとの最大値の和ではなく、ヒープの合計が最大になったときの値です
+			/// @param[in] device
+			/// @param[in] heapIndex
+			/// @retval Counter
+			static Counter sGetHeapCounter(VkDevice device, uint32_t heapIndex)noexcept;
+
+			/// @brief peakBytesを現在のliveBytesに戻す
+			/// @param[in] device
+			static void sResetPeak(VkDevice device)noexcept;
+
+		public:
+			HVKMemoryStatistics();
+			~HVKMemoryStatistics();
+
+			void release()noexcept override;
+
+			/// @brief 作成
+			/// @param[in] instance vkGetPhysicalDeviceMemoryProperties2KHRの取得に使います
+			/// @param[in] gpu
+			/// @param[in] device 集計を取得するデバイス. gpuから作成したもの
+			/// @param[in] isMemoryBudgetEnabled デバイスでVK_EXT_memory_budgetを有効にしているか
+			void create(HVKInstance& instance, HVKPhysicalDevice& gpu, HVKDevice& device, bool isMemoryBudgetEnabled);
+
+			/// @brief ドライバから予算と使用量を取得し直す
+			///
+			/// ドライバへの問い合わせは重いので、1フレームに1回程度にしてください
+			void update()noexcept;
+
+			/// @brief 現在の予算をHVKMemoryTypeResolverの順位付けに反映させる
+			/// @param[inout] resolver
+			void applyTo(HVKMemoryTypeResolver& resolver)const noexcept;
+
+			/// @brief additionalSizeを確保すると予算を超えるか
+			/// @param[in] heapIndex
+			/// @param[in] additionalSize
+			/// @retval bool
+			bool isOverBudget(uint32_t heapIndex, VkDeviceSize additionalSize = 0)const noexcept;
+
+			/// @brief 統計をJSON形式の文字列にする
+			/// @param[in] pHeap nullptrでなければブロックの使用状況も出力します
+			/// @retval std::string
+			std::string toJson(const HVKDeviceMemoryHeap* pHeap = nullptr)const;
+
+		public:
+			bool isGood()const noexcept override;
+			bool isMemoryBudgetAvailable()const noexcept;
+			const VkPhysicalDeviceMemoryProperties& memoryProperties()const noexcept;
+
+			/// @brief ヒープの集計
+			Counter heapCounter(uint32_t heapIndex)const noexcept;
+
+			/// @brief ヒープの予算
+			VkDeviceSize heapBudget(uint32_t heapIndex)const noexcept;
+
+			/// @brief ヒープの使用量. VK_EXT_memory_budgetが使えるときは他のプロセスなどの使用量も含みます
+			VkDeviceSize heapUsage(uint32_t heapIndex)const noexcept;
+
+			/// @brief 予算の残り
+			VkDeviceSize remainingBudget(uint32_t heapIndex)const noexcept;
+
+		private:
+			VkPhysicalDevice mGPU;
+			VkDevice mDevice;
+			PFN_vkGetPhysicalDeviceMemoryProperties2KHR mpGetMemoryProperties2;
+			VkPhysicalDeviceMemoryProperties mMemoryProps;
+			VkDeviceSize mHeapBudgets[VK_MAX_MEMORY_HEAPS];
+			VkDeviceSize mHeapUsages[VK_MAX_MEMORY_HEAPS];
+			VkDeviceSize mLiveBytesAtUpdate[VK_MAX_MEMORY_HEAPS];	///< update時のliveBytes. 次のupdateまでの増減をmHeapUsagesに足すのに使います
+		};
+	}
+}
@@ -0,0 +1,208 @@
+﻿#include "HVKMemoryTypeResolver.h"
+
+#include <utility> // for std::move
+
+#include "../common/Common.h"
+#include "../physicalDevice/HVKPhysicalDevice.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace
+		{
+			inline uint32_t countBits(uint32_t v)noexcept
+			{
+				v = v - ((v >> 1) & 0x55555555u);
+				v = (v & 0x33333333u) + ((v >> 2) & 0x33333333u);
+				return (((v + (v >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+			}
+		}
+
+		const uint32_t HVKMemoryTypeResolver::sInvalidIndex = static_cast<uint32_t>(-1);
+
+		HVKMemoryTypeResolver::Query::Query(uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags notPreferred)noexcept
+			: typeBits(typeBits)
+			, required(required)
+			, preferred(preferred)
+			, notPreferred(notPreferred)
+		{ }
+
+		bool HVKMemoryTypeResolver::Query::operator==(const Query& right)const noexcept
+		{
+			return this->typeBits == right.typeBits
+				&& this->required == right.required
+				&& this->preferred == right.preferred
+				&& this->notPreferred == right.notPreferred;
+		}
+
+		size_t HVKMemoryTypeResolver::QueryHash::operator()(const Query& query)const noexcept
+		{
+			size_t h = query.typeBits;
+			h = h * 31 + query.required;
+			h = h * 31 + query.preferred;
+			h = h * 31 + query.notPreferred;
+			return h;
+		}
+
+		HVKMemoryTypeResolver::HVKMemoryTypeResolver()
+			: mIsGood(false)
+		{
+			setMemory(&this->mMemoryProps, 0);
+			memset(this->mHeapBudgets, 0, sizeof(this->mHeapBudgets));
+		}
+
+		HVKMemoryTypeResolver::HVKMemoryTypeResolver(HVKMemoryTypeResolver&& right)noexcept
+			: HVKMemoryTypeResolver()
+		{
+			*this = std::move(right);
+		}
+
+		HVKMemoryTypeResolver& HVKMemoryTypeResolver::operator=(HVKMemoryTypeResolver&& right)noexcept
+		{
+			this->release();
+
+			this->mMemoryProps = right.mMemoryProps;
+			memcpy(this->mHeapBudgets, right.mHeapBudgets, sizeof(this->mHeapBudgets));
+			this->mIsGood = right.mIsGood;
+			this->mCache = std::move(right.mCache);
+
+			right.release();
+			return *this;
+		}
+
+		HVKMemoryTypeResolver::~HVKMemoryTypeResolver()
+		{
+			this->release();
+		}
+
+		void HVKMemoryTypeResolver::release()noexcept
+		{
+			setMemory(&this->mMemoryProps, 0);
+			memset(this->mHeapBudgets, 0, sizeof(this->mHeapBudgets));
+			this->mCache.clear();
+			this->mIsGood = false;
+		}
+
+		void HVKMemoryTypeResolver::create(HVKPhysicalDevice& gpu)
+		{
+			this->create(gpu.getMemoryProperties());
+		}
+
+		void HVKMemoryTypeResolver::create(const VkPhysicalDeviceMemoryProperties& memoryProps)
+		{
+			this->release();
+
+			this->mMemoryProps = memoryProps;
+			for (auto i = 0u; i < this->mMemoryProps.memoryHeapCount; ++i) {
+				this->mHeapBudgets[i] = this->mMemoryProps.memoryHeaps[i].size;
+			}
+			this->mIsGood = true;
+		}
+
+		uint32_t HVKMemoryTypeResolver::find(const Query& query)
+		{
+			assert(this->isGood());
+
+			auto it = this->mCache.find(query);
+			if (this->mCache.end() != it) {
+				return it->second;
+			}
+			auto result = this->search(query);
+			this->mCache.insert({ query, result });
+			return result;
+		}
+
+		uint32_t HVKMemoryTypeResolver::find(uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags notPreferred)
+		{
+			return this->find(Query(typeBits, required, preferred, notPreferred));
+		}
+
+		void HVKMemoryTypeResolver::setHeapBudget(uint32_t heapIndex, VkDeviceSize remainingBudget)noexcept
+		{
+			assert(heapIndex < this->mMemoryProps.memoryHeapCount);
+			if (this->mHeapBudgets[heapIndex] != remainingBudget) {
+				this->mHeapBudgets[heapIndex] = remainingBudget;
+				this->clearCache();
+			}
+		}
+
+		void HVKMemoryTypeResolver::clearCache()noexcept
+		{
+			this->mCache.clear();
+		}
+
+		uint32_t HVKMemoryTypeResolver::search(const Query& query)const noexcept
+		{
+			uint32_t result = sInvalidIndex;
+			uint32_t bestCost = UINT32_MAX;
+			VkDeviceSize bestBudget = 0;
+			VkDeviceSize bestHeapSize = 0;
+			for (auto i = 0u; i < this->mMemoryProps.memoryTypeCount; ++i) {
+				unless(query.typeBits & (1u << i)) {
+					continue;
+				}
+				auto flags = this->mMemoryProps.memoryTypes[i].propertyFlags;
+				if ((flags & query.required) != query.required) {
+					continue;
+				}
+
+				//望ましいフラグが欠けている数と望ましくないフラグを持っている数が少ないほど良い
+				auto cost = countBits(query.preferred & ~flags) + countBits(query.notPreferred & flags);
+				auto heapIndex = this->mMemoryProps.memoryTypes[i].heapIndex;
+				auto budget = this->mHeapBudgets[heapIndex];
+				auto heapSize = this->mMemoryProps.memoryHeaps[heapIndex].size;
+
+				bool isBetter = false;
+				if (cost != bestCost) {
+					isBetter = cost < bestCost;
+				} else if (budget != bestBudget) {
+					isBetter = bestBudget < budget;
+				} else {
+					isBetter = bestHeapSize < heapSize;
+				}
+
+				if (isBetter) {
+					result = i;
+					bestCost = cost;
+					bestBudget = budget;
+					bestHeapSize = heapSize;
+				}
+			}
+			return result;
+		}
+
+		bool HVKMemoryTypeResolver::isGood()const noexcept
+		{
+			return this->mIsGood;
+		}
+
+		const VkPhysicalDeviceMemoryProperties& HVKMemoryTypeResolver::memoryProperties()const noexcept
+		{
+			return this->mMemoryProps;
+		}
+
+		VkDeviceSize HVKMemoryTypeResolver::heapBudget(uint32_t heapIndex)const noexcept
+		{
+			assert(heapIndex < this->mMemoryProps.memoryHeapCount);
+			return this->mHeapBudgets[heapIndex];
+		}
+
+		VkMemoryPropertyFlags HVKMemoryTypeResolver::propertyFlags(uint32_t memoryTypeIndex)const noexcept
+		{
+			assert(memoryTypeIndex < this->mMemoryProps.memoryTypeCount);
+			return this->mMemoryProps.memoryTypes[memoryTypeIndex].propertyFlags;
+		}
+
+		uint32_t HVKMemoryTypeResolver::heapIndex(uint32_t memoryTypeIndex)const noexcept
+		{
+			assert(memoryTypeIndex < this->mMemoryProps.memoryTypeCount);
+			return this->mMemoryProps.memoryTypes[memoryTypeIndex].heapIndex;
+		}
+
+		size_t HVKMemoryTypeResolver::cacheCount()const noexcept
+		{
+			return this->mCache.size();
+		}
+	}
+}
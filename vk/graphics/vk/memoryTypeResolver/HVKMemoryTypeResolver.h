@@ -0,0 +1,101 @@
+﻿#pragma once
+
+#include <unordered_map>
+#include <vulkan\vulkan.h>
+
+#include "../HVKInterface.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		class HVKPhysicalDevice;
+
+		/// @brief メモリタイプの選択を行い、その結果をキャッシュするクラス
+		///
+		/// 必須のフラグ、あると望ましいフラグ、ないほうが望ましいフラグから候補を順位付けします。
+		/// 順位が同じときはヒープの残り予算(設定していなければヒープの大きさ)が大きいものを選びます。
+		/// 結果は(typeBits, フラグ)ごとに保存するので、同じ検索を繰り返してもメモリタイプを走査し直しません。
+		class HVKMemoryTypeResolver : public IHVKInterface
+		{
+			HVKMemoryTypeResolver(const HVKMemoryTypeResolver&) = delete;
+			HVKMemoryTypeResolver& operator=(const HVKMemoryTypeResolver&) = delete;
+
+		public:
+			static const uint32_t sInvalidIndex;
+
+			/// @brief 検索条件
+			struct Query
+			{
+				uint32_t typeBits;						///< VkMemoryRequirements::memoryTypeBits
+				VkMemoryPropertyFlags required;			///< 必ず持っていなければならないフラグ
+				VkMemoryPropertyFlags preferred;		///< 持っていると望ましいフラグ
+				VkMemoryPropertyFlags notPreferred;		///< 持っていないほうが望ましいフラグ
+
+				Query(uint32_t typeBits = ~0u, VkMemoryPropertyFlags required = 0, VkMemoryPropertyFlags preferred = 0, VkMemoryPropertyFlags notPreferred = 0)noexcept;
+				bool operator==(const Query& right)const noexcept;
+			};
+
+		public:
+			HVKMemoryTypeResolver();
+			HVKMemoryTypeResolver(HVKMemoryTypeResolver&& right)noexcept;
+			HVKMemoryTypeResolver& operator=(HVKMemoryTypeResolver&& right)noexcept;
+			~HVKMemoryTypeResolver();
+
+			void release()noexcept override;
+
+			/// @brief 作成
+			/// @param[in] gpu
+			void create(HVKPhysicalDevice& gpu);
+
+			/// @brief 作成
+			/// @param[in] memoryProps
+			void create(const VkPhysicalDeviceMemoryProperties& memoryProps);
+
+			/// @brief 条件に最も合うメモリタイプを探す
+			/// @param[in] query
+			/// @retval uint32_t 見つからなかったときはsInvalidIndex
+			uint32_t find(const Query& query);
+
+			/// @brief 条件に最も合うメモリタイプを探す
+			/// @param[in] typeBits
+			/// @param[in] required
+			/// @param[in] preferred
+			/// @param[in] notPreferred
+			/// @retval uint32_t 見つからなかったときはsInvalidIndex
+			uint32_t find(uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0, VkMemoryPropertyFlags notPreferred = 0);
+
+			/// @brief ヒープの残り予算を設定する
+			///
+			/// 順位が変わる可能性があるので、値が変わったときはキャッシュを破棄します
+			/// @param[in] heapIndex
+			/// @param[in] remainingBudget
+			void setHeapBudget(uint32_t heapIndex, VkDeviceSize remainingBudget)noexcept;
+
+			/// @brief キャッシュを破棄する
+			void clearCache()noexcept;
+
+		public:
+			bool isGood()const noexcept override;
+			const VkPhysicalDeviceMemoryProperties& memoryProperties()const noexcept;
+			VkDeviceSize heapBudget(uint32_t heapIndex)const noexcept;
+			VkMemoryPropertyFlags propertyFlags(uint32_t memoryTypeIndex)const noexcept;
+			uint32_t heapIndex(uint32_t memoryTypeIndex)const noexcept;
+			size_t cacheCount()const noexcept;
+
+		private:
+			struct QueryHash
+			{
+				size_t operator()(const Query& query)const noexcept;
+			};
+
+			uint32_t search(const Query& query)const noexcept;
+
+		private:
+			VkPhysicalDeviceMemoryProperties mMemoryProps;
+			VkDeviceSize mHeapBudgets[VK_MAX_MEMORY_HEAPS];
+			bool mIsGood;
+			std::unordered_map<Query, uint32_t, QueryHash> mCache;
+		};
+	}
+}
@@ -0,0 +1,219 @@
+﻿#include "HVKMipGenerator.h"
+
+#include <algorithm>
+
+#include "../common/Common.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace
+		{
+			VkImageMemoryBarrier makeBarrier(const HVKMipGenerateInfo& info, uint32_t baseMipLevel, uint32_t levelCount, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask)noexcept
+			{
+				VkImageMemoryBarrier barrier;
+				barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				barrier.pNext = nullptr;
+				barrier.srcAccessMask = srcAccessMask;
+				barrier.dstAccessMask = dstAccessMask;
+				barrier.oldLayout = oldLayout;
+				barrier.newLayout = newLayout;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.image = info.image;
+				barrier.subresourceRange.aspectMask = info.aspect;
+				barrier.subresourceRange.baseMipLevel = baseMipLevel;
+				barrier.subresourceRange.levelCount = levelCount;
+				barrier.subresourceRange.baseArrayLayer = info.baseArrayLayer;
+				barrier.subresourceRange.layerCount = info.layerCount;
+				return barrier;
+			}
+
+			VkOffset3D mipExtent(const VkExtent3D& extent, uint32_t level)noexcept
+			{
+				VkOffset3D result;
+				result.x = static_cast<int32_t>(std::max(1u, extent.width >> level));
+				result.y = static_cast<int32_t>(std::max(1u, extent.height >> level));
+				result.z = static_cast<int32_t>(std::max(1u, extent.depth >> level));
+				return result;
+			}
+		}
+
+		HVKMipGenerateInfo::HVKMipGenerateInfo()noexcept
+			: image(VK_NULL_HANDLE)
+			, format(VK_FORMAT_UNDEFINED)
+			, tiling(VK_IMAGE_TILING_OPTIMAL)
+			, aspect(VK_IMAGE_ASPECT_COLOR_BIT)
+			, mipLevels(1)
+			, baseArrayLayer(0)
+			, layerCount(1)
+			, oldLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+			, newLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+			, srcStageMask(VK_PIPELINE_STAGE_TRANSFER_BIT)
+			, srcAccessMask(VK_ACCESS_TRANSFER_WRITE_BIT)
+			, dstStageMask(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
+			, dstAccessMask(VK_ACCESS_SHADER_READ_BIT)
+			, pImage(nullptr)
+		{
+			this->extent.width = 1;
+			this->extent.height = 1;
+			this->extent.depth = 1;
+		}
+
+		HVKMipGenerateInfo::HVKMipGenerateInfo(VkImage image, const VkImageCreateInfo& createInfo)noexcept
+			: HVKMipGenerateInfo()
+		{
+			this->image = image;
+			this->format = createInfo.format;
+			this->tiling = createInfo.tiling;
+			this->extent = createInfo.extent;
+			this->mipLevels = createInfo.mipLevels;
+			this->layerCount = createInfo.arrayLayers;
+		}
+
+		HVKMipGenerator::HVKMipGenerator()
+			: mpPhysicalDevice(nullptr)
+		{ }
+
+		HVKMipGenerator::HVKMipGenerator(HVKMipGenerator&& right)noexcept
+			: HVKMipGenerator()
+		{
+			*this = std::move(right);
+		}
+
+		HVKMipGenerator& HVKMipGenerator::operator=(HVKMipGenerator&& right)noexcept
+		{
+			this->release();
+
+			this->mpPhysicalDevice = right.mpPhysicalDevice;
+			this->mSupports = std::move(right.mSupports);
+
+			right.mSupports.clear();
+			right.release();
+			return *this;
+		}
+
+		HVKMipGenerator::~HVKMipGenerator()
+		{
+			this->release();
+		}
+
+		void HVKMipGenerator::release()noexcept
+		{
+			this->mpPhysicalDevice = nullptr;
+			this->mSupports.clear();
+		}
+
+		void HVKMipGenerator::create(HVKPhysicalDevice& physicalDevice)
+		{
+			this->release();
+			this->mpPhysicalDevice = &physicalDevice;
+		}
+
+		bool HVKMipGenerator::isSupported(VkFormat format, VkImageTiling tiling)
+		{
+			return this->findSupport(format, tiling).isBlitSupported;
+		}
+
+		void HVKMipGenerator::record(VkCommandBuffer cmd, const HVKMipGenerateInfo& info)
+		{
+			this->recordBarriersAndBlits(cmd, info);
+			if (nullptr != info.pImage) {
+				//どのレベルも終わりのバリアでnewLayoutに移っている
+				VkImageSubresourceRange range;
+				range.aspectMask = info.aspect;
+				range.baseMipLevel = 0;
+				range.levelCount = info.mipLevels;
+				range.baseArrayLayer = info.baseArrayLayer;
+				range.layerCount = info.layerCount;
+				info.pImage->setState(range, info.newLayout, info.dstAccessMask, info.dstStageMask);
+			}
+		}
+
+		void HVKMipGenerator::recordBarriersAndBlits(VkCommandBuffer cmd, const HVKMipGenerateInfo& info)
+		{
+			assert(this->isGood());
+			assert(0 < info.mipLevels && 0 < info.layerCount);
+
+			auto& support = this->findSupport(info.format, info.tiling);
+			if (!support.isBlitSupported) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKMipGenerator, record, VK_ERROR_FORMAT_NOT_SUPPORTED)
+					<< "ブリットに対応していないフォーマットです format=" << info.format;
+			}
+			//深度とステンシルはリニアフィルタでブリットできない
+			auto isColor = 0 == (info.aspect & (VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT));
+			auto filter = support.isLinearFilterSupported && isColor ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+			if (1 == info.mipLevels) {
+				auto barrier = makeBarrier(info, 0, 1, info.oldLayout, info.newLayout, info.srcAccessMask, info.dstAccessMask);
+				vkCmdPipelineBarrier(cmd, info.srcStageMask, info.dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+				return;
+			}
+
+			//レベル0を読み込み元に、それ以外を書き込み先にする. 下のレベルの古い内容は使わないのでUNDEFINEDから移す
+			VkImageMemoryBarrier beginBarriers[] = {
+				makeBarrier(info, 0, 1, info.oldLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, info.srcAccessMask, VK_ACCESS_TRANSFER_READ_BIT),
+				makeBarrier(info, 1, info.mipLevels - 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT),
+			};
+			vkCmdPipelineBarrier(cmd, info.srcStageMask | VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+				0, nullptr, 0, nullptr, 2, beginBarriers);
+
+			for (auto level = 1u; level < info.mipLevels; ++level) {
+				VkImageBlit blit;
+				blit.srcSubresource.aspectMask = info.aspect;
+				blit.srcSubresource.mipLevel = level - 1;
+				blit.srcSubresource.baseArrayLayer = info.baseArrayLayer;
+				blit.srcSubresource.layerCount = info.layerCount;
+				blit.srcOffsets[0] = { 0, 0, 0 };
+				blit.srcOffsets[1] = mipExtent(info.extent, level - 1);
+				blit.dstSubresource = blit.srcSubresource;
+				blit.dstSubresource.mipLevel = level;
+				blit.dstOffsets[0] = { 0, 0, 0 };
+				blit.dstOffsets[1] = mipExtent(info.extent, level);
+				vkCmdBlitImage(cmd, info.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, info.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, filter);
+
+				//最後のレベルは読み込み元にならないので、終わりのバリアでまとめて移す
+				if (level + 1 < info.mipLevels) {
+					auto barrier = makeBarrier(info, level, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+					vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+				}
+			}
+
+			auto lastLevel = info.mipLevels - 1;
+			VkImageMemoryBarrier endBarriers[] = {
+				makeBarrier(info, 0, lastLevel, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, info.newLayout, VK_ACCESS_TRANSFER_READ_BIT, info.dstAccessMask),
+				makeBarrier(info, lastLevel, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, info.newLayout, VK_ACCESS_TRANSFER_WRITE_BIT, info.dstAccessMask),
+			};
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, info.dstStageMask, 0,
+				0, nullptr, 0, nullptr, 2, endBarriers);
+		}
+
+		const HVKMipGenerator::FormatSupport& HVKMipGenerator::findSupport(VkFormat format, VkImageTiling tiling)
+		{
+			assert(this->isGood());
+
+			auto it = std::find_if(this->mSupports.begin(), this->mSupports.end(), [&](const FormatSupport& support) {
+				return support.format == format && support.tiling == tiling;
+			});
+			if (this->mSupports.end() != it) {
+				return *it;
+			}
+
+			auto props = this->mpPhysicalDevice->getFormatProperties(format);
+			auto features = VK_IMAGE_TILING_LINEAR == tiling ? props.linearTilingFeatures : props.optimalTilingFeatures;
+			FormatSupport support;
+			support.format = format;
+			support.tiling = tiling;
+			support.isBlitSupported = (VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT) == (features & (VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT));
+			support.isLinearFilterSupported = 0 != (features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+			this->mSupports.push_back(support);
+			return this->mSupports.back();
+		}
+
+		bool HVKMipGenerator::isGood()const noexcept
+		{
+			return nullptr != this->mpPhysicalDevice;
+		}
+	}
+}
@@ -0,0 +1,101 @@
+﻿#pragma once
+
+#include <vector>
+#include <vulkan\vulkan.h>
+
+#include "../HVKInterface.h"
+#include "../physicalDevice/HVKPhysicalDevice.h"
+#include "../image/HVKImage.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		/// @brief ミップマップを生成するイメージの情報
+		struct HVKMipGenerateInfo
+		{
+			VkImage image;
+			VkFormat format;
+			VkImageTiling tiling;
+			VkImageAspectFlags aspect;
+			VkExtent3D extent;				///< レベル0の大きさ
+			uint32_t mipLevels;				///< 生成するレベルを含めたレベルの数
+			uint32_t baseArrayLayer;
+			uint32_t layerCount;
+			VkImageLayout oldLayout;		///< レベル0の現在のレイアウト. それより下のレベルの内容は捨てます
+			VkImageLayout newLayout;		///< 生成後のすべてのレベルのレイアウト
+			VkPipelineStageFlags srcStageMask;	///< レベル0へ書き込んだステージ
+			VkAccessFlags srcAccessMask;		///< レベル0への書き込み
+			VkPipelineStageFlags dstStageMask;	///< 生成後にイメージを使うステージ
+			VkAccessFlags dstAccessMask;		///< 生成後のイメージへのアクセス
+			HVKImage* pImage;					///< imageのラッパー. 指定すると生成後の状態を書き換えます
+
+			HVKMipGenerateInfo()noexcept;
+
+			/// @brief 作成情報から設定する
+			///
+			/// 転送で書き込んだイメージをフラグメントシェーダでサンプリングする場合を想定した値を設定します
+			/// @param[in] image
+			/// @param[in] createInfo imageの作成に使ったもの
+			HVKMipGenerateInfo(VkImage image, const VkImageCreateInfo& createInfo)noexcept;
+		};
+
+		/// @brief vkCmdBlitImageを繰り返してミップマップを生成するクラス
+		///
+		/// レベルiをレベルi-1から半分の大きさで縮小コピーし、レベルごとにレイアウトを切り替えるバリアを挟みます。
+		/// フォーマットがVK_FORMAT_FEATURE_BLIT_SRC_BITとVK_FORMAT_FEATURE_BLIT_DST_BITに対応しているかは
+		/// HVKPhysicalDevice::getFormatPropertiesで調べ、結果はフォーマットごとに保持します。
+		/// VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BITに対応していればリニアフィルタ、していなければニアレストで縮小します
+		class HVKMipGenerator : public IHVKInterface
+		{
+			HVKMipGenerator(const HVKMipGenerator&) = delete;
+			HVKMipGenerator& operator=(const HVKMipGenerator&) = delete;
+
+		public:
+			HVKMipGenerator();
+			HVKMipGenerator(HVKMipGenerator&& right)noexcept;
+			HVKMipGenerator& operator=(HVKMipGenerator&& right)noexcept;
+			~HVKMipGenerator();
+
+			void release()noexcept override;
+
+			/// @brief 作成
+			/// @param[in] physicalDevice 解放するまで生存していること
+			void create(HVKPhysicalDevice& physicalDevice);
+
+			/// @brief ブリットでミップマップを生成できるフォーマットか調べる
+			/// @param[in] format
+			/// @param[in] tiling
+			/// @retval bool
+			bool isSupported(VkFormat format, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL);
+
+			/// @brief ミップマップを生成するコマンドを記録する
+			///
+			/// イメージはVK_IMAGE_USAGE_TRANSFER_SRC_BITとVK_IMAGE_USAGE_TRANSFER_DST_BITを付けて作成してください。
+			/// コマンドバッファはグラフィックス機能を持つキューのものであること
+			/// @param[in] cmd
+			/// @param[in] info
+			/// @exception HVKException フォーマットが対応していないとき
+			void record(VkCommandBuffer cmd, const HVKMipGenerateInfo& info);
+
+		public:
+			bool isGood()const noexcept override;
+
+		private:
+			struct FormatSupport
+			{
+				VkFormat format;
+				VkImageTiling tiling;
+				bool isBlitSupported;
+				bool isLinearFilterSupported;
+			};
+
+			const FormatSupport& findSupport(VkFormat format, VkImageTiling tiling);
+			void recordBarriersAndBlits(VkCommandBuffer cmd, const HVKMipGenerateInfo& info);
+
+		private:
+			HVKPhysicalDevice* mpPhysicalDevice;
+			std::vector<FormatSupport> mSupports;
+		};
+	}
+}
@@ -0,0 +1,501 @@
+﻿#include "HVKProfilingHostAllocator.h"
+
+#include <cassert>
+#include <cstring>
+#include <chrono>
+#include <sstream>
+#include <algorithm>
+
+#include "../hostAllocator/HVKHostAllocator.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace
+		{
+			inline size_t alignUp(size_t value, size_t alignment)noexcept
+			{
+				return (value + alignment - 1) & ~(alignment - 1);
+			}
+
+			void writeHistogram(std::ostringstream& out, const HVKProfilingHostAllocator::Histogram& histogram)
+			{
+				//末尾の0は省く
+				auto count = HVKProfilingHostAllocator::sBucketCount;
+				while (0 < count && 0 == histogram.buckets[count - 1]) {
+					--count;
+				}
+				out << "[";
+				for (auto i = 0u; i < count; ++i) {
+					out << (0 == i ? "" : ",") << histogram.buckets[i];
+				}
+				out << "]";
+			}
+
+			void writeCounter(std::ostringstream& out, const HVKProfilingHostAllocator::Counter& counter)
+			{
+				out << "\"allocationCount\":" << counter.allocationCount
+					<< ",\"liveCount\":" << counter.liveCount
+					<< ",\"liveBytes\":" << counter.liveBytes
+					<< ",\"peakBytes\":" << counter.peakBytes
+					<< ",\"totalBytes\":" << counter.totalBytes
+					<< ",\"sizeHistogram\":";
+				writeHistogram(out, counter.sizes);
+				out << ",\"lifetimeHistogramUs\":";
+				writeHistogram(out, counter.lifetimes);
+			}
+		}
+
+		const uint32_t HVKProfilingHostAllocator::sScopeCount;
+		const uint32_t HVKProfilingHostAllocator::sBucketCount;
+		const uint32_t HVKProfilingHostAllocator::sShardCount;
+		const size_t HVKProfilingHostAllocator::sCacheLineSize;
+		const size_t HVKProfilingHostAllocator::sHeaderSize;
+
+		//
+		//	struct Histogram, Counter
+		//
+
+		HVKProfilingHostAllocator::Histogram::Histogram()noexcept
+		{
+			std::fill(std::begin(this->buckets), std::end(this->buckets), 0);
+		}
+
+		HVKProfilingHostAllocator::Histogram& HVKProfilingHostAllocator::Histogram::operator+=(const Histogram& right)noexcept
+		{
+			for (auto i = 0u; i < sBucketCount; ++i) {
+				this->buckets[i] += right.buckets[i];
+			}
+			return *this;
+		}
+
+		HVKProfilingHostAllocator::Counter::Counter()noexcept
+			: allocationCount(0)
+			, liveCount(0)
+			, liveBytes(0)
+			, peakBytes(0)
+			, totalBytes(0)
+		{ }
+
+		HVKProfilingHostAllocator::Counter& HVKProfilingHostAllocator::Counter::operator+=(const Counter& right)noexcept
+		{
+			this->allocationCount += right.allocationCount;
+			this->liveCount += right.liveCount;
+			this->liveBytes += right.liveBytes;
+			this->totalBytes += right.totalBytes;
+			this->sizes += right.sizes;
+			this->lifetimes += right.lifetimes;
+			return *this;
+		}
+
+		//
+		//	struct AtomicCounter, AtomicLiveBytes
+		//
+
+		HVKProfilingHostAllocator::AtomicCounter::AtomicCounter()noexcept
+			: allocationCount(0)
+			, liveCount(0)
+			, totalBytes(0)
+		{
+			for (auto i = 0u; i < sBucketCount; ++i) {
+				this->sizes[i].store(0, std::memory_order_relaxed);
+				this->lifetimes[i].store(0, std::memory_order_relaxed);
+			}
+		}
+
+		void HVKProfilingHostAllocator::AtomicCounter::recordAllocate(uint64_t size)noexcept
+		{
+			this->allocationCount.fetch_add(1, std::memory_order_relaxed);
+			this->liveCount.fetch_add(1, std::memory_order_relaxed);
+			this->totalBytes.fetch_add(size, std::memory_order_relaxed);
+			this->sizes[sCalBucket(size)].fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void HVKProfilingHostAllocator::AtomicCounter::recordFree()noexcept
+		{
+			this->liveCount.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		void HVKProfilingHostAllocator::AtomicCounter::addTo(Counter& out)const noexcept
+		{
+			out.allocationCount += this->allocationCount.load(std::memory_order_relaxed);
+			//区画ごとには負になりうるので、符号付きのまま足す
+			out.liveCount += static_cast<uint64_t>(this->liveCount.load(std::memory_order_relaxed));
+			out.totalBytes += this->totalBytes.load(std::memory_order_relaxed);
+			for (auto i = 0u; i < sBucketCount; ++i) {
+				out.sizes.buckets[i] += this->sizes[i].load(std::memory_order_relaxed);
+				out.lifetimes.buckets[i] += this->lifetimes[i].load(std::memory_order_relaxed);
+			}
+		}
+
+		HVKProfilingHostAllocator::AtomicLiveBytes::AtomicLiveBytes()noexcept
+			: liveBytes(0)
+			, peakBytes(0)
+		{ }
+
+		void HVKProfilingHostAllocator::AtomicLiveBytes::recordAllocate(uint64_t size)noexcept
+		{
+			auto live = this->liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+			auto peak = this->peakBytes.load(std::memory_order_relaxed);
+			while (peak < live && !this->peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+			}
+		}
+
+		void HVKProfilingHostAllocator::AtomicLiveBytes::recordFree(uint64_t size)noexcept
+		{
+			this->liveBytes.fetch_sub(size, std::memory_order_relaxed);
+		}
+
+		void HVKProfilingHostAllocator::AtomicLiveBytes::resetPeak()noexcept
+		{
+			this->peakBytes.store(this->liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+
+		//
+		//	class HVKProfilingHostAllocator
+		//
+
+		const char* HVKProfilingHostAllocator::sOwnerName(OWNER owner)noexcept
+		{
+			switch (owner) {
+			case eOWNER_INSTANCE:				return "HVKInstance";
+			case eOWNER_DEVICE:					return "HVKDevice";
+			case eOWNER_SURFACE:				return "HVKSurfaceKHR";
+			case eOWNER_SWAPCHAIN:				return "HVKSwapChainKHR";
+			case eOWNER_COMMAND_POOL:			return "HVKCommandPool";
+			case eOWNER_BUFFER:					return "HVKBuffer";
+			case eOWNER_IMAGE:					return "HVKImage";
+			case eOWNER_DEVICE_MEMORY:			return "HVKDeviceMemory";
+			case eOWNER_DESCRIPTOR_POOL:		return "HVKDescriptorPool";
+			case eOWNER_DESCRIPTOR_SET_LAYOUT:	return "HVKDescriptorSetLayout";
+			case eOWNER_PIPELINE_LAYOUT:		return "HVKPipelineLayout";
+			case eOWNER_RENDER_PASS:			return "HVKRenderPass";
+			case eOWNER_SEMAPHORE:				return "HVKSemaphore";
+			case eOWNER_SHADER_MODULE:			return "HVKShaderModule";
+			default:							return "other";
+			}
+		}
+
+		const char* HVKProfilingHostAllocator::sScopeName(VkSystemAllocationScope scope)noexcept
+		{
+			switch (scope) {
+			case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND:	return "command";
+			case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT:		return "object";
+			case VK_SYSTEM_ALLOCATION_SCOPE_CACHE:		return "cache";
+			case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE:		return "device";
+			case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE:	return "instance";
+			default:									return "unknown";
+			}
+		}
+
+		HVKProfilingHostAllocator::HVKProfilingHostAllocator(const VkAllocationCallbacks* pTarget, bool isRecordLifetime)
+			: mIsRecordLifetime(isRecordLifetime)
+			, mShards(new Shard[sShardCount])
+		{
+			static_assert(sizeof(Header) <= sHeaderSize, "ヘッダが予約した領域に収まりません");
+			static_assert(sizeof(AtomicLiveBytes) == sCacheLineSize, "AtomicLiveBytesがキャッシュラインの大きさと一致しません");
+
+			this->mTarget = nullptr != pTarget ? *pTarget : HVKHostAllocator::sGetBuiltin().callbacks();
+			for (auto i = 0u; i < eOWNER_COUNT; ++i) {
+				this->mContexts[i].pParent = this;
+				this->mContexts[i].owner = static_cast<OWNER>(i);
+
+				auto& callbacks = this->mCallbacks[i];
+				callbacks.pUserData = &this->mContexts[i];
+				callbacks.pfnAllocation = &HVKProfilingHostAllocator::sAllocation;
+				callbacks.pfnReallocation = &HVKProfilingHostAllocator::sReallocation;
+				callbacks.pfnFree = &HVKProfilingHostAllocator::sFree;
+				callbacks.pfnInternalAllocation = &HVKProfilingHostAllocator::sInternalAllocation;
+				callbacks.pfnInternalFree = &HVKProfilingHostAllocator::sInternalFree;
+			}
+		}
+
+		HVKProfilingHostAllocator::~HVKProfilingHostAllocator()
+		{ }
+
+		VkAllocationCallbacks* HVKProfilingHostAllocator::callbacksPointer(OWNER owner)noexcept
+		{
+			assert(owner < eOWNER_COUNT);
+			return &this->mCallbacks[owner];
+		}
+
+		void HVKProfilingHostAllocator::resetPeak()noexcept
+		{
+			for (auto& liveBytes : this->mLiveBytes) {
+				for (auto& bytes : liveBytes) {
+					bytes.resetPeak();
+				}
+			}
+			for (auto& bytes : this->mOwnerLiveBytes) {
+				bytes.resetPeak();
+			}
+			for (auto& bytes : this->mScopeLiveBytes) {
+				bytes.resetPeak();
+			}
+			for (auto& bytes : this->mInternalLiveBytes) {
+				bytes.resetPeak();
+			}
+		}
+
+		std::string HVKProfilingHostAllocator::toJson()const
+		{
+			std::ostringstream out;
+			out << "{\"owners\":[";
+			auto isFirstOwner = true;
+			for (auto owner = 0u; owner < eOWNER_COUNT; ++owner) {
+				auto total = this->ownerCounter(static_cast<OWNER>(owner));
+				if (0 == total.allocationCount) {
+					continue;
+				}
+				out << (isFirstOwner ? "" : ",") << "{\"owner\":\"" << sOwnerName(static_cast<OWNER>(owner)) << "\",";
+				writeCounter(out, total);
+				out << ",\"scopes\":[";
+				auto isFirstScope = true;
+				for (auto scope = 0u; scope < sScopeCount; ++scope) {
+					auto counter = this->counter(static_cast<OWNER>(owner), static_cast<VkSystemAllocationScope>(scope));
+					if (0 == counter.allocationCount) {
+						continue;
+					}
+					out << (isFirstScope ? "" : ",") << "{\"scope\":\"" << sScopeName(static_cast<VkSystemAllocationScope>(scope)) << "\",";
+					writeCounter(out, counter);
+					out << "}";
+					isFirstScope = false;
+				}
+				out << "]}";
+				isFirstOwner = false;
+			}
+			out << "]";
+
+			out << ",\"scopes\":[";
+			for (auto scope = 0u; scope < sScopeCount; ++scope) {
+				auto counter = this->scopeCounter(static_cast<VkSystemAllocationScope>(scope));
+				auto internal = this->internalCounter(static_cast<VkSystemAllocationScope>(scope));
+				out << (0 == scope ? "" : ",") << "{\"scope\":\"" << sScopeName(static_cast<VkSystemAllocationScope>(scope)) << "\",";
+				writeCounter(out, counter);
+				out << ",\"internal\":{"
+					<< "\"allocationCount\":" << internal.allocationCount
+					<< ",\"liveBytes\":" << internal.liveBytes
+					<< ",\"peakBytes\":" << internal.peakBytes
+					<< "}}";
+			}
+			out << "]}";
+			return out.str();
+		}
+
+		HVKProfilingHostAllocator::Counter HVKProfilingHostAllocator::counter(OWNER owner, VkSystemAllocationScope scope)const noexcept
+		{
+			assert(owner < eOWNER_COUNT && static_cast<uint32_t>(scope) < sScopeCount);
+			Counter result;
+			for (auto i = 0u; i < sShardCount; ++i) {
+				this->mShards[i].counters[owner][scope].addTo(result);
+			}
+			auto& bytes = this->mLiveBytes[owner][scope];
+			result.liveBytes = bytes.liveBytes.load(std::memory_order_relaxed);
+			result.peakBytes = bytes.peakBytes.load(std::memory_order_relaxed);
+			return result;
+		}
+
+		HVKProfilingHostAllocator::Counter HVKProfilingHostAllocator::ownerCounter(OWNER owner)const noexcept
+		{
+			assert(owner < eOWNER_COUNT);
+			Counter result;
+			for (auto scope = 0u; scope < sScopeCount; ++scope) {
+				result += this->counter(owner, static_cast<VkSystemAllocationScope>(scope));
+			}
+			auto& bytes = this->mOwnerLiveBytes[owner];
+			result.liveBytes = bytes.liveBytes.load(std::memory_order_relaxed);
+			result.peakBytes = bytes.peakBytes.load(std::memory_order_relaxed);
+			return result;
+		}
+
+		HVKProfilingHostAllocator::Counter HVKProfilingHostAllocator::scopeCounter(VkSystemAllocationScope scope)const noexcept
+		{
+			assert(static_cast<uint32_t>(scope) < sScopeCount);
+			Counter result;
+			for (auto owner = 0u; owner < eOWNER_COUNT; ++owner) {
+				result += this->counter(static_cast<OWNER>(owner), scope);
+			}
+			auto& bytes = this->mScopeLiveBytes[scope];
+			result.liveBytes = bytes.liveBytes.load(std::memory_order_relaxed);
+			result.peakBytes = bytes.peakBytes.load(std::memory_order_relaxed);
+			return result;
+		}
+
+		HVKProfilingHostAllocator::Counter HVKProfilingHostAllocator::internalCounter(VkSystemAllocationScope scope)const noexcept
+		{
+			assert(static_cast<uint32_t>(scope) < sScopeCount);
+			Counter result;
+			this->mInternalCounters[scope].addTo(result);
+			auto& bytes = this->mInternalLiveBytes[scope];
+			result.liveBytes = bytes.liveBytes.load(std::memory_order_relaxed);
+			result.peakBytes = bytes.peakBytes.load(std::memory_order_relaxed);
+			return result;
+		}
+
+		uint32_t HVKProfilingHostAllocator::sCalBucket(uint64_t value)noexcept
+		{
+			uint32_t bucket = 0;
+			while (1 < value && bucket + 1 < sBucketCount) {
+				value >>= 1;
+				++bucket;
+			}
+			return bucket;
+		}
+
+		uint64_t HVKProfilingHostAllocator::sNow()noexcept
+		{
+			auto now = std::chrono::steady_clock::now().time_since_epoch();
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now).count());
+		}
+
+		uint32_t HVKProfilingHostAllocator::sCurrentShard()noexcept
+		{
+			//スレッドが最初に記録したときに順番に割り振る
+			static std::atomic<uint32_t> sNextShard(0);
+			thread_local uint32_t tShard = sNextShard.fetch_add(1, std::memory_order_relaxed) % sShardCount;
+			return tShard;
+		}
+
+		size_t HVKProfilingHostAllocator::sCalOffset(size_t alignment)noexcept
+		{
+			//アライメントの倍数だけずらせば、割り当て先の先頭が揃っている限りユーザーの領域も揃う
+			return alignUp(sHeaderSize, std::max<size_t>(alignment, 16));
+		}
+
+		void* HVKProfilingHostAllocator::allocate(OWNER owner, size_t size, size_t alignment, VkSystemAllocationScope scope)noexcept
+		{
+			auto offset = sCalOffset(alignment);
+			auto* pBase = static_cast<uint8_t*>(this->mTarget.pfnAllocation(this->mTarget.pUserData, size + offset, std::max<size_t>(alignment, 16), scope));
+			if (nullptr == pBase) {
+				return nullptr;
+			}
+
+			auto* pMemory = pBase + offset;
+			auto* pHeader = reinterpret_cast<Header*>(pMemory - sizeof(Header));
+			pHeader->size = size;
+			pHeader->timestamp = this->mIsRecordLifetime ? sNow() : 0;
+			pHeader->offset = static_cast<uint32_t>(offset);
+			pHeader->owner = static_cast<uint16_t>(owner);
+			pHeader->scope = static_cast<uint16_t>(scope);
+			this->mShards[sCurrentShard()].counters[owner][scope].recordAllocate(size);
+			this->recordLiveAllocate(owner, scope, size);
+			return pMemory;
+		}
+
+		void* HVKProfilingHostAllocator::reallocate(OWNER owner, void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope scope)noexcept
+		{
+			if (nullptr == pOriginal) {
+				return this->allocate(owner, size, alignment, scope);
+			}
+			if (0 == size) {
+				this->free(pOriginal);
+				return nullptr;
+			}
+
+			auto header = *reinterpret_cast<Header*>(static_cast<uint8_t*>(pOriginal) - sizeof(Header));
+			if (sCalOffset(alignment) != header.offset) {
+				//ヘッダの位置がアライメントの倍数でなくなるので、ずらしたまま割り当て直すことはできない
+				auto* pMemory = this->allocate(owner, size, alignment, scope);
+				if (nullptr == pMemory) {
+					return nullptr;
+				}
+				memcpy(pMemory, pOriginal, static_cast<size_t>(std::min<uint64_t>(size, header.size)));
+				//寿命は引き継ぐので、古いほうの解放では記録しない
+				reinterpret_cast<Header*>(static_cast<uint8_t*>(pMemory) - sizeof(Header))->timestamp = header.timestamp;
+				this->deallocate(pOriginal, header, false);
+				return pMemory;
+			}
+
+			auto* pOriginalBase = static_cast<uint8_t*>(pOriginal) - header.offset;
+			auto* pBase = static_cast<uint8_t*>(this->mTarget.pfnReallocation(this->mTarget.pUserData, pOriginalBase, size + header.offset, std::max<size_t>(alignment, 16), scope));
+			if (nullptr == pBase) {
+				return nullptr;
+			}
+
+			//同じオブジェクトの大きさが変わっただけとして扱い、寿命は引き継ぐ
+			auto& shard = this->mShards[sCurrentShard()];
+			shard.counters[header.owner][header.scope].recordFree();
+			this->recordLiveFree(header.owner, header.scope, header.size);
+			shard.counters[owner][scope].recordAllocate(size);
+			this->recordLiveAllocate(owner, scope, size);
+
+			auto* pMemory = pBase + header.offset;
+			auto* pHeader = reinterpret_cast<Header*>(pMemory - sizeof(Header));
+			pHeader->size = size;
+			pHeader->owner = static_cast<uint16_t>(owner);
+			pHeader->scope = static_cast<uint16_t>(scope);
+			return pMemory;
+		}
+
+		void HVKProfilingHostAllocator::free(void* pMemory)noexcept
+		{
+			if (nullptr == pMemory) {
+				return;
+			}
+
+			auto header = *reinterpret_cast<Header*>(static_cast<uint8_t*>(pMemory) - sizeof(Header));
+			this->deallocate(pMemory, header, this->mIsRecordLifetime);
+		}
+
+		void HVKProfilingHostAllocator::deallocate(void* pMemory, const Header& header, bool isRecordLifetime)noexcept
+		{
+			auto& counter = this->mShards[sCurrentShard()].counters[header.owner][header.scope];
+			counter.recordFree();
+			this->recordLiveFree(header.owner, header.scope, header.size);
+			if (isRecordLifetime) {
+				auto now = sNow();
+				counter.lifetimes[sCalBucket(header.timestamp < now ? now - header.timestamp : 0)].fetch_add(1, std::memory_order_relaxed);
+			}
+
+			this->mTarget.pfnFree(this->mTarget.pUserData, static_cast<uint8_t*>(pMemory) - header.offset);
+		}
+
+		void HVKProfilingHostAllocator::recordLiveAllocate(uint32_t owner, uint32_t scope, uint64_t size)noexcept
+		{
+			this->mLiveBytes[owner][scope].recordAllocate(size);
+			this->mOwnerLiveBytes[owner].recordAllocate(size);
+			this->mScopeLiveBytes[scope].recordAllocate(size);
+		}
+
+		void HVKProfilingHostAllocator::recordLiveFree(uint32_t owner, uint32_t scope, uint64_t size)noexcept
+		{
+			this->mLiveBytes[owner][scope].recordFree(size);
+			this->mOwnerLiveBytes[owner].recordFree(size);
+			this->mScopeLiveBytes[scope].recordFree(size);
+		}
+
+		VKAPI_ATTR void* VKAPI_CALL HVKProfilingHostAllocator::sAllocation(void* pUserData, size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+		{
+			auto* pContext = static_cast<OwnerContext*>(pUserData);
+			return pContext->pParent->allocate(pContext->owner, size, alignment, allocationScope);
+		}
+
+		VKAPI_ATTR void* VKAPI_CALL HVKProfilingHostAllocator::sReallocation(void* pUserData, void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+		{
+			auto* pContext = static_cast<OwnerContext*>(pUserData);
+			return pContext->pParent->reallocate(pContext->owner, pOriginal, size, alignment, allocationScope);
+		}
+
+		VKAPI_ATTR void VKAPI_CALL HVKProfilingHostAllocator::sFree(void* pUserData, void* pMemory)
+		{
+			static_cast<OwnerContext*>(pUserData)->pParent->free(pMemory);
+		}
+
+		VKAPI_ATTR void VKAPI_CALL HVKProfilingHostAllocator::sInternalAllocation(void* pUserData, size_t size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope)
+		{
+			(void)allocationType;
+			auto* pParent = static_cast<OwnerContext*>(pUserData)->pParent;
+			pParent->mInternalCounters[allocationScope].recordAllocate(size);
+			pParent->mInternalLiveBytes[allocationScope].recordAllocate(size);
+		}
+
+		VKAPI_ATTR void VKAPI_CALL HVKProfilingHostAllocator::sInternalFree(void* pUserData, size_t size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope)
+		{
+			(void)allocationType;
+			auto* pParent = static_cast<OwnerContext*>(pUserData)->pParent;
+			pParent->mInternalCounters[allocationScope].recordFree();
+			pParent->mInternalLiveBytes[allocationScope].recordFree(size);
+		}
+	}
+}
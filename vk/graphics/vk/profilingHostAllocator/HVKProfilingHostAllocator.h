@@ -0,0 +1,201 @@
+﻿#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vulkan\vulkan.h>
+
+namespace hinode
+{
+	namespace graphics
+	{
+		/// @brief ホスト側の割り当てを集計するVkAllocationCallbacksの実装
+		///
+		/// 割り当て自体は作成時に渡したコールバックに任せ、スコープと割り当てを要求したラッパーの種類ごとに
+		/// 回数、大きさ、ピーク、寿命を記録します。大きさと寿命は2の累乗ごとのヒストグラムでも記録します。
+		/// 回数とヒストグラムはスレッドごとに分けた区画に記録し、読み出すときに合計するので、
+		/// 複数のスレッドから割り当てても同じキャッシュラインを取り合いません。
+		/// 寿命の記録は割り当てと解放のたびに時刻を取るので、作成時に有効にしたときだけ行います。
+		///
+		/// ラッパーの種類はコールバックのpUserDataで区別するので、
+		/// 集計したいオブジェクトにはcallbacksPointer(OWNER)をsetCallbacksで設定してください
+		class HVKProfilingHostAllocator
+		{
+			HVKProfilingHostAllocator(const HVKProfilingHostAllocator&) = delete;
+			HVKProfilingHostAllocator& operator=(const HVKProfilingHostAllocator&) = delete;
+
+		public:
+			/// @brief 割り当てを要求したラッパーの種類
+			enum OWNER {
+				eOWNER_INSTANCE,
+				eOWNER_DEVICE,
+				eOWNER_SURFACE,
+				eOWNER_SWAPCHAIN,
+				eOWNER_COMMAND_POOL,
+				eOWNER_BUFFER,
+				eOWNER_IMAGE,
+				eOWNER_DEVICE_MEMORY,
+				eOWNER_DESCRIPTOR_POOL,
+				eOWNER_DESCRIPTOR_SET_LAYOUT,
+				eOWNER_PIPELINE_LAYOUT,
+				eOWNER_RENDER_PASS,
+				eOWNER_SEMAPHORE,
+				eOWNER_SHADER_MODULE,
+				eOWNER_OTHER,
+				eOWNER_COUNT,
+			};
+
+			static const uint32_t sScopeCount = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+			static const uint32_t sBucketCount = 32;
+
+			/// @brief 2の累乗ごとのヒストグラム. buckets[i]は[2^i, 2^(i+1))の数です
+			struct Histogram
+			{
+				uint64_t buckets[sBucketCount];
+
+				Histogram()noexcept;
+				Histogram& operator+=(const Histogram& right)noexcept;
+			};
+
+			/// @brief 集計結果
+			struct Counter
+			{
+				uint64_t allocationCount;	///< 割り当ての累計
+				uint64_t liveCount;			///< 解放されていない数
+				uint64_t liveBytes;			///< 解放されていない大きさの合計
+				uint64_t peakBytes;			///< liveBytesの最大値
+				uint64_t totalBytes;		///< 割り当てた大きさの累計
+				Histogram sizes;			///< 割り当ての大きさ(バイト)
+				Histogram lifetimes;		///< 解放されるまでの時間(マイクロ秒). 寿命を記録しないときは空です
+
+				Counter()noexcept;
+				/// @brief peakBytesは足しても全体のピークにならないので合計しません. 合計したものには別に記録したピークを設定してください
+				Counter& operator+=(const Counter& right)noexcept;
+			};
+
+			static const char* sOwnerName(OWNER owner)noexcept;
+			static const char* sScopeName(VkSystemAllocationScope scope)noexcept;
+
+		public:
+			/// @brief 作成
+			/// @param[in] pTarget 実際の割り当てを行うコールバック. nullptrならHVKHostAllocator::sGetBuiltin()を使います
+			/// @param[in] isRecordLifetime 寿命を記録するか. 割り当てと解放のたびに時刻を取ります
+			explicit HVKProfilingHostAllocator(const VkAllocationCallbacks* pTarget = nullptr, bool isRecordLifetime = false);
+			~HVKProfilingHostAllocator();
+
+			/// @brief ownerとして記録するコールバックを返す. このクラスと同じ寿命です
+			/// @param[in] owner
+			/// @retval VkAllocationCallbacks*
+			VkAllocationCallbacks* callbacksPointer(OWNER owner)noexcept;
+
+			/// @brief ピークを現在の使用量に戻す
+			void resetPeak()noexcept;
+
+			/// @brief 集計をJSONで出力する
+			///
+			/// 割り当てのないラッパーとスコープの組み合わせは省きます
+			/// @retval std::string
+			std::string toJson()const;
+
+		public:
+			Counter counter(OWNER owner, VkSystemAllocationScope scope)const noexcept;
+			/// @brief ownerのすべてのスコープを合計したもの. peakBytesはowner全体で記録したものです
+			Counter ownerCounter(OWNER owner)const noexcept;
+			/// @brief scopeのすべてのラッパーを合計したもの. peakBytesはscope全体で記録したものです
+			Counter scopeCounter(VkSystemAllocationScope scope)const noexcept;
+			/// @brief ドライバがpfnInternalAllocationで通知してきたもの. ヒストグラムと寿命は記録しません
+			Counter internalCounter(VkSystemAllocationScope scope)const noexcept;
+
+		private:
+			static const uint32_t sShardCount = 8;
+			static const size_t sCacheLineSize = 64;
+
+			/// @brief 回数とヒストグラム. 区画ごとに持ち、読み出すときに合計します
+			struct AtomicCounter
+			{
+				std::atomic<uint64_t> allocationCount;
+				std::atomic<int64_t> liveCount;		///< 他の区画で解放されると負になることがあります
+				std::atomic<uint64_t> totalBytes;
+				std::atomic<uint64_t> sizes[sBucketCount];
+				std::atomic<uint64_t> lifetimes[sBucketCount];
+
+				AtomicCounter()noexcept;
+				void recordAllocate(uint64_t size)noexcept;
+				void recordFree()noexcept;
+				void addTo(Counter& out)const noexcept;
+			};
+
+			/// @brief 解放されていない大きさとそのピーク. ピークは全体の値でないと意味がないので区画に分けません
+			struct AtomicLiveBytes
+			{
+				std::atomic<uint64_t> liveBytes;
+				std::atomic<uint64_t> peakBytes;
+				uint8_t padding[sCacheLineSize - sizeof(std::atomic<uint64_t>) * 2];	///< 隣と同じキャッシュラインを取り合わないようにする
+
+				AtomicLiveBytes()noexcept;
+				void recordAllocate(uint64_t size)noexcept;
+				void recordFree(uint64_t size)noexcept;
+				void resetPeak()noexcept;
+			};
+
+			struct Shard
+			{
+				uint8_t padding[sCacheLineSize];	///< 前の区画と同じキャッシュラインを取り合わないようにする
+				AtomicCounter counters[eOWNER_COUNT][sScopeCount];
+			};
+
+			struct Header
+			{
+				uint64_t size;
+				uint64_t timestamp;		///< 割り当てた時刻(マイクロ秒)
+				uint32_t offset;		///< 割り当て先の先頭からの距離
+				uint16_t owner;
+				uint16_t scope;
+			};
+
+			struct OwnerContext
+			{
+				HVKProfilingHostAllocator* pParent;
+				OWNER owner;
+			};
+
+			static const size_t sHeaderSize = (sizeof(Header) + 15) / 16 * 16;
+
+			static uint32_t sCalBucket(uint64_t value)noexcept;
+			static uint64_t sNow()noexcept;
+			/// @brief 呼び出したスレッドが記録する区画
+			static uint32_t sCurrentShard()noexcept;
+			static size_t sCalOffset(size_t alignment)noexcept;
+
+			void* allocate(OWNER owner, size_t size, size_t alignment, VkSystemAllocationScope scope)noexcept;
+			void* reallocate(OWNER owner, void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope scope)noexcept;
+			void free(void* pMemory)noexcept;
+			/// @brief 解放を記録して割り当て先に返す
+			/// @param[in] pMemory
+			/// @param[in] header pMemoryのヘッダの写し
+			/// @param[in] isRecordLifetime
+			void deallocate(void* pMemory, const Header& header, bool isRecordLifetime)noexcept;
+			/// @brief ownerとscopeの組み合わせ、owner全体、scope全体の解放されていない大きさを記録する
+			void recordLiveAllocate(uint32_t owner, uint32_t scope, uint64_t size)noexcept;
+			void recordLiveFree(uint32_t owner, uint32_t scope, uint64_t size)noexcept;
+
+			static VKAPI_ATTR void* VKAPI_CALL sAllocation(void* pUserData, size_t size, size_t alignment, VkSystemAllocationScope allocationScope);
+			static VKAPI_ATTR void* VKAPI_CALL sReallocation(void* pUserData, void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope allocationScope);
+			static VKAPI_ATTR void VKAPI_CALL sFree(void* pUserData, void* pMemory);
+			static VKAPI_ATTR void VKAPI_CALL sInternalAllocation(void* pUserData, size_t size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope);
+			static VKAPI_ATTR void VKAPI_CALL sInternalFree(void* pUserData, size_t size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope);
+
+		private:
+			VkAllocationCallbacks mTarget;
+			OwnerContext mContexts[eOWNER_COUNT];
+			VkAllocationCallbacks mCallbacks[eOWNER_COUNT];
+			bool mIsRecordLifetime;
+			std::unique_ptr<Shard[]> mShards;
+			AtomicLiveBytes mLiveBytes[eOWNER_COUNT][sScopeCount];
+			AtomicLiveBytes mOwnerLiveBytes[eOWNER_COUNT];	///< ピークは組み合わせごとのピークの和にならないので別に持つ
+			AtomicLiveBytes mScopeLiveBytes[sScopeCount];
+			AtomicCounter mInternalCounters[sScopeCount];
+			AtomicLiveBytes mInternalLiveBytes[sScopeCount];
+		};
+	}
+}
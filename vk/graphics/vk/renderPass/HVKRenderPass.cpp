@@ -163,6 +163,17 @@ namespace hinode
 			this->finalLayout = _finalLayout;
 			return *this;
 		}
+
+		HVKAttachmentDescription& HVKAttachmentDescription::setTransientOp(VkAttachmentLoadOp _loadOp)noexcept
+		{
+			//TRANSIENTȃC[W͓eǂݍ߂Ȃ̂ŁALOAD͎gȂ
+			assert(VK_ATTACHMENT_LOAD_OP_LOAD != _loadOp);
+			this->loadOp = _loadOp;
+			this->storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			this->stencilLoadOp = _loadOp;
+			this->stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			return *this;
+		}
 	}
 
 	namespace graphics
@@ -67,6 +67,13 @@ namespace hinode
 			HVKAttachmentDescription& setOp(VkAttachmentLoadOp loadOp, VkAttachmentStoreOp storeOp)noexcept;
 			HVKAttachmentDescription& setStencilOp(VkAttachmentLoadOp loadOp, VkAttachmentStoreOp storeOp)noexcept;
 			HVKAttachmentDescription& setLayout(VkImageLayout initialLayout, VkImageLayout finalLayout)noexcept;
+
+			/// @brief _[pX̊OɓecȂA^b`gɂ
+			///
+			/// [xƃXeV܂߂ăXgAIvVK_ATTACHMENT_STORE_OP_DONT_CAREɂ܂B
+			/// ^Cx[XGPUł̓ւ̏oȂAx蓖Ẵmۂꂸɍς݂܂
+			/// @param[in] loadOp [xƃXeV̗Ɏg܂
+			HVKAttachmentDescription& setTransientOp(VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR)noexcept;
 		};
 	}
 
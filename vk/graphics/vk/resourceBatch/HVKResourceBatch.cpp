@@ -0,0 +1,341 @@
+﻿#include "HVKResourceBatch.h"
+
+#include <algorithm>
+
+#include "../common/Common.h"
+#include "../memoryTypeResolver/HVKMemoryTypeResolver.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace
+		{
+			inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)noexcept
+			{
+				return (value + alignment - 1) / alignment * alignment;
+			}
+		}
+
+		const VkDeviceSize HVKResourceBatch::sHeapDivisor;
+
+		HVKResourceBatch::Placement::Placement()noexcept
+			: pMemory(nullptr)
+			, offset(0)
+			, size(0)
+			, pMappedData(nullptr)
+		{ }
+
+		HVKResourceBatch::HVKResourceBatch()
+			: mIsBuilt(false)
+		{ }
+
+		HVKResourceBatch::HVKResourceBatch(HVKResourceBatch&& right)noexcept
+			: HVKResourceBatch()
+		{
+			*this = std::move(right);
+		}
+
+		HVKResourceBatch& HVKResourceBatch::operator=(HVKResourceBatch&& right)noexcept
+		{
+			this->release();
+
+			//vectorのムーブでは要素が移動しないので、Placement::pMemoryはそのまま使える
+			this->mBufferInfos = std::move(right.mBufferInfos);
+			this->mImageInfos = std::move(right.mImageInfos);
+			this->mBufferEntries = std::move(right.mBufferEntries);
+			this->mImageEntries = std::move(right.mImageEntries);
+			this->mBuffers = std::move(right.mBuffers);
+			this->mImages = std::move(right.mImages);
+			this->mMemories = std::move(right.mMemories);
+			this->mIsBuilt = right.mIsBuilt;
+
+			right.mBuffers.clear();
+			right.mImages.clear();
+			right.mMemories.clear();
+			right.release();
+			return *this;
+		}
+
+		HVKResourceBatch::~HVKResourceBatch()
+		{
+			this->release();
+		}
+
+		void HVKResourceBatch::release()noexcept
+		{
+			//メモリより先にリソースを破棄する
+			this->mBuffers.clear();
+			this->mImages.clear();
+			this->mMemories.clear();
+			this->mBufferInfos.clear();
+			this->mImageInfos.clear();
+			this->mBufferEntries.clear();
+			this->mImageEntries.clear();
+			this->mIsBuilt = false;
+		}
+
+		HVKResourceBatch::BufferID HVKResourceBatch::addBuffer(const VkBufferCreateInfo& info, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags notPreferred)
+		{
+			assert(!this->mIsBuilt);
+
+			Entry entry;
+			entry.required = required;
+			entry.preferred = preferred;
+			entry.notPreferred = notPreferred;
+			entry.memoryTypeIndex = HVKMemoryTypeResolver::sInvalidIndex;
+			entry.isOptimal = false;
+			this->mBufferInfos.push_back(info);
+			this->mBufferEntries.push_back(entry);
+			return static_cast<BufferID>(this->mBufferInfos.size() - 1);
+		}
+
+		HVKResourceBatch::ImageID HVKResourceBatch::addImage(const VkImageCreateInfo& info, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags notPreferred)
+		{
+			assert(!this->mIsBuilt);
+
+			Entry entry;
+			entry.required = required;
+			entry.preferred = preferred;
+			entry.notPreferred = notPreferred;
+			entry.memoryTypeIndex = HVKMemoryTypeResolver::sInvalidIndex;
+			entry.isOptimal = VK_IMAGE_TILING_OPTIMAL == info.tiling;
+			this->mImageInfos.push_back(info);
+			this->mImageEntries.push_back(entry);
+			return static_cast<ImageID>(this->mImageInfos.size() - 1);
+		}
+
+		void HVKResourceBatch::build(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps, VkDeviceSize bufferImageGranularity, VkDeviceSize maxAllocationSize)
+		{
+			assert(!this->mIsBuilt);
+
+			try {
+				this->createResources(device);
+				this->planAndAllocate(device, memoryProps, std::max<VkDeviceSize>(1, bufferImageGranularity), 0 == maxAllocationSize ? UINT64_MAX : maxAllocationSize);
+				this->bindResources();
+			} catch (...) {
+				this->mBuffers.clear();
+				this->mImages.clear();
+				this->mMemories.clear();
+				throw;
+			}
+			this->mIsBuilt = true;
+		}
+
+		void HVKResourceBatch::createResources(VkDevice device)
+		{
+			//reserveしておけば要素は移動しないので、設定したコールバックが失われない
+			auto* pCallbacks = const_cast<VkAllocationCallbacks*>(this->allocationCallbacksPointer());
+			this->mBuffers.reserve(this->mBufferInfos.size());
+			for (auto i = 0u; i < this->mBufferInfos.size(); ++i) {
+				this->mBuffers.emplace_back();
+				auto& buffer = this->mBuffers.back();
+				buffer.setCallbacks(pCallbacks);
+				buffer.create(device, &this->mBufferInfos[i]);
+				this->mBufferEntries[i].requirements = buffer.getMemoryRequirements();
+			}
+
+			this->mImages.reserve(this->mImageInfos.size());
+			for (auto i = 0u; i < this->mImageInfos.size(); ++i) {
+				this->mImages.emplace_back();
+				auto& image = this->mImages.back();
+				image.setCallbacks(pCallbacks);
+				image.create(device, &this->mImageInfos[i]);
+				this->mImageEntries[i].requirements = image.getMemoryRequirements();
+			}
+		}
+
+		void HVKResourceBatch::planAndAllocate(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps, VkDeviceSize bufferImageGranularity, VkDeviceSize maxAllocationSize)
+		{
+			HVKMemoryTypeResolver resolver;
+			resolver.create(memoryProps);
+
+			std::vector<Entry*> packed[VK_MAX_MEMORY_TYPES];
+			auto resolve = [&](Entry& entry) {
+				auto& requirements = entry.requirements;
+				entry.memoryTypeIndex = resolver.find(requirements.memoryTypeBits, entry.required, entry.preferred, entry.notPreferred);
+				if (HVKMemoryTypeResolver::sInvalidIndex == entry.memoryTypeIndex) {
+					throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKResourceBatch, planAndAllocate, VK_ERROR_FEATURE_NOT_PRESENT)
+						<< "条件に合うメモリタイプが見つかりませんでした typeBits=" << requirements.memoryTypeBits << " required=" << entry.required;
+				}
+				entry.placement.size = requirements.size;
+				if (maxAllocationSize < requirements.size) {
+					throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKResourceBatch, planAndAllocate, VK_ERROR_OUT_OF_DEVICE_MEMORY)
+						<< "1回で確保できる大きさを超えています size=" << requirements.size << " max=" << maxAllocationSize;
+				}
+				if (!requirements.requiresDedicatedAllocation) {
+					packed[entry.memoryTypeIndex].push_back(&entry);
+				}
+			};
+			for (auto& entry : this->mBufferEntries) {
+				resolve(entry);
+			}
+			for (auto& entry : this->mImageEntries) {
+				resolve(entry);
+			}
+
+			for (auto typeIndex = 0u; typeIndex < VK_MAX_MEMORY_TYPES; ++typeIndex) {
+				auto& entries = packed[typeIndex];
+				if (entries.empty()) {
+					continue;
+				}
+
+				//リニアなものを前にまとめ、それぞれの中ではアライメントの大きい順に並べて隙間を減らす
+				std::stable_sort(entries.begin(), entries.end(), [](const Entry* pLeft, const Entry* pRight) {
+					if (pLeft->isOptimal != pRight->isOptimal) {
+						return !pLeft->isOptimal;
+					}
+					return pLeft->requirements.alignment > pRight->requirements.alignment;
+				});
+
+				//1つのブロックはヒープの一部と1回で確保できる大きさまでにして、ヒープを使い切らないようにする
+				auto heapSize = memoryProps.memoryHeaps[memoryProps.memoryTypes[typeIndex].heapIndex].size;
+				auto blockLimit = std::min(std::max<VkDeviceSize>(1, heapSize / sHeapDivisor), maxAllocationSize);
+
+				//収まらなくなったところでそれまでのものを1つのブロックとして確保する
+				auto blockBegin = entries.begin();
+				auto flushBlock = [&](std::vector<Entry*>::iterator blockEnd, VkDeviceSize blockSize) {
+					auto& memory = this->newMemory(device, memoryProps, blockSize, typeIndex, nullptr);
+					auto* pMapped = static_cast<uint8_t*>(memory.mappedPointer());
+					for (auto it = blockBegin; it != blockEnd; ++it) {
+						(*it)->placement.pMemory = &memory;
+						(*it)->placement.pMappedData = pMapped ? pMapped + (*it)->placement.offset : nullptr;
+					}
+					blockBegin = blockEnd;
+				};
+
+				VkDeviceSize cursor = 0;
+				auto isPrevOptimal = false;
+				for (auto it = entries.begin(); it != entries.end(); ++it) {
+					auto* pEntry = *it;
+					auto place = [&]() {
+						auto offset = cursor;
+						if (pEntry->isOptimal && !isPrevOptimal) {
+							offset = alignUp(offset, bufferImageGranularity);
+						}
+						return alignUp(offset, std::max<VkDeviceSize>(1, pEntry->requirements.alignment));
+					};
+					auto offset = place();
+					if (blockBegin != it && blockLimit < offset + pEntry->requirements.size) {
+						flushBlock(it, cursor);
+						cursor = 0;
+						isPrevOptimal = false;
+						offset = place();
+					}
+					isPrevOptimal = pEntry->isOptimal;
+					pEntry->placement.offset = offset;
+					cursor = offset + pEntry->requirements.size;
+				}
+				flushBlock(entries.end(), cursor);
+			}
+
+			auto allocateDedicated = [&](Entry& entry, VkBuffer buffer, VkImage image) {
+				VkMemoryDedicatedAllocateInfoKHR dedicatedInfo;
+				dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO_KHR;
+				dedicatedInfo.pNext = nullptr;
+				dedicatedInfo.buffer = buffer;
+				dedicatedInfo.image = image;
+				const void* pNext = entry.requirements.isDedicatedHintAvailable ? &dedicatedInfo : nullptr;
+
+				auto& memory = this->newMemory(device, memoryProps, entry.requirements.size, entry.memoryTypeIndex, pNext);
+				entry.placement.pMemory = &memory;
+				entry.placement.offset = 0;
+				entry.placement.pMappedData = memory.mappedPointer();
+			};
+			for (auto i = 0u; i < this->mBufferEntries.size(); ++i) {
+				if (this->mBufferEntries[i].requirements.requiresDedicatedAllocation) {
+					allocateDedicated(this->mBufferEntries[i], this->mBuffers[i].buffer(), VK_NULL_HANDLE);
+				}
+			}
+			for (auto i = 0u; i < this->mImageEntries.size(); ++i) {
+				if (this->mImageEntries[i].requirements.requiresDedicatedAllocation) {
+					allocateDedicated(this->mImageEntries[i], VK_NULL_HANDLE, this->mImages[i].image());
+				}
+			}
+		}
+
+		HVKDeviceMemory& HVKResourceBatch::newMemory(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps, VkDeviceSize size, uint32_t memoryTypeIndex, const void* pAllocateNext)
+		{
+			std::unique_ptr<HVKDeviceMemory> pMemory(new HVKDeviceMemory());
+			pMemory->setCallbacks(const_cast<VkAllocationCallbacks*>(this->allocationCallbacksPointer()));
+			HVKMemoryAllocateInfo allocInfo(size, memoryTypeIndex);
+			allocInfo.pNext = pAllocateNext;
+			//ホストから見えるメモリは確保したときにマップしておき、リソースごとのマップを不要にする
+			auto isHostVisible = 0 != (memoryProps.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			pMemory->create(device, &allocInfo, isHostVisible);
+			this->mMemories.push_back(std::move(pMemory));
+			return *this->mMemories.back();
+		}
+
+		void HVKResourceBatch::bindResources()
+		{
+			for (auto i = 0u; i < this->mBuffers.size(); ++i) {
+				auto& placement = this->mBufferEntries[i].placement;
+				auto ret = placement.pMemory->bindBuffer(this->mBuffers[i].buffer(), placement.offset);
+				if (VK_SUCCESS != ret) {
+					throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKResourceBatch, bindResources, ret) << "バッファとメモリの結びつけに失敗しました index=" << i;
+				}
+			}
+			for (auto i = 0u; i < this->mImages.size(); ++i) {
+				auto& placement = this->mImageEntries[i].placement;
+				auto ret = placement.pMemory->bindImage(this->mImages[i].image(), placement.offset);
+				if (VK_SUCCESS != ret) {
+					throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKResourceBatch, bindResources, ret) << "イメージとメモリの結びつけに失敗しました index=" << i;
+				}
+			}
+		}
+
+		bool HVKResourceBatch::isGood()const noexcept
+		{
+			return this->mIsBuilt;
+		}
+
+		size_t HVKResourceBatch::bufferCount()const noexcept
+		{
+			return this->mBufferInfos.size();
+		}
+
+		size_t HVKResourceBatch::imageCount()const noexcept
+		{
+			return this->mImageInfos.size();
+		}
+
+		HVKBuffer& HVKResourceBatch::buffer(BufferID id)noexcept
+		{
+			assert(this->isGood() && id < this->mBuffers.size());
+			return this->mBuffers[id];
+		}
+
+		HVKImage& HVKResourceBatch::image(ImageID id)noexcept
+		{
+			assert(this->isGood() && id < this->mImages.size());
+			return this->mImages[id];
+		}
+
+		const HVKResourceBatch::Placement& HVKResourceBatch::bufferPlacement(BufferID id)const noexcept
+		{
+			assert(this->isGood() && id < this->mBufferEntries.size());
+			return this->mBufferEntries[id].placement;
+		}
+
+		const HVKResourceBatch::Placement& HVKResourceBatch::imagePlacement(ImageID id)const noexcept
+		{
+			assert(this->isGood() && id < this->mImageEntries.size());
+			return this->mImageEntries[id].placement;
+		}
+
+		size_t HVKResourceBatch::memoryCount()const noexcept
+		{
+			return this->mMemories.size();
+		}
+
+		VkDeviceSize HVKResourceBatch::allocatedSize()const noexcept
+		{
+			VkDeviceSize result = 0;
+			for (auto& pMemory : this->mMemories) {
+				result += pMemory->size();
+			}
+			return result;
+		}
+	}
+}
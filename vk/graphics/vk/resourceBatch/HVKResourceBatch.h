@@ -0,0 +1,130 @@
+﻿#pragma once
+
+#include <vector>
+#include <memory>
+#include <vulkan\vulkan.h>
+
+#include "../HVKInterface.h"
+#include "../allocationCallbacks/HVKAllocationCallbacks.h"
+#include "../buffer/HVKBuffer.h"
+#include "../image/HVKImage.h"
+#include "../deviceMemory/HVKDeviceMemory.h"
+#include "../memoryRequirements/HVKMemoryRequirements.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		/// @brief 多数のバッファとイメージをまとめて作成し、メモリタイプごとに1回の確保で結びつけるクラス
+		///
+		/// addBuffer, addImageで作成情報を集めてからbuildを呼び出すと、
+		/// すべてのリソースの作成とメモリ要件の取得を行い、メモリタイプごとに詰めて配置したVkDeviceMemoryを確保して結びつけます。
+		/// 1つのVkDeviceMemoryはヒープの1/sHeapDivisorと1回で確保できる大きさまでにして、超える分は新しいVkDeviceMemoryに配置します。
+		/// バッファとVK_IMAGE_TILING_LINEARのイメージを前に、VK_IMAGE_TILING_OPTIMALのイメージを後ろにまとめるので、
+		/// bufferImageGranularityのための隙間はVkDeviceMemoryごとに1か所だけになります。
+		/// 専用メモリが必須のリソースだけは個別に確保します
+		class HVKResourceBatch : public IHVKInterface, public HVKAllocationCallbacks
+		{
+			HVKResourceBatch(const HVKResourceBatch&) = delete;
+			HVKResourceBatch& operator=(const HVKResourceBatch&) = delete;
+
+		public:
+			/// @brief 1つのVkDeviceMemoryの大きさの上限をヒープの大きさのこの値分の1にする. HVKDeviceMemoryHeapのブロックと同じです
+			static const VkDeviceSize sHeapDivisor = 8;
+
+			using BufferID = uint32_t;
+			using ImageID = uint32_t;
+
+			/// @brief リソースの配置先
+			struct Placement
+			{
+				HVKDeviceMemory* pMemory;
+				VkDeviceSize offset;
+				VkDeviceSize size;
+				void* pMappedData;	///< ホストから見えるメモリタイプならoffsetの位置を指すポインタ. それ以外はnullptr
+
+				Placement()noexcept;
+			};
+
+		public:
+			HVKResourceBatch();
+			HVKResourceBatch(HVKResourceBatch&& right)noexcept;
+			HVKResourceBatch& operator=(HVKResourceBatch&& right)noexcept;
+			~HVKResourceBatch();
+
+			void release()noexcept override;
+
+			/// @brief バッファの作成情報を追加する
+			///
+			/// pInfo->pQueueFamilyIndicesなどが指す先はbuildが終わるまで生存していること
+			/// @param[in] info
+			/// @param[in] required 必ず持っていなければならないフラグ
+			/// @param[in] preferred 持っていると望ましいフラグ
+			/// @param[in] notPreferred 持っていないほうが望ましいフラグ
+			/// @retval BufferID
+			BufferID addBuffer(const VkBufferCreateInfo& info, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0, VkMemoryPropertyFlags notPreferred = 0);
+
+			/// @brief イメージの作成情報を追加する
+			///
+			/// pInfo->pQueueFamilyIndicesなどが指す先はbuildが終わるまで生存していること
+			/// @param[in] info
+			/// @param[in] required
+			/// @param[in] preferred
+			/// @param[in] notPreferred
+			/// @retval ImageID
+			ImageID addImage(const VkImageCreateInfo& info, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0, VkMemoryPropertyFlags notPreferred = 0);
+
+			/// @brief 追加されたリソースをすべて作成し、メモリを確保して結びつける
+			///
+			/// 失敗したときは作成途中のリソースとメモリをすべて破棄します
+			/// @param[in] device
+			/// @param[in] memoryProps
+			/// @param[in] bufferImageGranularity VkPhysicalDeviceLimits::bufferImageGranularity
+			/// @param[in] maxAllocationSize 1回で確保できる大きさ. VkPhysicalDeviceMaintenance3Properties::maxMemoryAllocationSizeなど. 0なら制限しません
+			/// @exception HVKException 1つのリソースがmaxAllocationSizeを超えるときも投げます
+			void build(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps, VkDeviceSize bufferImageGranularity, VkDeviceSize maxAllocationSize = 0);
+
+		public:
+			bool isGood()const noexcept override;
+			size_t bufferCount()const noexcept;
+			size_t imageCount()const noexcept;
+			HVKBuffer& buffer(BufferID id)noexcept;
+			HVKImage& image(ImageID id)noexcept;
+			const Placement& bufferPlacement(BufferID id)const noexcept;
+			const Placement& imagePlacement(ImageID id)const noexcept;
+
+			/// @brief 確保したVkDeviceMemoryの数. 専用メモリを含みます
+			size_t memoryCount()const noexcept;
+
+			/// @brief 確保したVkDeviceMemoryの大きさの合計
+			VkDeviceSize allocatedSize()const noexcept;
+
+		private:
+			struct Entry
+			{
+				VkMemoryPropertyFlags required;
+				VkMemoryPropertyFlags preferred;
+				VkMemoryPropertyFlags notPreferred;
+				HVKMemoryRequirements requirements;
+				uint32_t memoryTypeIndex;
+				bool isOptimal;
+				Placement placement;
+			};
+
+			void createResources(VkDevice device);
+			void planAndAllocate(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps, VkDeviceSize bufferImageGranularity, VkDeviceSize maxAllocationSize);
+			HVKDeviceMemory& newMemory(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps, VkDeviceSize size, uint32_t memoryTypeIndex, const void* pAllocateNext);
+			void bindResources();
+
+		private:
+			std::vector<VkBufferCreateInfo> mBufferInfos;
+			std::vector<VkImageCreateInfo> mImageInfos;
+			std::vector<Entry> mBufferEntries;
+			std::vector<Entry> mImageEntries;
+			std::vector<HVKBuffer> mBuffers;
+			std::vector<HVKImage> mImages;
+			std::vector<std::unique_ptr<HVKDeviceMemory>> mMemories;
+			bool mIsBuilt;
+		};
+	}
+}
@@ -0,0 +1,674 @@
+﻿#include "HVKStagingUploader.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "../common/Common.h"
+#include "../memoryTypeResolver/HVKMemoryTypeResolver.h"
+#include "../image/HVKImage.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace
+		{
+			inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)noexcept
+			{
+				return (value + alignment - 1) / alignment * alignment;
+			}
+
+			inline VkDeviceSize lcm(VkDeviceSize a, VkDeviceSize b)noexcept
+			{
+				auto x = a;
+				auto y = b;
+				while (0 != y) {
+					auto t = x % y;
+					x = y;
+					y = t;
+				}
+				return a / x * b;
+			}
+		}
+
+		HVKStagingUploader::ImageUpload::ImageUpload()noexcept
+			: ImageUpload(VK_NULL_HANDLE, VK_FORMAT_UNDEFINED, VK_IMAGE_ASPECT_COLOR_BIT, 0, { 0, 0, 0 }, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+		{ }
+
+		HVKStagingUploader::ImageUpload::ImageUpload(VkImage image, VkFormat format, VkImageAspectFlags aspect, uint32_t mipLevel, VkExtent3D extent, VkImageLayout oldLayout, VkImageLayout newLayout)noexcept
+			: image(image)
+			, format(format)
+			, offset({ 0, 0, 0 })
+			, extent(extent)
+			, bufferRowLength(0)
+			, bufferImageHeight(0)
+			, oldLayout(oldLayout)
+			, newLayout(newLayout)
+			, srcStageMask(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT)
+			, srcAccessMask(0)
+			, pImage(nullptr)
+		{
+			this->subresource.aspectMask = aspect;
+			this->subresource.mipLevel = mipLevel;
+			this->subresource.baseArrayLayer = 0;
+			this->subresource.layerCount = 1;
+		}
+
+		HVKStagingUploader::HVKStagingUploader()
+			: mParentDevice(nullptr)
+			, mQueue(nullptr)
+			, mQueueFamilyIndex(0)
+			, mDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+			, mpMapped(nullptr)
+			, mCapacity(0)
+			, mHead(0)
+			, mTail(0)
+			, mImageAlignment(1)
+			, mNextSubmission(0)
+			, mOldestSubmission(0)
+			, mNextToken(1)
+			, mCompletedToken(0)
+		{ }
+
+		HVKStagingUploader::~HVKStagingUploader()
+		{
+			this->release();
+		}
+
+		void HVKStagingUploader::release()noexcept
+		{
+			for (auto& submission : this->mSubmissions) {
+				if (submission.isInFlight) {
+					vkWaitForFences(this->mParentDevice, 1, &submission.fence, VK_TRUE, UINT64_MAX);
+				}
+				if (VK_NULL_HANDLE != submission.fence) {
+					vkDestroyFence(this->mParentDevice, submission.fence, this->allocationCallbacksPointer());
+				}
+				if (VK_NULL_HANDLE != submission.semaphore) {
+					vkDestroySemaphore(this->mParentDevice, submission.semaphore, this->allocationCallbacksPointer());
+				}
+				submission.cmd.release();
+			}
+			this->mSubmissions.clear();
+			this->mCommandPool.release();
+			this->mMappedRanges.release();
+			this->mStagingBuffer.release();
+			this->mStagingMemory.release();
+			this->mBufferCopies.clear();
+			this->mImageCopies.clear();
+
+			this->mParentDevice = nullptr;
+			this->mQueue = nullptr;
+			this->mQueueFamilyIndex = 0;
+			this->mDstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			this->mpMapped = nullptr;
+			this->mCapacity = 0;
+			this->mHead = 0;
+			this->mTail = 0;
+			this->mNextSubmission = 0;
+			this->mOldestSubmission = 0;
+			this->mNextToken = 1;
+			this->mCompletedToken = 0;
+		}
+
+		void HVKStagingUploader::create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps, const VkPhysicalDeviceLimits& limits, VkQueue queue, uint32_t queueFamilyIndex, VkDeviceSize stagingSize, uint32_t submitCount, uint32_t dstQueueFamilyIndex)
+		{
+			assert(0 < stagingSize && 0 < submitCount);
+			this->release();
+
+			this->mParentDevice = device;
+			this->mQueue = queue;
+			this->mQueueFamilyIndex = queueFamilyIndex;
+			this->mDstQueueFamilyIndex = queueFamilyIndex != dstQueueFamilyIndex ? dstQueueFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+			this->mCapacity = stagingSize;
+			this->mImageAlignment = std::max<VkDeviceSize>(1, limits.optimalBufferCopyOffsetAlignment);
+
+			auto* pCallbacks = const_cast<VkAllocationCallbacks*>(this->allocationCallbacksPointer());
+			this->mStagingBuffer.setCallbacks(pCallbacks);
+			this->mStagingMemory.setCallbacks(pCallbacks);
+			this->mCommandPool.setCallbacks(pCallbacks);
+
+			try {
+				HVKBufferCreateInfo bufferInfo(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+				this->mStagingBuffer.create(device, &bufferInfo);
+
+				//ホストからは書き込むだけなので、キャッシュされないメモリで十分
+				auto requirements = this->mStagingBuffer.getMemoryRequirements();
+				HVKMemoryTypeResolver resolver;
+				resolver.create(memoryProps);
+				auto memoryTypeIndex = resolver.find(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, 0, VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+				if (HVKMemoryTypeResolver::sInvalidIndex == memoryTypeIndex) {
+					throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKStagingUploader, create, VK_ERROR_FEATURE_NOT_PRESENT) << "ホストから見えるメモリタイプが見つかりませんでした";
+				}
+				HVKMemoryAllocateInfo allocInfo(requirements.size, memoryTypeIndex);
+				this->mStagingMemory.create(device, &allocInfo, true);
+				auto bindResult = this->mStagingMemory.bindBuffer(this->mStagingBuffer);
+				if (VK_SUCCESS != bindResult) {
+					throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKStagingUploader, create, bindResult) << "ステージングバッファとメモリの結びつけに失敗しました";
+				}
+				this->mpMapped = static_cast<uint8_t*>(this->mStagingMemory.mappedPointer());
+				this->mMappedRanges.create(device, memoryProps, limits.nonCoherentAtomSize);
+
+				HVKCommandPoolCreateInfo poolInfo(queueFamilyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+				this->mCommandPool.create(device, &poolInfo);
+
+				this->mSubmissions.resize(submitCount);
+				for (auto& submission : this->mSubmissions) {
+					submission.fence = VK_NULL_HANDLE;
+					submission.token = 0;
+					submission.end = 0;
+					submission.isInFlight = false;
+					submission.semaphore = VK_NULL_HANDLE;
+					submission.isAcquirePending = false;
+
+					HVKCommandBufferAllocateInfo cmdInfo(this->mCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+					submission.cmd.create(device, &cmdInfo);
+
+					VkFenceCreateInfo fenceInfo;
+					fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+					fenceInfo.pNext = nullptr;
+					fenceInfo.flags = 0;
+					auto ret = vkCreateFence(device, &fenceInfo, this->allocationCallbacksPointer(), &submission.fence);
+					if (VK_SUCCESS != ret) {
+						throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKStagingUploader, create, ret) << "フェンスの作成に失敗しました";
+					}
+
+					if (this->isOwnershipTransfer()) {
+						VkSemaphoreCreateInfo semaphoreInfo;
+						semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+						semaphoreInfo.pNext = nullptr;
+						semaphoreInfo.flags = 0;
+						ret = vkCreateSemaphore(device, &semaphoreInfo, this->allocationCallbacksPointer(), &submission.semaphore);
+						if (VK_SUCCESS != ret) {
+							throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKStagingUploader, create, ret) << "セマフォの作成に失敗しました";
+						}
+					}
+				}
+			} catch (...) {
+				this->release();
+				throw;
+			}
+		}
+
+		HVKStagingUploader::Token HVKStagingUploader::uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* pData, VkDeviceSize size)
+		{
+			assert(this->isGood());
+			if (0 == size) {
+				return this->mNextToken;
+			}
+
+			//コピー元の位置に制限はないので、隣の転送とまとめやすいよう詰めて配置する
+			auto offset = this->writeStaging(pData, size, 1);
+
+			BufferCopy copy;
+			copy.dst = dst;
+			copy.region.srcOffset = offset;
+			copy.region.dstOffset = dstOffset;
+			copy.region.size = size;
+			this->mBufferCopies.push_back(copy);
+			return this->mNextToken;
+		}
+
+		HVKStagingUploader::Token HVKStagingUploader::uploadImage(const ImageUpload& upload, const void* pData, VkDeviceSize size)
+		{
+			assert(this->isGood());
+			assert(VK_IMAGE_LAYOUT_UNDEFINED != upload.newLayout && VK_IMAGE_LAYOUT_PREINITIALIZED != upload.newLayout);
+			if (0 == size) {
+				return this->mNextToken;
+			}
+
+			//bufferOffsetはテクセルブロックの大きさと4の倍数でなければならない
+			auto texelBlockSize = HVKImage::sFormatTexelBlockSize(upload.format);
+			assert(0 < texelBlockSize && "ImageUpload::formatに分かるフォーマットを指定してください");
+			auto alignment = lcm(lcm(0 < texelBlockSize ? texelBlockSize : 16, 4), this->mImageAlignment);
+			auto offset = this->writeStaging(pData, size, alignment);
+
+			ImageCopy copy;
+			copy.image = upload.image;
+			copy.pImage = upload.pImage;
+			copy.region.bufferOffset = offset;
+			copy.region.bufferRowLength = upload.bufferRowLength;
+			copy.region.bufferImageHeight = upload.bufferImageHeight;
+			copy.region.imageSubresource = upload.subresource;
+			copy.region.imageOffset = upload.offset;
+			copy.region.imageExtent = upload.extent;
+			copy.oldLayout = upload.oldLayout;
+			copy.newLayout = upload.newLayout;
+			copy.srcStageMask = upload.srcStageMask;
+			copy.srcAccessMask = upload.srcAccessMask;
+			this->mImageCopies.push_back(copy);
+			return this->mNextToken;
+		}
+
+		HVKStagingUploader::Token HVKStagingUploader::submit(VkSemaphore signalSemaphore)
+		{
+			assert(this->isGood());
+
+			if (this->mBufferCopies.empty() && this->mImageCopies.empty()) {
+				return this->mNextToken - 1;
+			}
+
+			auto& submission = this->mSubmissions[this->mNextSubmission];
+			if (submission.isAcquirePending) {
+				//待たれていないセマフォを再びシグナルすることはできない
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKStagingUploader, submit, VK_NOT_READY) << "所有権を取得していない転送が多すぎます。recordAcquireを呼んでください";
+			}
+			if (submission.isInFlight) {
+				//提出は順番に行っているので、これが最も古いものになる
+				auto ret = this->waitOldest(UINT64_MAX);
+				if (VK_SUCCESS != ret) {
+					throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKStagingUploader, submit, ret) << "以前の転送の完了を待てませんでした";
+				}
+			}
+
+			auto ret = vkResetFences(this->mParentDevice, 1, &submission.fence);
+			if (VK_SUCCESS != ret) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKStagingUploader, submit, ret) << "フェンスのリセットに失敗しました";
+			}
+
+			VkCommandBufferBeginInfo beginInfo;
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.pNext = nullptr;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			beginInfo.pInheritanceInfo = nullptr;
+			ret = vkBeginCommandBuffer(submission.cmd, &beginInfo);
+			if (VK_SUCCESS != ret) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKStagingUploader, submit, ret) << "コマンドの記録を開始できませんでした";
+			}
+			this->recordCommands(submission);
+			ret = vkEndCommandBuffer(submission.cmd);
+			if (VK_SUCCESS != ret) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKStagingUploader, submit, ret) << "コマンドの記録に失敗しました";
+			}
+
+			ret = this->mMappedRanges.flush();
+			if (VK_SUCCESS != ret) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKStagingUploader, submit, ret) << "ステージングバッファのフラッシュに失敗しました";
+			}
+
+			VkSubmitInfo submitInfo;
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.pNext = nullptr;
+			submitInfo.waitSemaphoreCount = 0;
+			submitInfo.pWaitSemaphores = nullptr;
+			submitInfo.pWaitDstStageMask = nullptr;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &submission.cmd.buffer();
+			VkSemaphore signalSemaphores[2];
+			submitInfo.signalSemaphoreCount = 0;
+			submitInfo.pSignalSemaphores = signalSemaphores;
+			if (this->isOwnershipTransfer()) {
+				signalSemaphores[submitInfo.signalSemaphoreCount++] = submission.semaphore;
+			}
+			if (VK_NULL_HANDLE != signalSemaphore) {
+				signalSemaphores[submitInfo.signalSemaphoreCount++] = signalSemaphore;
+			}
+			ret = vkQueueSubmit(this->mQueue, 1, &submitInfo, submission.fence);
+			if (VK_SUCCESS != ret) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKStagingUploader, submit, ret) << "転送の提出に失敗しました";
+			}
+
+			submission.token = this->mNextToken++;
+			submission.end = this->mHead;
+			submission.isInFlight = true;
+			submission.isAcquirePending = this->isOwnershipTransfer();
+			this->mNextSubmission = (this->mNextSubmission + 1) % static_cast<uint32_t>(this->mSubmissions.size());
+
+			this->mBufferCopies.clear();
+			this->mImageCopies.clear();
+			return submission.token;
+		}
+
+		bool HVKStagingUploader::isComplete(Token token)noexcept
+		{
+			assert(this->isGood());
+			this->reclaim();
+			return token <= this->mCompletedToken;
+		}
+
+		VkResult HVKStagingUploader::wait(Token token, uint64_t timeout)noexcept
+		{
+			assert(this->isGood());
+			assert(token < this->mNextToken);
+
+			this->reclaim();
+			while (this->mCompletedToken < token) {
+				auto ret = this->waitOldest(timeout);
+				if (VK_SUCCESS != ret) {
+					return ret;
+				}
+			}
+			return VK_SUCCESS;
+		}
+
+		uint32_t HVKStagingUploader::recordAcquire(VkCommandBuffer cmd, VkPipelineStageFlags dstStageMask, std::vector<VkSemaphore>* pOutWaitSemaphores, std::vector<VkPipelineStageFlags>* pOutWaitStages)
+		{
+			assert(this->isGood());
+			assert(nullptr != pOutWaitSemaphores && nullptr != pOutWaitStages);
+
+			if (!this->isOwnershipTransfer()) {
+				return 0;
+			}
+
+			std::vector<VkBufferMemoryBarrier> bufferBarriers;
+			std::vector<VkImageMemoryBarrier> imageBarriers;
+			uint32_t count = 0;
+			//mNextSubmissionから順に見ると古い提出から並ぶ
+			auto submitCount = static_cast<uint32_t>(this->mSubmissions.size());
+			for (auto i = 0u; i < submitCount; ++i) {
+				auto& submission = this->mSubmissions[(this->mNextSubmission + i) % submitCount];
+				if (!submission.isAcquirePending) {
+					continue;
+				}
+
+				//解放と取得のバリアはアクセスマスク以外を一致させる必要がある
+				for (auto barrier : submission.bufferBarriers) {
+					barrier.srcAccessMask = 0;
+					barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+					bufferBarriers.push_back(barrier);
+				}
+				for (auto barrier : submission.imageBarriers) {
+					barrier.srcAccessMask = 0;
+					barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+					imageBarriers.push_back(barrier);
+				}
+				pOutWaitSemaphores->push_back(submission.semaphore);
+				pOutWaitStages->push_back(dstStageMask);
+				submission.isAcquirePending = false;
+				++count;
+			}
+
+			if (!bufferBarriers.empty() || !imageBarriers.empty()) {
+				//セマフォの待機と依存関係をつなげるため、待機するステージから始める
+				vkCmdPipelineBarrier(cmd, dstStageMask, dstStageMask, 0,
+					0, nullptr,
+					static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+					static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+			}
+			return count;
+		}
+
+		VkDeviceSize HVKStagingUploader::writeStaging(const void* pData, VkDeviceSize size, VkDeviceSize alignment)
+		{
+			if (this->mCapacity < size) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKStagingUploader, writeStaging, VK_ERROR_OUT_OF_HOST_MEMORY)
+					<< "ステージングバッファより大きなデータは転送できません size=" << size << " capacity=" << this->mCapacity;
+			}
+
+			this->reclaim();
+			VkDeviceSize offset = 0;
+			while (!this->tryAllocate(size, alignment, &offset)) {
+				if (!this->mBufferCopies.empty() || !this->mImageCopies.empty()) {
+					//溜まっている転送を提出しないと領域が空かない
+					this->submit();
+				}
+				auto ret = this->waitOldest(UINT64_MAX);
+				if (VK_SUCCESS != ret) {
+					throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKStagingUploader, writeStaging, ret) << "ステージングバッファの空きを待てませんでした";
+				}
+			}
+
+			memcpy(this->mpMapped + offset, pData, static_cast<size_t>(size));
+			this->mMappedRanges.addFlush(this->mStagingMemory, offset, size);
+			return offset;
+		}
+
+		bool HVKStagingUploader::tryAllocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* pOutOffset)noexcept
+		{
+			if (this->isRingEmpty()) {
+				this->mHead = 0;
+				this->mTail = 0;
+			}
+
+			auto begin = alignUp(this->mHead, alignment);
+			if (this->isRingEmpty() || this->mTail < this->mHead) {
+				if (begin + size <= this->mCapacity) {
+					*pOutOffset = begin;
+					this->mHead = begin + size;
+					return true;
+				}
+				//終端に入らなければ先頭に戻る
+				if (size <= this->mTail) {
+					*pOutOffset = 0;
+					this->mHead = size;
+					return true;
+				}
+				return false;
+			}
+
+			//mHead == mTailで使用中ならすべて埋まっている
+			if (this->mHead < this->mTail && begin + size <= this->mTail) {
+				*pOutOffset = begin;
+				this->mHead = begin + size;
+				return true;
+			}
+			return false;
+		}
+
+		bool HVKStagingUploader::isRingEmpty()const noexcept
+		{
+			if (!this->mBufferCopies.empty() || !this->mImageCopies.empty()) {
+				return false;
+			}
+			for (auto& submission : this->mSubmissions) {
+				if (submission.isInFlight) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		void HVKStagingUploader::reclaim()noexcept
+		{
+			while (true) {
+				auto& submission = this->mSubmissions[this->mOldestSubmission];
+				if (!submission.isInFlight || VK_SUCCESS != vkGetFenceStatus(this->mParentDevice, submission.fence)) {
+					break;
+				}
+				this->mTail = submission.end;
+				this->mCompletedToken = submission.token;
+				submission.isInFlight = false;
+				this->mOldestSubmission = (this->mOldestSubmission + 1) % static_cast<uint32_t>(this->mSubmissions.size());
+			}
+		}
+
+		VkResult HVKStagingUploader::waitOldest(uint64_t timeout)noexcept
+		{
+			auto& submission = this->mSubmissions[this->mOldestSubmission];
+			if (!submission.isInFlight) {
+				return VK_SUCCESS;
+			}
+			auto ret = vkWaitForFences(this->mParentDevice, 1, &submission.fence, VK_TRUE, timeout);
+			if (VK_SUCCESS != ret) {
+				return ret;
+			}
+			this->reclaim();
+			return VK_SUCCESS;
+		}
+
+		void HVKStagingUploader::recordCommands(Submission& submission)
+		{
+			VkCommandBuffer cmd = submission.cmd.buffer();
+			auto isOwnershipTransfer = this->isOwnershipTransfer();
+			submission.bufferBarriers.clear();
+			submission.imageBarriers.clear();
+
+			//同じサブリソースへのレイアウト遷移は1回にまとめる
+			auto isSameSubresource = [](const ImageCopy& left, const ImageCopy& right) {
+				return left.image == right.image
+					&& left.region.imageSubresource.aspectMask == right.region.imageSubresource.aspectMask
+					&& left.region.imageSubresource.mipLevel == right.region.imageSubresource.mipLevel
+					&& left.region.imageSubresource.baseArrayLayer == right.region.imageSubresource.baseArrayLayer
+					&& left.region.imageSubresource.layerCount == right.region.imageSubresource.layerCount;
+			};
+			std::vector<VkImageMemoryBarrier> preBarriers;
+			std::vector<VkImageMemoryBarrier> postBarriers;
+			VkPipelineStageFlags preSrcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+			for (auto i = 0u; i < this->mImageCopies.size(); ++i) {
+				auto& copy = this->mImageCopies[i];
+				auto isDuplicate = false;
+				for (auto j = 0u; j < i && !isDuplicate; ++j) {
+					isDuplicate = isSameSubresource(this->mImageCopies[j], copy);
+				}
+				if (isDuplicate) {
+					continue;
+				}
+
+				VkImageMemoryBarrier barrier;
+				barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				barrier.pNext = nullptr;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.image = copy.image;
+				barrier.subresourceRange.aspectMask = copy.region.imageSubresource.aspectMask;
+				barrier.subresourceRange.baseMipLevel = copy.region.imageSubresource.mipLevel;
+				barrier.subresourceRange.levelCount = 1;
+				barrier.subresourceRange.baseArrayLayer = copy.region.imageSubresource.baseArrayLayer;
+				barrier.subresourceRange.layerCount = copy.region.imageSubresource.layerCount;
+
+				//直前の書き込みが終わるのを待ってからレイアウトを変える
+				barrier.srcAccessMask = copy.srcAccessMask;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.oldLayout = copy.oldLayout;
+				barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				preBarriers.push_back(barrier);
+				preSrcStageMask |= copy.srcStageMask;
+
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.newLayout = copy.newLayout;
+				if (isOwnershipTransfer) {
+					barrier.dstAccessMask = 0;
+					barrier.srcQueueFamilyIndex = this->mQueueFamilyIndex;
+					barrier.dstQueueFamilyIndex = this->mDstQueueFamilyIndex;
+				}
+				postBarriers.push_back(barrier);
+				if (nullptr != copy.pImage) {
+					//所有権を移譲するときもrecordAcquireで同じアクセスに可視にする
+					copy.pImage->setState(barrier.subresourceRange, copy.newLayout, VK_ACCESS_MEMORY_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+				}
+			}
+			if (!preBarriers.empty()) {
+				vkCmdPipelineBarrier(cmd, preSrcStageMask, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+					0, nullptr, 0, nullptr, static_cast<uint32_t>(preBarriers.size()), preBarriers.data());
+			}
+
+			//コピー先ごとに並べ、コピー元とコピー先の両方が連続しているものはまとめる
+			std::less<VkBuffer> lessBuffer;
+			std::stable_sort(this->mBufferCopies.begin(), this->mBufferCopies.end(), [&](const BufferCopy& left, const BufferCopy& right) {
+				if (left.dst != right.dst) {
+					return lessBuffer(left.dst, right.dst);
+				}
+				return left.region.dstOffset < right.region.dstOffset;
+			});
+			std::vector<VkBufferCopy> regions;
+			for (auto i = 0u; i < this->mBufferCopies.size(); ) {
+				auto dst = this->mBufferCopies[i].dst;
+				regions.clear();
+				regions.push_back(this->mBufferCopies[i].region);
+				for (++i; i < this->mBufferCopies.size() && dst == this->mBufferCopies[i].dst; ++i) {
+					auto& region = this->mBufferCopies[i].region;
+					auto& last = regions.back();
+					if (last.srcOffset + last.size == region.srcOffset && last.dstOffset + last.size == region.dstOffset) {
+						last.size += region.size;
+					} else {
+						regions.push_back(region);
+					}
+				}
+				vkCmdCopyBuffer(cmd, this->mStagingBuffer.buffer(), dst, static_cast<uint32_t>(regions.size()), regions.data());
+
+				if (isOwnershipTransfer) {
+					//取得側と範囲を一致させればよいので、バッファごとに書き込んだ範囲全体で1つにする
+					VkDeviceSize begin = regions.front().dstOffset;
+					VkDeviceSize end = regions.front().dstOffset + regions.front().size;
+					for (auto& region : regions) {
+						end = std::max(end, region.dstOffset + region.size);
+					}
+					VkBufferMemoryBarrier barrier;
+					barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+					barrier.pNext = nullptr;
+					barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+					barrier.dstAccessMask = 0;
+					barrier.srcQueueFamilyIndex = this->mQueueFamilyIndex;
+					barrier.dstQueueFamilyIndex = this->mDstQueueFamilyIndex;
+					barrier.buffer = dst;
+					barrier.offset = begin;
+					barrier.size = end - begin;
+					submission.bufferBarriers.push_back(barrier);
+				}
+			}
+
+			std::stable_sort(this->mImageCopies.begin(), this->mImageCopies.end(), [](const ImageCopy& left, const ImageCopy& right) {
+				return std::less<VkImage>()(left.image, right.image);
+			});
+			std::vector<VkBufferImageCopy> imageRegions;
+			for (auto i = 0u; i < this->mImageCopies.size(); ) {
+				auto image = this->mImageCopies[i].image;
+				imageRegions.clear();
+				for (; i < this->mImageCopies.size() && image == this->mImageCopies[i].image; ++i) {
+					imageRegions.push_back(this->mImageCopies[i].region);
+				}
+				vkCmdCopyBufferToImage(cmd, this->mStagingBuffer.buffer(), image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(imageRegions.size()), imageRegions.data());
+			}
+
+			if (isOwnershipTransfer) {
+				//所有権の解放. 可視性は取得側のバリアとセマフォで保証される
+				submission.imageBarriers = postBarriers;
+				vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+					0, nullptr,
+					static_cast<uint32_t>(submission.bufferBarriers.size()), submission.bufferBarriers.data(),
+					static_cast<uint32_t>(submission.imageBarriers.size()), submission.imageBarriers.data());
+				return;
+			}
+
+			VkMemoryBarrier memoryBarrier;
+			memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			memoryBarrier.pNext = nullptr;
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+				1, &memoryBarrier, 0, nullptr, static_cast<uint32_t>(postBarriers.size()), postBarriers.data());
+		}
+
+		bool HVKStagingUploader::isGood()const noexcept
+		{
+			return nullptr != this->mParentDevice && nullptr != this->mpMapped;
+		}
+
+		HVKStagingUploader::Token HVKStagingUploader::pendingToken()const noexcept
+		{
+			return this->mNextToken;
+		}
+
+		HVKStagingUploader::Token HVKStagingUploader::completedToken()const noexcept
+		{
+			return this->mCompletedToken;
+		}
+
+		VkDeviceSize HVKStagingUploader::stagingSize()const noexcept
+		{
+			return this->mCapacity;
+		}
+
+		size_t HVKStagingUploader::pendingCopyCount()const noexcept
+		{
+			return this->mBufferCopies.size() + this->mImageCopies.size();
+		}
+
+		uint32_t HVKStagingUploader::queueFamilyIndex()const noexcept
+		{
+			return this->mQueueFamilyIndex;
+		}
+
+		uint32_t HVKStagingUploader::dstQueueFamilyIndex()const noexcept
+		{
+			return VK_QUEUE_FAMILY_IGNORED != this->mDstQueueFamilyIndex ? this->mDstQueueFamilyIndex : this->mQueueFamilyIndex;
+		}
+
+		bool HVKStagingUploader::isOwnershipTransfer()const noexcept
+		{
+			return VK_QUEUE_FAMILY_IGNORED != this->mDstQueueFamilyIndex;
+		}
+	}
+}
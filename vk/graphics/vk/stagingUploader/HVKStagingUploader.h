@@ -0,0 +1,212 @@
+﻿#pragma once
+
+#include <vector>
+#include <vulkan\vulkan.h>
+
+#include "../HVKInterface.h"
+#include "../allocationCallbacks/HVKAllocationCallbacks.h"
+#include "../buffer/HVKBuffer.h"
+#include "../deviceMemory/HVKDeviceMemory.h"
+#include "../commandPool/HVKCommandPool.h"
+#include "../commandBuffer/HVKCommandBuffer.h"
+#include "../mappedRangeBatch/HVKMappedRangeBatch.h"
+#include "../image/HVKImage.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		/// @brief DEVICE_LOCALなバッファやイメージへの転送をまとめて行うクラス
+		///
+		/// 転送するデータは共有のステージングバッファにリングバッファとして詰めていき、
+		/// submitで1つのコマンドバッファにすべてのコピーを記録して1回だけ提出します。
+		/// 同じバッファへの連続した領域のコピーは1つにまとめます。
+		/// 完了は返されたTokenをisCompleteかwaitで調べてください。
+		///
+		/// イメージへのコピーはステージングバッファ上のオフセットを、テクセルブロックの大きさと4とoptimalBufferCopyOffsetAlignmentの最小公倍数に揃えます。
+		/// そのためImageUpload::formatにはイメージのフォーマットを指定してください。
+		///
+		/// 専用の転送キューで使うときは、createでリソースを使うキューのファミリーを指定してください。
+		/// 転送先の所有権を解放するバリアとセマフォのシグナルを提出時に記録するので、
+		/// 使う側のキューではrecordAcquireで所有権を取得し、返されたセマフォを待ってから使います。
+		/// 所有権の移譲中は転送前の内容が保証されないので、イメージの一部だけを書き換える転送には使えません。
+		/// また、専用の転送キューはminImageTransferGranularityの制限を持つことがあるので注意してください。
+		class HVKStagingUploader : public IHVKInterface, public HVKAllocationCallbacks
+		{
+			HVKStagingUploader(const HVKStagingUploader&) = delete;
+			HVKStagingUploader& operator=(const HVKStagingUploader&) = delete;
+
+		public:
+			/// @brief 転送の完了を調べるためのもの. submitごとに増えていきます
+			using Token = uint64_t;
+
+			/// @brief イメージへの転送の情報
+			struct ImageUpload
+			{
+				VkImage image;
+				VkFormat format;				///< imageのフォーマット. コピー元のオフセットを揃えるのに使います
+				VkImageSubresourceLayers subresource;
+				VkOffset3D offset;
+				VkExtent3D extent;
+				uint32_t bufferRowLength;		///< 0ならextent.widthで詰まっているものとします
+				uint32_t bufferImageHeight;		///< 0ならextent.heightで詰まっているものとします
+				VkImageLayout oldLayout;		///< 転送前のレイアウト. 内容を捨ててよいならVK_IMAGE_LAYOUT_UNDEFINED
+				VkImageLayout newLayout;		///< 転送後のレイアウト
+				VkPipelineStageFlags srcStageMask;	///< 転送前にイメージを使っていたステージ. 既定値はVK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
+				VkAccessFlags srcAccessMask;		///< 転送前のイメージへの書き込み. oldLayoutがVK_IMAGE_LAYOUT_UNDEFINEDでなく、直前に書き込んでいるなら指定してください
+				HVKImage* pImage;					///< imageのラッパー. 指定するとsubmitで転送後のバリアに合わせて状態を書き換えます. submitまで破棄しないでください
+
+				ImageUpload()noexcept;
+				ImageUpload(VkImage image, VkFormat format, VkImageAspectFlags aspect, uint32_t mipLevel, VkExtent3D extent, VkImageLayout oldLayout, VkImageLayout newLayout)noexcept;
+			};
+
+		public:
+			HVKStagingUploader();
+			~HVKStagingUploader();
+
+			/// @brief 破棄
+			///
+			/// 提出済みの転送が終わるまで待ちます
+			void release()noexcept override;
+
+			/// @brief 作成
+			/// @param[in] device
+			/// @param[in] memoryProps
+			/// @param[in] limits
+			/// @param[in] queue 転送を提出するキュー
+			/// @param[in] queueFamilyIndex queueのファミリー
+			/// @param[in] stagingSize ステージングバッファの大きさ
+			/// @param[in] submitCount 同時に提出しておける数
+			/// @param[in] dstQueueFamilyIndex 転送先のリソースを使うキューのファミリー. queueFamilyIndexと異なるときは所有権の移譲を行います
+			/// @exception HVKException
+			void create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProps, const VkPhysicalDeviceLimits& limits, VkQueue queue, uint32_t queueFamilyIndex, VkDeviceSize stagingSize, uint32_t submitCount = 2, uint32_t dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED);
+
+			/// @brief バッファへの転送を追加する
+			///
+			/// pDataの内容はこの関数の中でステージングバッファにコピーします。
+			/// ステージングバッファに空きがないときは、それまでの転送を提出したり、古い転送の完了を待ったりします
+			/// @param[in] dst
+			/// @param[in] dstOffset
+			/// @param[in] pData
+			/// @param[in] size
+			/// @retval Token
+			/// @exception HVKException
+			Token uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* pData, VkDeviceSize size);
+
+			/// @brief イメージへの転送を追加する
+			/// @param[in] upload
+			/// @param[in] pData
+			/// @param[in] size
+			/// @retval Token
+			/// @exception HVKException
+			Token uploadImage(const ImageUpload& upload, const void* pData, VkDeviceSize size);
+
+			/// @brief 追加された転送を1つのコマンドバッファに記録して提出する
+			///
+			/// 所有権を移譲するときは、同時に提出しておける数を超える前にrecordAcquireを呼んでください
+			/// @param[in] signalSemaphore 転送が終わったときにシグナルするセマフォ. 他のキューで使うときに指定してください
+			/// @retval Token 提出した転送のToken. 追加されたものがないときは直前に提出したもの
+			/// @exception HVKException
+			Token submit(VkSemaphore signalSemaphore = VK_NULL_HANDLE);
+
+			/// @brief 提出済みの転送先の所有権を取得するバリアを記録する
+			///
+			/// cmdは作成時に指定したdstQueueFamilyIndexのキューに提出するものを渡してください。
+			/// cmdを提出するときは、pOutWaitSemaphoresに追加されたセマフォをpOutWaitStagesのステージで待つ必要があります。
+			/// 所有権を移譲しないときは何もしません
+			/// @param[in] cmd
+			/// @param[in] dstStageMask 転送先を最初に使うステージ
+			/// @param[out] pOutWaitSemaphores
+			/// @param[out] pOutWaitStages
+			/// @retval uint32_t 所有権を取得した提出の数
+			uint32_t recordAcquire(VkCommandBuffer cmd, VkPipelineStageFlags dstStageMask, std::vector<VkSemaphore>* pOutWaitSemaphores, std::vector<VkPipelineStageFlags>* pOutWaitStages);
+
+			/// @brief tokenの転送が終わったか
+			/// @param[in] token
+			/// @retval bool
+			bool isComplete(Token token)noexcept;
+
+			/// @brief tokenの転送が終わるまで待つ
+			/// @param[in] token
+			/// @param[in] timeout
+			/// @retval VkResult
+			VkResult wait(Token token, uint64_t timeout = UINT64_MAX)noexcept;
+
+		public:
+			bool isGood()const noexcept override;
+
+			/// @brief 次のsubmitで提出される転送のToken
+			Token pendingToken()const noexcept;
+			Token completedToken()const noexcept;
+			VkDeviceSize stagingSize()const noexcept;
+			size_t pendingCopyCount()const noexcept;
+			uint32_t queueFamilyIndex()const noexcept;
+			uint32_t dstQueueFamilyIndex()const noexcept;
+			bool isOwnershipTransfer()const noexcept;
+
+		private:
+			struct BufferCopy
+			{
+				VkBuffer dst;
+				VkBufferCopy region;
+			};
+
+			struct ImageCopy
+			{
+				VkImage image;
+				HVKImage* pImage;
+				VkBufferImageCopy region;
+				VkImageLayout oldLayout;
+				VkImageLayout newLayout;
+				VkPipelineStageFlags srcStageMask;
+				VkAccessFlags srcAccessMask;
+			};
+
+			struct Submission
+			{
+				HVKCommandBuffer cmd;
+				VkFence fence;
+				Token token;
+				VkDeviceSize end;	///< 提出したときのステージングバッファの書き込み位置
+				bool isInFlight;
+
+				VkSemaphore semaphore;	///< 所有権の移譲で使う側のキューに待たせるもの
+				std::vector<VkBufferMemoryBarrier> bufferBarriers;	///< 所有権を解放したバッファ
+				std::vector<VkImageMemoryBarrier> imageBarriers;	///< 所有権を解放したイメージ
+				bool isAcquirePending;
+			};
+
+			/// @brief ステージングバッファから領域を確保し、pDataをコピーする
+			VkDeviceSize writeStaging(const void* pData, VkDeviceSize size, VkDeviceSize alignment);
+			bool tryAllocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* pOutOffset)noexcept;
+			bool isRingEmpty()const noexcept;
+			void reclaim()noexcept;
+			VkResult waitOldest(uint64_t timeout)noexcept;
+			void recordCommands(Submission& submission);
+
+		private:
+			VkDevice mParentDevice;
+			VkQueue mQueue;
+			uint32_t mQueueFamilyIndex;
+			uint32_t mDstQueueFamilyIndex;
+			HVKBuffer mStagingBuffer;
+			HVKDeviceMemory mStagingMemory;
+			HVKMappedRangeBatch mMappedRanges;
+			uint8_t* mpMapped;
+			VkDeviceSize mCapacity;
+			VkDeviceSize mHead;
+			VkDeviceSize mTail;
+			VkDeviceSize mImageAlignment;	///< optimalBufferCopyOffsetAlignment
+
+			HVKCommandPool mCommandPool;
+			std::vector<Submission> mSubmissions;
+			uint32_t mNextSubmission;
+			uint32_t mOldestSubmission;
+			Token mNextToken;
+			Token mCompletedToken;
+
+			std::vector<BufferCopy> mBufferCopies;
+			std::vector<ImageCopy> mImageCopies;
+		};
+	}
+}
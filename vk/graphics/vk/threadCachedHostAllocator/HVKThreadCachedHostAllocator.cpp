@@ -0,0 +1,149 @@
+﻿#include "HVKThreadCachedHostAllocator.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+namespace hinode
+{
+	namespace graphics
+	{
+		HVKThreadCachedHostAllocator::Cache::Cache()
+			: arenaAllocationCount(0)
+			, pRemoteFrees(nullptr)
+		{ }
+
+		HVKThreadCachedHostAllocator::HVKThreadCachedHostAllocator()
+			: mID(utility::HostThreadCacheTable::sIssueID())
+			, mCallbacks(Header::sMakeCallbacks(this))
+			, mRemoteFreeCount(0)
+		{ }
+
+		HVKThreadCachedHostAllocator::~HVKThreadCachedHostAllocator()
+		{
+			std::lock_guard<std::mutex> lock(this->mCachesMutex);
+			this->mCaches.clear();
+		}
+
+		VkAllocationCallbacks HVKThreadCachedHostAllocator::callbacks()noexcept
+		{
+			return this->mCallbacks;
+		}
+
+		VkAllocationCallbacks* HVKThreadCachedHostAllocator::callbacksPointer()noexcept
+		{
+			return &this->mCallbacks;
+		}
+
+		void* HVKThreadCachedHostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)noexcept
+		{
+			assert(0 == (alignment & (alignment - 1)));
+			if (0 == size || UINT32_MAX < size) {
+				return nullptr;
+			}
+
+			alignment = std::max(alignment, Header::sMinAlignment);
+			//他のスレッドから解放されたときにRemoteNodeを書き込めるようにする
+			auto requiredSize = Header::sCalRequiredSize(std::max(size, sizeof(RemoteNode)), alignment);
+
+			auto isCached = VK_SYSTEM_ALLOCATION_SCOPE_COMMAND == scope || VK_SYSTEM_ALLOCATION_SCOPE_OBJECT == scope;
+			auto* pCache = isCached ? this->getThreadCache() : nullptr;
+			if (nullptr != pCache) {
+				if (VK_SYSTEM_ALLOCATION_SCOPE_COMMAND == scope) {
+					//減らすのは他のスレッドでも、巻き戻すのは所有するスレッドだけなので競合しない
+					if (0 == pCache->arenaAllocationCount.load(std::memory_order_acquire)) {
+						pCache->arena.reset();
+					}
+					auto* pBase = pCache->arena.allocate(requiredSize, Header::sMinAlignment);
+					if (nullptr == pBase) {
+						return nullptr;
+					}
+					pCache->arenaAllocationCount.fetch_add(1, std::memory_order_relaxed);
+					return Header::sPlace(pBase, pCache, size, alignment, Header::eORIGIN_ARENA, 0);
+				}
+
+				auto classIndex = utility::SizeClassPool::sCalClassIndex(requiredSize);
+				if (classIndex < utility::SizeClassPool::sClassCount) {
+					if (nullptr != pCache->pRemoteFrees.load(std::memory_order_relaxed)) {
+						this->drainRemoteFrees(pCache);
+					}
+					auto* pBase = pCache->pool.allocate(classIndex);
+					if (nullptr == pBase) {
+						return nullptr;
+					}
+					return Header::sPlace(pBase, pCache, size, alignment, Header::eORIGIN_POOL, static_cast<uint16_t>(classIndex));
+				}
+			}
+
+			auto* pBase = std::malloc(requiredSize + Header::sMinAlignment - 1);
+			if (nullptr == pBase) {
+				return nullptr;
+			}
+			return Header::sPlace(pBase, nullptr, size, alignment, Header::eORIGIN_SYSTEM, 0);
+		}
+
+		void* HVKThreadCachedHostAllocator::reallocate(void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope scope)noexcept
+		{
+			return Header::sReallocate(*this, pOriginal, size, alignment, scope);
+		}
+
+		void HVKThreadCachedHostAllocator::free(void* pMemory)noexcept
+		{
+			if (nullptr == pMemory) {
+				return;
+			}
+
+			auto header = *Header::sGet(pMemory);
+			auto* pOwner = static_cast<Cache*>(header.pOwner);
+			switch (header.origin) {
+			case Header::eORIGIN_ARENA:
+				pOwner->arenaAllocationCount.fetch_sub(1, std::memory_order_release);
+				break;
+			case Header::eORIGIN_POOL:
+				if (pOwner == utility::HostThreadCacheTable::sFind(this->mID)) {
+					pOwner->pool.free(header.pBase, header.classIndex);
+				} else {
+					//所有するスレッドのリストの先頭に積むだけ. 取り出しは所有するスレッドがまとめて行うのでABAは起きない
+					auto* pNode = static_cast<RemoteNode*>(pMemory);
+					auto* pHead = pOwner->pRemoteFrees.load(std::memory_order_relaxed);
+					do {
+						pNode->pNext = pHead;
+					} while (!pOwner->pRemoteFrees.compare_exchange_weak(pHead, pNode, std::memory_order_release, std::memory_order_relaxed));
+					this->mRemoteFreeCount.fetch_add(1, std::memory_order_relaxed);
+				}
+				break;
+			default:
+				std::free(header.pBase);
+				break;
+			}
+		}
+
+		size_t HVKThreadCachedHostAllocator::cacheCount()noexcept
+		{
+			std::lock_guard<std::mutex> lock(this->mCachesMutex);
+			return this->mCaches.size();
+		}
+
+		uint64_t HVKThreadCachedHostAllocator::remoteFreeCount()const noexcept
+		{
+			return this->mRemoteFreeCount.load(std::memory_order_relaxed);
+		}
+
+		HVKThreadCachedHostAllocator::Cache* HVKThreadCachedHostAllocator::getThreadCache()noexcept
+		{
+			return utility::HostThreadCacheTable::sGetOrCreate(this->mID, this->mCachesMutex, this->mCaches);
+		}
+
+		void HVKThreadCachedHostAllocator::drainRemoteFrees(Cache* pCache)noexcept
+		{
+			auto* pNode = pCache->pRemoteFrees.exchange(nullptr, std::memory_order_acquire);
+			while (nullptr != pNode) {
+				auto* pNext = pNode->pNext;
+				auto* pHeader = Header::sGet(pNode);
+				pCache->pool.free(pHeader->pBase, pHeader->classIndex);
+				pNode = pNext;
+			}
+		}
+	}
+}
@@ -0,0 +1,102 @@
+﻿#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <vulkan\vulkan.h>
+
+#include "../utility/SizeClassPool/SizeClassPool.h"
+#include "../utility/BumpArena/BumpArena.h"
+#include "../utility/HostAllocatorCommon/HostAllocatorCommon.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		/// @brief スレッドごとにキャッシュを持つVkAllocationCallbacksの実装
+		///
+		/// 割り当てたスレッドごとにプールとアリーナを持つので、複数のスレッドから同時にリソースを作成してもロックを取り合いません。
+		/// スコープによる割り当て先の切り替えはHVKHostAllocatorと同じです。
+		/// 他のスレッドが割り当てたものを解放したときは、所有するスレッドのリストにロックなしで積み、
+		/// 所有するスレッドが次にプールから割り当てるときにまとめて回収します。
+		///
+		/// キャッシュは終了したスレッドの分もこのクラスを破棄するまで残るので、スレッドプールのように同じスレッドを使い続ける用途に向いています。
+		/// setCallbacksにcallbacksPointer()を渡すと、そのオブジェクトだけで使えます
+		class HVKThreadCachedHostAllocator
+		{
+			HVKThreadCachedHostAllocator(const HVKThreadCachedHostAllocator&) = delete;
+			HVKThreadCachedHostAllocator& operator=(const HVKThreadCachedHostAllocator&) = delete;
+
+		public:
+			HVKThreadCachedHostAllocator();
+			~HVKThreadCachedHostAllocator();
+
+			/// @brief このアロケータを呼び出すVkAllocationCallbacksを返す
+			/// @retval VkAllocationCallbacks
+			VkAllocationCallbacks callbacks()noexcept;
+
+			/// @brief HVKAllocationCallbacks::setCallbacksに渡すためのもの. このクラスと同じ寿命です
+			/// @retval VkAllocationCallbacks*
+			VkAllocationCallbacks* callbacksPointer()noexcept;
+
+			/// @brief 割り当て
+			/// @param[in] size
+			/// @param[in] alignment 2の累乗であること
+			/// @param[in] scope
+			/// @retval void* 失敗したときはnullptr
+			void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)noexcept;
+
+			/// @brief 再割り当て
+			/// @param[in] pOriginal nullptrならallocateと同じです
+			/// @param[in] size 0ならfreeと同じです
+			/// @param[in] alignment
+			/// @param[in] scope
+			/// @retval void* 失敗したときはnullptrを返し、pOriginalはそのまま残ります
+			void* reallocate(void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope scope)noexcept;
+
+			/// @brief 解放. どのスレッドから呼んでもかまいません
+			/// @param[in] pMemory
+			void free(void* pMemory)noexcept;
+
+		public:
+			/// @brief これまでにキャッシュを作ったスレッドの数
+			size_t cacheCount()noexcept;
+			/// @brief 他のスレッドから解放された数の累計
+			uint64_t remoteFreeCount()const noexcept;
+
+		private:
+			/// @brief pOwnerは割り当てたスレッドのCache. mallocのときはnullptr
+			using Header = utility::HostAllocationHeader;
+
+			/// @brief 他のスレッドから解放されたものをつなぐノード. 割り当てた領域の先頭に書き込みます
+			struct RemoteNode
+			{
+				RemoteNode* pNext;
+			};
+
+			struct Cache
+			{
+				utility::SizeClassPool pool;
+				utility::BumpArena arena;
+				std::atomic<size_t> arenaAllocationCount;
+				std::atomic<RemoteNode*> pRemoteFrees;
+
+				Cache();
+			};
+
+			/// @brief 呼び出したスレッドのキャッシュを返す. なければ作ります
+			Cache* getThreadCache()noexcept;
+			/// @brief 他のスレッドから解放されたものをプールに戻す. 所有するスレッドからのみ呼べます
+			void drainRemoteFrees(Cache* pCache)noexcept;
+
+		private:
+			uint64_t mID;	///< thread_localの対応表で使う. 再利用されません
+			VkAllocationCallbacks mCallbacks;
+
+			std::mutex mCachesMutex;
+			std::vector<std::unique_ptr<Cache>> mCaches;
+			std::atomic<uint64_t> mRemoteFreeCount;
+		};
+	}
+}
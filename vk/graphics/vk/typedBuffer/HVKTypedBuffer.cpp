@@ -0,0 +1,154 @@
+﻿#include "HVKTypedBuffer.h"
+
+#include <cstring>
+
+#include "../common/Common.h"
+#include "../mappedRangeBatch/HVKMappedRangeBatch.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		HVKTypedBufferBase::HVKTypedBufferBase()
+			: mpHeap(nullptr)
+			, mByteSize(0)
+			, mUsage(0)
+			, mRequired(0)
+			, mPreferred(0)
+			, mNotPreferred(0)
+		{ }
+
+		HVKTypedBufferBase::HVKTypedBufferBase(HVKTypedBufferBase&& right)noexcept
+			: HVKTypedBufferBase()
+		{
+			*this = std::move(right);
+		}
+
+		HVKTypedBufferBase& HVKTypedBufferBase::operator=(HVKTypedBufferBase&& right)noexcept
+		{
+			this->release();
+
+			this->mpHeap = right.mpHeap;
+			this->mpBuffer = std::move(right.mpBuffer);
+			this->mAllocation = right.mAllocation;
+			this->mByteSize = right.mByteSize;
+			this->mUsage = right.mUsage;
+			this->mRequired = right.mRequired;
+			this->mPreferred = right.mPreferred;
+			this->mNotPreferred = right.mNotPreferred;
+
+			right.mpHeap = nullptr;
+			right.mAllocation = HVKMemoryAllocation();
+			right.release();
+			return *this;
+		}
+
+		HVKTypedBufferBase::~HVKTypedBufferBase()
+		{
+			this->release();
+		}
+
+		void HVKTypedBufferBase::release()noexcept
+		{
+			//メモリより先にバッファを破棄する
+			this->mpBuffer.reset();
+			if (this->mpHeap) {
+				this->mpHeap->free(this->mAllocation);
+			}
+			this->mAllocation = HVKMemoryAllocation();
+			this->mpHeap = nullptr;
+			this->mByteSize = 0;
+			this->mUsage = 0;
+			this->mRequired = 0;
+			this->mPreferred = 0;
+			this->mNotPreferred = 0;
+		}
+
+		void HVKTypedBufferBase::createBytes(HVKDeviceMemoryHeap& heap, VkDeviceSize byteSize, VkBufferUsageFlags usage, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags notPreferred)
+		{
+			assert(heap.isGood());
+			assert(0 < byteSize);
+
+			this->release();
+			this->mpHeap = &heap;
+			this->mUsage = usage;
+			this->mRequired = required;
+			this->mPreferred = preferred;
+			this->mNotPreferred = notPreferred;
+			try {
+				this->resizeBytes(byteSize, 0);
+			} catch (...) {
+				this->release();
+				throw;
+			}
+		}
+
+		void HVKTypedBufferBase::resizeBytes(VkDeviceSize byteSize, VkDeviceSize keepBytes)
+		{
+			assert(nullptr != this->mpHeap);
+			assert(0 < byteSize);
+
+			std::unique_ptr<HVKBuffer> pBuffer(new HVKBuffer());
+			pBuffer->setCallbacks(const_cast<VkAllocationCallbacks*>(this->allocationCallbacksPointer()));
+			HVKBufferCreateInfo bufferInfo(byteSize, this->mUsage);
+			pBuffer->create(this->mpHeap->device(), &bufferInfo);
+
+			auto allocation = this->mpHeap->allocateForBuffer(*pBuffer, this->mRequired, this->mPreferred, this->mNotPreferred);
+			auto result = allocation.bindBuffer(pBuffer->buffer());
+			if (VK_SUCCESS != result) {
+				pBuffer.reset();
+				this->mpHeap->free(allocation);
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(HVKTypedBufferBase, resizeBytes, result) << "バッファとメモリの結びつけに失敗しました";
+			}
+
+			//マップされたままなので、古い内容は割り当て同士で直接コピーできる
+			keepBytes = std::min(keepBytes, std::min(byteSize, this->mByteSize));
+			if (0 < keepBytes && allocation.pMappedData && this->mAllocation.pMappedData) {
+				memcpy(allocation.pMappedData, this->mAllocation.pMappedData, static_cast<size_t>(keepBytes));
+			}
+
+			this->mpBuffer = std::move(pBuffer);
+			this->mpHeap->free(this->mAllocation);
+			this->mAllocation = allocation;
+			this->mByteSize = byteSize;
+		}
+
+		void HVKTypedBufferBase::addFlushBytes(HVKMappedRangeBatch& batch, VkDeviceSize byteOffset, VkDeviceSize byteSize)const noexcept
+		{
+			assert(this->isGood());
+			if (0 < byteSize) {
+				batch.addFlush(this->mAllocation, byteOffset, byteSize);
+			}
+		}
+
+		bool HVKTypedBufferBase::isGood()const noexcept
+		{
+			return nullptr != this->mpBuffer && this->mAllocation.isGood();
+		}
+
+		bool HVKTypedBufferBase::isHostVisible()const noexcept
+		{
+			return nullptr != this->mAllocation.pMappedData;
+		}
+
+		VkBuffer HVKTypedBufferBase::buffer()noexcept
+		{
+			return this->mpBuffer ? this->mpBuffer->buffer() : VK_NULL_HANDLE;
+		}
+
+		VkDeviceSize HVKTypedBufferBase::byteSize()const noexcept
+		{
+			return this->mByteSize;
+		}
+
+		const HVKMemoryAllocation& HVKTypedBufferBase::allocation()const noexcept
+		{
+			return this->mAllocation;
+		}
+
+		void* HVKTypedBufferBase::mappedData()const noexcept
+		{
+			return this->mAllocation.pMappedData;
+		}
+	}
+}
@@ -0,0 +1,242 @@
+﻿#pragma once
+
+#include <memory>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <cassert>
+#include <vulkan\vulkan.h>
+
+#include "../HVKInterface.h"
+#include "../allocationCallbacks/HVKAllocationCallbacks.h"
+#include "../buffer/HVKBuffer.h"
+#include "../deviceMemoryHeap/HVKDeviceMemoryHeap.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		class HVKMappedRangeBatch;
+
+		/// @brief マップされたメモリを指すstd::span相当のビュー
+		///
+		/// 所有権は持たないので、元のHVKTypedBufferが作り直されたり解放されたりすると無効になります
+		template<typename T>
+		class HVKMappedSpan
+		{
+		public:
+			using element_type = T;
+			using value_type = typename std::remove_cv<T>::type;
+			using iterator = T*;
+
+			HVKMappedSpan()noexcept : mpData(nullptr), mCount(0) {}
+			HVKMappedSpan(T* pData, size_t count)noexcept : mpData(pData), mCount(count) {}
+
+			/// @brief 一部分を取り出す
+			/// @param[in] offset
+			/// @param[in] count offsetからの要素数. 範囲外は切り詰めます
+			/// @retval HVKMappedSpan
+			HVKMappedSpan subspan(size_t offset, size_t count = static_cast<size_t>(-1))const noexcept
+			{
+				assert(offset <= this->mCount);
+				return HVKMappedSpan(this->mpData + offset, std::min(count, this->mCount - offset));
+			}
+
+			T& operator[](size_t index)const noexcept
+			{
+				assert(index < this->mCount);
+				return this->mpData[index];
+			}
+
+			T* data()const noexcept { return this->mpData; }
+			size_t size()const noexcept { return this->mCount; }
+			size_t size_bytes()const noexcept { return this->mCount * sizeof(T); }
+			bool empty()const noexcept { return 0 == this->mCount; }
+			iterator begin()const noexcept { return this->mpData; }
+			iterator end()const noexcept { return this->mpData + this->mCount; }
+
+		private:
+			T* mpData;
+			size_t mCount;
+		};
+	}
+
+	namespace graphics
+	{
+		/// @brief HVKTypedBufferの型に依存しない部分
+		///
+		/// VkBufferとHVKDeviceMemoryHeapからの割り当てをまとめて持ち、作成からbindBufferまでを行います。
+		/// ホストから見えるメモリタイプのときは割り当て先のブロックが常にマップされているので、mappedData()に直接書き込めます
+		class HVKTypedBufferBase : public IHVKInterface, public HVKAllocationCallbacks
+		{
+			HVKTypedBufferBase(const HVKTypedBufferBase&) = delete;
+			HVKTypedBufferBase& operator=(const HVKTypedBufferBase&) = delete;
+
+		public:
+			HVKTypedBufferBase();
+			HVKTypedBufferBase(HVKTypedBufferBase&& right)noexcept;
+			HVKTypedBufferBase& operator=(HVKTypedBufferBase&& right)noexcept;
+			~HVKTypedBufferBase();
+
+			void release()noexcept override;
+
+			/// @brief 作成
+			/// @param[in] heap 解放するまで生存していること
+			/// @param[in] byteSize 0より大きいこと
+			/// @param[in] usage
+			/// @param[in] required 必ず持っていなければならないフラグ
+			/// @param[in] preferred 持っていると望ましいフラグ
+			/// @param[in] notPreferred 持っていないほうが望ましいフラグ
+			/// @exception HVKException
+			void createBytes(HVKDeviceMemoryHeap& heap, VkDeviceSize byteSize, VkBufferUsageFlags usage, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags notPreferred);
+
+			/// @brief 大きさを変える
+			///
+			/// 新しいVkBufferと割り当てを作り、ホストから見えるときはkeepBytesまでの内容をコピーしてから古いものを解放します。
+			/// 古いVkBufferはすぐに破棄されるので、GPUが使い終わってから呼び出してください。
+			/// 失敗したときは元の状態のままです
+			/// @param[in] byteSize
+			/// @param[in] keepBytes 引き継ぐ内容の大きさ
+			/// @exception HVKException
+			void resizeBytes(VkDeviceSize byteSize, VkDeviceSize keepBytes);
+
+			/// @brief 書き込んだ範囲をフラッシュ対象に追加する. HOST_COHERENTならbatch側で無視されます
+			/// @param[in] batch
+			/// @param[in] byteOffset
+			/// @param[in] byteSize
+			void addFlushBytes(HVKMappedRangeBatch& batch, VkDeviceSize byteOffset, VkDeviceSize byteSize)const noexcept;
+
+		public:
+			bool isGood()const noexcept override;
+			bool isHostVisible()const noexcept;
+			VkBuffer buffer()noexcept;
+			operator VkBuffer()noexcept { return this->buffer(); }
+			VkDeviceSize byteSize()const noexcept;
+			const HVKMemoryAllocation& allocation()const noexcept;
+			void* mappedData()const noexcept;
+
+		private:
+			HVKDeviceMemoryHeap* mpHeap;
+			std::unique_ptr<HVKBuffer> mpBuffer;
+			HVKMemoryAllocation mAllocation;
+			VkDeviceSize mByteSize;
+			VkBufferUsageFlags mUsage;
+			VkMemoryPropertyFlags mRequired;
+			VkMemoryPropertyFlags mPreferred;
+			VkMemoryPropertyFlags mNotPreferred;
+		};
+
+		/// @brief 要素の型を持ったVkBuffer
+		///
+		/// 作成、割り当て、結びつけを一度に行い、マップされたメモリをHVKMappedSpan<T>として公開します。
+		/// 既定ではHOST_VISIBLEを必須、DEVICE_LOCALを望ましいとするので、毎フレーム書き換えるインスタンスデータなどに
+		/// 中間バッファを介さずそのまま書き込めます。コピーはできずムーブのみ可能です
+		/// @tparam T memcpyでコピーできる型
+		template<typename T>
+		class HVKTypedBuffer : public HVKTypedBufferBase
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "HVKTypedBufferの要素はmemcpyでコピーできる型である必要があります");
+
+		public:
+			HVKTypedBuffer() : mCount(0) {}
+			HVKTypedBuffer(HVKTypedBuffer&& right)noexcept
+				: HVKTypedBuffer()
+			{
+				*this = std::move(right);
+			}
+			HVKTypedBuffer& operator=(HVKTypedBuffer&& right)noexcept
+			{
+				//基底のムーブでrightはrelease()されるので、先に要素数を受け取っておく
+				auto count = right.mCount;
+				HVKTypedBufferBase::operator=(std::move(right));
+				this->mCount = count;
+				return *this;
+			}
+
+			void release()noexcept override
+			{
+				HVKTypedBufferBase::release();
+				this->mCount = 0;
+			}
+
+			/// @brief 作成
+			/// @param[in] heap 解放するまで生存していること
+			/// @param[in] count 要素数. 0より大きいこと
+			/// @param[in] usage
+			/// @param[in] required
+			/// @param[in] preferred
+			/// @param[in] notPreferred
+			/// @exception HVKException
+			void create(HVKDeviceMemoryHeap& heap, size_t count, VkBufferUsageFlags usage,
+				VkMemoryPropertyFlags required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+				VkMemoryPropertyFlags preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				VkMemoryPropertyFlags notPreferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT)
+			{
+				this->createBytes(heap, count * sizeof(T), usage, required, preferred, notPreferred);
+				this->mCount = count;
+			}
+
+			/// @brief 要素数を変える
+			///
+			/// capacity()に収まるときは作り直しません。
+			/// 収まらないときは1.5倍ずつ広げて作り直し、既存の要素を引き継ぎます。
+			/// 作り直したときはbuffer()と以前のビューが無効になるので、GPUが使い終わってから呼び出してください
+			/// @param[in] count
+			/// @exception HVKException
+			void resize(size_t count)
+			{
+				assert(this->isGood());
+				if (this->capacity() < count) {
+					auto newCapacity = std::max(count, this->capacity() + this->capacity() / 2);
+					this->resizeBytes(newCapacity * sizeof(T), std::min(count, this->mCount) * sizeof(T));
+				}
+				this->mCount = count;
+			}
+
+			/// @brief 要素数に合わせて作り直す
+			/// @exception HVKException
+			void shrinkToFit()
+			{
+				assert(this->isGood());
+				if (0 < this->mCount && this->mCount < this->capacity()) {
+					this->resizeBytes(this->mCount * sizeof(T), this->mCount * sizeof(T));
+				}
+			}
+
+			/// @brief マップされたメモリのビュー
+			///
+			/// ホストから見えないメモリタイプのときは空のビューを返します
+			/// @retval HVKMappedSpan<T>
+			HVKMappedSpan<T> view()noexcept
+			{
+				return HVKMappedSpan<T>(static_cast<T*>(this->mappedData()), this->mappedData() ? this->mCount : 0);
+			}
+			HVKMappedSpan<const T> view()const noexcept
+			{
+				return HVKMappedSpan<const T>(static_cast<const T*>(this->mappedData()), this->mappedData() ? this->mCount : 0);
+			}
+
+			/// @brief 書き込んだ要素の範囲をフラッシュ対象に追加する
+			/// @param[in] batch
+			/// @param[in] first
+			/// @param[in] count
+			void addFlush(HVKMappedRangeBatch& batch, size_t first, size_t count)const noexcept
+			{
+				assert(first + count <= this->mCount);
+				this->addFlushBytes(batch, first * sizeof(T), count * sizeof(T));
+			}
+			void addFlush(HVKMappedRangeBatch& batch)const noexcept
+			{
+				this->addFlush(batch, 0, this->mCount);
+			}
+
+		public:
+			size_t size()const noexcept { return this->mCount; }
+			size_t capacity()const noexcept { return static_cast<size_t>(this->byteSize() / sizeof(T)); }
+			VkDeviceSize sizeBytes()const noexcept { return this->mCount * sizeof(T); }
+
+		private:
+			size_t mCount;
+		};
+	}
+}
@@ -0,0 +1,127 @@
+﻿#include "BumpArena.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <utility> // for std::move
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace utility
+		{
+			namespace
+			{
+				inline uintptr_t alignUp(uintptr_t value, uintptr_t alignment)noexcept
+				{
+					return (value + alignment - 1) & ~(alignment - 1);
+				}
+			}
+
+			BumpArena::BumpArena(size_t chunkSize)
+				: mChunkSize(chunkSize)
+				, mCurrent(0)
+				, mHead(0)
+			{
+				assert(0 < chunkSize);
+			}
+
+			BumpArena::BumpArena(BumpArena&& right)noexcept
+				: BumpArena(right.mChunkSize)
+			{
+				*this = std::move(right);
+			}
+
+			BumpArena& BumpArena::operator=(BumpArena&& right)noexcept
+			{
+				this->release();
+
+				this->mChunkSize = right.mChunkSize;
+				this->mChunks = std::move(right.mChunks);
+				this->mCurrent = right.mCurrent;
+				this->mHead = right.mHead;
+
+				right.mChunks.clear();
+				right.mCurrent = 0;
+				right.mHead = 0;
+				return *this;
+			}
+
+			BumpArena::~BumpArena()
+			{
+				this->release();
+			}
+
+			void BumpArena::release()noexcept
+			{
+				for (auto& chunk : this->mChunks) {
+					std::free(chunk.pBegin);
+				}
+				this->mChunks.clear();
+				this->mChunks.shrink_to_fit();
+				this->mCurrent = 0;
+				this->mHead = 0;
+			}
+
+			void* BumpArena::allocate(size_t size, size_t alignment)noexcept
+			{
+				assert(0 < alignment && 0 == (alignment & (alignment - 1)));
+
+				//使い切ったチャンクは飛ばし、入るものが見つかるまで進める
+				for (; this->mCurrent < this->mChunks.size(); ++this->mCurrent, this->mHead = 0) {
+					auto& chunk = this->mChunks[this->mCurrent];
+					auto begin = reinterpret_cast<uintptr_t>(chunk.pBegin);
+					auto offset = alignUp(begin + this->mHead, alignment) - begin;
+					if (offset + size <= chunk.size) {
+						this->mHead = offset + size;
+						return chunk.pBegin + offset;
+					}
+				}
+
+				Chunk chunk;
+				chunk.size = size + alignment - 1 < this->mChunkSize ? this->mChunkSize : size + alignment - 1;
+				chunk.pBegin = static_cast<uint8_t*>(std::malloc(chunk.size));
+				if (nullptr == chunk.pBegin) {
+					return nullptr;
+				}
+				try {
+					this->mChunks.push_back(chunk);
+				} catch (...) {
+					std::free(chunk.pBegin);
+					return nullptr;
+				}
+				this->mCurrent = this->mChunks.size() - 1;
+
+				auto begin = reinterpret_cast<uintptr_t>(chunk.pBegin);
+				auto offset = alignUp(begin, alignment) - begin;
+				this->mHead = offset + size;
+				return chunk.pBegin + offset;
+			}
+
+			void BumpArena::reset()noexcept
+			{
+				this->mCurrent = 0;
+				this->mHead = 0;
+			}
+
+			size_t BumpArena::chunkSize()const noexcept
+			{
+				return this->mChunkSize;
+			}
+
+			size_t BumpArena::chunkCount()const noexcept
+			{
+				return this->mChunks.size();
+			}
+
+			size_t BumpArena::reservedSize()const noexcept
+			{
+				size_t result = 0;
+				for (auto& chunk : this->mChunks) {
+					result += chunk.size;
+				}
+				return result;
+			}
+		}
+	}
+}
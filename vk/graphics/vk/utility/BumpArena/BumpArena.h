@@ -0,0 +1,67 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace utility
+		{
+			/// @brief ポインタを進めるだけで割り当てるアリーナ
+			///
+			/// 個別の解放はできず、resetでまとめて先頭に戻します。
+			/// 確保したチャンクはresetしても保持するので、同じ使い方を繰り返す限り新しい確保は起きません。
+			/// スレッドセーフではありません
+			class BumpArena
+			{
+				BumpArena(const BumpArena&) = delete;
+				BumpArena& operator=(const BumpArena&) = delete;
+
+			public:
+				static const size_t sDefaultChunkSize = 64 * 1024;
+
+			public:
+				explicit BumpArena(size_t chunkSize = sDefaultChunkSize);
+				BumpArena(BumpArena&& right)noexcept;
+				BumpArena& operator=(BumpArena&& right)noexcept;
+				~BumpArena();
+
+				/// @brief すべてのチャンクを解放する
+				void release()noexcept;
+
+				/// @brief 割り当て
+				///
+				/// 現在のチャンクに入らなければ次のチャンクに移り、なければchunkSizeとsizeの大きいほうで新しく確保します
+				/// @param[in] size
+				/// @param[in] alignment 2の累乗であること
+				/// @retval void* 失敗したときはnullptr
+				void* allocate(size_t size, size_t alignment)noexcept;
+
+				/// @brief 割り当てをすべて破棄して先頭に戻す
+				void reset()noexcept;
+
+			public:
+				size_t chunkSize()const noexcept;
+				size_t chunkCount()const noexcept;
+				/// @brief 確保しているチャンクの大きさの合計
+				size_t reservedSize()const noexcept;
+
+			private:
+				struct Chunk
+				{
+					uint8_t* pBegin;
+					size_t size;
+				};
+
+			private:
+				size_t mChunkSize;
+				std::vector<Chunk> mChunks;
+				size_t mCurrent;
+				size_t mHead;
+			};
+		}
+	}
+}
@@ -0,0 +1,116 @@
+﻿#include "HostAllocatorCommon.h"
+
+#include <atomic>
+
+#include "../SizeClassPool/SizeClassPool.h"
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace utility
+		{
+			namespace
+			{
+				inline uintptr_t alignUp(uintptr_t value, uintptr_t alignment)noexcept
+				{
+					return (value + alignment - 1) & ~(alignment - 1);
+				}
+
+				std::atomic<uint64_t> gNextAllocatorID(1);
+
+				struct ThreadCacheEntry
+				{
+					uint64_t allocatorID;
+					void* pCache;
+				};
+				thread_local std::vector<ThreadCacheEntry> tThreadCaches;
+				thread_local ThreadCacheEntry tLastThreadCache = { 0, nullptr };
+			}
+
+			const size_t HostAllocationHeader::sMinAlignment;
+			const size_t HostAllocationHeader::sReservedSize;
+
+			HostAllocationHeader* HostAllocationHeader::sGet(void* pMemory)noexcept
+			{
+				static_assert(sizeof(HostAllocationHeader) <= sReservedSize, "ヘッダが予約した領域に収まりません");
+				static_assert(0 == sReservedSize % sMinAlignment, "予約する領域はsMinAlignmentの倍数でなければなりません");
+				return reinterpret_cast<HostAllocationHeader*>(static_cast<uint8_t*>(pMemory) - sizeof(HostAllocationHeader));
+			}
+
+			void* HostAllocationHeader::sPlace(void* pBase, void* pOwner, size_t size, size_t alignment, ORIGIN origin, uint16_t classIndex)noexcept
+			{
+				auto user = alignUp(reinterpret_cast<uintptr_t>(pBase) + sReservedSize, alignment);
+				auto* pMemory = reinterpret_cast<void*>(user);
+				auto* pHeader = sGet(pMemory);
+				pHeader->pBase = pBase;
+				pHeader->pOwner = pOwner;
+				pHeader->size = static_cast<uint32_t>(size);
+				pHeader->origin = origin;
+				pHeader->classIndex = classIndex;
+				return pMemory;
+			}
+
+			size_t HostAllocationHeader::sCalRequiredSize(size_t size, size_t alignment)noexcept
+			{
+				return sReservedSize + size + (alignment - sMinAlignment);
+			}
+
+			size_t HostAllocationHeader::sCapacity(void* pMemory)noexcept
+			{
+				auto* pHeader = sGet(pMemory);
+				if (eORIGIN_POOL != pHeader->origin) {
+					//プール以外は確保した大きさを覚えていないので、伸ばすときは常に割り当て直す
+					return pHeader->size;
+				}
+				auto used = static_cast<uint8_t*>(pMemory) - static_cast<uint8_t*>(pHeader->pBase);
+				return SizeClassPool::sClassSize(pHeader->classIndex) - static_cast<size_t>(used);
+			}
+
+			VKAPI_ATTR void VKAPI_CALL HostAllocationHeader::sInternalNotification(void* pUserData, size_t size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope)
+			{
+				(void)pUserData;
+				(void)size;
+				(void)allocationType;
+				(void)allocationScope;
+			}
+
+			uint64_t HostThreadCacheTable::sIssueID()noexcept
+			{
+				return gNextAllocatorID++;
+			}
+
+			void* HostThreadCacheTable::sFind(uint64_t allocatorID)noexcept
+			{
+				//ほとんどの場合は1つのアロケータしか使わないので、直前のものを先に調べる
+				if (tLastThreadCache.allocatorID == allocatorID) {
+					return tLastThreadCache.pCache;
+				}
+				for (auto& entry : tThreadCaches) {
+					if (entry.allocatorID == allocatorID) {
+						tLastThreadCache = entry;
+						return entry.pCache;
+					}
+				}
+				return nullptr;
+			}
+
+			void HostThreadCacheTable::sAdd(uint64_t allocatorID, void* pCache)
+			{
+				ThreadCacheEntry entry = { allocatorID, pCache };
+				tThreadCaches.push_back(entry);
+			}
+
+			void HostThreadCacheTable::sRemove(uint64_t allocatorID)noexcept
+			{
+				if (!tThreadCaches.empty() && tThreadCaches.back().allocatorID == allocatorID) {
+					tThreadCaches.pop_back();
+				}
+				if (tLastThreadCache.allocatorID == allocatorID) {
+					tLastThreadCache.allocatorID = 0;
+					tLastThreadCache.pCache = nullptr;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,199 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <vulkan\vulkan.h>
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace utility
+		{
+			/// @brief VkAllocationCallbacksの実装が割り当ての直前に置くヘッダ
+			///
+			/// HVKHostAllocatorとHVKThreadCachedHostAllocatorで共有しています。
+			/// 解放時にスコープが分からなくても、ヘッダから割り当て先を判別できます。
+			/// 割り当て先は常にsMinAlignmentに揃った領域を返すものとします
+			struct HostAllocationHeader
+			{
+				enum ORIGIN : uint16_t {
+					eORIGIN_SYSTEM,
+					eORIGIN_POOL,
+					eORIGIN_ARENA,
+				};
+
+				void* pBase;		///< 割り当て先から返された先頭
+				void* pOwner;		///< 割り当てたプールやアリーナの持ち主. 使わないときはnullptr
+				uint32_t size;		///< 要求された大きさ
+				uint16_t origin;
+				uint16_t classIndex;
+
+				static const size_t sMinAlignment = 16;
+				static const size_t sReservedSize = 32;	///< ヘッダのために割り当ての前に空ける大きさ. sMinAlignmentの倍数
+
+				/// @brief 割り当てたポインタのヘッダを返す
+				/// @param[in] pMemory
+				/// @retval HostAllocationHeader*
+				static HostAllocationHeader* sGet(void* pMemory)noexcept;
+
+				/// @brief pBaseにヘッダを書き込み、アライメントを満たす位置を返す
+				/// @param[in] pBase 割り当て先から返された先頭. sCalRequiredSizeの大きさがあること
+				/// @param[in] pOwner
+				/// @param[in] size
+				/// @param[in] alignment sMinAlignment以上の2の累乗
+				/// @param[in] origin
+				/// @param[in] classIndex プールのときのクラス
+				/// @retval void*
+				static void* sPlace(void* pBase, void* pOwner, size_t size, size_t alignment, ORIGIN origin, uint16_t classIndex)noexcept;
+
+				/// @brief 割り当て先が16に揃っているときに必要な大きさ
+				/// @param[in] size
+				/// @param[in] alignment sMinAlignment以上の2の累乗
+				/// @retval size_t
+				static size_t sCalRequiredSize(size_t size, size_t alignment)noexcept;
+
+				/// @brief pMemoryの割り当てに使える大きさ
+				///
+				/// プール以外は確保した大きさを覚えていないので、要求された大きさを返します
+				/// @param[in] pMemory
+				/// @retval size_t
+				static size_t sCapacity(void* pMemory)noexcept;
+
+				/// @brief 再割り当て
+				///
+				/// 確保済みの領域に収まりアライメントも満たしていれば、同じポインタを返します
+				/// @param[in] allocator allocate, freeを持つもの
+				/// @param[in] pOriginal nullptrならallocateと同じです
+				/// @param[in] size 0ならfreeと同じです
+				/// @param[in] alignment
+				/// @param[in] scope
+				/// @retval void* 失敗したときはnullptrを返し、pOriginalはそのまま残ります
+				template<typename Allocator>
+				static void* sReallocate(Allocator& allocator, void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope scope)noexcept
+				{
+					if (nullptr == pOriginal) {
+						return allocator.allocate(size, alignment, scope);
+					}
+					if (0 == size) {
+						allocator.free(pOriginal);
+						return nullptr;
+					}
+
+					auto* pHeader = sGet(pOriginal);
+					auto isAligned = 0 == (reinterpret_cast<uintptr_t>(pOriginal) & (std::max(alignment, sMinAlignment) - 1));
+					if (isAligned && size <= sCapacity(pOriginal)) {
+						pHeader->size = static_cast<uint32_t>(size);
+						return pOriginal;
+					}
+
+					auto* pNew = allocator.allocate(size, alignment, scope);
+					if (nullptr == pNew) {
+						return nullptr;
+					}
+					memcpy(pNew, pOriginal, std::min<size_t>(size, pHeader->size));
+					allocator.free(pOriginal);
+					return pNew;
+				}
+
+				/// @brief allocatorのallocate, reallocate, freeを呼び出すVkAllocationCallbacksを作る
+				/// @param[in] pAllocator
+				/// @retval VkAllocationCallbacks
+				template<typename Allocator>
+				static VkAllocationCallbacks sMakeCallbacks(Allocator* pAllocator)noexcept
+				{
+					VkAllocationCallbacks result;
+					result.pUserData = pAllocator;
+					result.pfnAllocation = &Thunks<Allocator>::sAllocation;
+					result.pfnReallocation = &Thunks<Allocator>::sReallocation;
+					result.pfnFree = &Thunks<Allocator>::sFree;
+					result.pfnInternalAllocation = &sInternalNotification;
+					result.pfnInternalFree = &sInternalNotification;
+					return result;
+				}
+
+			private:
+				template<typename Allocator>
+				struct Thunks
+				{
+					static VKAPI_ATTR void* VKAPI_CALL sAllocation(void* pUserData, size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+					{
+						return static_cast<Allocator*>(pUserData)->allocate(size, alignment, allocationScope);
+					}
+
+					static VKAPI_ATTR void* VKAPI_CALL sReallocation(void* pUserData, void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+					{
+						return static_cast<Allocator*>(pUserData)->reallocate(pOriginal, size, alignment, allocationScope);
+					}
+
+					static VKAPI_ATTR void VKAPI_CALL sFree(void* pUserData, void* pMemory)
+					{
+						static_cast<Allocator*>(pUserData)->free(pMemory);
+					}
+				};
+
+				/// @brief ドライバが自前で確保したことの通知. 何もしない
+				static VKAPI_ATTR void VKAPI_CALL sInternalNotification(void* pUserData, size_t size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope);
+			};
+
+			/// @brief アロケータごとに、呼び出したスレッドのキャッシュを引く対応表
+			///
+			/// 対応表はthread_localに置くので、引くときにロックは取りません。
+			/// アロケータのIDはsIssueIDで発行し、再利用しないので、破棄されたアロケータの対応が残っていても誤って引かれることはありません
+			class HostThreadCacheTable
+			{
+			public:
+				/// @brief アロケータのIDを発行する
+				/// @retval uint64_t
+				static uint64_t sIssueID()noexcept;
+
+				/// @brief 呼び出したスレッドのキャッシュを返す
+				/// @param[in] allocatorID
+				/// @retval void* なければnullptr
+				static void* sFind(uint64_t allocatorID)noexcept;
+
+				/// @brief 呼び出したスレッドのキャッシュを返す. なければ作ってcachesに加えます
+				///
+				/// スレッドごとに最初の1回だけcachesMutexのロックを取ります
+				/// @param[in] allocatorID
+				/// @param[in] cachesMutex
+				/// @param[inout] caches アロケータが持つキャッシュ. アロケータを破棄するまで残します
+				/// @retval Cache* 作れなかったときはnullptr
+				template<typename Cache>
+				static Cache* sGetOrCreate(uint64_t allocatorID, std::mutex& cachesMutex, std::vector<std::unique_ptr<Cache>>& caches)noexcept
+				{
+					auto* pCache = static_cast<Cache*>(sFind(allocatorID));
+					if (nullptr != pCache) {
+						return pCache;
+					}
+
+					try {
+						std::unique_ptr<Cache> pNewCache(new Cache());
+						sAdd(allocatorID, pNewCache.get());
+						try {
+							std::lock_guard<std::mutex> lock(cachesMutex);
+							caches.push_back(std::move(pNewCache));
+						} catch (...) {
+							//対応表に残ったものは使われる前に破棄されないよう取り除く
+							sRemove(allocatorID);
+							throw;
+						}
+						return static_cast<Cache*>(sFind(allocatorID));
+					} catch (...) {
+						return nullptr;
+					}
+				}
+
+			private:
+				/// @exception std::bad_alloc
+				static void sAdd(uint64_t allocatorID, void* pCache);
+				static void sRemove(uint64_t allocatorID)noexcept;
+			};
+		}
+	}
+}
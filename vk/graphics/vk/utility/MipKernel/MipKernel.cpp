@@ -0,0 +1,828 @@
+﻿#include "MipKernel.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && 2 <= _M_IX86_FP) || defined(__SSE2__)
+#define HINODE_MIP_KERNEL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define HINODE_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define HINODE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(_M_ARM64) || defined(__ARM_NEON)
+#define HINODE_MIP_KERNEL_NEON
+#include <arm_neon.h>
+#endif
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace utility
+		{
+			namespace
+			{
+				//------------------------------------------------------------------------
+				//変換用のテーブル
+				//------------------------------------------------------------------------
+				float srgbToLinear(float s)noexcept
+				{
+					return s <= 0.04045f ? s / 12.92f : std::pow((s + 0.055f) / 1.055f, 2.4f);
+				}
+
+				float linearToSrgb(float v)noexcept
+				{
+					return v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.f / 2.4f) - 0.055f;
+				}
+
+				double besselI0(double x)noexcept
+				{
+					auto sum = 1.0;
+					auto term = 1.0;
+					for (auto k = 1; k < 32; ++k) {
+						auto t = x / (2.0 * k);
+						term *= t * t;
+						sum += term;
+					}
+					return sum;
+				}
+
+				struct Tables
+				{
+					static const uint32_t sSrgbEncodeSize = 4096;
+					static const uint32_t sKaiserCurveResolution = 64;	///< 距離1あたりの標本の数
+					static const uint32_t sKaiserCurveSize = MipKernel::sKaiserTapCount / 2 * sKaiserCurveResolution + 1;
+
+					float srgbDecode[256];
+					float srgbThreshold[256];	///< [i]以上の値はi+1以上に書き出す
+					uint8_t srgbEncode[sSrgbEncodeSize];	///< sqrt(リニア値)で引く. 結果はsrgbThresholdで補正する
+					float kaiser[MipKernel::sKaiserTapCount];
+					float kaiserCurve[sKaiserCurveSize];	///< 中心からの距離ごとの正規化していない重み. 奇数の大きさの縮小に使う
+
+					Tables()noexcept
+					{
+						for (auto i = 0u; i < 256; ++i) {
+							this->srgbDecode[i] = srgbToLinear(i / 255.f);
+							this->srgbThreshold[i] = i < 255 ? srgbToLinear((i + 0.5f) / 255.f) : 2.f;
+						}
+						for (auto i = 0u; i < sSrgbEncodeSize; ++i) {
+							auto s = i / static_cast<float>(sSrgbEncodeSize - 1);
+							auto encoded = linearToSrgb(s * s) * 255.f + 0.5f;
+							this->srgbEncode[i] = static_cast<uint8_t>(std::min(255.f, encoded));
+						}
+
+						//縮小後の画素の中心からの距離がk - 3.5の画素を使う. sincは縮小率に合わせて横に2倍に伸ばす
+						const double pi = 3.14159265358979323846;
+						const double beta = 4.0;
+						const double halfWidth = MipKernel::sKaiserTapCount / 2.0;
+						double weights[MipKernel::sKaiserTapCount];
+						double total = 0.0;
+						for (auto k = 0u; k < MipKernel::sKaiserTapCount; ++k) {
+							auto d = k - (MipKernel::sKaiserTapCount - 1) / 2.0;
+							auto x = d / 2.0;
+							auto sinc = std::sin(pi * x) / (pi * x);
+							auto r = d / halfWidth;
+							auto window = besselI0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(beta);
+							weights[k] = sinc * window;
+							total += weights[k];
+						}
+						for (auto k = 0u; k < MipKernel::sKaiserTapCount; ++k) {
+							this->kaiser[k] = static_cast<float>(weights[k] / total);
+						}
+						for (auto i = 0u; i < sKaiserCurveSize; ++i) {
+							auto d = i / static_cast<double>(sKaiserCurveResolution);
+							auto x = d / 2.0;
+							auto sinc = 0 == i ? 1.0 : std::sin(pi * x) / (pi * x);
+							auto r = d / halfWidth;
+							auto window = besselI0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(beta);
+							this->kaiserCurve[i] = static_cast<float>(sinc * window);
+						}
+					}
+				};
+
+				const Tables& tables()noexcept
+				{
+					static const Tables sTables;
+					return sTables;
+				}
+
+				float saturate(float v)noexcept
+				{
+					//NaNは0にする
+					return 0.f < v ? (v < 1.f ? v : 1.f) : 0.f;
+				}
+
+				uint8_t encodeSrgb(const Tables& t, float v)noexcept
+				{
+					v = saturate(v);
+					auto index = static_cast<uint32_t>(std::sqrt(v) * (Tables::sSrgbEncodeSize - 1) + 0.5f);
+					uint32_t result = t.srgbEncode[index];
+					while (result < 255 && t.srgbThreshold[result] <= v) {
+						++result;
+					}
+					while (0 < result && v < t.srgbThreshold[result - 1]) {
+						--result;
+					}
+					return static_cast<uint8_t>(result);
+				}
+
+				uint8_t encodeUnorm(float v)noexcept
+				{
+					return static_cast<uint8_t>(saturate(v) * 255.f + 0.5f);
+				}
+
+				uint16_t floatToHalf(float value)noexcept
+				{
+					//最近接偶数への丸め
+					const uint32_t f32Infinity = 255u << 23;
+					const uint32_t f16Max = (127u + 16u) << 23;
+					const uint32_t denormMagicBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+					uint32_t f;
+					std::memcpy(&f, &value, sizeof(f));
+					auto sign = f & 0x80000000u;
+					f ^= sign;
+
+					uint16_t result;
+					if (f16Max <= f) {
+						result = f32Infinity < f ? 0x7e00 : 0x7c00;
+					} else if (f < (113u << 23)) {
+						//非正規化数になる値は足し算で仮数部を丸める
+						float magic;
+						std::memcpy(&magic, &denormMagicBits, sizeof(magic));
+						float fv;
+						std::memcpy(&fv, &f, sizeof(fv));
+						fv += magic;
+						uint32_t bits;
+						std::memcpy(&bits, &fv, sizeof(bits));
+						result = static_cast<uint16_t>(bits - denormMagicBits);
+					} else {
+						auto mantissaOdd = (f >> 13) & 1u;
+						f += (static_cast<uint32_t>(15 - 127) << 23) + 0xfffu;
+						f += mantissaOdd;
+						result = static_cast<uint16_t>(f >> 13);
+					}
+					return static_cast<uint16_t>(result | (sign >> 16));
+				}
+
+				float halfToFloat(uint16_t half)noexcept
+				{
+					uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+					uint32_t exponent = (half >> 10) & 0x1fu;
+					uint32_t mantissa = half & 0x3ffu;
+
+					uint32_t bits;
+					if (0 == exponent) {
+						float value = mantissa * (1.f / 16777216.f);
+						std::memcpy(&bits, &value, sizeof(bits));
+						bits |= sign;
+					} else if (0x1fu == exponent) {
+						bits = sign | 0x7f800000u | (mantissa << 13);
+					} else {
+						bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+					}
+					float result;
+					std::memcpy(&result, &bits, sizeof(result));
+					return result;
+				}
+
+				//------------------------------------------------------------------------
+				//縮小カーネル
+				//------------------------------------------------------------------------
+				/// @brief 複数の行に重みをかけて足す
+				typedef void(*WeightedRowsFunc)(const float* const* ppRows, const float* pWeights, uint32_t rowCount, size_t count, float* pDst);
+				/// @brief 隣り合う2画素を平均する. 縮小元の幅は2以上であること
+				typedef void(*HorizontalBoxFunc)(const float* pSrc, uint32_t dstWidth, uint32_t channelCount, float* pDst);
+				/// @brief [begin, end)の画素にsKaiserTapCount個の重みをかける. すべての画素で縮小元をはみ出さないこと
+				typedef void(*HorizontalTapsFunc)(const float* pSrc, uint32_t srcWidth, uint32_t begin, uint32_t end, const float* pWeights, float* pDst);
+
+				struct KernelTable
+				{
+					WeightedRowsFunc weightedRows;
+					HorizontalBoxFunc horizontalBox;
+					HorizontalTapsFunc horizontalTaps4;	///< 4チャンネル用
+					HorizontalTapsFunc horizontalTaps1;	///< 1チャンネル用
+				};
+
+				void weightedRowsScalar(const float* const* ppRows, const float* pWeights, uint32_t rowCount, size_t begin, size_t count, float* pDst)noexcept
+				{
+					for (auto i = begin; i < count; ++i) {
+						auto sum = pWeights[0] * ppRows[0][i];
+						for (auto r = 1u; r < rowCount; ++r) {
+							sum += pWeights[r] * ppRows[r][i];
+						}
+						pDst[i] = sum;
+					}
+				}
+
+				void weightedRowsScalar(const float* const* ppRows, const float* pWeights, uint32_t rowCount, size_t count, float* pDst)
+				{
+					weightedRowsScalar(ppRows, pWeights, rowCount, 0, count, pDst);
+				}
+
+				void horizontalBoxScalar(const float* pSrc, uint32_t begin, uint32_t dstWidth, uint32_t channelCount, float* pDst)noexcept
+				{
+					for (auto x = begin; x < dstWidth; ++x) {
+						auto p = pSrc + static_cast<size_t>(x) * 2 * channelCount;
+						for (auto c = 0u; c < channelCount; ++c) {
+							pDst[x * channelCount + c] = (p[c] + p[channelCount + c]) * 0.5f;
+						}
+					}
+				}
+
+				void horizontalBoxScalar(const float* pSrc, uint32_t dstWidth, uint32_t channelCount, float* pDst)
+				{
+					horizontalBoxScalar(pSrc, 0, dstWidth, channelCount, pDst);
+				}
+
+				void horizontalTapsScalar(const float* pSrc, uint32_t channelCount, uint32_t begin, uint32_t end, const float* pWeights, float* pDst)noexcept
+				{
+					for (auto x = begin; x < end; ++x) {
+						auto p = pSrc + (static_cast<size_t>(x) * 2 - (MipKernel::sKaiserTapCount / 2 - 1)) * channelCount;
+						for (auto c = 0u; c < channelCount; ++c) {
+							auto sum = 0.f;
+							for (auto k = 0u; k < MipKernel::sKaiserTapCount; ++k) {
+								sum += pWeights[k] * p[k * channelCount + c];
+							}
+							pDst[x * channelCount + c] = sum;
+						}
+					}
+				}
+
+				void horizontalTaps4Scalar(const float* pSrc, uint32_t, uint32_t begin, uint32_t end, const float* pWeights, float* pDst)
+				{
+					horizontalTapsScalar(pSrc, 4, begin, end, pWeights, pDst);
+				}
+
+				void horizontalTaps1Scalar(const float* pSrc, uint32_t, uint32_t begin, uint32_t end, const float* pWeights, float* pDst)
+				{
+					horizontalTapsScalar(pSrc, 1, begin, end, pWeights, pDst);
+				}
+
+				/// @brief 端の画素用. はみ出した分は端の画素を繰り返す
+				void horizontalTapsClamped(const float* pSrc, uint32_t srcWidth, uint32_t channelCount, uint32_t x, const float* pWeights, float* pDst)noexcept
+				{
+					for (auto c = 0u; c < channelCount; ++c) {
+						auto sum = 0.f;
+						for (auto k = 0u; k < MipKernel::sKaiserTapCount; ++k) {
+							auto srcX = static_cast<int64_t>(x) * 2 - (MipKernel::sKaiserTapCount / 2 - 1) + k;
+							srcX = std::min<int64_t>(std::max<int64_t>(srcX, 0), srcWidth - 1);
+							sum += pWeights[k] * pSrc[srcX * channelCount + c];
+						}
+						pDst[x * channelCount + c] = sum;
+					}
+				}
+
+				/// @brief 奇数の大きさをボックスフィルタで縮小するときの3タップの重み
+				///
+				/// 縮小後のdst番目の画素は元の2dst, 2dst + 1, 2dst + 2を覆うので、
+				/// 端の画素を捨てずにすべての画素を同じ重さで使うよう、覆う割合で重みをつける
+				/// @param[in] dstSize 縮小後の大きさ. 元の大きさは2 * dstSize + 1
+				/// @param[in] dst
+				/// @param[out] pWeights 3個
+				void oddBoxWeights(uint32_t dstSize, uint32_t dst, float* pWeights)noexcept
+				{
+					auto scale = 1.f / static_cast<float>(2 * dstSize + 1);
+					pWeights[0] = static_cast<float>(dstSize - dst) * scale;
+					pWeights[1] = static_cast<float>(dstSize) * scale;
+					pWeights[2] = static_cast<float>(dst + 1) * scale;
+				}
+
+				/// @brief 奇数の幅を3タップで横方向に縮小する
+				void horizontalBoxOdd(const float* pSrc, uint32_t dstWidth, uint32_t channelCount, float* pDst)noexcept
+				{
+					for (auto x = 0u; x < dstWidth; ++x) {
+						float weights[3];
+						oddBoxWeights(dstWidth, x, weights);
+						auto* p = pSrc + static_cast<size_t>(x) * 2 * channelCount;
+						for (auto c = 0u; c < channelCount; ++c) {
+							pDst[x * channelCount + c] = weights[0] * p[c] + weights[1] * p[channelCount + c] + weights[2] * p[channelCount * 2 + c];
+						}
+					}
+				}
+
+				/// @brief 奇数の大きさをカイザーフィルタで縮小するときの縮小後のdst番目の画素の中心
+				///
+				/// 2dst + 0.5を中心にすると最後の画素の分だけ原点側にずれるので、
+				/// 縮小前後の端をそろえて(dst + 0.5) * srcSize / dstSize - 0.5を中心にする
+				/// @param[in] dstSize 縮小後の大きさ. 元の大きさは2 * dstSize + 1
+				/// @param[in] dst
+				/// @retval float
+				float oddKaiserCenter(uint32_t dstSize, uint32_t dst)noexcept
+				{
+					return (dst + 0.5f) * static_cast<float>(2 * dstSize + 1) / static_cast<float>(dstSize) - 0.5f;
+				}
+
+				/// @brief centerを中心にしたsKaiserTapCount個の重み
+				///
+				/// 中心の端数ごとに重みが変わるので、そのたびに正規化する
+				/// @param[in] center
+				/// @param[out] pWeights sKaiserTapCount個
+				/// @retval int64_t 最初のタップの位置
+				int64_t kaiserWeightsAt(float center, float* pWeights)noexcept
+				{
+					auto& t = tables();
+					auto first = static_cast<int64_t>(std::floor(center)) - (MipKernel::sKaiserTapCount / 2 - 1);
+					auto total = 0.f;
+					for (auto k = 0u; k < MipKernel::sKaiserTapCount; ++k) {
+						auto pos = std::fabs(static_cast<float>(first + k) - center) * Tables::sKaiserCurveResolution;
+						auto i = static_cast<uint32_t>(pos);
+						auto weight = 0.f;
+						if (i + 1 < Tables::sKaiserCurveSize) {
+							auto frac = pos - static_cast<float>(i);
+							weight = t.kaiserCurve[i] + (t.kaiserCurve[i + 1] - t.kaiserCurve[i]) * frac;
+						}
+						pWeights[k] = weight;
+						total += weight;
+					}
+					for (auto k = 0u; k < MipKernel::sKaiserTapCount; ++k) {
+						pWeights[k] /= total;
+					}
+					return first;
+				}
+
+				/// @brief 奇数の幅をカイザーフィルタで横方向に縮小する. 画素ごとに重みが変わるのでSIMDは使わない
+				void horizontalKaiserOdd(const float* pSrc, uint32_t srcWidth, uint32_t dstWidth, uint32_t channelCount, float* pDst)noexcept
+				{
+					for (auto x = 0u; x < dstWidth; ++x) {
+						float weights[MipKernel::sKaiserTapCount];
+						auto first = kaiserWeightsAt(oddKaiserCenter(dstWidth, x), weights);
+						for (auto c = 0u; c < channelCount; ++c) {
+							auto sum = 0.f;
+							for (auto k = 0u; k < MipKernel::sKaiserTapCount; ++k) {
+								auto srcX = std::min<int64_t>(std::max<int64_t>(first + k, 0), srcWidth - 1);
+								sum += weights[k] * pSrc[srcX * channelCount + c];
+							}
+							pDst[x * channelCount + c] = sum;
+						}
+					}
+				}
+
+				const KernelTable sScalarKernels = {
+					weightedRowsScalar, horizontalBoxScalar, horizontalTaps4Scalar, horizontalTaps1Scalar,
+				};
+
+#ifdef HINODE_MIP_KERNEL_X86
+				void weightedRowsSse2(const float* const* ppRows, const float* pWeights, uint32_t rowCount, size_t count, float* pDst)
+				{
+					__m128 weights[MipKernel::sKaiserTapCount];
+					for (auto r = 0u; r < rowCount; ++r) {
+						weights[r] = _mm_set1_ps(pWeights[r]);
+					}
+					size_t i = 0;
+					for (; i + 4 <= count; i += 4) {
+						auto sum = _mm_mul_ps(weights[0], _mm_loadu_ps(ppRows[0] + i));
+						for (auto r = 1u; r < rowCount; ++r) {
+							sum = _mm_add_ps(sum, _mm_mul_ps(weights[r], _mm_loadu_ps(ppRows[r] + i)));
+						}
+						_mm_storeu_ps(pDst + i, sum);
+					}
+					weightedRowsScalar(ppRows, pWeights, rowCount, i, count, pDst);
+				}
+
+				void horizontalBoxSse2(const float* pSrc, uint32_t dstWidth, uint32_t channelCount, float* pDst)
+				{
+					auto half = _mm_set1_ps(0.5f);
+					uint32_t x = 0;
+					if (4 == channelCount) {
+						for (; x < dstWidth; ++x) {
+							auto p = pSrc + x * 8;
+							_mm_storeu_ps(pDst + x * 4, _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(p), _mm_loadu_ps(p + 4)), half));
+						}
+					} else {
+						for (; x + 4 <= dstWidth; x += 4) {
+							auto a = _mm_loadu_ps(pSrc + x * 2);
+							auto b = _mm_loadu_ps(pSrc + x * 2 + 4);
+							auto even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+							auto odd = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+							_mm_storeu_ps(pDst + x, _mm_mul_ps(_mm_add_ps(even, odd), half));
+						}
+					}
+					horizontalBoxScalar(pSrc, x, dstWidth, channelCount, pDst);
+				}
+
+				void horizontalTaps4Sse2(const float* pSrc, uint32_t, uint32_t begin, uint32_t end, const float* pWeights, float* pDst)
+				{
+					__m128 weights[MipKernel::sKaiserTapCount];
+					for (auto k = 0u; k < MipKernel::sKaiserTapCount; ++k) {
+						weights[k] = _mm_set1_ps(pWeights[k]);
+					}
+					for (auto x = begin; x < end; ++x) {
+						auto p = pSrc + (static_cast<size_t>(x) * 2 - (MipKernel::sKaiserTapCount / 2 - 1)) * 4;
+						auto sum = _mm_mul_ps(weights[0], _mm_loadu_ps(p));
+						for (auto k = 1u; k < MipKernel::sKaiserTapCount; ++k) {
+							sum = _mm_add_ps(sum, _mm_mul_ps(weights[k], _mm_loadu_ps(p + k * 4)));
+						}
+						_mm_storeu_ps(pDst + x * 4, sum);
+					}
+				}
+
+				void horizontalTaps1Sse2(const float* pSrc, uint32_t srcWidth, uint32_t begin, uint32_t end, const float* pWeights, float* pDst)
+				{
+					__m128 weights[MipKernel::sKaiserTapCount];
+					for (auto k = 0u; k < MipKernel::sKaiserTapCount; ++k) {
+						weights[k] = _mm_set1_ps(pWeights[k]);
+					}
+					//4画素まとめて計算する. 偶数番目だけを取り出すため最後のタップの1つ先まで読むので、その分も範囲内か調べる
+					auto x = begin;
+					for (; x + 4 <= end && static_cast<size_t>(x) * 2 + 12 <= srcWidth; x += 4) {
+						auto p = pSrc + static_cast<size_t>(x) * 2 - (MipKernel::sKaiserTapCount / 2 - 1);
+						auto sum = _mm_setzero_ps();
+						for (auto k = 0u; k < MipKernel::sKaiserTapCount; ++k) {
+							auto a = _mm_loadu_ps(p + k);
+							auto b = _mm_loadu_ps(p + k + 4);
+							auto even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+							sum = _mm_add_ps(sum, _mm_mul_ps(weights[k], even));
+						}
+						_mm_storeu_ps(pDst + x, sum);
+					}
+					horizontalTapsScalar(pSrc, 1, x, end, pWeights, pDst);
+				}
+
+				HINODE_TARGET_AVX2 void weightedRowsAvx2(const float* const* ppRows, const float* pWeights, uint32_t rowCount, size_t count, float* pDst)
+				{
+					__m256 weights[MipKernel::sKaiserTapCount];
+					for (auto r = 0u; r < rowCount; ++r) {
+						weights[r] = _mm256_set1_ps(pWeights[r]);
+					}
+					size_t i = 0;
+					for (; i + 8 <= count; i += 8) {
+						auto sum = _mm256_mul_ps(weights[0], _mm256_loadu_ps(ppRows[0] + i));
+						for (auto r = 1u; r < rowCount; ++r) {
+							sum = _mm256_add_ps(sum, _mm256_mul_ps(weights[r], _mm256_loadu_ps(ppRows[r] + i)));
+						}
+						_mm256_storeu_ps(pDst + i, sum);
+					}
+					weightedRowsScalar(ppRows, pWeights, rowCount, i, count, pDst);
+				}
+
+				HINODE_TARGET_AVX2 void horizontalBoxAvx2(const float* pSrc, uint32_t dstWidth, uint32_t channelCount, float* pDst)
+				{
+					auto half = _mm256_set1_ps(0.5f);
+					uint32_t x = 0;
+					if (4 == channelCount) {
+						//2画素ずつ読んで128bit単位で組み替える
+						for (; x + 2 <= dstWidth; x += 2) {
+							auto a = _mm256_loadu_ps(pSrc + x * 8);
+							auto b = _mm256_loadu_ps(pSrc + x * 8 + 8);
+							auto left = _mm256_permute2f128_ps(a, b, 0x20);
+							auto right = _mm256_permute2f128_ps(a, b, 0x31);
+							_mm256_storeu_ps(pDst + x * 4, _mm256_mul_ps(_mm256_add_ps(left, right), half));
+						}
+					} else {
+						//shuffleはレーンごとに並べるので、足した後で64bit単位に並べ直す
+						for (; x + 8 <= dstWidth; x += 8) {
+							auto a = _mm256_loadu_ps(pSrc + x * 2);
+							auto b = _mm256_loadu_ps(pSrc + x * 2 + 8);
+							auto even = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+							auto odd = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+							auto sum = _mm256_castps_pd(_mm256_mul_ps(_mm256_add_ps(even, odd), half));
+							_mm256_storeu_ps(pDst + x, _mm256_castpd_ps(_mm256_permute4x64_pd(sum, _MM_SHUFFLE(3, 1, 2, 0))));
+						}
+					}
+					horizontalBoxScalar(pSrc, x, dstWidth, channelCount, pDst);
+				}
+
+				const KernelTable sSse2Kernels = {
+					weightedRowsSse2, horizontalBoxSse2, horizontalTaps4Sse2, horizontalTaps1Sse2,
+				};
+
+				//横方向のタップは1画素が128bitに収まるのでSSE2のものを使う
+				const KernelTable sAvx2Kernels = {
+					weightedRowsAvx2, horizontalBoxAvx2, horizontalTaps4Sse2, horizontalTaps1Sse2,
+				};
+
+				bool isAvx2Supported()noexcept
+				{
+					uint32_t regs[4] = {};
+#ifdef _MSC_VER
+					int info[4];
+					__cpuid(info, 0);
+					if (info[0] < 7) {
+						return false;
+					}
+					__cpuid(info, 1);
+					regs[2] = static_cast<uint32_t>(info[2]);
+#else
+					if (__get_cpuid_max(0, nullptr) < 7) {
+						return false;
+					}
+					__cpuid(1, regs[0], regs[1], regs[2], regs[3]);
+#endif
+					//OSXSAVEとAVX
+					const uint32_t osxsaveAvx = (1u << 27) | (1u << 28);
+					if (osxsaveAvx != (regs[2] & osxsaveAvx)) {
+						return false;
+					}
+					//OSがYMMレジスタを保存するか
+#ifdef _MSC_VER
+					auto xcr0 = _xgetbv(0);
+#else
+					uint32_t xcr0Low, xcr0High;
+					__asm__ volatile("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+					uint64_t xcr0 = xcr0Low;
+#endif
+					if (0x6 != (xcr0 & 0x6)) {
+						return false;
+					}
+#ifdef _MSC_VER
+					__cpuidex(info, 7, 0);
+					regs[1] = static_cast<uint32_t>(info[1]);
+#else
+					__cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+					return 0 != (regs[1] & (1u << 5));
+				}
+#endif
+
+#ifdef HINODE_MIP_KERNEL_NEON
+				void weightedRowsNeon(const float* const* ppRows, const float* pWeights, uint32_t rowCount, size_t count, float* pDst)
+				{
+					size_t i = 0;
+					for (; i + 4 <= count; i += 4) {
+						auto sum = vmulq_n_f32(vld1q_f32(ppRows[0] + i), pWeights[0]);
+						for (auto r = 1u; r < rowCount; ++r) {
+							sum = vmlaq_n_f32(sum, vld1q_f32(ppRows[r] + i), pWeights[r]);
+						}
+						vst1q_f32(pDst + i, sum);
+					}
+					weightedRowsScalar(ppRows, pWeights, rowCount, i, count, pDst);
+				}
+
+				void horizontalBoxNeon(const float* pSrc, uint32_t dstWidth, uint32_t channelCount, float* pDst)
+				{
+					uint32_t x = 0;
+					if (4 == channelCount) {
+						for (; x < dstWidth; ++x) {
+							auto p = pSrc + x * 8;
+							vst1q_f32(pDst + x * 4, vmulq_n_f32(vaddq_f32(vld1q_f32(p), vld1q_f32(p + 4)), 0.5f));
+						}
+					} else {
+						for (; x + 4 <= dstWidth; x += 4) {
+							auto pair = vld2q_f32(pSrc + x * 2);
+							vst1q_f32(pDst + x, vmulq_n_f32(vaddq_f32(pair.val[0], pair.val[1]), 0.5f));
+						}
+					}
+					horizontalBoxScalar(pSrc, x, dstWidth, channelCount, pDst);
+				}
+
+				void horizontalTaps4Neon(const float* pSrc, uint32_t, uint32_t begin, uint32_t end, const float* pWeights, float* pDst)
+				{
+					for (auto x = begin; x < end; ++x) {
+						auto p = pSrc + (static_cast<size_t>(x) * 2 - (MipKernel::sKaiserTapCount / 2 - 1)) * 4;
+						auto sum = vmulq_n_f32(vld1q_f32(p), pWeights[0]);
+						for (auto k = 1u; k < MipKernel::sKaiserTapCount; ++k) {
+							sum = vmlaq_n_f32(sum, vld1q_f32(p + k * 4), pWeights[k]);
+						}
+						vst1q_f32(pDst + x * 4, sum);
+					}
+				}
+
+				void horizontalTaps1Neon(const float* pSrc, uint32_t srcWidth, uint32_t begin, uint32_t end, const float* pWeights, float* pDst)
+				{
+					//vld2q_f32は8要素読むので、最後のタップの1つ先まで範囲内か調べる
+					auto x = begin;
+					for (; x + 4 <= end && static_cast<size_t>(x) * 2 + 12 <= srcWidth; x += 4) {
+						auto p = pSrc + static_cast<size_t>(x) * 2 - (MipKernel::sKaiserTapCount / 2 - 1);
+						auto sum = vdupq_n_f32(0.f);
+						for (auto k = 0u; k < MipKernel::sKaiserTapCount; ++k) {
+							sum = vmlaq_n_f32(sum, vld2q_f32(p + k).val[0], pWeights[k]);
+						}
+						vst1q_f32(pDst + x, sum);
+					}
+					horizontalTapsScalar(pSrc, 1, x, end, pWeights, pDst);
+				}
+
+				const KernelTable sNeonKernels = {
+					weightedRowsNeon, horizontalBoxNeon, horizontalTaps4Neon, horizontalTaps1Neon,
+				};
+#endif
+
+				std::atomic<int>& currentInstructionSet()noexcept
+				{
+					static std::atomic<int> sSet(MipKernel::sDetectInstructionSet());
+					return sSet;
+				}
+
+				const KernelTable& kernels()noexcept
+				{
+					switch (currentInstructionSet().load(std::memory_order_relaxed)) {
+#ifdef HINODE_MIP_KERNEL_X86
+					case MipKernel::eINSTRUCTION_SET_SSE2: return sSse2Kernels;
+					case MipKernel::eINSTRUCTION_SET_AVX2: return sAvx2Kernels;
+#endif
+#ifdef HINODE_MIP_KERNEL_NEON
+					case MipKernel::eINSTRUCTION_SET_NEON: return sNeonKernels;
+#endif
+					default: return sScalarKernels;
+					}
+				}
+			}
+
+			MipKernel::INSTRUCTION_SET MipKernel::sDetectInstructionSet()noexcept
+			{
+#if defined(HINODE_MIP_KERNEL_X86)
+				static const INSTRUCTION_SET sDetected = isAvx2Supported() ? eINSTRUCTION_SET_AVX2 : eINSTRUCTION_SET_SSE2;
+				return sDetected;
+#elif defined(HINODE_MIP_KERNEL_NEON)
+				return eINSTRUCTION_SET_NEON;
+#else
+				return eINSTRUCTION_SET_SCALAR;
+#endif
+			}
+
+			MipKernel::INSTRUCTION_SET MipKernel::sGetInstructionSet()noexcept
+			{
+				return static_cast<INSTRUCTION_SET>(currentInstructionSet().load(std::memory_order_relaxed));
+			}
+
+			void MipKernel::sSetInstructionSet(INSTRUCTION_SET set)noexcept
+			{
+				auto detected = sDetectInstructionSet();
+				bool isSupported;
+				switch (set) {
+				case eINSTRUCTION_SET_SCALAR: isSupported = true; break;
+				case eINSTRUCTION_SET_SSE2: isSupported = eINSTRUCTION_SET_SSE2 == detected || eINSTRUCTION_SET_AVX2 == detected; break;
+				default: isSupported = set == detected; break;
+				}
+				currentInstructionSet().store(isSupported ? set : detected, std::memory_order_relaxed);
+			}
+
+			uint32_t MipKernel::sChannelCount(PIXEL_FORMAT format)noexcept
+			{
+				return ePIXEL_FORMAT_R32F == format ? 1 : 4;
+			}
+
+			uint32_t MipKernel::sTexelSize(PIXEL_FORMAT format)noexcept
+			{
+				switch (format) {
+				case ePIXEL_FORMAT_RGBA16F: return 8;
+				default: return 4;
+				}
+			}
+
+			void MipKernel::sDecodeRow(PIXEL_FORMAT format, const void* pSrc, float* pDst, uint32_t width)noexcept
+			{
+				switch (format) {
+				case ePIXEL_FORMAT_RGBA8_UNORM:
+				{
+					auto p = static_cast<const uint8_t*>(pSrc);
+					for (auto i = 0u; i < width * 4; ++i) {
+						pDst[i] = p[i] * (1.f / 255.f);
+					}
+					break;
+				}
+				case ePIXEL_FORMAT_RGBA8_SRGB:
+				{
+					auto& t = tables();
+					auto p = static_cast<const uint8_t*>(pSrc);
+					for (auto x = 0u; x < width; ++x, p += 4, pDst += 4) {
+						pDst[0] = t.srgbDecode[p[0]];
+						pDst[1] = t.srgbDecode[p[1]];
+						pDst[2] = t.srgbDecode[p[2]];
+						pDst[3] = p[3] * (1.f / 255.f);
+					}
+					break;
+				}
+				case ePIXEL_FORMAT_RGBA16F:
+				{
+					auto p = static_cast<const uint16_t*>(pSrc);
+					for (auto i = 0u; i < width * 4; ++i) {
+						pDst[i] = halfToFloat(p[i]);
+					}
+					break;
+				}
+				case ePIXEL_FORMAT_R32F:
+					std::memcpy(pDst, pSrc, sizeof(float) * width);
+					break;
+				default:
+					assert(false && "未対応のフォーマットです");
+				}
+			}
+
+			void MipKernel::sEncodeRow(PIXEL_FORMAT format, const float* pSrc, void* pDst, uint32_t width)noexcept
+			{
+				switch (format) {
+				case ePIXEL_FORMAT_RGBA8_UNORM:
+				{
+					auto p = static_cast<uint8_t*>(pDst);
+					for (auto i = 0u; i < width * 4; ++i) {
+						p[i] = encodeUnorm(pSrc[i]);
+					}
+					break;
+				}
+				case ePIXEL_FORMAT_RGBA8_SRGB:
+				{
+					auto& t = tables();
+					auto p = static_cast<uint8_t*>(pDst);
+					for (auto x = 0u; x < width; ++x, p += 4, pSrc += 4) {
+						p[0] = encodeSrgb(t, pSrc[0]);
+						p[1] = encodeSrgb(t, pSrc[1]);
+						p[2] = encodeSrgb(t, pSrc[2]);
+						p[3] = encodeUnorm(pSrc[3]);
+					}
+					break;
+				}
+				case ePIXEL_FORMAT_RGBA16F:
+				{
+					auto p = static_cast<uint16_t*>(pDst);
+					for (auto i = 0u; i < width * 4; ++i) {
+						p[i] = floatToHalf(pSrc[i]);
+					}
+					break;
+				}
+				case ePIXEL_FORMAT_R32F:
+					std::memcpy(pDst, pSrc, sizeof(float) * width);
+					break;
+				default:
+					assert(false && "未対応のフォーマットです");
+				}
+			}
+
+			void MipKernel::sDownsampleRow(FILTER filter, const float* pSrc, uint32_t srcWidth, uint32_t srcHeight, uint32_t channelCount, uint32_t dstY, float* pDst, float* pScratch)noexcept
+			{
+				assert(1 == channelCount || 4 == channelCount);
+				assert(0 < srcWidth && 0 < srcHeight);
+
+				auto& k = kernels();
+				auto dstWidth = std::max(1u, srcWidth / 2);
+				auto rowSize = static_cast<size_t>(srcWidth) * channelCount;
+
+				//縦方向. はみ出した行は端の行を繰り返す
+				const float* rows[sKaiserTapCount];
+				float boxWeights[] = { 0.5f, 0.5f, 0.f };
+				float kaiserWeights[sKaiserTapCount];
+				const float* pWeights;
+				uint32_t rowCount;
+				if (eFILTER_BOX == filter) {
+					rows[0] = pSrc + rowSize * std::min(dstY * 2, srcHeight - 1);
+					rows[1] = pSrc + rowSize * std::min(dstY * 2 + 1, srcHeight - 1);
+					rowCount = 2;
+					if (1 < srcHeight && 1 == (srcHeight & 1)) {
+						//2x2では最後の行が使われないので、3行にまたがらせる
+						rows[2] = pSrc + rowSize * (dstY * 2 + 2);
+						oddBoxWeights(srcHeight / 2, dstY, boxWeights);
+						rowCount = 3;
+					}
+					pWeights = boxWeights;
+				} else {
+					auto first = static_cast<int64_t>(dstY) * 2 - (sKaiserTapCount / 2 - 1);
+					pWeights = tables().kaiser;
+					if (1 < srcHeight && 1 == (srcHeight & 1)) {
+						first = kaiserWeightsAt(oddKaiserCenter(srcHeight / 2, dstY), kaiserWeights);
+						pWeights = kaiserWeights;
+					}
+					for (auto i = 0u; i < sKaiserTapCount; ++i) {
+						auto y = std::min<int64_t>(std::max<int64_t>(first + i, 0), srcHeight - 1);
+						rows[i] = pSrc + rowSize * static_cast<size_t>(y);
+					}
+					rowCount = sKaiserTapCount;
+				}
+				k.weightedRows(rows, pWeights, rowCount, rowSize, pScratch);
+
+				//横方向
+				if (eFILTER_BOX == filter) {
+					if (1 == srcWidth) {
+						std::memcpy(pDst, pScratch, sizeof(float) * channelCount);
+					} else if (1 == (srcWidth & 1)) {
+						horizontalBoxOdd(pScratch, dstWidth, channelCount, pDst);
+					} else {
+						k.horizontalBox(pScratch, dstWidth, channelCount, pDst);
+					}
+					return;
+				}
+
+				if (1 < srcWidth && 1 == (srcWidth & 1)) {
+					horizontalKaiserOdd(pScratch, srcWidth, dstWidth, channelCount, pDst);
+					return;
+				}
+
+				//すべてのタップが範囲内に収まる画素だけをSIMDで計算する
+				pWeights = tables().kaiser;
+				const uint32_t halfTaps = sKaiserTapCount / 2;
+				uint32_t interiorEnd = 0;
+				if (sKaiserTapCount <= srcWidth) {
+					interiorEnd = std::min(dstWidth, (srcWidth - halfTaps - 1) / 2 + 1);
+				}
+				auto interiorBegin = std::min(halfTaps / 2, interiorEnd);
+				for (auto x = 0u; x < interiorBegin; ++x) {
+					horizontalTapsClamped(pScratch, srcWidth, channelCount, x, pWeights, pDst);
+				}
+				if (interiorBegin < interiorEnd) {
+					auto taps = 4 == channelCount ? k.horizontalTaps4 : k.horizontalTaps1;
+					taps(pScratch, srcWidth, interiorBegin, interiorEnd, pWeights, pDst);
+				}
+				for (auto x = std::max(interiorBegin, interiorEnd); x < dstWidth; ++x) {
+					horizontalTapsClamped(pScratch, srcWidth, channelCount, x, pWeights, pDst);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,89 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace utility
+		{
+			/// @brief CPUでミップマップを作るための縮小カーネル
+			///
+			/// 画素はすべてリニアな空間のfloatに展開してから縮小し、書き出すときに元のフォーマットへ戻します。
+			/// sRGBのフォーマットはRGBだけをリニアに変換し、アルファはそのまま扱います。
+			/// 縮小は縦方向と横方向に分けて行い、x86ではSSE2とAVX2(実行時に判定)、ARMではNEONを使います。
+			/// すべての関数はスレッドセーフで、行ごとに別のスレッドから呼び出せます
+			class MipKernel
+			{
+			public:
+				enum PIXEL_FORMAT {
+					ePIXEL_FORMAT_RGBA8_UNORM,
+					ePIXEL_FORMAT_RGBA8_SRGB,
+					ePIXEL_FORMAT_RGBA16F,
+					ePIXEL_FORMAT_R32F,
+				};
+
+				enum FILTER {
+					eFILTER_BOX,	///< 2x2の平均. 奇数の大きさの方向は最後の画素を捨てないよう3画素に重みをつけて平均します
+					eFILTER_KAISER,	///< カイザー窓をかけたsinc. 縦横それぞれsKaiserTapCount画素を使います. 奇数の大きさの方向は縮小前後の端がそろうよう中心をずらします
+				};
+
+				enum INSTRUCTION_SET {
+					eINSTRUCTION_SET_SCALAR,
+					eINSTRUCTION_SET_SSE2,
+					eINSTRUCTION_SET_AVX2,
+					eINSTRUCTION_SET_NEON,
+				};
+
+				static const uint32_t sKaiserTapCount = 8;
+
+			public:
+				/// @brief 実行しているCPUで使える最も速い命令セットを返す
+				/// @retval INSTRUCTION_SET
+				static INSTRUCTION_SET sDetectInstructionSet()noexcept;
+
+				/// @brief 現在使っている命令セットを返す
+				/// @retval INSTRUCTION_SET
+				static INSTRUCTION_SET sGetInstructionSet()noexcept;
+
+				/// @brief 使う命令セットを変える. 比較や検証用です
+				///
+				/// CPUが対応していないものを指定したときはsDetectInstructionSet()の結果を使います
+				/// @param[in] set
+				static void sSetInstructionSet(INSTRUCTION_SET set)noexcept;
+
+				static uint32_t sChannelCount(PIXEL_FORMAT format)noexcept;
+				static uint32_t sTexelSize(PIXEL_FORMAT format)noexcept;
+
+				/// @brief 1行をリニアなfloatに展開する
+				/// @param[in] format
+				/// @param[in] pSrc
+				/// @param[out] pDst width * sChannelCount(format)個
+				/// @param[in] width
+				static void sDecodeRow(PIXEL_FORMAT format, const void* pSrc, float* pDst, uint32_t width)noexcept;
+
+				/// @brief リニアなfloatの1行をformatに書き出す
+				/// @param[in] format
+				/// @param[in] pSrc
+				/// @param[out] pDst width * sTexelSize(format)バイト
+				/// @param[in] width
+				static void sEncodeRow(PIXEL_FORMAT format, const float* pSrc, void* pDst, uint32_t width)noexcept;
+
+				/// @brief 縮小した画像の1行を計算する
+				///
+				/// 縮小後の大きさは縦横それぞれmax(1, 元の大きさ / 2)です
+				/// @param[in] filter
+				/// @param[in] pSrc 縮小元の画像. 行の間に隙間がないこと
+				/// @param[in] srcWidth
+				/// @param[in] srcHeight
+				/// @param[in] channelCount 1か4
+				/// @param[in] dstY 計算する行
+				/// @param[out] pDst 縮小後の1行
+				/// @param[in] pScratch 作業用. srcWidth * channelCount個
+				static void sDownsampleRow(FILTER filter, const float* pSrc, uint32_t srcWidth, uint32_t srcHeight, uint32_t channelCount, uint32_t dstY, float* pDst, float* pScratch)noexcept;
+			};
+		}
+	}
+}
@@ -0,0 +1,150 @@
+﻿#include "SizeClassPool.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <utility> // for std::move
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace utility
+		{
+			namespace
+			{
+				inline uintptr_t alignUp(uintptr_t value, uintptr_t alignment)noexcept
+				{
+					return (value + alignment - 1) & ~(alignment - 1);
+				}
+			}
+
+			uint32_t SizeClassPool::sCalClassIndex(size_t size)noexcept
+			{
+				uint32_t index = 0;
+				for (auto classSize = sMinClassSize; classSize < size && index < sClassCount; classSize <<= 1) {
+					++index;
+				}
+				return index;
+			}
+
+			size_t SizeClassPool::sClassSize(uint32_t classIndex)noexcept
+			{
+				assert(classIndex < sClassCount);
+				return sMinClassSize << classIndex;
+			}
+
+			SizeClassPool::SizeClassPool()
+				: mAllocationCount(0)
+			{
+				for (auto& pList : this->mpFreeLists) {
+					pList = nullptr;
+				}
+			}
+
+			SizeClassPool::SizeClassPool(SizeClassPool&& right)noexcept
+				: SizeClassPool()
+			{
+				*this = std::move(right);
+			}
+
+			SizeClassPool& SizeClassPool::operator=(SizeClassPool&& right)noexcept
+			{
+				this->release();
+
+				for (auto i = 0u; i < sClassCount; ++i) {
+					this->mpFreeLists[i] = right.mpFreeLists[i];
+					right.mpFreeLists[i] = nullptr;
+				}
+				this->mChunks = std::move(right.mChunks);
+				this->mAllocationCount = right.mAllocationCount;
+
+				right.mChunks.clear();
+				right.mAllocationCount = 0;
+				return *this;
+			}
+
+			SizeClassPool::~SizeClassPool()
+			{
+				this->release();
+			}
+
+			void SizeClassPool::release()noexcept
+			{
+				for (auto* pChunk : this->mChunks) {
+					std::free(pChunk);
+				}
+				this->mChunks.clear();
+				this->mChunks.shrink_to_fit();
+				for (auto& pList : this->mpFreeLists) {
+					pList = nullptr;
+				}
+				this->mAllocationCount = 0;
+			}
+
+			void* SizeClassPool::allocate(uint32_t classIndex)noexcept
+			{
+				assert(classIndex < sClassCount);
+
+				auto& pList = this->mpFreeLists[classIndex];
+				if (nullptr == pList && !this->addChunk(classIndex)) {
+					return nullptr;
+				}
+				auto* pNode = pList;
+				pList = pNode->pNext;
+				++this->mAllocationCount;
+				return pNode;
+			}
+
+			void SizeClassPool::free(void* pBlock, uint32_t classIndex)noexcept
+			{
+				assert(classIndex < sClassCount);
+				if (nullptr == pBlock) {
+					return;
+				}
+				assert(0 < this->mAllocationCount);
+
+				auto* pNode = static_cast<FreeNode*>(pBlock);
+				pNode->pNext = this->mpFreeLists[classIndex];
+				this->mpFreeLists[classIndex] = pNode;
+				--this->mAllocationCount;
+			}
+
+			bool SizeClassPool::addChunk(uint32_t classIndex)noexcept
+			{
+				//mallocのアライメントは処理系によって8のこともあるので自分で揃える
+				auto* pChunk = std::malloc(sChunkSize + sBlockAlignment - 1);
+				if (nullptr == pChunk) {
+					return false;
+				}
+				try {
+					this->mChunks.push_back(pChunk);
+				} catch (...) {
+					std::free(pChunk);
+					return false;
+				}
+
+				auto classSize = sClassSize(classIndex);
+				auto begin = alignUp(reinterpret_cast<uintptr_t>(pChunk), sBlockAlignment);
+				auto blockCount = sChunkSize / classSize;
+				//先頭から順に使われるよう後ろから積む
+				auto& pList = this->mpFreeLists[classIndex];
+				for (auto i = blockCount; 0 < i; --i) {
+					auto* pNode = reinterpret_cast<FreeNode*>(begin + (i - 1) * classSize);
+					pNode->pNext = pList;
+					pList = pNode;
+				}
+				return true;
+			}
+
+			size_t SizeClassPool::chunkCount()const noexcept
+			{
+				return this->mChunks.size();
+			}
+
+			size_t SizeClassPool::allocationCount()const noexcept
+			{
+				return this->mAllocationCount;
+			}
+		}
+	}
+}
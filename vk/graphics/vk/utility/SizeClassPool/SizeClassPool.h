@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace utility
+		{
+			/// @brief 大きさごとのクラスに分けた固定長ブロックのプール
+			///
+			/// 各クラスはsChunkSizeのチャンクを切り分けたフリーリストを持ち、割り当てと解放は定数時間で行われます。
+			/// ブロックの先頭は常にsBlockAlignmentに揃っています。
+			/// スレッドセーフではありません
+			class SizeClassPool
+			{
+				SizeClassPool(const SizeClassPool&) = delete;
+				SizeClassPool& operator=(const SizeClassPool&) = delete;
+
+			public:
+				static const uint32_t sClassCount = 8;		///< 32, 64, ..., 4096
+				static const size_t sMinClassSize = 32;
+				static const size_t sMaxClassSize = sMinClassSize << (sClassCount - 1);
+				static const size_t sChunkSize = 64 * 1024;
+				static const size_t sBlockAlignment = 16;
+
+				/// @brief sizeが入るクラスを返す
+				/// @param[in] size
+				/// @retval uint32_t sMaxClassSizeより大きいときはsClassCount
+				static uint32_t sCalClassIndex(size_t size)noexcept;
+
+				/// @brief クラスのブロックの大きさ
+				/// @param[in] classIndex
+				/// @retval size_t
+				static size_t sClassSize(uint32_t classIndex)noexcept;
+
+			public:
+				SizeClassPool();
+				SizeClassPool(SizeClassPool&& right)noexcept;
+				SizeClassPool& operator=(SizeClassPool&& right)noexcept;
+				~SizeClassPool();
+
+				/// @brief すべてのチャンクを解放する
+				///
+				/// 割り当て中のブロックも無効になります
+				void release()noexcept;
+
+				/// @brief 割り当て
+				/// @param[in] classIndex sClassCount未満
+				/// @retval void* 失敗したときはnullptr
+				void* allocate(uint32_t classIndex)noexcept;
+
+				/// @brief 解放
+				/// @param[in] pBlock allocateで返されたもの
+				/// @param[in] classIndex 割り当てたときに指定したもの
+				void free(void* pBlock, uint32_t classIndex)noexcept;
+
+			public:
+				size_t chunkCount()const noexcept;
+				size_t allocationCount()const noexcept;
+
+			private:
+				struct FreeNode
+				{
+					FreeNode* pNext;
+				};
+
+				bool addChunk(uint32_t classIndex)noexcept;
+
+			private:
+				FreeNode* mpFreeLists[sClassCount];
+				std::vector<void*> mChunks;
+				size_t mAllocationCount;
+			};
+		}
+	}
+}
@@ -0,0 +1,449 @@
+﻿#include "TLSFAllocator.h"
+
+#include <cassert>
+#include <cstring>
+#include <utility> // for std::move
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace utility
+		{
+			namespace
+			{
+				const size_t NODE_CHUNK_SIZE = 256;
+
+				inline TLSFAllocator::size_type alignUp(TLSFAllocator::size_type value, TLSFAllocator::size_type alignment)noexcept
+				{
+					return (value + alignment - 1) & ~(alignment - 1);
+				}
+			}
+
+			uint32_t TLSFAllocator::sFindMSB(size_type v)noexcept
+			{
+				assert(0 != v);
+#ifdef _MSC_VER
+				unsigned long index;
+				if (_BitScanReverse(&index, static_cast<unsigned long>(v >> 32))) {
+					return index + 32;
+				}
+				_BitScanReverse(&index, static_cast<unsigned long>(v));
+				return index;
+#else
+				return 63 - __builtin_clzll(v);
+#endif
+			}
+
+			uint32_t TLSFAllocator::sFindLSB(uint64_t v)noexcept
+			{
+				assert(0 != v);
+#ifdef _MSC_VER
+				unsigned long index;
+				if (_BitScanForward(&index, static_cast<unsigned long>(v))) {
+					return index;
+				}
+				_BitScanForward(&index, static_cast<unsigned long>(v >> 32));
+				return index + 32;
+#else
+				return __builtin_ctzll(v);
+#endif
+			}
+
+			void TLSFAllocator::sMappingInsert(size_type size, uint32_t* pOutFL, uint32_t* pOutSL)noexcept
+			{
+				if (size < SL_INDEX_COUNT) {
+					*pOutFL = 0;
+					*pOutSL = static_cast<uint32_t>(size);
+				} else {
+					auto msb = sFindMSB(size);
+					*pOutSL = static_cast<uint32_t>(size >> (msb - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+					*pOutFL = msb - SL_INDEX_COUNT_LOG2 + 1;
+				}
+			}
+
+			void TLSFAllocator::sMappingSearch(size_type size, uint32_t* pOutFL, uint32_t* pOutSL)noexcept
+			{
+				//見つかったリストのどのブロックでもsizeが入るように切り上げる
+				if (SL_INDEX_COUNT <= size) {
+					size += (static_cast<size_type>(1) << (sFindMSB(size) - SL_INDEX_COUNT_LOG2)) - 1;
+				}
+				sMappingInsert(size, pOutFL, pOutSL);
+			}
+
+			TLSFAllocator::TLSFAllocator()
+				: mCapacity(0)
+				, mGranularity(1)
+				, mUsedSize(0)
+				, mAllocationCount(0)
+				, mFLBitmap(0)
+				, mpUnusedNodes(nullptr)
+				, mpFirstNode(nullptr)
+			{
+				memset(this->mSLBitmap, 0, sizeof(this->mSLBitmap));
+				memset(this->mFreeLists, 0, sizeof(this->mFreeLists));
+			}
+
+			TLSFAllocator::TLSFAllocator(TLSFAllocator&& right)noexcept
+				: TLSFAllocator()
+			{
+				*this = std::move(right);
+			}
+
+			TLSFAllocator& TLSFAllocator::operator=(TLSFAllocator&& right)noexcept
+			{
+				this->release();
+
+				this->mCapacity = right.mCapacity;
+				this->mGranularity = right.mGranularity;
+				this->mUsedSize = right.mUsedSize;
+				this->mAllocationCount = right.mAllocationCount;
+				this->mFLBitmap = right.mFLBitmap;
+				memcpy(this->mSLBitmap, right.mSLBitmap, sizeof(this->mSLBitmap));
+				memcpy(this->mFreeLists, right.mFreeLists, sizeof(this->mFreeLists));
+				this->mNodeChunks = std::move(right.mNodeChunks);
+				this->mpUnusedNodes = right.mpUnusedNodes;
+				this->mpFirstNode = right.mpFirstNode;
+
+				right.mNodeChunks.clear();
+				right.release();
+				return *this;
+			}
+
+			TLSFAllocator::~TLSFAllocator()
+			{
+				this->release();
+			}
+
+			void TLSFAllocator::release()noexcept
+			{
+				this->mNodeChunks.clear();
+				this->mNodeChunks.shrink_to_fit();
+				this->mpUnusedNodes = nullptr;
+				this->mpFirstNode = nullptr;
+
+				this->mCapacity = 0;
+				this->mGranularity = 1;
+				this->mUsedSize = 0;
+				this->mAllocationCount = 0;
+				this->mFLBitmap = 0;
+				memset(this->mSLBitmap, 0, sizeof(this->mSLBitmap));
+				memset(this->mFreeLists, 0, sizeof(this->mFreeLists));
+			}
+
+			void TLSFAllocator::create(size_type capacity, size_type granularity)
+			{
+				assert(0 < capacity);
+				assert(0 < granularity && 0 == (granularity & (granularity - 1)));
+				this->release();
+
+				this->mCapacity = capacity;
+				this->mGranularity = granularity;
+
+				auto* pNode = this->newNode();
+				pNode->offset = 0;
+				pNode->size = capacity;
+				pNode->isFree = true;
+				this->mpFirstNode = pNode;
+				this->insertFreeNode(pNode);
+			}
+
+			TLSFAllocator::Allocation TLSFAllocator::allocate(size_type size, size_type alignment, uint32_t tag)noexcept
+			{
+				assert(this->isGood());
+				assert(0 == alignment || 0 == (alignment & (alignment - 1)));
+
+				Allocation result;
+				if (0 == size) size = 1;
+				if (0 == alignment) alignment = 1;
+				if (this->freeSize() < size) {
+					return result;
+				}
+
+				//まずはアライメントとページ境界の余白を含めた大きさで探す. 見つかればどのブロックでも入る
+				size_type offset = 0;
+				Node* pTarget = nullptr;
+				{
+					auto searchSize = size + alignment - 1;
+					if (1 < this->mGranularity) {
+						searchSize += (this->mGranularity - 1) * 2;
+					}
+					uint32_t fl, sl;
+					sMappingSearch(searchSize, &fl, &sl);
+					auto* pNode = this->findFreeNode(fl, sl);
+					if (pNode && this->fit(pNode, size, alignment, tag, &offset)) {
+						pTarget = pNode;
+					}
+				}
+
+				//見つからなければ、sizeが入る可能性のあるリストを順に調べる
+				if (nullptr == pTarget) {
+					uint32_t fl, sl;
+					sMappingInsert(size, &fl, &sl);
+					for (; fl < FL_INDEX_COUNT && nullptr == pTarget; ++fl, sl = 0) {
+						if (0 == (this->mFLBitmap & (static_cast<uint64_t>(1) << fl))) {
+							continue;
+						}
+						for (; sl < SL_INDEX_COUNT && nullptr == pTarget; ++sl) {
+							for (auto* pNode = this->mFreeLists[fl][sl]; pNode; pNode = pNode->pNextFree) {
+								if (this->fit(pNode, size, alignment, tag, &offset)) {
+									pTarget = pNode;
+									break;
+								}
+							}
+						}
+					}
+					if (nullptr == pTarget) {
+						return result;
+					}
+				}
+
+				this->removeFreeNode(pTarget);
+
+				//前方の余白を空きブロックとして切り出す
+				if (pTarget->offset < offset) {
+					auto* pFront = this->newNode();
+					pFront->offset = pTarget->offset;
+					pFront->size = offset - pTarget->offset;
+					pFront->isFree = true;
+					pFront->pPrevPhys = pTarget->pPrevPhys;
+					pFront->pNextPhys = pTarget;
+					if (pFront->pPrevPhys) {
+						pFront->pPrevPhys->pNextPhys = pFront;
+					} else {
+						this->mpFirstNode = pFront;
+					}
+					pTarget->pPrevPhys = pFront;
+					pTarget->offset = offset;
+					pTarget->size -= pFront->size;
+					this->insertFreeNode(pFront);
+				}
+
+				//後方の残りを空きブロックとして切り出す
+				if (size < pTarget->size) {
+					auto* pBack = this->newNode();
+					pBack->offset = offset + size;
+					pBack->size = pTarget->size - size;
+					pBack->isFree = true;
+					pBack->pPrevPhys = pTarget;
+					pBack->pNextPhys = pTarget->pNextPhys;
+					if (pBack->pNextPhys) {
+						pBack->pNextPhys->pPrevPhys = pBack;
+					}
+					pTarget->pNextPhys = pBack;
+					pTarget->size = size;
+					this->insertFreeNode(pBack);
+				}
+
+				pTarget->isFree = false;
+				pTarget->tag = tag;
+				this->mUsedSize += pTarget->size;
+				++this->mAllocationCount;
+
+				result.offset = pTarget->offset;
+				result.size = pTarget->size;
+				result.pNode = pTarget;
+				return result;
+			}
+
+			void TLSFAllocator::free(const Allocation& allocation)noexcept
+			{
+				auto* pNode = allocation.pNode;
+				if (nullptr == pNode) {
+					return;
+				}
+				assert(!pNode->isFree);
+
+				this->mUsedSize -= pNode->size;
+				--this->mAllocationCount;
+				pNode->isFree = true;
+
+				auto* pPrev = pNode->pPrevPhys;
+				if (pPrev && pPrev->isFree) {
+					this->removeFreeNode(pPrev);
+					pPrev->size += pNode->size;
+					pPrev->pNextPhys = pNode->pNextPhys;
+					if (pPrev->pNextPhys) {
+						pPrev->pNextPhys->pPrevPhys = pPrev;
+					}
+					this->deleteNode(pNode);
+					pNode = pPrev;
+				}
+
+				auto* pNext = pNode->pNextPhys;
+				if (pNext && pNext->isFree) {
+					this->removeFreeNode(pNext);
+					pNode->size += pNext->size;
+					pNode->pNextPhys = pNext->pNextPhys;
+					if (pNode->pNextPhys) {
+						pNode->pNextPhys->pPrevPhys = pNode;
+					}
+					this->deleteNode(pNext);
+				}
+
+				this->insertFreeNode(pNode);
+			}
+
+			TLSFAllocator::Node* TLSFAllocator::newNode()noexcept
+			{
+				if (nullptr == this->mpUnusedNodes) {
+					std::unique_ptr<Node[]> chunk(new Node[NODE_CHUNK_SIZE]);
+					for (size_t i = 0; i < NODE_CHUNK_SIZE; ++i) {
+						chunk[i].pNextFree = (i + 1 < NODE_CHUNK_SIZE) ? &chunk[i + 1] : nullptr;
+					}
+					this->mpUnusedNodes = &chunk[0];
+					this->mNodeChunks.push_back(std::move(chunk));
+				}
+
+				auto* pNode = this->mpUnusedNodes;
+				this->mpUnusedNodes = pNode->pNextFree;
+				memset(pNode, 0, sizeof(Node));
+				return pNode;
+			}
+
+			void TLSFAllocator::deleteNode(Node* pNode)noexcept
+			{
+				pNode->pNextFree = this->mpUnusedNodes;
+				this->mpUnusedNodes = pNode;
+			}
+
+			void TLSFAllocator::insertFreeNode(Node* pNode)noexcept
+			{
+				uint32_t fl, sl;
+				sMappingInsert(pNode->size, &fl, &sl);
+
+				auto*& pHead = this->mFreeLists[fl][sl];
+				pNode->pPrevFree = nullptr;
+				pNode->pNextFree = pHead;
+				if (pHead) {
+					pHead->pPrevFree = pNode;
+				}
+				pHead = pNode;
+
+				this->mFLBitmap |= static_cast<uint64_t>(1) << fl;
+				this->mSLBitmap[fl] |= 1u << sl;
+			}
+
+			void TLSFAllocator::removeFreeNode(Node* pNode)noexcept
+			{
+				uint32_t fl, sl;
+				sMappingInsert(pNode->size, &fl, &sl);
+
+				if (pNode->pPrevFree) {
+					pNode->pPrevFree->pNextFree = pNode->pNextFree;
+				} else {
+					this->mFreeLists[fl][sl] = pNode->pNextFree;
+				}
+				if (pNode->pNextFree) {
+					pNode->pNextFree->pPrevFree = pNode->pPrevFree;
+				}
+				pNode->pPrevFree = nullptr;
+				pNode->pNextFree = nullptr;
+
+				if (nullptr == this->mFreeLists[fl][sl]) {
+					this->mSLBitmap[fl] &= ~(1u << sl);
+					if (0 == this->mSLBitmap[fl]) {
+						this->mFLBitmap &= ~(static_cast<uint64_t>(1) << fl);
+					}
+				}
+			}
+
+			TLSFAllocator::Node* TLSFAllocator::findFreeNode(uint32_t fl, uint32_t sl)noexcept
+			{
+				if (FL_INDEX_COUNT <= fl) {
+					return nullptr;
+				}
+				uint32_t slMap = this->mSLBitmap[fl] & (~0u << sl);
+				if (0 == slMap) {
+					if (FL_INDEX_COUNT <= fl + 1) {
+						return nullptr;
+					}
+					uint64_t flMap = this->mFLBitmap & (~static_cast<uint64_t>(0) << (fl + 1));
+					if (0 == flMap) {
+						return nullptr;
+					}
+					fl = sFindLSB(flMap);
+					slMap = this->mSLBitmap[fl];
+				}
+				sl = sFindLSB(slMap);
+				return this->mFreeLists[fl][sl];
+			}
+
+			bool TLSFAllocator::fit(const Node* pNode, size_type size, size_type alignment, uint32_t tag, size_type* pOutOffset)const noexcept
+			{
+				auto offset = alignUp(pNode->offset, alignment);
+				if (this->isConflictPage(pNode->pPrevPhys, offset, tag, true)) {
+					offset = alignUp(offset, this->mGranularity);
+				}
+				if (pNode->offset + pNode->size < offset + size) {
+					return false;
+				}
+				if (this->isConflictPage(pNode->pNextPhys, offset + size - 1, tag, false)) {
+					return false;
+				}
+				*pOutOffset = offset;
+				return true;
+			}
+
+			bool TLSFAllocator::isConflictPage(const Node* pUsedNode, size_type offset, uint32_t tag, bool isPrev)const noexcept
+			{
+				if (this->mGranularity <= 1 || nullptr == pUsedNode || pUsedNode->isFree || pUsedNode->tag == tag) {
+					return false;
+				}
+				auto pageMask = ~(this->mGranularity - 1);
+				auto neighborOffset = isPrev ? pUsedNode->offset + pUsedNode->size - 1 : pUsedNode->offset;
+				return (neighborOffset & pageMask) == (offset & pageMask);
+			}
+
+			bool TLSFAllocator::isGood()const noexcept
+			{
+				return 0 < this->mCapacity;
+			}
+
+			bool TLSFAllocator::isEmpty()const noexcept
+			{
+				return 0 == this->mAllocationCount;
+			}
+
+			TLSFAllocator::size_type TLSFAllocator::capacity()const noexcept
+			{
+				return this->mCapacity;
+			}
+
+			TLSFAllocator::size_type TLSFAllocator::usedSize()const noexcept
+			{
+				return this->mUsedSize;
+			}
+
+			TLSFAllocator::size_type TLSFAllocator::freeSize()const noexcept
+			{
+				return this->mCapacity - this->mUsedSize;
+			}
+
+			TLSFAllocator::size_type TLSFAllocator::largestFreeSize()const noexcept
+			{
+				if (0 == this->mFLBitmap) {
+					return 0;
+				}
+				//最も大きいクラスのリストだけを調べればよい
+				auto fl = sFindMSB(this->mFLBitmap);
+				auto sl = sFindMSB(this->mSLBitmap[fl]);
+				size_type result = 0;
+				for (auto* pNode = this->mFreeLists[fl][sl]; nullptr != pNode; pNode = pNode->pNextFree) {
+					result = std::max(result, pNode->size);
+				}
+				return result;
+			}
+
+			size_t TLSFAllocator::allocationCount()const noexcept
+			{
+				return this->mAllocationCount;
+			}
+		}
+	}
+}
@@ -0,0 +1,129 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace utility
+		{
+			/// @brief TLSF(Two-Level Segregated Fit)によるオフセットの割り当てを行うクラス
+			///
+			/// 実際のメモリは持たず、[0, capacity)の範囲を切り分けたオフセットを返します。
+			/// 割り当てと解放はどちらも定数時間で行われます。
+			/// 割り当てごとにタグを指定でき、タグが異なる割り当て同士はgranularityで指定したページを共有しないように配置されます。
+			/// (VkPhysicalDeviceLimits::bufferImageGranularityに対応するためのもの)
+			class TLSFAllocator
+			{
+				TLSFAllocator(const TLSFAllocator&) = delete;
+				TLSFAllocator& operator=(const TLSFAllocator&) = delete;
+
+			public:
+				using size_type = uint64_t;
+
+				/// @brief 物理的に隣接するブロックを表すノード
+				struct Node
+				{
+					size_type offset;
+					size_type size;
+					Node* pPrevPhys;
+					Node* pNextPhys;
+					Node* pPrevFree;
+					Node* pNextFree;
+					uint32_t tag;
+					bool isFree;
+				};
+
+				/// @brief 割り当て結果
+				struct Allocation
+				{
+					size_type offset;
+					size_type size;
+					Node* pNode;
+
+					Allocation()noexcept : offset(0), size(0), pNode(nullptr) {}
+					bool isGood()const noexcept { return nullptr != this->pNode; }
+				};
+
+			public:
+				TLSFAllocator();
+				TLSFAllocator(TLSFAllocator&& right)noexcept;
+				TLSFAllocator& operator=(TLSFAllocator&& right)noexcept;
+				~TLSFAllocator();
+
+				void release()noexcept;
+
+				/// @brief 管理する範囲を設定する
+				/// @param[in] capacity
+				/// @param[in] granularity 異なるタグを持つ割り当て同士が共有できないページの大きさ. 2の累乗であること
+				void create(size_type capacity, size_type granularity = 1);
+
+				/// @brief 割り当て
+				///
+				/// 割り当てに失敗したときはisGood()がfalseを返すAllocationを返します
+				/// @param[in] size
+				/// @param[in] alignment 2の累乗であること
+				/// @param[in] tag
+				/// @retval Allocation
+				Allocation allocate(size_type size, size_type alignment, uint32_t tag = 0)noexcept;
+
+				/// @brief 解放. 定数時間で終わります
+				/// @param[in] allocation
+				void free(const Allocation& allocation)noexcept;
+
+			public:
+				bool isGood()const noexcept;
+				bool isEmpty()const noexcept;
+				size_type capacity()const noexcept;
+				size_type usedSize()const noexcept;
+				size_type freeSize()const noexcept;
+
+				/// @brief 最も大きな空き領域の大きさ. 断片化の度合いを調べるのに使います
+				/// @retval size_type
+				size_type largestFreeSize()const noexcept;
+				size_t allocationCount()const noexcept;
+
+			private:
+				enum {
+					SL_INDEX_COUNT_LOG2 = 5,
+					SL_INDEX_COUNT = 1 << SL_INDEX_COUNT_LOG2,
+					FL_INDEX_COUNT = 64 - SL_INDEX_COUNT_LOG2 + 1,
+				};
+
+				static uint32_t sFindMSB(size_type v)noexcept;
+				static uint32_t sFindLSB(uint64_t v)noexcept;
+				static void sMappingInsert(size_type size, uint32_t* pOutFL, uint32_t* pOutSL)noexcept;
+				static void sMappingSearch(size_type size, uint32_t* pOutFL, uint32_t* pOutSL)noexcept;
+
+				Node* newNode()noexcept;
+				void deleteNode(Node* pNode)noexcept;
+
+				void insertFreeNode(Node* pNode)noexcept;
+				void removeFreeNode(Node* pNode)noexcept;
+				Node* findFreeNode(uint32_t fl, uint32_t sl)noexcept;
+
+				/// @brief pNodeにsize, alignment, tagの割り当てが入るか調べる
+				/// @retval bool 入るときはpOutOffsetに割り当て先のオフセットを設定します
+				bool fit(const Node* pNode, size_type size, size_type alignment, uint32_t tag, size_type* pOutOffset)const noexcept;
+				bool isConflictPage(const Node* pUsedNode, size_type offset, uint32_t tag, bool isPrev)const noexcept;
+
+			private:
+				size_type mCapacity;
+				size_type mGranularity;
+				size_type mUsedSize;
+				size_t mAllocationCount;
+
+				uint64_t mFLBitmap;
+				uint32_t mSLBitmap[FL_INDEX_COUNT];
+				Node* mFreeLists[FL_INDEX_COUNT][SL_INDEX_COUNT];
+
+				std::vector<std::unique_ptr<Node[]>> mNodeChunks;
+				Node* mpUnusedNodes;
+				Node* mpFirstNode;
+			};
+		}
+	}
+}
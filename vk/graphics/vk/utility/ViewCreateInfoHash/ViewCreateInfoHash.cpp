@@ -0,0 +1,104 @@
+﻿#include "ViewCreateInfoHash.h"
+
+#include <cstdint>
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace utility
+		{
+			namespace
+			{
+				//FNV-1a
+				class Hasher
+				{
+				public:
+					Hasher()noexcept : mValue(14695981039346656037ull) {}
+
+					Hasher& add(uint64_t value)noexcept
+					{
+						for (auto i = 0u; i < 8; ++i) {
+							this->mValue ^= (value >> (i * 8)) & 0xff;
+							this->mValue *= 1099511628211ull;
+						}
+						return *this;
+					}
+
+					size_t value()const noexcept { return static_cast<size_t>(this->mValue); }
+
+				private:
+					uint64_t mValue;
+				};
+
+				VkComponentSwizzle resolveSwizzle(VkComponentSwizzle swizzle, VkComponentSwizzle identity)noexcept
+				{
+					return VK_COMPONENT_SWIZZLE_IDENTITY == swizzle ? identity : swizzle;
+				}
+
+				VkComponentMapping resolveComponents(const VkComponentMapping& components)noexcept
+				{
+					VkComponentMapping result;
+					result.r = resolveSwizzle(components.r, VK_COMPONENT_SWIZZLE_R);
+					result.g = resolveSwizzle(components.g, VK_COMPONENT_SWIZZLE_G);
+					result.b = resolveSwizzle(components.b, VK_COMPONENT_SWIZZLE_B);
+					result.a = resolveSwizzle(components.a, VK_COMPONENT_SWIZZLE_A);
+					return result;
+				}
+			}
+
+			size_t hashViewCreateInfo(const VkBufferViewCreateInfo& info)noexcept
+			{
+				return Hasher()
+					.add(info.flags)
+					.add(info.format)
+					.add(info.offset)
+					.add(info.range)
+					.value();
+			}
+
+			size_t hashViewCreateInfo(const VkImageViewCreateInfo& info)noexcept
+			{
+				auto components = resolveComponents(info.components);
+				auto& range = info.subresourceRange;
+				return Hasher()
+					.add(info.flags)
+					.add(info.viewType)
+					.add(info.format)
+					.add(components.r).add(components.g).add(components.b).add(components.a)
+					.add(range.aspectMask)
+					.add(range.baseMipLevel).add(range.levelCount)
+					.add(range.baseArrayLayer).add(range.layerCount)
+					.value();
+			}
+
+			bool isSameViewCreateInfo(const VkBufferViewCreateInfo& left, const VkBufferViewCreateInfo& right)noexcept
+			{
+				return left.flags == right.flags
+					&& left.format == right.format
+					&& left.offset == right.offset
+					&& left.range == right.range;
+			}
+
+			bool isSameViewCreateInfo(const VkImageViewCreateInfo& left, const VkImageViewCreateInfo& right)noexcept
+			{
+				auto leftComponents = resolveComponents(left.components);
+				auto rightComponents = resolveComponents(right.components);
+				auto& leftRange = left.subresourceRange;
+				auto& rightRange = right.subresourceRange;
+				return left.flags == right.flags
+					&& left.viewType == right.viewType
+					&& left.format == right.format
+					&& leftComponents.r == rightComponents.r
+					&& leftComponents.g == rightComponents.g
+					&& leftComponents.b == rightComponents.b
+					&& leftComponents.a == rightComponents.a
+					&& leftRange.aspectMask == rightRange.aspectMask
+					&& leftRange.baseMipLevel == rightRange.baseMipLevel
+					&& leftRange.levelCount == rightRange.levelCount
+					&& leftRange.baseArrayLayer == rightRange.baseArrayLayer
+					&& leftRange.layerCount == rightRange.layerCount;
+			}
+		}
+	}
+}
@@ -0,0 +1,42 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <vulkan\vulkan.h>
+
+namespace hinode
+{
+	namespace graphics
+	{
+		namespace utility
+		{
+			/// @brief ビューの作成情報のハッシュ値を計算する
+			///
+			/// 構造体のパディングを含めないよう、ビューの内容を決めるメンバだけを使います。
+			/// pNextの先は見ないので、pNextを持つ作成情報は呼び出し側で比較対象から外してください
+			/// @param[in] info
+			/// @retval size_t
+			size_t hashViewCreateInfo(const VkBufferViewCreateInfo& info)noexcept;
+
+			/// @brief ビューの作成情報のハッシュ値を計算する
+			///
+			/// format, components, subresourceRangeなど、ビューの内容を決めるメンバだけを使います
+			/// @param[in] info
+			/// @retval size_t
+			size_t hashViewCreateInfo(const VkImageViewCreateInfo& info)noexcept;
+
+			/// @brief 同じビューが作られる作成情報か調べる
+			/// @param[in] left
+			/// @param[in] right
+			/// @retval bool
+			bool isSameViewCreateInfo(const VkBufferViewCreateInfo& left, const VkBufferViewCreateInfo& right)noexcept;
+
+			/// @brief 同じビューが作られる作成情報か調べる
+			///
+			/// VK_COMPONENT_SWIZZLE_IDENTITYと対応する成分を直接指定したものは同じものとして扱います
+			/// @param[in] left
+			/// @param[in] right
+			/// @retval bool
+			bool isSameViewCreateInfo(const VkImageViewCreateInfo& left, const VkImageViewCreateInfo& right)noexcept;
+		}
+	}
+}
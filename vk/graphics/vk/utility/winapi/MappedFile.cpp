@@ -0,0 +1,132 @@
+﻿#include "MappedFile.h"
+
+#include <utility>
+#include <algorithm>
+#include "../../common/Common.h"
+
+using namespace hinode::graphics;
+
+namespace hinode
+{
+	namespace winapi
+	{
+		MappedFile::MappedFile()
+			: mFile(INVALID_HANDLE_VALUE)
+			, mMapping(nullptr)
+			, mpData(nullptr)
+			, mSize(0)
+		{ }
+
+		MappedFile::MappedFile(MappedFile&& right)noexcept
+			: MappedFile()
+		{
+			*this = std::move(right);
+		}
+
+		MappedFile& MappedFile::operator=(MappedFile&& right)noexcept
+		{
+			this->release();
+
+			this->mFile = right.mFile;
+			this->mMapping = right.mMapping;
+			this->mpData = right.mpData;
+			this->mSize = right.mSize;
+
+			right.mFile = INVALID_HANDLE_VALUE;
+			right.mMapping = nullptr;
+			right.mpData = nullptr;
+			right.mSize = 0;
+			return *this;
+		}
+
+		MappedFile::~MappedFile()
+		{
+			this->release();
+		}
+
+		void MappedFile::release()noexcept
+		{
+			if (this->mpData) {
+				UnmapViewOfFile(this->mpData);
+				this->mpData = nullptr;
+			}
+			if (this->mMapping) {
+				CloseHandle(this->mMapping);
+				this->mMapping = nullptr;
+			}
+			if (INVALID_HANDLE_VALUE != this->mFile) {
+				CloseHandle(this->mFile);
+				this->mFile = INVALID_HANDLE_VALUE;
+			}
+			this->mSize = 0;
+		}
+
+		void MappedFile::open(const TCHAR* pPath)
+		{
+			this->release();
+
+			this->mFile = CreateFile(pPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (INVALID_HANDLE_VALUE == this->mFile) {
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(MappedFile, open, VK_ERROR_INITIALIZATION_FAILED) << "ファイルを開けませんでした error=" << GetLastError();
+			}
+
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(this->mFile, &fileSize)) {
+				auto error = GetLastError();
+				this->release();
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(MappedFile, open, VK_ERROR_INITIALIZATION_FAILED) << "ファイルの大きさを取得できませんでした error=" << error;
+			}
+			this->mSize = static_cast<uint64_t>(fileSize.QuadPart);
+			if (0 == this->mSize) {
+				//大きさ0のファイルはマップできない
+				return;
+			}
+
+			this->mMapping = CreateFileMapping(this->mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (nullptr == this->mMapping) {
+				auto error = GetLastError();
+				this->release();
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(MappedFile, open, VK_ERROR_INITIALIZATION_FAILED) << "ファイルマッピングの作成に失敗しました error=" << error;
+			}
+
+			this->mpData = static_cast<const uint8_t*>(MapViewOfFile(this->mMapping, FILE_MAP_READ, 0, 0, 0));
+			if (nullptr == this->mpData) {
+				auto error = GetLastError();
+				this->release();
+				throw HINODE_GRAPHICS_CREATE_EXCEPTION(MappedFile, open, VK_ERROR_INITIALIZATION_FAILED) << "ファイルのマップに失敗しました error=" << error;
+			}
+		}
+
+		void MappedFile::prefetch(uint64_t offset, uint64_t size)const noexcept
+		{
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+			if (nullptr == this->mpData || this->mSize <= offset) {
+				return;
+			}
+			WIN32_MEMORY_RANGE_ENTRY entry;
+			entry.VirtualAddress = const_cast<uint8_t*>(this->mpData + offset);
+			entry.NumberOfBytes = static_cast<SIZE_T>(std::min(size, this->mSize - offset));
+			//失敗しても読み込みが遅くなるだけなので無視する
+			PrefetchVirtualMemory(GetCurrentProcess(), 1, &entry, 0);
+#else
+			(void)offset;
+			(void)size;
+#endif
+		}
+
+		bool MappedFile::isGood()const noexcept
+		{
+			return INVALID_HANDLE_VALUE != this->mFile;
+		}
+
+		const uint8_t* MappedFile::data()const noexcept
+		{
+			return this->mpData;
+		}
+
+		uint64_t MappedFile::size()const noexcept
+		{
+			return this->mSize;
+		}
+	}
+}
@@ -0,0 +1,54 @@
+﻿#pragma once
+
+#include <Windows.h>
+#include <cstdint>
+
+namespace hinode
+{
+	namespace winapi
+	{
+		/// @brief 読み込み専用でファイル全体をメモリにマップするクラス
+		///
+		/// ファイルの内容はアクセスしたページからOSが読み込むので、ヒープに読み込み用のバッファを持つ必要がありません。
+		/// 先頭から順に読むことを前提にFILE_FLAG_SEQUENTIAL_SCANで開きます
+		class MappedFile
+		{
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+
+		public:
+			MappedFile();
+			MappedFile(MappedFile&& right)noexcept;
+			MappedFile& operator=(MappedFile&& right)noexcept;
+			~MappedFile();
+
+			void release()noexcept;
+
+			/// @brief ファイルを開いてマップする
+			///
+			/// 大きさが0のファイルは開けますが、data()はnullptrを返します
+			/// @param[in] pPath
+			/// @exception HVKException
+			void open(const TCHAR* pPath);
+
+			/// @brief 範囲をあらかじめ読み込むようOSに頼む
+			///
+			/// PrefetchVirtualMemoryが使える環境でのみ効果があり、読み込みの完了は待ちません。
+			/// 転送中に次の範囲を読み込ませておくことで、ディスクの読み込みとGPUの転送を重ねられます
+			/// @param[in] offset
+			/// @param[in] size
+			void prefetch(uint64_t offset, uint64_t size)const noexcept;
+
+		public:
+			bool isGood()const noexcept;
+			const uint8_t* data()const noexcept;
+			uint64_t size()const noexcept;
+
+		private:
+			HANDLE mFile;
+			HANDLE mMapping;
+			const uint8_t* mpData;
+			uint64_t mSize;
+		};
+	}
+}
@@ -0,0 +1,97 @@
+﻿#include "HostAllocatorBenchmark.h"
+
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+#include <graphics\vk\hostAllocator\HVKHostAllocator.h>
+#include <graphics\vk\threadCachedHostAllocator\HVKThreadCachedHostAllocator.h>
+
+namespace
+{
+	/// @brief threadCount個のスレッドで作成と破棄を繰り返し、1秒あたりの回数を返す
+	double measure(VkDevice device, const VkAllocationCallbacks* pCallbacks, uint32_t threadCount, uint32_t iterationPerThread)
+	{
+		//同時に生きているものがあるほうが実際の使い方に近いので、少し溜めてからまとめて破棄する
+		const size_t batchSize = 16;
+
+		std::atomic<uint32_t> readyCount(0);
+		std::atomic<bool> isStart(false);
+		std::atomic<uint32_t> failedCount(0);
+		auto work = [&]() {
+			VkBufferCreateInfo info = {};
+			info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+			info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			std::vector<VkBuffer> buffers;
+			buffers.reserve(batchSize);
+			readyCount.fetch_add(1);
+			while (!isStart.load()) {
+				std::this_thread::yield();
+			}
+			for (auto i = 0u; i < iterationPerThread; ++i) {
+				info.size = 256 + (i % 16) * 256;
+				VkBuffer buffer = nullptr;
+				if (VK_SUCCESS != vkCreateBuffer(device, &info, pCallbacks, &buffer)) {
+					failedCount.fetch_add(1);
+					break;
+				}
+				buffers.push_back(buffer);
+				if (batchSize <= buffers.size()) {
+					for (auto& b : buffers) {
+						vkDestroyBuffer(device, b, pCallbacks);
+					}
+					buffers.clear();
+				}
+			}
+			for (auto& b : buffers) {
+				vkDestroyBuffer(device, b, pCallbacks);
+			}
+		};
+
+		std::vector<std::thread> threads;
+		threads.reserve(threadCount);
+		for (auto i = 0u; i < threadCount; ++i) {
+			threads.emplace_back(work);
+		}
+		while (readyCount.load() < threadCount) {
+			std::this_thread::yield();
+		}
+		auto start = std::chrono::steady_clock::now();
+		isStart.store(true);
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (0 < failedCount.load() || seconds <= 0.0) {
+			return 0.0;
+		}
+		return static_cast<double>(threadCount) * iterationPerThread / seconds;
+	}
+}
+
+void runHostAllocatorBenchmark(VkDevice device, uint32_t maxThreadCount, uint32_t iterationPerThread, std::ostream& out)
+{
+	using namespace hinode::graphics;
+
+	if (0 == maxThreadCount) {
+		maxThreadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	out << "host allocator benchmark: vkCreateBuffer/vkDestroyBuffer per second" << std::endl;
+	out << "threads\tdriver\thostAllocator\tthreadCached" << std::endl;
+	for (auto threadCount = 1u; threadCount <= maxThreadCount; threadCount *= 2) {
+		//アロケータは計測ごとに作り直し、前の計測で温まったキャッシュを持ち越さない
+		HVKHostAllocator hostAllocator;
+		HVKThreadCachedHostAllocator threadCachedAllocator;
+		auto hostCallbacks = hostAllocator.callbacks();
+		auto threadCachedCallbacks = threadCachedAllocator.callbacks();
+		auto driver = measure(device, nullptr, threadCount, iterationPerThread);
+		auto host = measure(device, &hostCallbacks, threadCount, iterationPerThread);
+		auto threadCached = measure(device, &threadCachedCallbacks, threadCount, iterationPerThread);
+		out << threadCount << "\t" << driver << "\t" << host << "\t" << threadCached << std::endl;
+	}
+}
@@ -0,0 +1,14 @@
+﻿#pragma once
+
+#include <ostream>
+#include <vulkan\vulkan.h>
+
+/// @brief ホスト側アロケータごとに、複数のスレッドからバッファの作成と破棄を繰り返したときの速さを測る
+///
+/// ドライバ既定の割り当て、HVKHostAllocator、HVKThreadCachedHostAllocatorの順に、
+/// スレッド数を1から倍々に増やして1秒あたりの作成と破棄の回数を出力します。
+/// @param[in] device
+/// @param[in] maxThreadCount 0ならstd::thread::hardware_concurrency()
+/// @param[in] iterationPerThread スレッドごとに作成と破棄を繰り返す回数
+/// @param[out] out 結果の出力先
+void runHostAllocatorBenchmark(VkDevice device, uint32_t maxThreadCount, uint32_t iterationPerThread, std::ostream& out);
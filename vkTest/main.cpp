@@ -1,4 +1,5 @@
 #include <iostream>
+#include <cstring>
 
 #include <graphics\vk\KHR\DefineKHRPlatform.h>
 #include <graphics\vk\common\Common.h>
@@ -11,6 +12,9 @@
 #include <graphics\vk\KHR\surface\HVKSurfaceKHR.h>
 #include <graphics\vk\image\HVKImage.h>
 #include <graphics\vk\deviceMemory\HVKDeviceMemory.h>
+#include <graphics\vk\deviceMemoryHeap\HVKDeviceMemoryHeap.h>
+#include <graphics\vk\memoryStatistics\HVKMemoryStatistics.h>
+#include <graphics\vk\mappedRangeBatch\HVKMappedRangeBatch.h>
 #include <graphics\vk\buffer\HVKBuffer.h>
 #include <graphics\vk\pipelineLayout\HVKPipelineLayout.h>
 #include <graphics\vk\descriptorSetLayout\HVKDescriptorSetLayout.h>
@@ -18,10 +22,14 @@
 #include <graphics\vk\descriptorSets\HVKDescriptorSets.h>
 #include <graphics\vk\semaphore\HVKSemaphore.h>
 #include <graphics\vk\renderPass\HVKRenderPass.h>
+#include <graphics\vk\stagingUploader\HVKStagingUploader.h>
+#include <graphics\vk\hostAllocator\HVKHostAllocator.h>
+#include <graphics\vk\profilingHostAllocator\HVKProfilingHostAllocator.h>
 
 #include <graphics\vk\utility\math\SimpleMath.h>
 
 #include "winapi\VKWindow\VKWindow.h"
+#include "benchmark\HostAllocatorBenchmark.h"
 
 using namespace std;
 
@@ -32,6 +40,13 @@ int main(int argc, char** args)
 
 	Log::sStandbyLogFile();
 
+	//hCõzXg̊蓖Ăgݍ݂̃v[ƃA[iōs
+	HVKAllocationCallbacks::sSetDefaultCallbacks(HVKHostAllocator::sGetBuiltin());
+
+	//foCXhCoɗvzXg̊蓖ĂWv. gIuWFNgɍĂ
+	//TvȂ̂ŎL^
+	HVKProfilingHostAllocator hostProfiler(nullptr, true);
+
 	try {
 		VKWindow window;
 		{
@@ -74,6 +89,7 @@ int main(int argc, char** args)
 		//auto props = gpu.getProperties();
 
 		HVKDeviceQueueCreateInfo queueInfo;
+		HVKDeviceQueueCreateInfo transferQueueInfo;
 		{
 			auto queueFamilyProps = gpu.getQueueFamilyProperties();
 
@@ -82,11 +98,20 @@ int main(int argc, char** args)
 
 			auto supportsPresent = surface.getSupportPresentOfAllQueueFamily(gpu);
 			queueInfo.setQueueFamilyIndexAndPresentQueueIndex(queueFamilyProps, supportsPresent);
+
+			//]p̃L[΃Abv[h͂ōsA`ƕs
+			auto transferQueueFamilyIndex = HVKDeviceQueueCreateInfo::sFindTransferQueueFamilyIndex(queueFamilyProps, queueInfo.queueFamilyIndex);
+			transferQueueInfo = HVKDeviceQueueCreateInfo(transferQueueFamilyIndex, 1);
+			transferQueueInfo.setQueuePriorities({ 0.f });
 		}
 
 		HVKDevice device;
+		device.setCallbacks(hostProfiler.callbacksPointer(HVKProfilingHostAllocator::eOWNER_DEVICE));
 		{
-			HVKDeviceCreateInfo deviceCreateInfo(&queueInfo, 1);
+			//炸ɕ`Ɠt@~[ɂȂƂ͕`̃L[ĝŁAǉŗvȂ
+			VkDeviceQueueCreateInfo queueInfos[] = { queueInfo, transferQueueInfo };
+			auto queueInfoCount = queueInfo.queueFamilyIndex != transferQueueInfo.queueFamilyIndex ? 2u : 1u;
+			HVKDeviceCreateInfo deviceCreateInfo(queueInfos, queueInfoCount);
 			auto deviceProps = gpu.getDeviceExtensionProperties();
 			std::vector<const char*> devicePropNames = {"VK_KHR_swapchain"};
 			deviceCreateInfo.enabledExtensionCount = static_cast<decltype(deviceCreateInfo.enabledExtensionCount)>(devicePropNames.size());
@@ -94,6 +119,14 @@ int main(int argc, char** args)
 			device.create(gpu, &deviceCreateInfo);
 		}
 
+		//--bench-host-allocatornƂ̓zXgAP[^̌vsďI
+		for (auto i = 1; i < argc; ++i) {
+			if (0 == strcmp(args[i], "--bench-host-allocator")) {
+				runHostAllocatorBenchmark(device.device(), 0, 20000, cout);
+				return 0;
+			}
+		}
+
 		HVKCommandPool commandPool;
 		{
 			HVKCommandPoolCreateInfo poolInfo(queueInfo.queueFamilyIndex, 0);
@@ -109,80 +142,92 @@ int main(int argc, char** args)
 		VkFormat surfaceFormat;
 		VkExtent2D swapchainExtent;
 		HVKSwapChainKHR swapchain;
-		std::vector<HVKImage> images;
+		std::vector<VkSurfaceFormatKHR> surfaceFormats;
+		VkSurfaceCapabilitiesKHR surfaceCapabilities;
+		std::vector<VkPresentModeKHR> presentModes;
+		//蒼ƂɂĝŎcĂ
+		HVKSwapchainCreateInfoKHR swapchainCreateInfo = HVKSwapchainCreateInfoKHR::sCreate(surfaceFormats, surfaceCapabilities, presentModes, gpu, surface);
 		{
-			std::vector<VkSurfaceFormatKHR> surfaceFormats;
-			VkSurfaceCapabilitiesKHR surfaceCapabilities;
-			std::vector<VkPresentModeKHR> presentModes;
-			HVKSwapchainCreateInfoKHR swapchainCreateInfo = HVKSwapchainCreateInfoKHR::sCreate(surfaceFormats, surfaceCapabilities, presentModes, gpu, surface);
 			if (queueInfo.queueFamilyIndex != queueInfo.presentQueueFamilyIndex) {
 				swapchainCreateInfo.setQueueFamilyIndices({ queueInfo.queueFamilyIndex, queueInfo.presentQueueFamilyIndex });
 			}
+			//C[Wƃr[̓Xbv`FC\g
 			swapchain.create(device, &swapchainCreateInfo);
 			surfaceFormat = swapchainCreateInfo.imageFormat;
-
-			std::vector<VkImage> rawImages = swapchain.getAllImages();
-			images = HVKImage::sConvert(device, rawImages.data(), static_cast<uint32_t>(rawImages.size()));
-			for (auto& image : images) {
-				HVKImageViewCreateInfo viewInfo(VK_IMAGE_VIEW_TYPE_2D, swapchainCreateInfo.imageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
-				image.addView(&viewInfo);
-			}
-			rawImages.clear();
-
 			swapchainExtent = swapchainCreateInfo.imageExtent;
 		}
 
 		auto deviceMemoryProps = gpu.getMemoryProperties();
 
-		VkFormat depthFormat;
-		HVKImage depthBuffer;
-		HVKDeviceMemory depthBufferMemory;
+		HVKDeviceMemoryHeap memoryHeap;
+		auto deviceLimits = gpu.getProperties().limits;
+		memoryHeap.create(device, deviceMemoryProps, deviceLimits.bufferImageGranularity, deviceLimits.nonCoherentAtomSize);
+
+		//Abv[h͓]p̃L[ɒoA`̃L[̃t@~[֏Lڂ. t@~[Ȃڏ͂Ȃ
+		HVKStagingUploader uploader;
 		{
-			HVKImageCreateInfo imageInfo = HVKImageCreateInfo::sMake2D(VK_FORMAT_D16_UNORM, swapchainExtent.width, swapchainExtent.height);
-			imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-			auto formatProps = gpu.getFormatProperties(imageInfo.format);
-			imageInfo.tiling = HVKImageCreateInfo::sCheckTiling(formatProps, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
-			assert(imageInfo.tiling != VK_IMAGE_TILING_MAX_ENUM);
+			auto transferQueue = device.getQueue(transferQueueInfo.queueFamilyIndex, 0);
+			uploader.create(device, deviceMemoryProps, deviceLimits, transferQueue, transferQueueInfo.queueFamilyIndex, 4 * 1024 * 1024, 2, queueInfo.queueFamilyIndex);
+		}
+
+		const VkFormat depthFormat = VK_FORMAT_D16_UNORM;
+		HVKImage depthBuffer;
+		HVKMemoryAllocation depthBufferMemory;
+		//Xbv`FC蒼Ƃɂ̑傫ō蒼
+		auto createDepthBuffer = [&]() {
+			//ɃC[Wj
+			depthBuffer.release();
+			memoryHeap.free(depthBufferMemory);
+
+			//[x̓_[pX̊Oœǂ܂Ȃ̂ŁAx蓖Ẵɒu悤TRANSIENTɂ
+			HVKImageCreateInfo imageInfo = HVKImageCreateInfo::sMakeTransientAttachment(depthFormat, swapchainExtent.width, swapchainExtent.height, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
 			depthBuffer.create(device, &imageInfo);
-			depthFormat = imageInfo.format;
-
-			auto memoryRequirements = depthBuffer.getMemoryRequirements();
-			HVKMemoryAllocateInfo memAlloInfo;
-			memAlloInfo.allocationSize = memoryRequirements.size;
-			memAlloInfo.memoryTypeIndex = HVKMemoryAllocateInfo::sCheckMemmoryType(deviceMemoryProps, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			assert(memAlloInfo.memoryTypeIndex != -1);
-			depthBufferMemory.create(device, &memAlloInfo);
+
+			//x蓖Ẵ^CvȂΒʏDEVICE_LOCALȃɂȂ
+			depthBufferMemory = memoryHeap.allocateForTransientImage(depthBuffer);
 			depthBufferMemory.bindImage(depthBuffer);
 
 			HVKImageViewCreateInfo viewInfo(VK_IMAGE_VIEW_TYPE_2D, imageInfo.format, VK_IMAGE_ASPECT_DEPTH_BIT);
 			depthBuffer.addView(&viewInfo);
+		};
+		{
+			auto formatProps = gpu.getFormatProperties(depthFormat);
+			assert(formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+			createDepthBuffer();
 		}
 
 		const VkDeviceSize uniformBufferSize = sizeof(float4x4);
 		HVKBuffer uniformBuf;
-		HVKDeviceMemory uniformBufMemory;
+		HVKMemoryAllocation uniformBufMemory;
 		{
 			HVKBufferCreateInfo bufInfo(sizeof(float4x4), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
 			uniformBuf.create(device, &bufInfo);
 
 			auto memoryRequirements = uniformBuf.getMemoryRequirements();
-			HVKMemoryAllocateInfo memAllocInfo;
-			memAllocInfo.allocationSize = memoryRequirements.size;
-			memAllocInfo.memoryTypeIndex = HVKMemoryAllocateInfo::sCheckMemmoryType(deviceMemoryProps, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			assert(memAllocInfo.memoryTypeIndex != -1);
-			uniformBufMemory.create(device, &memAllocInfo);
+			//HOST_COHERENTłȂĂHVKMappedRangeBatchŃtbV΂悢̂ŁAzXg猩邱Ƃv
+			uniformBufMemory = memoryHeap.allocate(memoryRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, 0, 0, HVKDeviceMemoryHeap::eRESOURCE_TYPE_LINEAR);
 
-			uint8_t* pData;
-			auto ret = uniformBufMemory.map((void**)&pData, 0, memoryRequirements.size, 0);
-			assert(VK_SUCCESS == ret);
+			//zXg猩郁̓q[vɃ}bvĂ̂ŁÂ܂܏߂
+			auto* pData = static_cast<uint8_t*>(uniformBufMemory.pMappedData);
+			assert(nullptr != pData);
 
 			//memcpy(pData, matrix, sizeof(matrix));
 
-			uniformBufMemory.unmap();
+			HVKMappedRangeBatch mappedRanges;
+			mappedRanges.create(device, deviceMemoryProps, deviceLimits.nonCoherentAtomSize);
+			mappedRanges.addFlush(uniformBufMemory);
+			mappedRanges.flush();
 
 			uniformBufMemory.bindBuffer(uniformBuf);
 		}
 
+		{
+			HVKMemoryStatistics memoryStatistics;
+			memoryStatistics.create(instance, gpu, device, false);
+			cout << memoryStatistics.toJson(&memoryHeap) << endl;
+			cout << hostProfiler.toJson() << endl;
+		}
+
 		HVKDescriptorSetLayout descSetLayout;
 		HVKPipelineLayout pipelineLayout;
 		{
@@ -239,7 +284,7 @@ int main(int argc, char** args)
 				HVKAttachmentDescription()
 					.setFormat(depthFormat)
 					.setSampleCount(VK_SAMPLE_COUNT_1_BIT)
-					.setOp(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE)
+					.setTransientOp(VK_ATTACHMENT_LOAD_OP_CLEAR)
 					.setLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL),
 			};
 
@@ -255,9 +300,28 @@ int main(int argc, char** args)
 			renderPass.create(device, &renderPassInfo);
 		}
 
-		auto currentBackbufferIndex = swapchain.acquireNextImage(UINT64_MAX, semaphore, nullptr);
-
-		images.clear();
+		uint32_t currentBackbufferIndex;
+		try {
+			currentBackbufferIndex = swapchain.acquireNextImage(UINT64_MAX, semaphore, nullptr);
+		} catch (HVKException& e) {
+			if (VK_ERROR_OUT_OF_DATE_KHR != e.result()) {
+				throw;
+			}
+			//EBhȆ傫ςĂ獡̑傫ō蒼. \recreate̒ōXV
+			e.offAutoWroteLog();
+			swapchainCreateInfo.imageExtent = HVKSwapChainKHR::sGetPhysicalDeviceSurfaceCapabilities(gpu, surface).currentExtent;
+			swapchain.recreate(&swapchainCreateInfo);
+			swapchainExtent = swapchainCreateInfo.imageExtent;
+			//[xobt@Xbv`FCƓ傫ō蒼.
+			//̃Tv͂܂t[obt@ĂȂAƂ͂ŃXbv`FC̃r[Ɛ[x̃r[蒼
+			createDepthBuffer();
+			currentBackbufferIndex = swapchain.acquireNextImage(UINT64_MAX, semaphore, nullptr);
+		}
+		auto& backbuffer = swapchain.image(currentBackbufferIndex);
+		auto backbufferView = swapchain.imageView(currentBackbufferIndex);
+		assert(backbuffer.isGood() && VK_NULL_HANDLE != backbufferView);
+		(void)backbuffer;
+		(void)backbufferView;
 
 		window.mainLoop();
 